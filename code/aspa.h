@@ -9,6 +9,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <math.h>
 #include <assert.h>
 #include <gsl/gsl_math.h>
@@ -21,6 +22,7 @@
 #include <gsl/gsl_cdf.h>
 #include <gsl/gsl_sf.h>
 #include <gsl/gsl_histogram.h>
+#include <gsl/gsl_rng.h>
 
 gsl_vector * aspa_raw_fscanf(FILE * STREAM, double sampling_frequency);
 
@@ -36,7 +38,12 @@ gsl_vector * aspa_raw_fscanf(FILE * STREAM, double sampling_frequency);
  *  The latter will be 1 if no aggregation has been performed and
  *  will contain the number of aggregated trials otherwise.
  *  sta stands for: spike train array.
+ *  Quantities derived from the spike trains (number of spikes, ISI,
+ *  aggregated train...) can be kept in an optional cache, see
+ *  `aspa_sta_cache_enable`.
 */
+struct aspa_sta_cache;
+
 typedef struct
 {
   size_t n_trials; //!< Number of trials
@@ -46,6 +53,7 @@ typedef struct
   double trial_duration; //!< Single trial duration (s)
   double * trial_start_time; //!< Vector holding the actual start time of each trial
   gsl_vector ** st; //!< The spike trains
+  struct aspa_sta_cache * cache; //!< Derived quantities (NULL if not cached)
 } aspa_sta;
 
 aspa_sta * aspa_sta_alloc(size_t n_trials, size_t n_aggregated, double onset, double offset, double trial_duration);
@@ -58,6 +66,12 @@ double aspa_sta_get_st_start(const aspa_sta * sta, size_t st_index);
 
 int aspa_sta_set_st_start(aspa_sta * sta, size_t st_index, double time);
 
+int aspa_sta_cache_enable(aspa_sta * sta);
+
+void aspa_sta_cache_invalidate(aspa_sta * sta);
+
+int aspa_sta_cache_disable(aspa_sta * sta);
+
 aspa_sta * aspa_sta_from_raw(gsl_vector * raw, double inter_trial_interval, double onset, double offset, double trial_duration);
 
 int aspa_sta_fprintf(FILE * stream, const aspa_sta * sta, bool flat);
@@ -78,11 +92,11 @@ aspa_sta * aspa_sta_fread(FILE * STREAM);
 
 aspa_sta * aspa_sta_aggregate(const aspa_sta * sta);
 
-void aspa_cp_plot_i(const aspa_sta * sta, bool flat, bool normalized);
+int aspa_cp_plot_i(const aspa_sta * sta, bool flat, bool normalized);
 
 int aspa_cp_plot_g(FILE * STREAM, const aspa_sta * sta, bool flat, bool normalized);
 
-void aspa_raster_plot_i(const aspa_sta * sta);
+int aspa_raster_plot_i(const aspa_sta * sta);
 
 int aspa_raster_plot_g(FILE * STREAM, const aspa_sta * sta);
 
@@ -129,6 +143,642 @@ double aspa_adinf(double z);
 
 int aspa_durbin_modification(const gsl_vector * seq, gsl_vector * res);
 
-void aspa_lagged_rank_plot_i(const aspa_sta * sta, size_t lag);
+gsl_permutation * aspa_sta_isi_rank(const aspa_sta * sta);
+
+int aspa_lagged_rank_plot_i(const aspa_sta * sta, size_t lag);
 
 int aspa_lagged_rank_plot_g(FILE * STREAM, const aspa_sta * sta, size_t lag);
+
+double aspa_bayesian_blocks_ncp_prior(size_t n, double p0);
+
+gsl_histogram * aspa_bayesian_blocks(const gsl_vector * data, bool sorted, double p0);
+
+/** @brief Structure holding a cross- or auto-correlogram together
+ *         with its shift and trial-shuffled predictors
+ *
+ *  The lags, t_b - t_a, are binned over [-max_lag,max_lag), bin k
+ *  covering [-max_lag+k*bin_width,-max_lag+(k+1)*bin_width).
+*/
+typedef struct
+{
+  size_t n_bins; //!< Number of bins
+  size_t n_trials; //!< Number of trials used
+  double bin_width; //!< Bin width (s)
+  double max_lag; //!< Largest lag, a multiple of bin_width (s)
+  gsl_vector * raw; //!< Pair counts summed over trials
+  gsl_vector * shift; //!< Shift predictor (trial i vs trial i+1)
+  gsl_vector * shuffled; //!< Mean trial-shuffled predictor (trial i vs trials j != i)
+} aspa_ccg;
+
+aspa_ccg * aspa_ccg_alloc(double max_lag, double bin_width);
+
+int aspa_ccg_free(aspa_ccg * ccg);
+
+aspa_ccg * aspa_correlogram(const aspa_sta * sta_a, const aspa_sta * sta_b, double max_lag, double bin_width);
+
+aspa_ccg * aspa_autocorrelogram(const aspa_sta * sta, double max_lag, double bin_width);
+
+int aspa_ccg_fprintf(FILE * STREAM, const aspa_ccg * ccg);
+
+/** @brief Structure holding the binned trials of an aspa_sta packed
+ *         as bits
+ *
+ *  Bin k of trial i is occupied if at least one spike fell in it. With
+ *  the dense representation (rle == false), it is bit k%64 of word
+ *  bits[i*n_words+k/64]. With the run-length representation (rle == true),
+ *  used for very sparse trains, the runs of consecutive occupied bins of
+ *  trial i are the elements run_offset[i] to run_offset[i+1]-1 of
+ *  run_start and run_length.
+*/
+typedef struct
+{
+  size_t n_trials; //!< Number of trials
+  size_t n_bins; //!< Number of bins per trial
+  size_t n_words; //!< Number of 64 bits words per trial
+  double bin_width; //!< Bin width (s)
+  size_t n_multiple; //!< Number of bins that contained more than one spike
+  bool rle; //!< Is the run-length representation used?
+  uint64_t * bits; //!< The packed bins (dense representation)
+  size_t * run_offset; //!< First run of each trial (run-length representation)
+  size_t * run_start; //!< First bin of each run (run-length representation)
+  size_t * run_length; //!< Number of bins of each run (run-length representation)
+} aspa_bitset;
+
+aspa_bitset * aspa_bitset_alloc(size_t n_trials, size_t n_bins, double bin_width, bool rle);
+
+int aspa_bitset_free(aspa_bitset * bs);
+
+aspa_bitset * aspa_sta_to_bitset(const aspa_sta * sta, double bin_width);
+
+size_t aspa_bitset_count(const aspa_bitset * bs, size_t t_idx, size_t from, size_t to);
+
+gsl_matrix * aspa_bitset_window_counts(const aspa_bitset * bs, size_t window);
+
+gsl_vector * aspa_bitset_fano(const aspa_bitset * bs, size_t window);
+
+size_t aspa_bitset_coincidences(const aspa_bitset * a, size_t a_idx, const aspa_bitset * b, size_t b_idx);
+
+gsl_matrix * aspa_bitset_coincidence_matrix(const aspa_bitset * a, const aspa_bitset * b);
+
+int aspa_bitset_fwrite(FILE * stream, const aspa_bitset * bs);
+
+aspa_bitset * aspa_bitset_fread(FILE * STREAM);
+
+/** Default number of pixel columns of the interactive plots */
+#define ASPA_LOD_WIDTH 2048
+
+/** @brief Structure holding a multi-resolution (level of detail)
+ *         version of a raster or counting process plot
+ *
+ *  The plot is made of n_series series of points sorted by abscissa
+ *  (one per trial or a single one for the "flat" and "normalized"
+ *  counting processes). Level l holds the series decimated on
+ *  base_width 2^l pixel columns over [x_min,x_max]: the points of series s
+ *  are elements n_points[l][s] to n_points[l][s+1]-1 of x[l] and y[l].
+ *  The description of the aspa_sta the plot comes from is kept so that
+ *  the plot can be drawn without it.
+*/
+typedef struct
+{
+  size_t n_trials; //!< Number of trials
+  size_t n_aggregated; //!< Number of "real trials" aggregated per "trial"
+  double onset; //!< Stimulus onset time (s)
+  double offset; //!< Stimulus offset time (s)
+  double trial_duration; //!< Single trial duration (s)
+  bool cp; //!< Counting process (true) or raster (false) plot
+  bool flat; //!< Counting process on the actual time
+  bool normalized; //!< Mean counting process
+  double x_min; //!< Left end of the full display
+  double x_max; //!< Right end of the full display
+  double y_max; //!< Largest ordinate of the full display
+  size_t n_series; //!< Number of series
+  size_t base_width; //!< Number of columns of level 0
+  size_t n_levels; //!< Number of levels
+  size_t ** n_points; //!< Series offsets of each level
+  double ** x; //!< Abscissae of each level
+  double ** y; //!< Ordinates of each level
+} aspa_lod;
+
+size_t aspa_lod_decimate(const double * x, const double * y, size_t n, double x_min, double x_max, size_t width, double * x_out, double * y_out);
+
+aspa_lod * aspa_lod_raster(const aspa_sta * sta, size_t base_width, size_t n_levels);
+
+aspa_lod * aspa_lod_cp(const aspa_sta * sta, bool flat, bool normalized, size_t base_width, size_t n_levels);
+
+int aspa_lod_free(aspa_lod * lod);
+
+size_t aspa_lod_query(const aspa_lod * lod, size_t s_idx, double from, double to, size_t width, double * x, double * y);
+
+int aspa_lod_fprintf(FILE * STREAM, const aspa_lod * lod, double from, double to, size_t width);
+
+int aspa_lod_plot_i(const aspa_lod * lod, double from, double to, size_t width);
+
+int aspa_lod_fwrite(FILE * stream, const aspa_lod * lod);
+
+aspa_lod * aspa_lod_fread(FILE * STREAM);
+
+FILE * aspa_gp_session(void);
+
+FILE * aspa_gp_window(void);
+
+int aspa_gp_end(FILE * gp);
+
+int aspa_gp_binary_spec(FILE * gp, size_t n);
+
+int aspa_gp_binary_write(FILE * gp, const double * x, const double * y, size_t n);
+
+int aspa_gp_close(void);
+
+/** @brief Structure holding a plot rendered in memory
+ *
+ *  The plot area is plot_width x plot_height pixels, its pixel (r,c)
+ *  (row 0 at the top) counting the hits in count[r plot_width + c].
+ *  The grey level image (frame, stimulus box, labels included) is
+ *  only built when the plot is written.
+*/
+typedef struct
+{
+  size_t width; //!< Image width (pixels)
+  size_t height; //!< Image height (pixels)
+  size_t plot_width; //!< Plot area width (pixels)
+  size_t plot_height; //!< Plot area height (pixels)
+  size_t left; //!< Left margin, the plot area starts at column left (pixels)
+  double x_min; //!< Left end of the abscissa
+  double x_max; //!< Right end of the abscissa
+  double y_min; //!< Bottom end of the ordinate
+  double y_max; //!< Top end of the ordinate
+  double box_from; //!< Left end of the stimulus box (no box if >= box_to)
+  double box_to; //!< Right end of the stimulus box
+  uint32_t * count; //!< Hits per plot area pixel
+  char title[64]; //!< Title
+  char xlabel[32]; //!< Abscissa label
+  char ylabel[32]; //!< Ordinate label
+} aspa_image;
+
+aspa_image * aspa_image_alloc(size_t width, size_t height, double x_min, double x_max, double y_min, double y_max);
+
+int aspa_image_free(aspa_image * img);
+
+aspa_image * aspa_raster_image(const aspa_sta * sta, size_t width, size_t height);
+
+aspa_image * aspa_cp_image(const aspa_sta * sta, bool flat, bool normalized, size_t width, size_t height);
+
+aspa_image * aspa_lagged_rank_image(const aspa_sta * sta, size_t lag, size_t width, size_t height);
+
+int aspa_image_png(FILE * stream, const aspa_image * img);
+
+int aspa_image_svg(FILE * stream, const aspa_image * img);
+
+gsl_vector * aspa_sim_poisson(const gsl_rng * rng, size_t n, double rate);
+
+gsl_vector * aspa_sim_gamma(const gsl_rng * rng, size_t n, double rate, double shape);
+
+gsl_vector * aspa_sim_thinning(const gsl_rng * rng, size_t n, double (* intensity)(double t, void * params), void * params, double rate_max);
+
+gsl_vector * aspa_sim_bursting(const gsl_rng * rng, size_t n, double burst_rate, double spikes_per_burst, double intra_rate);
+
+aspa_sta * aspa_sim_sta(const gsl_vector * train, double trial_duration);
+
+/** @brief Structure holding the profile of an instrumented function
+ *
+ *  See aspa_profile.c, the members are updated atomically.
+*/
+typedef struct aspa_prof_entry
+{
+  const char * name; //!< Function name
+  bool registered; //!< Already in the report
+  uint64_t calls; //!< Number of calls
+  uint64_t ns; //!< Time spent (ns)
+  uint64_t spikes; //!< Spikes processed
+  uint64_t bytes; //!< Bytes parsed or written
+  uint64_t allocs; //!< Number of allocations
+  uint64_t alloc_bytes; //!< Bytes allocated
+  uint64_t cycles; //!< CPU cycles (hardware counter)
+  uint64_t instructions; //!< Instructions (hardware counter)
+  struct aspa_prof_entry * next; //!< Next entry of the report
+} aspa_prof_entry;
+
+/** Structure holding an open profiling scope */
+typedef struct
+{
+  aspa_prof_entry * entry; //!< The entry (NULL if profiling is disabled)
+  uint64_t start_ns; //!< Start time (ns)
+  uint64_t start_hw[2]; //!< Hardware counters at the start
+} aspa_prof_scope;
+
+bool aspa_profile_init(const char * program);
+
+aspa_prof_scope aspa_prof_scope_begin(aspa_prof_entry * entry, const char * name);
+
+void aspa_prof_scope_end(aspa_prof_scope * scope);
+
+void aspa_prof_count(aspa_prof_scope * scope, int counter, uint64_t value);
+
+#ifdef ASPA_PROFILE
+/** Profiles the enclosing function until it returns */
+#define ASPA_PROF_SCOPE()						\
+  static aspa_prof_entry aspa_prof_entry_;				\
+  aspa_prof_scope aspa_prof_scope_ __attribute__((cleanup(aspa_prof_scope_end))) = \
+    aspa_prof_scope_begin(&aspa_prof_entry_,__func__)
+/** Counts n spikes processed in the current scope */
+#define ASPA_PROF_SPIKES(n) aspa_prof_count(&aspa_prof_scope_,0,(n))
+/** Counts n bytes parsed or written in the current scope */
+#define ASPA_PROF_BYTES(n) aspa_prof_count(&aspa_prof_scope_,1,(n))
+/** Counts an allocation of n bytes in the current scope */
+#define ASPA_PROF_ALLOC(n) aspa_prof_count(&aspa_prof_scope_,2,(n))
+#else
+#define ASPA_PROF_SCOPE()
+#define ASPA_PROF_SPIKES(n)
+#define ASPA_PROF_BYTES(n)
+#define ASPA_PROF_ALLOC(n)
+#endif
+
+/** Error codes of the library, see aspa_ctx.c */
+enum
+{
+  ASPA_SUCCESS = 0, //!< Everything went fine
+  ASPA_FAILURE = -1, //!< Unspecified failure
+  ASPA_EINVAL = -2, //!< Invalid argument or data
+  ASPA_ENOMEM = -3, //!< Allocation failure
+  ASPA_EIO = -4, //!< Read or write error
+  ASPA_EFORMAT = -5 //!< Badly formatted input
+};
+
+/** @brief Structure holding the context of the library calls made
+ *         by a thread
+ *
+ *  See aspa_ctx.c. A zero initialized context uses malloc and free
+ *  for the temporary buffers and writes the error messages to the
+ *  stderr.
+*/
+typedef struct
+{
+  void * (* alloc)(size_t size, void * state); //!< Allocator of the temporary buffers (malloc if NULL)
+  void (* release)(void * ptr, void * state); //!< Deallocator of the temporary buffers (free if NULL)
+  void * alloc_state; //!< Last argument of alloc and release
+  void (* sink)(int status, const char * message, void * state); //!< Error sink (stderr if NULL)
+  void * sink_state; //!< Last argument of sink
+  int status; //!< Code of the last error (ASPA_SUCCESS if none)
+  char message[256]; //!< Message of the last error
+} aspa_ctx;
+
+aspa_ctx * aspa_ctx_attach(aspa_ctx * ctx);
+
+aspa_ctx * aspa_ctx_current(void);
+
+int aspa_ctx_error(int status, const char * format, ...) __attribute__((format(printf,2,3)));
+
+void * aspa_ctx_malloc(size_t size);
+
+void aspa_ctx_free(void * ptr);
+
+const char * aspa_strerror(int status);
+
+struct aspa_arena_block;
+
+/** @brief Structure holding an arena allocator
+ *
+ *  See aspa_arena.c. The buffers are taken from a list of blocks
+ *  and are all released at once by `aspa_arena_reset`.
+*/
+typedef struct
+{
+  struct aspa_arena_block * head; //!< Block in use (the older ones follow)
+  size_t used; //!< Number of bytes in use
+  size_t peak; //!< Largest number of bytes in use so far
+  size_t n_mallocs; //!< Number of blocks allocated so far
+} aspa_arena;
+
+aspa_arena * aspa_arena_alloc(size_t block_size);
+
+int aspa_arena_free(aspa_arena * arena);
+
+void * aspa_arena_malloc(aspa_arena * arena, size_t size);
+
+void aspa_arena_release(aspa_arena * arena, void * ptr);
+
+int aspa_arena_reset(aspa_arena * arena);
+
+void aspa_ctx_use_arena(aspa_ctx * ctx, aspa_arena * arena);
+
+/** @brief Structure holding the workspace of `aspa_fns_get_w`
+*/
+typedef struct
+{
+  size_t size; //!< Number of doubles of work
+  double * work; //!< Copy of the data
+} aspa_fns_workspace;
+
+aspa_fns_workspace * aspa_fns_workspace_alloc(size_t n);
+
+int aspa_fns_workspace_free(aspa_fns_workspace * w);
+
+double * aspa_fns_workspace_reserve(aspa_fns_workspace * w, size_t n);
+
+aspa_fns aspa_fns_get_w(const gsl_vector * data, aspa_fns_workspace * w);
+
+/** @brief Structure holding the workspace of the goodness of fit
+ *         functions
+*/
+typedef struct
+{
+  size_t size; //!< Number of doubles of work
+  double * work; //!< Sorted copy of the data or intervals
+} aspa_gof_workspace;
+
+aspa_gof_workspace * aspa_gof_workspace_alloc(size_t n);
+
+int aspa_gof_workspace_free(aspa_gof_workspace * w);
+
+double * aspa_gof_workspace_reserve(aspa_gof_workspace * w, size_t n);
+
+double aspa_Kolmogorov_D_w(const gsl_vector * data, bool sorted, const char * what, aspa_gof_workspace * w);
+
+double aspa_AndersonDarling_W2_w(const gsl_vector * data, bool sorted, aspa_gof_workspace * w);
+
+int aspa_durbin_modification_w(const gsl_vector * seq, gsl_vector * res, aspa_gof_workspace * w);
+
+/** Parallel loops with less work (trials plus spikes) run serially */
+#define ASPA_PARALLEL_MIN_WORK 65536
+
+/** Per trial function of `aspa_sta_parallel_for` */
+typedef void (* aspa_trial_fn)(const aspa_sta * sta, size_t t_idx, void * params);
+
+/** Per trial function of `aspa_sta_parallel_reduce` */
+typedef double (* aspa_trial_map)(const aspa_sta * sta, size_t t_idx, void * params);
+
+size_t aspa_pool_size(void);
+
+/** Function called on each index by `aspa_parallel_for` */
+typedef void (* aspa_index_fn)(size_t idx, void * params);
+
+int aspa_parallel_for(size_t n, size_t work, aspa_index_fn fn, void * params);
+
+int aspa_sta_parallel_for(const aspa_sta * sta, aspa_trial_fn fn, void * params);
+
+double aspa_sta_parallel_reduce(const aspa_sta * sta, aspa_trial_map map, double (* op)(double a, double b), double init, void * params);
+
+/** Smaller samples are sorted with the GSL functions */
+#define ASPA_SORT_RADIX_MIN 1024
+
+/** Larger samples are sorted in parallel */
+#define ASPA_SORT_PARALLEL_MIN (1 << 20)
+
+int aspa_sort_w(double * data, size_t n, double * work);
+
+int aspa_sort(double * data, size_t n);
+
+int aspa_sort_index(size_t * order, const double * data, size_t n);
+
+int aspa_rank(size_t * rank, const double * data, size_t n);
+
+void aspa_philox4x32(uint32_t ctr[4], const uint32_t key[2]);
+
+/** @brief Structure holding bootstrap confidence intervals of the
+ *         `aspa_fns` statistics
+*/
+typedef struct
+{
+  aspa_fns estimate; //!< Statistics of the sample
+  aspa_fns lower; //!< Lower bounds of the intervals
+  aspa_fns upper; //!< Upper bounds of the intervals
+  double level; //!< Confidence level
+  size_t n_resamples; //!< Number of bootstrap resamples
+} aspa_fns_ci;
+
+int aspa_fns_bootstrap(const gsl_vector * data, size_t n_resamples, double level, unsigned long seed, aspa_fns_ci * res);
+
+int aspa_sta_fns_bootstrap(const aspa_sta * sta, size_t n_resamples, double level, unsigned long seed, aspa_fns_ci * res);
+
+int aspa_fns_ci_fprintf(FILE * STREAM, const aspa_fns_ci * ci);
+
+double aspa_lagged_spearman_test(const gsl_vector * data, size_t lag, size_t n_permutations, unsigned long seed);
+
+/** @brief Structure holding the goodness of fit statistics of a unit
+ *
+ *  The statistics are computed on the spike times divided by the time
+ *  of the last spike of their trial, uniform under a homogeneous
+ *  Poisson hypothesis; the
+ *  p-values are the probabilities of larger statistics under that
+ *  hypothesis.
+*/
+typedef struct
+{
+  size_t n; //!< Number of rescaled times
+  double D; //!< Kolmogorov's statistic
+  double p_D; //!< Its p-value
+  double D_plus; //!< One sided statistic D+
+  double p_D_plus; //!< Its p-value
+  double D_minus; //!< One sided statistic D-
+  double p_D_minus; //!< Its p-value
+  double W2; //!< Anderson-Darling statistic
+  double p_W2; //!< Its p-value
+  double durbin_D; //!< Kolmogorov's statistic after Durbin's modification
+  double p_durbin_D; //!< Its p-value
+  double durbin_W2; //!< Anderson-Darling statistic after Durbin's modification
+  double p_durbin_W2; //!< Its p-value
+} aspa_gof;
+
+int aspa_gof_battery(const aspa_sta * const * sta, size_t n_units, aspa_gof * gof);
+
+int aspa_gof_fprintf(FILE * STREAM, const aspa_gof * gof, size_t n_units);
+
+void aspa_cdf_norm_P_array(double * res, const double * x, size_t size);
+
+void aspa_cdf_norm_Q_array(double * res, const double * x, size_t size);
+
+void aspa_cdf_ADinf_P_array(double * res, const double * z, size_t size);
+
+void aspa_cdf_AD_P_array(double * res, const int * n, const double * z, size_t size);
+
+int aspa_cdf_Kplus_array(double * res, int n, const double * d, size_t size);
+
+int aspa_durbin_modification_sorted_w(double * u, size_t n, double * work);
+
+/** @brief Kolmogorov's statistics of a sample */
+typedef struct
+{
+  double D; //!< Two sided statistic
+  double D_plus; //!< One sided statistic D+
+  double D_minus; //!< One sided statistic D-
+} aspa_ks_stats;
+
+/** @brief Kolmogorov's statistics, members of aspa_ks_stats */
+typedef enum
+{
+  ASPA_KS_D,
+  ASPA_KS_D_PLUS,
+  ASPA_KS_D_MINUS
+} aspa_ks_kind;
+
+/** A cumulative distribution function with parameters */
+typedef double (* aspa_cdf_fn)(double x, void * params);
+
+double aspa_ks_stats_select(aspa_ks_stats stats, aspa_ks_kind kind);
+
+aspa_ks_stats aspa_ks_stats_get(const gsl_vector * data, bool sorted);
+
+aspa_ks_stats aspa_ks_stats_get_w(const gsl_vector * data, bool sorted, aspa_gof_workspace * w);
+
+aspa_ks_stats aspa_ks_stats_array(const double * F, size_t n);
+
+aspa_ks_stats aspa_ks_stats_cdf(const double * x, size_t n, aspa_cdf_fn cdf, void * params);
+
+void aspa_weibull_sums(const double * y, size_t n, double k, double * s);
+
+/** @brief Kinds of piecewise intensities */
+typedef enum
+{
+  ASPA_INTENSITY_STEP, //!< Constant between the knots
+  ASPA_INTENSITY_LINEAR //!< Linear between the knots
+} aspa_intensity_kind;
+
+/** @brief Piecewise constant or linear intensity of a point process,
+ *         with the table of its integral
+*/
+typedef struct
+{
+  aspa_intensity_kind kind; //!< Constant or linear between the knots
+  size_t n; //!< Number of knots
+  double * t; //!< The increasing knots (s)
+  double * rate; //!< The intensity at the knots (Hz)
+  double * cum; //!< Integral of the intensity from t[0] to each knot
+} aspa_intensity;
+
+aspa_intensity * aspa_intensity_alloc(aspa_intensity_kind kind, const double * t, const double * rate, size_t n);
+
+int aspa_intensity_free(aspa_intensity * intensity);
+
+aspa_intensity * aspa_intensity_histogram(const gsl_histogram * h, double scale);
+
+aspa_intensity * aspa_intensity_psth(const aspa_sta * sta, double bin_width);
+
+double aspa_intensity_integral(const aspa_intensity * intensity, double x);
+
+aspa_sta * aspa_time_rescale(const aspa_sta * sta, const aspa_intensity * intensity);
+
+/** @brief Kernels of the rate curves */
+typedef enum
+{
+  ASPA_RATE_CAUSAL, //!< Window (t-width,t]
+  ASPA_RATE_CENTRED, //!< Window [t-width/2,t+width/2)
+  ASPA_RATE_EXPONENTIAL //!< Causal exponential of time constant width
+} aspa_rate_kernel;
+
+gsl_matrix * aspa_sta_rate_curve(const aspa_sta * sta, const double * widths, size_t n_widths, double step, aspa_rate_kernel kernel);
+
+/** @brief Burst detection methods */
+typedef enum
+{
+  ASPA_BURST_MAX_INTERVAL, //!< Thresholds on the intervals
+  ASPA_BURST_POISSON_SURPRISE //!< Legéndy and Salcman's Poisson surprise
+} aspa_burst_method;
+
+/** @brief Parameters of the burst detection, see aspa_bursts.c */
+typedef struct
+{
+  aspa_burst_method method;
+  double max_isi_start; //!< Max-interval: largest first interval (s)
+  double max_isi_end; //!< Max-interval: largest following intervals (s)
+  double min_ibi; //!< Max-interval: closer bursts are merged (s)
+  double min_duration; //!< Max-interval: shortest burst (s)
+  size_t min_spikes; //!< Smallest number of spikes of a burst
+  double min_surprise; //!< Poisson surprise: smallest surprise
+} aspa_burst_params;
+
+/** @brief Bursts of the trials of an aspa_sta, one element of each
+ *         array per burst
+*/
+typedef struct
+{
+  size_t n_bursts; //!< Number of bursts
+  size_t * trial; //!< Trial of the burst
+  size_t * first; //!< Index of its first spike in the trial
+  size_t * last; //!< Index of its last spike in the trial
+  double * start; //!< Time of its first spike (s)
+  double * duration; //!< Time between its first and last spikes (s)
+  double * surprise; //!< Its Poisson surprise (NaN for max-interval)
+} aspa_bursts;
+
+aspa_burst_params aspa_burst_params_default(aspa_burst_method method);
+
+aspa_bursts * aspa_bursts_detect(const aspa_sta * sta, const aspa_burst_params * params);
+
+int aspa_bursts_free(aspa_bursts * bursts);
+
+int aspa_bursts_fprintf(FILE * STREAM, const aspa_bursts * bursts);
+
+/** @brief Distances between spike trains, see aspa_distance.c */
+typedef enum
+{
+  ASPA_DIST_VICTOR_PURPURA, //!< Victor and Purpura, cost q (1/s)
+  ASPA_DIST_VAN_ROSSUM, //!< van Rossum, time constant tau (s)
+  ASPA_DIST_ISI, //!< ISI-distance of Kreuz et al
+  ASPA_DIST_SPIKE //!< SPIKE-distance of Kreuz et al
+} aspa_distance_kind;
+
+gsl_matrix * aspa_sta_distance_matrix(const aspa_sta * sta, aspa_distance_kind kind, double param);
+
+int aspa_sta_victor_purpura_matrices(const aspa_sta * sta, const double * q, size_t n_q, gsl_matrix ** res);
+
+/** @brief Renewal models of the inter spike intervals, see aspa_renewal.c */
+typedef enum
+{
+  ASPA_RENEWAL_EXPONENTIAL, //!< Mean
+  ASPA_RENEWAL_GAMMA, //!< Shape and scale
+  ASPA_RENEWAL_INVERSE_GAUSSIAN, //!< Mean and shape
+  ASPA_RENEWAL_LOGNORMAL, //!< Mean and standard deviation of the log
+  ASPA_RENEWAL_WEIBULL, //!< Shape and scale
+  ASPA_RENEWAL_N_MODELS //!< Number of models
+} aspa_renewal_model;
+
+/** @brief Maximum likelihood fit of a renewal model */
+typedef struct
+{
+  aspa_renewal_model model; //!< The model
+  double par[2]; //!< Its parameters, in the order of aspa_renewal_model (NaN if unused)
+  double loglik; //!< Maximal log-likelihood
+  double aic; //!< Akaike's information criterion
+  double bic; //!< Bayesian information criterion
+  double D; //!< Kolmogorov's statistic of the intervals against the fitted cdf
+  double W2; //!< Anderson-Darling statistic
+  double p_W2; //!< Its p-value, ignoring the estimation of the parameters
+} aspa_renewal_model_fit;
+
+/** @brief Structure holding the renewal fits of a unit */
+typedef struct
+{
+  size_t n; //!< Number of intervals
+  aspa_renewal_model best; //!< Model of smallest AIC
+  aspa_renewal_model_fit fit[ASPA_RENEWAL_N_MODELS]; //!< One per model
+} aspa_renewal_fit;
+
+double aspa_renewal_cdf(double x, void * params);
+
+int aspa_renewal_fit_isi(const gsl_vector * isi, aspa_renewal_fit * res);
+
+int aspa_renewal_fit_units(const aspa_sta * const * sta, size_t n_units, aspa_renewal_fit * res);
+
+int aspa_renewal_fit_fprintf(FILE * STREAM, const aspa_renewal_fit * res, size_t n_units);
+
+/** @brief Structure holding variance-time curves, see aspa_vartime.c */
+typedef struct
+{
+  size_t n_windows; //!< Number of window widths
+  double * window; //!< The window widths (s)
+  double * mean; //!< Mean count of a window
+  double * var_within; //!< Variance of the counts of a trial around its mean
+  double * fano_within; //!< var_within/mean
+  double * allan_within; //!< Mean squared difference of successive windows of a trial over 2 mean
+  double * var_across; //!< Variance of the counts of a window across trials
+  double * fano_across; //!< var_across/mean
+  double * allan_across; //!< Mean squared difference of a window between successive trials over 2 mean
+} aspa_variance_time;
+
+aspa_variance_time * aspa_sta_variance_time(const aspa_sta * sta, double from, double to, const double * windows, size_t n_windows);
+
+int aspa_variance_time_free(aspa_variance_time * vt);
+
+int aspa_variance_time_plot_i(const aspa_variance_time * vt);
+
+int aspa_variance_time_plot_g(FILE * STREAM, const aspa_variance_time * vt);
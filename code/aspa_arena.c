@@ -0,0 +1,315 @@
+/** @file aspa_arena.c
+ *  @brief Function definitions for the arena allocator and the
+ *         workspaces
+ *
+ *  An arena hands out the temporary buffers of the library functions
+ *  from large blocks with a pointer increment. Buffers are released in
+ *  LIFO order (which is how the library uses them) by moving the pointer
+ *  back; a buffer released out of order is only reclaimed by
+ *  `aspa_arena_reset`. When the current block is full a larger one is
+ *  added; the reset merges the blocks into a single one, large enough
+ *  for the peak usage, so that a loop analysing many units with
+ *  `aspa_arena_reset` between them stops calling malloc after the first
+ *  units. An arena is attached to a context with `aspa_ctx_use_arena`;
+ *  like the context, it must be used by a single thread at a time.
+ *
+ *  The workspaces (`aspa_fns_workspace`, `aspa_gof_workspace`) are
+ *  GSL-style objects holding the buffer of a given function family:
+ *  they are allocated once, grown when a larger sample is met and passed
+ *  to the `*_w` variant of the functions.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_HEADER ARENA_ALIGN
+
+/** A block of an arena, the buffers follow the structure */
+struct aspa_arena_block
+{
+  struct aspa_arena_block * next; //!< Previous (fuller) block
+  size_t size; //!< Number of bytes available after the structure
+  size_t used; //!< Number of bytes in use
+  size_t top; //!< Offset of the header of the last buffer (SIZE_MAX if none)
+};
+
+/** Size of the block structure, rounded up to the alignment */
+#define BLOCK_HEAD ((sizeof(struct aspa_arena_block)+ARENA_ALIGN-1)/ARENA_ALIGN*ARENA_ALIGN)
+
+/** Allocates an empty block of at least `size` bytes */
+static struct aspa_arena_block * block_alloc(aspa_arena * arena, size_t size)
+{
+  struct aspa_arena_block * res = malloc(BLOCK_HEAD+size);
+  if (res == NULL)
+    return NULL;
+  res->next = NULL;
+  res->size = size;
+  res->used = 0;
+  res->top = SIZE_MAX;
+  arena->n_mallocs++;
+  return res;
+}
+
+/** @brief Allocates an arena
+ *
+ *  @param[in] block_size the size of the first block (in bytes), the
+ *             blocks added later are at least twice as large as the
+ *             previous one
+ *  @returns a pointer to an allocated aspa_arena, NULL if the allocation
+ *           failed
+*/
+aspa_arena * aspa_arena_alloc(size_t block_size)
+{
+  aspa_arena * res = calloc(1,sizeof(aspa_arena));
+  if (res == NULL)
+  {
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the arena failed.");
+    return NULL;
+  }
+  res->head = block_alloc(res,block_size > 0 ? block_size : 4096);
+  if (res->head == NULL)
+  {
+    free(res);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the arena failed.");
+    return NULL;
+  }
+  return res;
+}
+
+/** @brief Frees an arena and all its blocks
+ *
+ *  @param[in/out] arena a pointer to an allocated aspa_arena
+ *  @returns 0 if everything goes fine
+*/
+int aspa_arena_free(aspa_arena * arena)
+{
+  struct aspa_arena_block * block = arena->head;
+  while (block != NULL)
+  {
+    struct aspa_arena_block * next = block->next;
+    free(block);
+    block = next;
+  }
+  free(arena);
+  return 0;
+}
+
+/** @brief Returns a buffer from an arena
+ *
+ *  The buffer is aligned on 16 bytes.
+ *
+ *  @param[in/out] arena a pointer to an aspa_arena
+ *  @param[in] size the size of the buffer (in bytes)
+ *  @returns a pointer to the buffer, NULL if a new block was needed
+ *           and could not be allocated
+*/
+void * aspa_arena_malloc(aspa_arena * arena, size_t size)
+{
+  size_t needed = ARENA_HEADER+(size+ARENA_ALIGN-1)/ARENA_ALIGN*ARENA_ALIGN;
+  struct aspa_arena_block * block = arena->head;
+  if (block->used+needed > block->size)
+  {
+    size_t new_size = GSL_MAX(2*block->size,2*needed);
+    struct aspa_arena_block * larger = block_alloc(arena,new_size);
+    if (larger == NULL)
+      return NULL;
+    larger->next = block;
+    arena->head = block = larger;
+  }
+  char * base = (char *) block+BLOCK_HEAD;
+  *(size_t *) (base+block->used) = block->top;
+  block->top = block->used;
+  block->used += needed;
+  arena->used += needed;
+  arena->peak = GSL_MAX(arena->peak,arena->used);
+  return base+block->top+ARENA_HEADER;
+}
+
+/** @brief Gives a buffer back to an arena
+ *
+ *  If the buffer is the last one obtained from the arena, its space
+ *  can be reused immediately; otherwise it is reclaimed by the next
+ *  `aspa_arena_reset`.
+ *
+ *  @param[in/out] arena a pointer to an aspa_arena
+ *  @param[in] ptr a buffer obtained from `aspa_arena_malloc` (or NULL)
+ *  @returns nothing
+*/
+void aspa_arena_release(aspa_arena * arena, void * ptr)
+{
+  struct aspa_arena_block * block = arena->head;
+  if (ptr == NULL || block->top == SIZE_MAX)
+    return;
+  char * base = (char *) block+BLOCK_HEAD;
+  if ((char *) ptr != base+block->top+ARENA_HEADER)
+    return;
+  arena->used -= block->used-block->top;
+  block->used = block->top;
+  block->top = *(size_t *) (base+block->top);
+}
+
+/** @brief Releases all the buffers of an arena
+ *
+ *  If several blocks were needed since the last reset, they are
+ *  replaced by a single one large enough for the peak usage.
+ *
+ *  @param[in/out] arena a pointer to an aspa_arena
+ *  @returns 0 if everything goes fine, ASPA_ENOMEM if the blocks could
+ *           not be merged (the arena is still usable)
+*/
+int aspa_arena_reset(aspa_arena * arena)
+{
+  struct aspa_arena_block * block = arena->head;
+  int status = ASPA_SUCCESS;
+  if (block->next != NULL)
+  {
+    struct aspa_arena_block * merged = block_alloc(arena,arena->peak);
+    if (merged == NULL)
+      status = aspa_ctx_error(ASPA_ENOMEM,"Allocation of an arena block failed.");
+    else
+    {
+      while (block != NULL)
+      {
+	struct aspa_arena_block * next = block->next;
+	free(block);
+	block = next;
+      }
+      arena->head = block = merged;
+    }
+  }
+  for (; block != NULL; block = block->next)
+  {
+    block->used = 0;
+    block->top = SIZE_MAX;
+  }
+  arena->used = 0;
+  return status;
+}
+
+static void * arena_alloc(size_t size, void * state)
+{
+  return aspa_arena_malloc(state,size);
+}
+
+static void arena_release(void * ptr, void * state)
+{
+  aspa_arena_release(state,ptr);
+}
+
+/** @brief Makes a context take its temporary buffers from an arena
+ *
+ *  @param[in/out] ctx a pointer to a context
+ *  @param[in] arena a pointer to an aspa_arena, NULL to go back to
+ *             malloc and free
+ *  @returns nothing
+*/
+void aspa_ctx_use_arena(aspa_ctx * ctx, aspa_arena * arena)
+{
+  ctx->alloc = arena != NULL ? arena_alloc : NULL;
+  ctx->release = arena != NULL ? arena_release : NULL;
+  ctx->alloc_state = arena;
+}
+
+/** Makes sure that a workspace buffer holds at least n doubles */
+static double * work_reserve(double ** work, size_t * size, size_t n)
+{
+  if (n <= *size && *work != NULL)
+    return *work;
+  double * larger = realloc(*work,(n > 0 ? n : 1)*sizeof(double));
+  if (larger == NULL)
+  {
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of a workspace of %zu elements failed.",n);
+    return NULL;
+  }
+  *work = larger;
+  *size = n;
+  return larger;
+}
+
+/** @brief Allocates a workspace for `aspa_fns_get_w`
+ *
+ *  @param[in] n the initial size (largest sample expected, can be 0)
+ *  @returns a pointer to an allocated aspa_fns_workspace, NULL if the
+ *           allocation failed
+*/
+aspa_fns_workspace * aspa_fns_workspace_alloc(size_t n)
+{
+  aspa_fns_workspace * res = calloc(1,sizeof(aspa_fns_workspace));
+  if (res == NULL || work_reserve(&res->work,&res->size,n) == NULL)
+  {
+    free(res);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the workspace failed.");
+    return NULL;
+  }
+  return res;
+}
+
+/** @brief Frees an aspa_fns_workspace
+ *
+ *  @param[in/out] w a pointer to an allocated aspa_fns_workspace
+ *  @returns 0 if everything goes fine
+*/
+int aspa_fns_workspace_free(aspa_fns_workspace * w)
+{
+  free(w->work);
+  free(w);
+  return 0;
+}
+
+/** @brief Returns a buffer of at least n doubles from an
+ *         aspa_fns_workspace
+ *
+ *  @param[in/out] w a pointer to an aspa_fns_workspace
+ *  @param[in] n the number of doubles
+ *  @returns a pointer to the buffer, NULL if it could not be grown
+*/
+double * aspa_fns_workspace_reserve(aspa_fns_workspace * w, size_t n)
+{
+  return work_reserve(&w->work,&w->size,n);
+}
+
+/** @brief Allocates a workspace for the goodness of fit functions
+ *         (`aspa_Kolmogorov_D_w`, `aspa_AndersonDarling_W2_w`,
+ *         `aspa_durbin_modification_w`)
+ *
+ *  @param[in] n the initial size (largest sample expected, can be 0)
+ *  @returns a pointer to an allocated aspa_gof_workspace, NULL if the
+ *           allocation failed
+*/
+aspa_gof_workspace * aspa_gof_workspace_alloc(size_t n)
+{
+  aspa_gof_workspace * res = calloc(1,sizeof(aspa_gof_workspace));
+  if (res == NULL || work_reserve(&res->work,&res->size,2*n+3) == NULL)
+  {
+    free(res);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the workspace failed.");
+    return NULL;
+  }
+  return res;
+}
+
+/** @brief Frees an aspa_gof_workspace
+ *
+ *  @param[in/out] w a pointer to an allocated aspa_gof_workspace
+ *  @returns 0 if everything goes fine
+*/
+int aspa_gof_workspace_free(aspa_gof_workspace * w)
+{
+  free(w->work);
+  free(w);
+  return 0;
+}
+
+/** @brief Returns a buffer of at least n doubles from an
+ *         aspa_gof_workspace
+ *
+ *  @param[in/out] w a pointer to an aspa_gof_workspace
+ *  @param[in] n the number of doubles
+ *  @returns a pointer to the buffer, NULL if it could not be grown
+*/
+double * aspa_gof_workspace_reserve(aspa_gof_workspace * w, size_t n)
+{
+  return work_reserve(&w->work,&w->size,n);
+}
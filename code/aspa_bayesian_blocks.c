@@ -0,0 +1,140 @@
+/** @file aspa_bayesian_blocks.c
+ *  @brief User program for creating an adaptive histogram with the
+ *         Bayesian Blocks method
+ *
+ *  The data are read from the `stdin` in text format. A log transformation can be applied before
+ *  contructing the histogram. The resulting histogram is written to the `stdout` in the same
+ *  format as the one used by `aspa_hist`.
+ *  See Scargle et al (2013) [_The Astrophysical Journal_ __764__: 167](https://doi.org/10.1088/0004-637X/764/2/167).
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa.h"
+
+#include <getopt.h>
+
+int read_args(int argc, char ** argv,
+	      size_t * use_log,
+	      double * p0,
+	      size_t * prob);
+
+int main(int argc, char ** argv)
+{
+  aspa_profile_init(argv[0]); // JSON report on the stderr if ASPA_PROFILE is set
+  size_t use_log, prob;
+  double p0;
+  int status = read_args(argc,argv,&use_log,&p0,&prob);
+  if (status == -1) exit (EXIT_FAILURE);
+
+  int nb;
+  fscanf(stdin,"%d",&nb); // Get the sample size
+  fprintf(stderr,"Sample size: %d\n", nb);
+  size_t n = (size_t) nb;
+  if (use_log)
+    fprintf(stderr,"Using a log transformation of the data.\n");
+
+  gsl_vector * x = gsl_vector_alloc(n);
+  double y;
+  size_t x_idx=0;
+  while (fscanf (stdin, "%lg", &y) == 1) {
+    if (x_idx == n) {
+      x_idx++;
+      break;
+    }
+    if (use_log) { // If log transformation applied
+      if (y <= 0) { // Make sure it makes sense
+	fprintf(stderr,"Negative values, cannot use log transform!\n");
+	gsl_vector_free(x);
+	return -1;
+      }
+      y = log(y);
+    }
+    gsl_vector_set(x,x_idx,y);
+    x_idx+=1;
+  }
+  if (x_idx != n) {
+    fprintf(stderr,"The number of elements read %d is wrong.\n", (int) x_idx);
+    gsl_vector_free(x);
+    return -1;
+  }
+  gsl_histogram * hist = aspa_bayesian_blocks(x,false,p0);
+  gsl_vector_free(x);
+  if (hist == NULL) // the reason was written to the stderr
+    return -1;
+  size_t n_bins = hist->n;
+  fprintf(stderr,"Number of blocks: %d\n", (int) n_bins);
+  if (use_log) { // Transform the bins boundaries back
+    for (size_t i=0; i<n_bins+1; i++)
+      hist->range[i] = exp(hist->range[i]);
+  }
+  if (prob) { // Normalize the histogram
+    for (size_t bin_idx=0; bin_idx<n_bins; bin_idx++)
+      hist->bin[bin_idx] /= n*(hist->range[bin_idx+1]-hist->range[bin_idx]);
+  }
+  gsl_histogram_fprintf (stdout, hist, "%g", "%g");
+  gsl_histogram_free(hist);
+  return 0;
+}
+
+int read_args(int argc, char ** argv,
+	      size_t * use_log,
+	      double * p0,
+	      size_t * prob)
+{
+  static char usage[] = \
+    "usage: %s [-f --p0=real] [-l --log] \n"
+    "          [-p --prob] [-h --help]\n\n"
+    "  -f --p0 <real in (0,1)>: the false alarm probability used to\n"
+    "     set the prior on the number of blocks (default 0.05).\n"
+    "  -l --log: should the log of the observations be used?\n"
+    "  -p --prob: should the result be normalized so that the\n"
+    "     the histogram integral is one?\n"
+    "  -h --help: prints this message.\n"
+    " The program reads data from the 'stdin' (in text format),\n"
+    " the first line should contain the number of observations (integer)\n"
+    " the following lines should contain the observations, one per line\n"
+    " in decimal notation. If a log transformed of the data is requested\n"
+    " it is applied first. Then the optimal partition of the observations\n"
+    " into blocks of constant density is obtained with the 'Bayesian Blocks'\n"
+    " method of Scargle et al (2013) and used as a histogram with adaptive\n"
+    " bins. If a log transformation was used, the bins boundaries are transformed\n"
+    " back to the original scale. If argument 'prob' is specified, the histogram\n"
+    " is normalized such that its integral is one (it becomes of proper PDF\n"
+    " estimator), otherwise the bin counts are kept.\n"
+    " The program prints to the 'stdout' on 3 columns: the left bin boundary;\n"
+    " the right bin boundary; the bin count or bin frequency (depending on the\n"
+    " specification of argument 'prob').\n\n";
+  // Define default values
+  *use_log=0;
+  *prob=0;
+  *p0=0.05;
+  {int opt;
+    static struct option long_options[] = {
+      {"log",no_argument,NULL,'l'},
+      {"p0",required_argument,NULL,'f'},
+      {"prob",no_argument,NULL,'p'},
+      {"help",no_argument,NULL,'h'},
+      {NULL,0,NULL,0}
+    };
+    int long_index =0;
+    while ((opt = getopt_long(argc,argv,"lhf:p",long_options,\
+			      &long_index)) != -1) {
+      switch(opt) {
+      case 'l': *use_log=1;
+	break;
+      case 'f': *p0 = atof(optarg);
+	break;
+      case 'p': *prob = 1;
+	break;
+      case 'h': printf(usage,argv[0]);
+	return -1;
+      default : fprintf(stderr,usage,argv[0]);
+	return -1;
+      }
+    }
+  }
+  if (*p0 <= 0 || *p0 >= 1) {
+    fprintf(stderr,"p0 must be in (0,1).\n");
+    return -1;
+  }
+  return 0;
+}
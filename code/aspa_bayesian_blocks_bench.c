@@ -0,0 +1,45 @@
+/** @file aspa_bayesian_blocks_bench.c
+ *  @brief User program for timing function aspa_bayesian_blocks
+ *
+ *  Event sequences of increasing size (10^3 to 10^6 events) are
+ *  simulated from a Poisson process whose rate switches between a
+ *  low (20 Hz) and a high (100 Hz) value every second, like a
+ *  regularly bursting neuron. For each size the program prints on
+ *  three columns: the number of events, the number of blocks found
+ *  and the elapsed time in seconds.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa.h"
+
+#include <time.h>
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+
+int main()
+{
+  gsl_rng * rng = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(rng,20061001);
+  printf("# n_events n_blocks seconds\n");
+  for (size_t n=1000; n<=1000000; n*=10)
+  {
+    gsl_vector * events = gsl_vector_alloc(n);
+    double t=0.;
+    for (size_t i=0; i<n; i++)
+    {
+      double rate = (((size_t) floor(t)) % 2 == 0) ? 20. : 100.;
+      t += gsl_ran_exponential(rng,1./rate);
+      gsl_vector_set(events,i,t);
+    }
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC,&start);
+    gsl_histogram * hist = aspa_bayesian_blocks(events,true,0.05);
+    clock_gettime(CLOCK_MONOTONIC,&stop);
+    double elapsed = (stop.tv_sec-start.tv_sec)+1e-9*(stop.tv_nsec-start.tv_nsec);
+    printf("%d %d %g\n", (int) n, (int) hist->n, elapsed);
+    gsl_histogram_free(hist);
+    gsl_vector_free(events);
+  }
+  gsl_rng_free(rng);
+  return 0;
+}
@@ -0,0 +1,399 @@
+/** @file aspa_bench.c
+ *  @brief User program timing the library functions on simulated data
+ *
+ *  Spike trains of increasing size (powers of 10 between --min_spikes
+ *  and --max_spikes) are simulated with the generators of aspa_sim.c
+ *  (homogeneous Poisson, gamma renewal, inhomogeneous Poisson by
+ *  thinning and bursting) and cut into 10 s long trials. Each benchmark
+ *  is run --repeat times on each data set and one line per (benchmark,
+ *  generator, size) is printed on the stdout with whitespace separated
+ *  columns, a header line starting with '#' giving their names, so that
+ *  the output of two commits can be compared with standard tools.
+ *
+ *  Some functions use memory on the stack proportional to the sample
+ *  size or have a super-linear cost (exact Kolmogorov distribution,
+ *  Bayesian Blocks on homogeneous data, shuffle predictor of the
+ *  correlograms); they are only run up to the size given in the
+ *  `n_max` column of the benchmark table.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa.h"
+
+#include <getopt.h>
+#include <time.h>
+#include <gsl/gsl_randist.h>
+
+/** The data a benchmark is run on */
+typedef struct
+{
+  gsl_vector * train; //!< The simulated spike train
+  aspa_sta * sta; //!< The train cut into trials
+  gsl_vector * isi; //!< The inter spike intervals
+  gsl_vector * u; //!< The isi mapped on [0,1] by their empirical rate
+  double * copy; //!< Room for a copy of the isi
+  size_t * order; //!< Room for their sorting permutation
+  FILE * text; //!< sta written with aspa_sta_fprintf
+  FILE * bin; //!< sta written with aspa_sta_fwrite
+} bench_data;
+
+/** A benchmark: a name, the largest sample size it is run on and
+    the function doing the work once */
+typedef struct
+{
+  const char * name;
+  size_t n_max;
+  void (* run)(bench_data * data);
+} bench;
+
+static void bench_fprintf(bench_data * data)
+{
+  rewind(data->text);
+  aspa_sta_fprintf(data->text,data->sta,false);
+  fflush(data->text);
+}
+
+static void bench_fscanf(bench_data * data)
+{
+  rewind(data->text);
+  aspa_sta_free(aspa_sta_fscanf(data->text));
+}
+
+static void bench_fwrite(bench_data * data)
+{
+  rewind(data->bin);
+  aspa_sta_fwrite(data->bin,data->sta,false);
+  fflush(data->bin);
+}
+
+static void bench_fread(bench_data * data)
+{
+  rewind(data->bin);
+  aspa_sta_free(aspa_sta_fread(data->bin));
+}
+
+static void bench_from_raw(bench_data * data)
+{
+  aspa_sta_free(aspa_sta_from_raw(data->train,10.,0.,0.,10.));
+}
+
+static void bench_aggregate(bench_data * data)
+{
+  aspa_sta_free(aspa_sta_aggregate(data->sta));
+}
+
+static void bench_isi(bench_data * data)
+{
+  gsl_vector_free(aspa_sta_isi(data->sta));
+}
+
+static void bench_fns(bench_data * data)
+{
+  aspa_fns_get(data->isi);
+}
+
+static void bench_spearman(bench_data * data)
+{
+  aspa_lagged_spearman(data->isi,1);
+}
+
+static void bench_fns_bootstrap(bench_data * data)
+{
+  aspa_fns_ci ci;
+  aspa_fns_bootstrap(data->isi,100,0.95,20061001,&ci);
+}
+
+static void bench_spearman_test(bench_data * data)
+{
+  aspa_lagged_spearman_test(data->isi,1,100,20061001);
+}
+
+static void bench_gsl_sort(bench_data * data)
+{
+  memcpy(data->copy,data->isi->data,data->isi->size*sizeof(double));
+  gsl_sort(data->copy,1,data->isi->size);
+}
+
+static void bench_sort(bench_data * data)
+{
+  memcpy(data->copy,data->isi->data,data->isi->size*sizeof(double));
+  aspa_sort(data->copy,data->isi->size);
+}
+
+static void bench_gsl_sort_index(bench_data * data)
+{
+  gsl_sort_index(data->order,data->isi->data,1,data->isi->size);
+}
+
+static void bench_sort_index(bench_data * data)
+{
+  aspa_sort_index(data->order,data->isi->data,data->isi->size);
+}
+
+static void bench_ks(bench_data * data)
+{
+  double D = aspa_Kolmogorov_D(data->u,false,"D");
+  aspa_cdf_K(data->u->size,D);
+}
+
+static void bench_ad(bench_data * data)
+{
+  double W2 = aspa_AndersonDarling_W2(data->u,false);
+  aspa_cdf_AD_P(data->u->size,W2);
+}
+
+/** The sweep of aspa_hist_bw: cross-validation scores of histograms
+    with 2 to 200 bins */
+static void bench_hist_sweep(bench_data * data)
+{
+  size_t n = data->isi->size;
+  double xmin = gsl_vector_min(data->isi)-DBL_EPSILON;
+  double xmax = gsl_vector_max(data->isi)+DBL_EPSILON;
+  for (size_t m=2; m<=200; m++)
+  {
+    gsl_histogram * hist = gsl_histogram_alloc(m);
+    gsl_histogram_set_ranges_uniform(hist,xmin,xmax);
+    for (size_t i=0; i<n; i++)
+      gsl_histogram_increment(hist,gsl_vector_get(data->isi,i));
+    gsl_histogram_scale(hist,1.0/n);
+    gsl_histogram_mul(hist,hist);
+    gsl_histogram_sum(hist);
+    gsl_histogram_free(hist);
+  }
+}
+
+static void bench_bayesian_blocks(bench_data * data)
+{
+  gsl_histogram_free(aspa_bayesian_blocks(data->train,true,0.05));
+}
+
+static void bench_autocorrelogram(bench_data * data)
+{
+  aspa_ccg_free(aspa_autocorrelogram(data->sta,0.1,0.002));
+}
+
+static void bench_bitset(bench_data * data)
+{
+  aspa_bitset_free(aspa_sta_to_bitset(data->sta,0.001));
+}
+
+static void bench_raster_image(bench_data * data)
+{
+  aspa_image_free(aspa_raster_image(data->sta,800,600));
+}
+
+static const bench benches[] = {
+  {"sta_fprintf",SIZE_MAX,bench_fprintf},
+  {"sta_fscanf",SIZE_MAX,bench_fscanf},
+  {"sta_fwrite",SIZE_MAX,bench_fwrite},
+  {"sta_fread",SIZE_MAX,bench_fread},
+  {"sta_from_raw",SIZE_MAX,bench_from_raw},
+  {"sta_aggregate",SIZE_MAX,bench_aggregate},
+  {"sta_isi",SIZE_MAX,bench_isi},
+  {"fns_get",SIZE_MAX,bench_fns},
+  {"lagged_spearman",SIZE_MAX,bench_spearman},
+  {"fns_bootstrap",SIZE_MAX,bench_fns_bootstrap}, // 100 resamples
+  {"spearman_test",SIZE_MAX,bench_spearman_test}, // 100 permutations
+  {"gsl_sort",SIZE_MAX,bench_gsl_sort},
+  {"aspa_sort",SIZE_MAX,bench_sort},
+  {"gsl_sort_index",SIZE_MAX,bench_gsl_sort_index},
+  {"aspa_sort_index",SIZE_MAX,bench_sort_index},
+  {"ks_pvalue",10000,bench_ks}, // exact Kolmogorov distribution
+  {"ad_pvalue",SIZE_MAX,bench_ad},
+  {"hist_sweep",SIZE_MAX,bench_hist_sweep},
+  {"bayesian_blocks",10000,bench_bayesian_blocks}, // quadratic on homogeneous data
+  {"autocorrelogram",100000,bench_autocorrelogram}, // shuffle predictor grows with the trials
+  {"sta_to_bitset",SIZE_MAX,bench_bitset},
+  {"raster_image",SIZE_MAX,bench_raster_image}};
+
+#define N_BENCHES (sizeof(benches)/sizeof(bench))
+
+/** Intensity of the inhomogeneous Poisson process: 20 Hz modulated at 1 Hz */
+static double modulated_rate(double t, void * params)
+{
+  (void) params;
+  return 20.*(1.+0.9*sin(2.*M_PI*t));
+}
+
+#define N_GENERATORS 4
+static const char * generators[N_GENERATORS] = {"poisson","gamma","thinning","bursting"};
+
+/** Returns n spikes simulated with generator g */
+static gsl_vector * simulate(const gsl_rng * rng, size_t g, size_t n)
+{
+  switch (g) {
+  case 0: return aspa_sim_poisson(rng,n,20.);
+  case 1: return aspa_sim_gamma(rng,n,20.,3.);
+  case 2: return aspa_sim_thinning(rng,n,modulated_rate,NULL,38.);
+  default: return aspa_sim_bursting(rng,n,2.,8.,200.);
+  }
+}
+
+static double seconds(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return now.tv_sec+1e-9*now.tv_nsec;
+}
+
+int read_args(int argc, char ** argv,
+	      size_t * min_spikes,
+	      size_t * max_spikes,
+	      size_t * repeat,
+	      char ** generator,
+	      char ** only,
+	      unsigned long * seed);
+
+int main(int argc, char ** argv)
+{
+  aspa_profile_init(argv[0]); // JSON report on the stderr if ASPA_PROFILE is set
+  size_t min_spikes, max_spikes, repeat;
+  char * generator, * only;
+  unsigned long seed;
+  int status = read_args(argc,argv,&min_spikes,&max_spikes,&repeat,&generator,&only,&seed);
+  if (status == -1) exit (EXIT_FAILURE);
+
+  gsl_rng * rng = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(rng,seed);
+  double * elapsed = malloc(repeat*sizeof(double));
+  printf("# benchmark generator n_spikes n_trials repeat min_s median_s spikes_per_s\n");
+  for (size_t g=0; g<N_GENERATORS; g++)
+  {
+    if (generator != NULL && strcmp(generator,generators[g]) != 0)
+      continue;
+    for (size_t n=min_spikes; n<=max_spikes; n*=10)
+    {
+      bench_data data;
+      data.train = simulate(rng,g,n);
+      data.sta = aspa_sim_sta(data.train,10.);
+      data.isi = aspa_sta_isi(data.sta);
+      data.u = gsl_vector_alloc(data.isi->size);
+      data.copy = malloc(data.isi->size*sizeof(double));
+      data.order = malloc(data.isi->size*sizeof(size_t));
+      double rate = 1./gsl_stats_mean(data.isi->data,1,data.isi->size);
+      for (size_t i=0; i<data.isi->size; i++)
+	gsl_vector_set(data.u,i,1.-exp(-rate*gsl_vector_get(data.isi,i)));
+      data.text = tmpfile();
+      data.bin = tmpfile();
+      bench_fprintf(&data);
+      bench_fwrite(&data);
+      for (size_t b=0; b<N_BENCHES; b++)
+      {
+	if (n > benches[b].n_max || (only != NULL && strcmp(only,benches[b].name) != 0))
+	  continue;
+	for (size_t r=0; r<repeat; r++)
+	{
+	  double start = seconds();
+	  benches[b].run(&data);
+	  elapsed[r] = seconds()-start;
+	}
+	gsl_sort(elapsed,1,repeat);
+	double median = gsl_stats_median_from_sorted_data(elapsed,1,repeat);
+	printf("%s %s %zu %zu %zu %.6g %.6g %.6g\n", benches[b].name, generators[g],
+	       n, data.sta->n_trials, repeat, elapsed[0], median, n/median);
+	fflush(stdout);
+      }
+      fclose(data.text);
+      fclose(data.bin);
+      free(data.copy);
+      free(data.order);
+      gsl_vector_free(data.u);
+      gsl_vector_free(data.isi);
+      aspa_sta_free(data.sta);
+      gsl_vector_free(data.train);
+    }
+  }
+  free(elapsed);
+  gsl_rng_free(rng);
+  return 0;
+}
+
+int read_args(int argc, char ** argv,
+	      size_t * min_spikes,
+	      size_t * max_spikes,
+	      size_t * repeat,
+	      char ** generator,
+	      char ** only,
+	      unsigned long * seed)
+{
+  static char usage[] = \
+    "usage: %s [-m --min_spikes=integer] [-M --max_spikes=integer]\n"
+    "          [-r --repeat=integer] [-g --generator=string]\n"
+    "          [-o --only=string] [-s --seed=integer] [-h --help]\n\n"
+    "  -m --min_spikes <positive integer>: the smallest number of spikes\n"
+    "     (default 1000).\n"
+    "  -M --max_spikes <positive integer>: the largest number of spikes\n"
+    "     (default 1000000), sizes are min_spikes times powers of 10.\n"
+    "  -r --repeat <positive integer>: the number of runs of each benchmark\n"
+    "     (default 3).\n"
+    "  -g --generator <string>: one of 'poisson', 'gamma', 'thinning',\n"
+    "     'bursting', only this generator is used (default all).\n"
+    "  -o --only <string>: the name of the single benchmark to run\n"
+    "     (default all).\n"
+    "  -s --seed <positive integer>: the seed of the random number generator\n"
+    "     (default 20061001).\n"
+    "  -h --help: prints this message.\n"
+    " For each generator and size, the program simulates a spike train\n"
+    " (20 Hz mean rate), cuts it into 10 s long trials and times the\n"
+    " library functions on it. It prints to the 'stdout' one line per\n"
+    " benchmark with 8 columns: the benchmark name; the generator; the\n"
+    " number of spikes; the number of trials; the number of runs; the\n"
+    " shortest and the median elapsed times (s); the number of spikes\n"
+    " processed per second (median).\n\n";
+  // Define default values
+  *min_spikes=1000;
+  *max_spikes=1000000;
+  *repeat=3;
+  *generator=NULL;
+  *only=NULL;
+  *seed=20061001;
+  {int opt;
+    static struct option long_options[] = {
+      {"min_spikes",required_argument,NULL,'m'},
+      {"max_spikes",required_argument,NULL,'M'},
+      {"repeat",required_argument,NULL,'r'},
+      {"generator",required_argument,NULL,'g'},
+      {"only",required_argument,NULL,'o'},
+      {"seed",required_argument,NULL,'s'},
+      {"help",no_argument,NULL,'h'},
+      {NULL,0,NULL,0}
+    };
+    int long_index =0;
+    while ((opt = getopt_long(argc,argv,"hm:M:r:g:o:s:",long_options,\
+			      &long_index)) != -1) {
+      switch(opt) {
+      case 'm': *min_spikes = strtoul(optarg,NULL,10);
+	break;
+      case 'M': *max_spikes = strtoul(optarg,NULL,10);
+	break;
+      case 'r': *repeat = strtoul(optarg,NULL,10);
+	break;
+      case 'g': *generator = optarg;
+	break;
+      case 'o': *only = optarg;
+	break;
+      case 's': *seed = strtoul(optarg,NULL,10);
+	break;
+      case 'h': printf(usage,argv[0]);
+	return -1;
+      default : fprintf(stderr,usage,argv[0]);
+	return -1;
+      }
+    }
+  }
+  if (*min_spikes < 10 || *max_spikes < *min_spikes || *repeat == 0) {
+    fprintf(stderr,"We must have 10 <= min_spikes <= max_spikes and repeat > 0.\n");
+    return -1;
+  }
+  if (*generator != NULL) {
+    size_t g;
+    for (g=0; g<N_GENERATORS; g++)
+      if (strcmp(*generator,generators[g]) == 0)
+	break;
+    if (g == N_GENERATORS) {
+      fprintf(stderr,"Unknown generator: %s\n",*generator);
+      return -1;
+    }
+  }
+  return 0;
+}
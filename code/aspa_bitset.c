@@ -0,0 +1,513 @@
+/** @file aspa_bitset.c
+ *  @brief Function definitions for binned spike trains packed in bitsets
+ *
+ *  Each trial of an aspa_sta is binned and a bin is represented by a
+ *  single bit (set if at least one spike fell in it). The bits of a
+ *  trial are packed in 64 bits words, which gives a memory footprint 64
+ *  times smaller than a `double` matrix and lets count and coincidence
+ *  queries be computed with population counts. Very sparse trains are
+ *  stored instead as lists of runs of consecutive occupied bins.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ASPA_HAVE_X86 1
+#endif
+
+/** Dense storage is used unless the runs need ASPA_BITSET_RLE_RATIO
+    times less memory than the words */
+#define ASPA_BITSET_RLE_RATIO 8
+
+/** @brief Returns the number of set bits of a & b over n words
+ *
+ *  Portable version.
+*/
+static size_t and_popcount_generic(const uint64_t * a, const uint64_t * b, size_t n)
+{
+  size_t res = 0;
+  for (size_t i=0; i<n; i++)
+    res += __builtin_popcountll(a[i] & b[i]);
+  return res;
+}
+
+#ifdef ASPA_HAVE_X86
+/** @brief Returns the number of set bits of a & b over n words
+ *
+ *  AVX2 version: the bytes are counted with a nibble lookup table
+ *  (`vpshufb`) and summed with `vpsadbw`, see Mula, Kurz and Lemire
+ *  (2018) Faster Population Counts Using AVX2 Instructions
+ *  [_The Computer Journal_ __61__: 111-120](https://doi.org/10.1093/comjnl/bxx046).
+*/
+__attribute__((target("avx2")))
+static size_t and_popcount_avx2(const uint64_t * a, const uint64_t * b, size_t n)
+{
+  const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+					  0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i+4 <= n; i+=4)
+  {
+    __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *) (a+i)),
+				 _mm256_loadu_si256((const __m256i *) (b+i)));
+    __m256i lo = _mm256_and_si256(v,low_mask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v,4),low_mask);
+    __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup,lo),
+				  _mm256_shuffle_epi8(lookup,hi));
+    acc = _mm256_add_epi64(acc,_mm256_sad_epu8(cnt,_mm256_setzero_si256()));
+  }
+  uint64_t part[4];
+  _mm256_storeu_si256((__m256i *) part,acc);
+  return part[0]+part[1]+part[2]+part[3]+and_popcount_generic(a+i,b+i,n-i);
+}
+#endif
+
+/** @brief Returns the number of set bits of a & b over n words
+ *
+ *  The AVX2 version is used when the CPU supports it.
+*/
+static size_t and_popcount(const uint64_t * a, const uint64_t * b, size_t n)
+{
+#ifdef ASPA_HAVE_X86
+  if (n >= 8 && __builtin_cpu_supports("avx2"))
+    return and_popcount_avx2(a,b,n);
+#endif
+  return and_popcount_generic(a,b,n);
+}
+
+/** @brief Returns the number of set bits of words between bits from
+ *         (included) and to (excluded)
+*/
+static size_t dense_count(const uint64_t * w, size_t from, size_t to)
+{
+  if (from >= to)
+    return 0;
+  size_t first = from/64;
+  size_t last = (to-1)/64;
+  uint64_t head = ~0ULL << (from%64);
+  uint64_t tail = ~0ULL >> (63-(to-1)%64);
+  if (first == last)
+    return __builtin_popcountll(w[first] & head & tail);
+  size_t res = __builtin_popcountll(w[first] & head)+__builtin_popcountll(w[last] & tail);
+  res += and_popcount(w+first+1,w+first+1,last-first-1);
+  return res;
+}
+
+/** @brief Returns the number of occupied bins of a run list between
+ *         bins from (included) and to (excluded)
+*/
+static size_t rle_count(const size_t * start, const size_t * length, size_t n_runs,
+			size_t from, size_t to)
+{
+  // first run ending after from
+  size_t lo = 0, hi = n_runs;
+  while (lo < hi)
+  {
+    size_t mid = (lo+hi)/2;
+    if (start[mid]+length[mid] <= from)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  size_t res = 0;
+  for (size_t r=lo; r<n_runs && start[r] < to; r++)
+  {
+    size_t a = GSL_MAX(start[r],from);
+    size_t b = GSL_MIN(start[r]+length[r],to);
+    res += b-a;
+  }
+  return res;
+}
+
+/** @brief Allocates an aspa_bitset
+ *
+ *  If `rle` is false the words are allocated and cleared, otherwise
+ *  only the run offsets are allocated (the runs themselves are allocated
+ *  by the caller).
+ *
+ *  @param[in] n_trials the number of trials
+ *  @param[in] n_bins the number of bins per trial
+ *  @param[in] bin_width the bin width (in s)
+ *  @param[in] rle a boolean, should the run-length representation be used
+ *  @returns a pointer to an allocated aspa_bitset, NULL if the
+ *           allocation failed
+*/
+aspa_bitset * aspa_bitset_alloc(size_t n_trials, size_t n_bins, double bin_width, bool rle)
+{
+  aspa_bitset * res = malloc(sizeof(aspa_bitset));
+  if (res == NULL)
+  {
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the bitset failed.");
+    return NULL;
+  }
+  res->n_trials = n_trials;
+  res->n_bins = n_bins;
+  res->n_words = (n_bins+63)/64;
+  res->bin_width = bin_width;
+  res->n_multiple = 0;
+  res->rle = rle;
+  res->bits = NULL;
+  res->run_offset = NULL;
+  res->run_start = NULL;
+  res->run_length = NULL;
+  if (rle)
+    res->run_offset = calloc(n_trials+1,sizeof(size_t));
+  else
+    res->bits = calloc(n_trials*res->n_words,sizeof(uint64_t));
+  if (res->run_offset == NULL && res->bits == NULL)
+  {
+    aspa_bitset_free(res);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the bitset failed.");
+    return NULL;
+  }
+  return res;
+}
+
+/** @brief Frees an aspa_bitset
+ *
+ *  @param[in/out] bs a pointer to an allocated aspa_bitset
+ *  @returns 0 if everything goes fine
+*/
+int aspa_bitset_free(aspa_bitset * bs)
+{
+  free(bs->bits);
+  free(bs->run_offset);
+  free(bs->run_start);
+  free(bs->run_length);
+  free(bs);
+  return 0;
+}
+
+/** @brief Bins the trials of an aspa_sta structure and packs them
+ *         into an aspa_bitset
+ *
+ *  Bin k of a trial covers [k*bin_width,(k+1)*bin_width) on the within
+ *  trial time, the number of bins being ceil(trial_duration/bin_width).
+ *  Spikes outside [0,trial_duration] are ignored and a spike at exactly
+ *  trial_duration goes in the last bin. The number of bins containing
+ *  more than one spike (which the binary representation cannot tell
+ *  apart from single spike bins) is stored in member `n_multiple`.
+ *  The run-length representation is chosen automatically when the
+ *  trains are so sparse that it needs much less memory than the
+ *  packed words.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] bin_width the bin width (in s)
+ *  @returns a pointer to an allocated aspa_bitset
+*/
+aspa_bitset * aspa_sta_to_bitset(const aspa_sta * sta, double bin_width)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  assert (bin_width > 0);
+  size_t n_trials = sta->n_trials;
+  size_t n_bins = (size_t) ceil(sta->trial_duration/bin_width);
+  if (n_bins == 0)
+    n_bins = 1;
+  size_t n_words = (n_bins+63)/64;
+  size_t n_spikes = aspa_sta_n_spikes(sta);
+  bool rle = ASPA_BITSET_RLE_RATIO*2*n_spikes*sizeof(size_t) < n_trials*n_words*sizeof(uint64_t);
+  aspa_bitset * res = aspa_bitset_alloc(n_trials,n_bins,bin_width,rle);
+  if (res == NULL)
+    return NULL;
+  if (rle)
+  { // at most one run per spike
+    res->run_start = malloc((n_spikes ? n_spikes : 1)*sizeof(size_t));
+    res->run_length = malloc((n_spikes ? n_spikes : 1)*sizeof(size_t));
+    if (res->run_start == NULL || res->run_length == NULL)
+    {
+      aspa_bitset_free(res);
+      aspa_ctx_error(ASPA_ENOMEM,"Allocation of the bitset runs failed.");
+      return NULL;
+    }
+  }
+  size_t n_runs = 0;
+  for (size_t t_idx=0; t_idx<n_trials; t_idx++)
+  {
+    gsl_vector * st = aspa_sta_get_st(sta,t_idx);
+    uint64_t * w = rle ? NULL : res->bits+t_idx*n_words;
+    size_t previous = SIZE_MAX; // bin of previous spike
+    for (size_t i=0; i<st->size; i++)
+    {
+      double t = gsl_vector_get(st,i);
+      if (t < 0 || t > sta->trial_duration)
+	continue;
+      size_t bin = (size_t) (t/bin_width);
+      if (bin >= n_bins)
+	bin = n_bins-1;
+      if (bin == previous)
+      {
+	res->n_multiple++;
+	continue;
+      }
+      if (rle)
+      {
+	if (n_runs > res->run_offset[t_idx] &&
+	    res->run_start[n_runs-1]+res->run_length[n_runs-1] == bin)
+	{
+	  res->run_length[n_runs-1]++;
+	}
+	else
+	{
+	  res->run_start[n_runs] = bin;
+	  res->run_length[n_runs] = 1;
+	  n_runs++;
+	}
+      }
+      else
+      {
+	w[bin/64] |= 1ULL << (bin%64);
+      }
+      previous = bin;
+    }
+    if (rle)
+      res->run_offset[t_idx+1] = n_runs;
+  }
+  return res;
+}
+
+/** @brief Returns the number of occupied bins of a given trial of an
+ *         aspa_bitset between bins from (included) and to (excluded)
+ *
+ *  @param[in] bs a pointer to an aspa_bitset
+ *  @param[in] t_idx the trial index
+ *  @param[in] from the first bin
+ *  @param[in] to the bin following the last one
+ *  @returns the count
+*/
+size_t aspa_bitset_count(const aspa_bitset * bs, size_t t_idx, size_t from, size_t to)
+{
+  assert (t_idx < bs->n_trials);
+  if (to > bs->n_bins)
+    to = bs->n_bins;
+  if (bs->rle)
+  {
+    size_t o = bs->run_offset[t_idx];
+    return rle_count(bs->run_start+o,bs->run_length+o,bs->run_offset[t_idx+1]-o,from,to);
+  }
+  return dense_count(bs->bits+t_idx*bs->n_words,from,to);
+}
+
+/** @brief Returns the spike counts of each trial in consecutive
+ *         windows
+ *
+ *  The trials are split into windows of `window` bins (the last
+ *  incomplete window is dropped).
+ *
+ *  @param[in] bs a pointer to an aspa_bitset
+ *  @param[in] window the window length in bins
+ *  @returns a pointer to an allocated gsl_matrix with as many rows as
+ *           trials and as many columns as windows
+*/
+gsl_matrix * aspa_bitset_window_counts(const aspa_bitset * bs, size_t window)
+{
+  assert (window > 0 && window <= bs->n_bins);
+  size_t n_windows = bs->n_bins/window;
+  gsl_matrix * res = gsl_matrix_alloc(bs->n_trials,n_windows);
+  for (size_t t_idx=0; t_idx<bs->n_trials; t_idx++)
+    for (size_t k=0; k<n_windows; k++)
+      gsl_matrix_set(res,t_idx,k,(double) aspa_bitset_count(bs,t_idx,k*window,(k+1)*window));
+  return res;
+}
+
+/** @brief Returns the Fano factor (count variance over count mean
+ *         across trials) in consecutive windows
+ *
+ *  @param[in] bs a pointer to an aspa_bitset with at least two trials
+ *  @param[in] window the window length in bins
+ *  @returns a pointer to an allocated gsl_vector with one Fano factor
+ *           per window (NAN when no spike fell in the window)
+*/
+gsl_vector * aspa_bitset_fano(const aspa_bitset * bs, size_t window)
+{
+  assert (bs->n_trials > 1);
+  gsl_matrix * counts = aspa_bitset_window_counts(bs,window);
+  size_t n_windows = counts->size2;
+  gsl_vector * res = gsl_vector_alloc(n_windows);
+  for (size_t k=0; k<n_windows; k++)
+  {
+    const double * col = gsl_matrix_ptr(counts,0,k);
+    double mean = gsl_stats_mean(col,counts->tda,bs->n_trials);
+    double var = gsl_stats_variance(col,counts->tda,bs->n_trials);
+    gsl_vector_set(res,k,mean > 0 ? var/mean : NAN);
+  }
+  gsl_matrix_free(counts);
+  return res;
+}
+
+/** @brief Returns the number of bins occupied in trial a_idx of `a`
+ *         and in trial b_idx of `b`
+ *
+ *  Both aspa_bitset must have the same number of bins; their
+ *  representations (dense or run-length) may differ.
+ *
+ *  @param[in] a a pointer to an aspa_bitset
+ *  @param[in] a_idx a trial index of a
+ *  @param[in] b a pointer to an aspa_bitset
+ *  @param[in] b_idx a trial index of b
+ *  @returns the number of coincidences
+*/
+size_t aspa_bitset_coincidences(const aspa_bitset * a, size_t a_idx,
+				const aspa_bitset * b, size_t b_idx)
+{
+  assert (a->n_bins == b->n_bins);
+  assert (a_idx < a->n_trials && b_idx < b->n_trials);
+  if (!a->rle && !b->rle)
+    return and_popcount(a->bits+a_idx*a->n_words,b->bits+b_idx*b->n_words,a->n_words);
+  if (a->rle && !b->rle)
+  { // make a the dense one
+    const aspa_bitset * tmp = a;
+    a = b;
+    b = tmp;
+    size_t tmp_idx = a_idx;
+    a_idx = b_idx;
+    b_idx = tmp_idx;
+  }
+  size_t res = 0;
+  size_t b_first = b->run_offset[b_idx];
+  size_t b_last = b->run_offset[b_idx+1];
+  if (!a->rle)
+  { // dense against runs
+    const uint64_t * w = a->bits+a_idx*a->n_words;
+    for (size_t r=b_first; r<b_last; r++)
+      res += dense_count(w,b->run_start[r],b->run_start[r]+b->run_length[r]);
+    return res;
+  }
+  // runs against runs, merge the two sorted lists
+  size_t ra = a->run_offset[a_idx];
+  size_t a_last = a->run_offset[a_idx+1];
+  size_t rb = b_first;
+  while (ra < a_last && rb < b_last)
+  {
+    size_t a_end = a->run_start[ra]+a->run_length[ra];
+    size_t b_end = b->run_start[rb]+b->run_length[rb];
+    size_t lo = GSL_MAX(a->run_start[ra],b->run_start[rb]);
+    size_t hi = GSL_MIN(a_end,b_end);
+    if (hi > lo)
+      res += hi-lo;
+    if (a_end <= b_end)
+      ra++;
+    else
+      rb++;
+  }
+  return res;
+}
+
+/** @brief Returns the coincidence counts between all the trials
+ *         of two aspa_bitset
+ *
+ *  Element (i,j) of the result is the number of bins occupied in
+ *  trial i of `a` and in trial j of `b`. Using `a == b` gives the
+ *  trial by trial coincidences of a single unit, using two units
+ *  recorded simultaneously gives the between units coincidences
+ *  on the diagonal.
+ *
+ *  @param[in] a a pointer to an aspa_bitset
+ *  @param[in] b a pointer to an aspa_bitset
+ *  @returns a pointer to an allocated gsl_matrix
+*/
+gsl_matrix * aspa_bitset_coincidence_matrix(const aspa_bitset * a, const aspa_bitset * b)
+{
+  ASPA_PROF_SCOPE();
+  gsl_matrix * res = gsl_matrix_alloc(a->n_trials,b->n_trials);
+  for (size_t i=0; i<a->n_trials; i++)
+    for (size_t j=0; j<b->n_trials; j++)
+      gsl_matrix_set(res,i,j,(double) aspa_bitset_coincidences(a,i,b,j));
+  return res;
+}
+
+/** @brief Writes in binary to stream the content of an aspa_bitset
+ *
+ *  The layout follows the one of `aspa_sta_fwrite`: the number of trials
+ *  (size_t), the number of bins (size_t), the bin width (double), the
+ *  number of multiple spikes bins (size_t), the representation (size_t,
+ *  0 for dense 1 for run-length) followed, for the dense representation,
+ *  by the words (uint64_t) of each trial or, for the run-length one, by
+ *  the n_trials+1 run offsets (size_t) and the runs starts and lengths
+ *  (size_t).
+ *
+ *  @param[in/out] stream a pointer to an opened file
+ *  @param[in] bs a pointer to the aspa_bitset to be written
+ *  @returns 0 if successful, ASPA_EIO otherwise
+*/
+int aspa_bitset_fwrite(FILE * stream, const aspa_bitset * bs)
+{
+  size_t rle = bs->rle ? 1 : 0;
+  size_t ok = 0;
+  ok += fwrite(&(bs->n_trials),sizeof(size_t),1,stream);
+  ok += fwrite(&(bs->n_bins),sizeof(size_t),1,stream);
+  ok += fwrite(&(bs->bin_width),sizeof(double),1,stream);
+  ok += fwrite(&(bs->n_multiple),sizeof(size_t),1,stream);
+  ok += fwrite(&rle,sizeof(size_t),1,stream);
+  if (ok != 5)
+    return aspa_ctx_error(ASPA_EIO,"Writing the bitset failed.");
+  if (bs->rle)
+  {
+    size_t n_runs = bs->run_offset[bs->n_trials];
+    if (fwrite(bs->run_offset,sizeof(size_t),bs->n_trials+1,stream) != bs->n_trials+1 ||
+	fwrite(bs->run_start,sizeof(size_t),n_runs,stream) != n_runs ||
+	fwrite(bs->run_length,sizeof(size_t),n_runs,stream) != n_runs)
+      return aspa_ctx_error(ASPA_EIO,"Writing the bitset failed.");
+  }
+  else
+  {
+    size_t n = bs->n_trials*bs->n_words;
+    if (fwrite(bs->bits,sizeof(uint64_t),n,stream) != n)
+      return aspa_ctx_error(ASPA_EIO,"Writing the bitset failed.");
+  }
+  return 0;
+}
+
+/** @brief Reads an aspa_bitset written by `aspa_bitset_fwrite`
+ *
+ *  @param[in/out] STREAM a pointer to an opened file
+ *  @returns a pointer to an allocated aspa_bitset or NULL if the
+ *           stream could not be read
+*/
+aspa_bitset * aspa_bitset_fread(FILE * STREAM)
+{
+  size_t n_trials, n_bins, n_multiple, rle;
+  double bin_width;
+  size_t ok = 0;
+  ok += fread(&n_trials,sizeof(size_t),1,STREAM);
+  ok += fread(&n_bins,sizeof(size_t),1,STREAM);
+  ok += fread(&bin_width,sizeof(double),1,STREAM);
+  ok += fread(&n_multiple,sizeof(size_t),1,STREAM);
+  ok += fread(&rle,sizeof(size_t),1,STREAM);
+  if (ok != 5 || rle > 1)
+  {
+    aspa_ctx_error(ASPA_EFORMAT,"Badly formatted bitset header.");
+    return NULL;
+  }
+  aspa_bitset * res = aspa_bitset_alloc(n_trials,n_bins,bin_width,rle == 1);
+  if (res == NULL)
+    return NULL;
+  res->n_multiple = n_multiple;
+  bool failed;
+  if (res->rle)
+  {
+    failed = fread(res->run_offset,sizeof(size_t),n_trials+1,STREAM) != n_trials+1;
+    size_t n_runs = failed ? 0 : res->run_offset[n_trials];
+    failed = failed ||
+      (res->run_start = malloc((n_runs ? n_runs : 1)*sizeof(size_t))) == NULL ||
+      (res->run_length = malloc((n_runs ? n_runs : 1)*sizeof(size_t))) == NULL ||
+      fread(res->run_start,sizeof(size_t),n_runs,STREAM) != n_runs ||
+      fread(res->run_length,sizeof(size_t),n_runs,STREAM) != n_runs;
+  }
+  else
+  {
+    size_t n = n_trials*res->n_words;
+    failed = fread(res->bits,sizeof(uint64_t),n,STREAM) != n;
+  }
+  if (failed)
+  {
+    aspa_bitset_free(res);
+    aspa_ctx_error(ASPA_EFORMAT,"Badly formatted bitset.");
+    return NULL;
+  }
+  return res;
+}
@@ -0,0 +1,117 @@
+/** @file aspa_bitset_test.c
+ *  @brief User program for testing the aspa_bitset functions
+ *
+ *  Two 10 trials aspa_sta are simulated and binned, once with a
+ *  large bin width (dense representation) and once with a small one
+ *  (run-length representation). Window counts and coincidences are
+ *  compared with the ones obtained from the spike times directly and
+ *  the binary write / read cycle is checked.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa.h"
+
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+
+/** Returns a 0/1 occupancy array of trial t_idx */
+char * occupancy(const aspa_sta * sta, size_t t_idx, double bin_width, size_t n_bins)
+{
+  char * res = calloc(n_bins,1);
+  gsl_vector * st = aspa_sta_get_st(sta,t_idx);
+  for (size_t i=0; i<st->size; i++)
+  {
+    size_t bin = (size_t) (gsl_vector_get(st,i)/bin_width);
+    res[bin < n_bins ? bin : n_bins-1] = 1;
+  }
+  return res;
+}
+
+void check(const aspa_sta * sta_a, const aspa_sta * sta_b, double bin_width)
+{
+  aspa_bitset * a = aspa_sta_to_bitset(sta_a,bin_width);
+  aspa_bitset * b = aspa_sta_to_bitset(sta_b,bin_width);
+  printf("Bin width %g: %d bins, %s representation, %d multiple spikes bins.\n",
+	 bin_width, (int) a->n_bins, a->rle ? "run-length" : "dense", (int) a->n_multiple);
+  size_t n_bins = a->n_bins;
+  size_t window = n_bins/37+1;
+  gsl_matrix * counts = aspa_bitset_window_counts(a,window);
+  gsl_matrix * coinc = aspa_bitset_coincidence_matrix(a,b);
+  double count_diff = 0., coinc_diff = 0.;
+  for (size_t i=0; i<sta_a->n_trials; i++)
+  {
+    char * oa = occupancy(sta_a,i,bin_width,n_bins);
+    for (size_t k=0; k<counts->size2; k++)
+    {
+      double c = 0.;
+      for (size_t l=k*window; l<(k+1)*window; l++)
+	c += oa[l];
+      count_diff = GSL_MAX_DBL(count_diff,fabs(c-gsl_matrix_get(counts,i,k)));
+    }
+    for (size_t j=0; j<sta_b->n_trials; j++)
+    {
+      char * ob = occupancy(sta_b,j,bin_width,n_bins);
+      double c = 0.;
+      for (size_t l=0; l<n_bins; l++)
+	c += oa[l] && ob[l];
+      coinc_diff = GSL_MAX_DBL(coinc_diff,fabs(c-gsl_matrix_get(coinc,i,j)));
+      free(ob);
+    }
+    free(oa);
+  }
+  printf("  Max. abs. diff. window counts: %g; coincidences: %g.\n", count_diff, coinc_diff);
+  gsl_vector * fano = aspa_bitset_fano(a,window);
+  printf("  Fano factor of the first window: %g.\n", gsl_vector_get(fano,0));
+  FILE * fp = tmpfile();
+  aspa_bitset_fwrite(fp,a);
+  rewind(fp);
+  aspa_bitset * c = aspa_bitset_fread(fp);
+  fclose(fp);
+  size_t n_diff = 0;
+  for (size_t i=0; i<a->n_trials; i++)
+    n_diff += aspa_bitset_count(a,i,0,n_bins) != aspa_bitset_count(c,i,0,n_bins) ||
+      aspa_bitset_coincidences(a,i,c,i) != aspa_bitset_count(a,i,0,n_bins);
+  printf("  Number of trials differing after a write / read cycle: %d.\n", (int) n_diff);
+  aspa_bitset_free(c);
+  gsl_vector_free(fano);
+  gsl_matrix_free(counts);
+  gsl_matrix_free(coinc);
+  aspa_bitset_free(a);
+  aspa_bitset_free(b);
+}
+
+int main()
+{
+  gsl_rng * rng = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(rng,20061001);
+  size_t n_trials=10;
+  double duration=20.;
+  aspa_sta * sta_a = aspa_sta_alloc(n_trials,1,0,0,duration);
+  aspa_sta * sta_b = aspa_sta_alloc(n_trials,1,0,0,duration);
+  for (size_t i=0; i<n_trials; i++)
+  {
+    aspa_sta_set_st_start(sta_a,i,i*duration);
+    aspa_sta_set_st_start(sta_b,i,i*duration);
+    size_t n = gsl_ran_poisson(rng,15.*duration);
+    sta_a->st[i] = gsl_vector_alloc(n);
+    sta_b->st[i] = gsl_vector_alloc(n);
+    for (size_t j=0; j<n; j++)
+    {
+      double t = duration*gsl_rng_uniform(rng);
+      gsl_vector_set(sta_a->st[i],j,t);
+      // half of the spikes of b are synchronous with the ones of a
+      if (j % 2 == 0)
+	gsl_vector_set(sta_b->st[i],j,t);
+      else
+	gsl_vector_set(sta_b->st[i],j,duration*gsl_rng_uniform(rng));
+    }
+    gsl_sort_vector(sta_a->st[i]);
+    gsl_sort_vector(sta_b->st[i]);
+  }
+  check(sta_a,sta_b,0.001);
+  check(sta_a,sta_b,0.00001);
+  aspa_sta_free(sta_a);
+  aspa_sta_free(sta_b);
+  gsl_rng_free(rng);
+  return 0;
+}
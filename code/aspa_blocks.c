@@ -0,0 +1,165 @@
+/** @file aspa_blocks.c
+ *  @brief Function definitions for adaptive (Bayesian Blocks) histograms
+ *
+ *  The optimal partition of Scargle, Norris, Jackson and Chiang (2013)
+ *  Studies in Astronomical Time Series Analysis. VI. Bayesian Block
+ *  Representations [_The Astrophysical Journal_ __764__: 167](https://doi.org/10.1088/0004-637X/764/2/167)
+ *  is obtained by dynamic programming. The candidate block starts are
+ *  pruned as in the PELT algorithm of Killick, Fearnhead and Eckley (2012)
+ *  Optimal Detection of Changepoints With a Linear Computational Cost
+ *  [_JASA_ __107__: 1590-1598](https://doi.org/10.1080/01621459.2012.737745).
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+/** @brief Returns the prior on the number of change points
+ *
+ *  Empirical calibration of Scargle et al (2013), eq. 21, for event
+ *  data.
+ *
+ *  @param[in] n the number of events
+ *  @param[in] p0 the false alarm probability of a single change point
+ *  @returns the (log) penalty paid by each new block
+*/
+double aspa_bayesian_blocks_ncp_prior(size_t n, double p0)
+{
+  return 4.-log(73.53*p0*pow((double) n,-0.478));
+}
+
+/** @brief Returns a Bayesian Blocks histogram of a sample
+ *
+ *  The sample is viewed as a sequence of events (spike times of an
+ *  aggregated train or ISI); tied values are merged into a single
+ *  cell with the corresponding count. The cell edges are the mid-points
+ *  between successive distinct values, the first and last edges are
+ *  the sample minimum and maximum. The "fitness" of a block containing
+ *  N events over a length T is N (log N - log T) and the optimal
+ *  partition maximizes the sum of the blocks fitness minus `ncp_prior`
+ *  per block.
+ *
+ *  The dynamic program of Scargle et al (2013) is O(n^2) in general.
+ *  Since splitting a block never decreases the total fitness, a
+ *  candidate start whose best achievable fitness is already below the
+ *  current optimum can never become optimal again and is discarded
+ *  (PELT pruning). When the number of blocks grows with the sample size,
+ *  as it does with bursting trains or long recordings, the cost becomes
+ *  close to linear; it remains quadratic for a sample without any change
+ *  point.
+ *
+ *  The histogram bins contain the block counts.
+ *
+ *  @param[in] data pointer to a `gsl_vector` containing the data
+ *  @param[in] sorted a boolean indicated if the `data` content is
+ *             already sorted (`true`) or not (`false`)
+ *  @param[in] p0 the false alarm probability used to set the prior
+ *             on the number of blocks (0.05 is a classical value)
+ *  @returns a pointer to an allocated `gsl_histogram` or NULL if
+ *           `data` contains less than two distinct values
+*/
+gsl_histogram * aspa_bayesian_blocks(const gsl_vector * data, bool sorted, double p0)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(data->size);
+  size_t n = data->size;
+  // All the temporary arrays are taken from a single buffer
+  double * data_s = aspa_ctx_malloc((7*n+4)*sizeof(double)+(2*n+1)*sizeof(size_t));
+  if (data_s == NULL)
+    return NULL;
+  double * x = data_s+n;
+  double * cum_n = x+n;
+  double * edge = cum_n+n+1;
+  double * best = edge+n+1;
+  double * value = best+n+1;
+  double * range = value+n;
+  size_t * last = (size_t *) (range+n+1);
+  size_t * cand = last+n+1; // surviving block starts
+  for (size_t i=0; i<n; i++)
+    data_s[i] = gsl_vector_get(data,i);
+  if (sorted == false && aspa_sort_w(data_s,n,x) != 0)
+  { // x is not in use yet
+    aspa_ctx_free(data_s);
+    return NULL;
+  }
+  // Merge tied values, x holds the distinct values, cum_n the
+  // cumulative counts
+  size_t k = 0;
+  cum_n[0] = 0.;
+  for (size_t i=0; i<n; i++)
+  {
+    double xi = data_s[i];
+    if (k == 0 || xi > x[k-1])
+    {
+      x[k] = xi;
+      cum_n[k+1] = cum_n[k];
+      k++;
+    }
+    cum_n[k] += 1.;
+  }
+  if (k < 2)
+  {
+    aspa_ctx_free(data_s);
+    aspa_ctx_error(ASPA_EINVAL,"Bayesian blocks need at least two distinct values.");
+    return NULL;
+  }
+  edge[0] = x[0];
+  for (size_t i=1; i<k; i++)
+    edge[i] = 0.5*(x[i-1]+x[i]);
+  edge[k] = x[k-1];
+
+  double ncp_prior = aspa_bayesian_blocks_ncp_prior(n,p0);
+  // best[r] is the optimal fitness of cells 0..r-1, last[r] the first
+  // cell of the last block of the corresponding partition
+  size_t n_cand = 0;
+  best[0] = 0.;
+  for (size_t r=0; r<k; r++)
+  {
+    cand[n_cand++] = r;
+    double f_max = -HUGE_VAL;
+    for (size_t c=0; c<n_cand; c++)
+    {
+      size_t j = cand[c];
+      double n_b = cum_n[r+1]-cum_n[j];
+      double t_b = edge[r+1]-edge[j];
+      value[c] = best[j] + n_b*(log(n_b)-log(t_b)) - ncp_prior;
+      if (value[c] > f_max)
+      {
+	f_max = value[c];
+	last[r+1] = j;
+      }
+    }
+    best[r+1] = f_max;
+    // PELT pruning: starts that cannot beat the optimum even when
+    // freed from their ncp_prior are dropped
+    size_t kept = 0;
+    for (size_t c=0; c<n_cand; c++)
+    {
+      if (value[c] + ncp_prior >= f_max)
+	cand[kept++] = cand[c];
+    }
+    n_cand = kept;
+  }
+  // Backtrack the change points, they are stored from the end
+  size_t n_blocks = 0;
+  for (size_t r=k; r>0; r=last[r])
+    cand[n_blocks++] = last[r];
+  gsl_histogram * hist = gsl_histogram_alloc(n_blocks);
+  if (hist == NULL)
+  {
+    aspa_ctx_free(data_s);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the Bayesian blocks histogram failed.");
+    return NULL;
+  }
+  for (size_t b=0; b<n_blocks; b++)
+    range[b] = edge[cand[n_blocks-1-b]];
+  range[n_blocks] = edge[k];
+  gsl_histogram_set_ranges(hist, range, n_blocks+1);
+  for (size_t b=0; b<n_blocks; b++)
+  {
+    size_t end = (b+1 < n_blocks) ? cand[n_blocks-2-b] : k;
+    hist->bin[b] = cum_n[end]-cum_n[cand[n_blocks-1-b]];
+  }
+  aspa_ctx_free(data_s);
+  return hist;
+}
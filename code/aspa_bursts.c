@@ -0,0 +1,310 @@
+/** @file aspa_bursts.c
+ *  @brief Function definitions for the burst detection
+ *
+ *  Two methods are implemented, both scan the inter spike intervals of
+ *  each trial once, forward:
+ *   - The max-interval method (the one of NeuroExplorer): a burst
+ *     starts with an interval <= max_isi_start and goes on while the
+ *     intervals are <= max_isi_end; a burst closer than min_ibi to the
+ *     previous one is merged with it, the bursts shorter than
+ *     min_duration or with less than min_spikes spikes are dropped.
+ *   - The Poisson surprise method of Legéndy and Salcman (1985)
+ *     J. Neurophysiol. 53: 926-939: a burst starts with min_spikes
+ *     spikes whose intervals are below half the mean interval of the
+ *     trial; spikes are added at its end while the surprise
+ *     -log10 Prob{N >= n} (N Poisson, of mean the rate of the trial
+ *     times the duration of the n spikes) increases, then removed from
+ *     its start while it increases. The burst is kept if its surprise
+ *     is at least min_surprise, the scan resumes after it (kept or
+ *     not, so that the scan stays linear).
+ *
+ *  The log factorials of the Poisson terms are tabulated once, the
+ *  tail probability of a candidate is then a short series. The trials
+ *  are scanned in parallel twice: the bursts are counted, then stored
+ *  at their place in the compact arrays of the result.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+#define BURST_LFACT_MAX 4096 //!< Size of the table of log factorials
+
+typedef struct
+{
+  const aspa_burst_params * params;
+  const double * lfact; //!< log(k!) for k < BURST_LFACT_MAX
+  size_t * count; //!< Bursts per trial, then index of the first one
+  aspa_bursts * res; //!< NULL during the counting pass
+} burst_job;
+
+/** Receives the bursts of a trial */
+typedef struct
+{
+  const burst_job * job;
+  size_t t_idx;
+  const gsl_vector * st;
+  size_t n; //!< Number of bursts found so far
+} burst_sink;
+
+static void emit(burst_sink * sink, size_t first, size_t last, double surprise)
+{
+  aspa_bursts * res = sink->job->res;
+  if (res != NULL)
+  {
+    size_t b = sink->job->count[sink->t_idx]+sink->n;
+    double start = gsl_vector_get(sink->st,first);
+    res->trial[b] = sink->t_idx;
+    res->first[b] = first;
+    res->last[b] = last;
+    res->start[b] = start;
+    res->duration[b] = gsl_vector_get(sink->st,last)-start;
+    res->surprise[b] = surprise;
+  }
+  sink->n++;
+}
+
+static double lfact(const double * table, size_t k)
+{
+  return k < BURST_LFACT_MAX ? table[k] : lgamma(k+1.);
+}
+
+/** log Prob{N >= n} where N is Poisson of mean lambda */
+static double log_poisson_tail(const double * table, size_t n, double lambda)
+{
+  if (n == 0)
+    return 0.;
+  if (!(lambda > 0.))
+    return -INFINITY;
+  if (lambda < n)
+  { // Prob{N = n} (1+lambda/(n+1)+lambda^2/((n+1)(n+2))+...)
+    double s = 1., t = 1.;
+    for (size_t j=1; t > 1e-17*s; j++)
+    {
+      t *= lambda/(n+j);
+      s += t;
+    }
+    return -lambda+n*log(lambda)-lfact(table,n)+log(s);
+  }
+  // 1-Prob{N < n}, the terms decrease from k=n-1 down
+  double log_term = -lambda+(n-1)*log(lambda)-lfact(table,n-1);
+  double s = 0., t = 1.;
+  for (size_t k=n-1; ; k--)
+  {
+    s += t;
+    if (k == 0 || t < 1e-17*s)
+      break;
+    t *= k/lambda;
+  }
+  return log1p(-GSL_MIN(exp(log_term)*s,1.));
+}
+
+static double isi(const gsl_vector * st, size_t i)
+{
+  return gsl_vector_get(st,i+1)-gsl_vector_get(st,i);
+}
+
+/** Keeps the burst of spikes first to last if it is long enough */
+static void mi_flush(burst_sink * sink, size_t first, size_t last)
+{
+  const aspa_burst_params * p = sink->job->params;
+  if (last-first+1 >= p->min_spikes &&
+      gsl_vector_get(sink->st,last)-gsl_vector_get(sink->st,first) >= p->min_duration)
+    emit(sink,first,last,GSL_NAN);
+}
+
+static void max_interval(burst_sink * sink)
+{
+  const aspa_burst_params * p = sink->job->params;
+  const gsl_vector * st = sink->st;
+  size_t n = st->size;
+  bool pending = false;
+  size_t p_first = 0, p_last = 0;
+  for (size_t i=0; i+1 < n; i++)
+  {
+    if (isi(st,i) > p->max_isi_start)
+      continue;
+    size_t j = i+1;
+    while (j+1 < n && isi(st,j) <= p->max_isi_end)
+      j++;
+    if (pending && gsl_vector_get(st,i)-gsl_vector_get(st,p_last) < p->min_ibi)
+      p_last = j;
+    else
+    {
+      if (pending)
+	mi_flush(sink,p_first,p_last);
+      pending = true;
+      p_first = i;
+      p_last = j;
+    }
+    i = j;
+  }
+  if (pending)
+    mi_flush(sink,p_first,p_last);
+}
+
+/** Surprise of spikes first to last at the given rate */
+static double surprise(const burst_sink * sink, double rate, size_t first, size_t last)
+{
+  double T = gsl_vector_get(sink->st,last)-gsl_vector_get(sink->st,first);
+  return -log_poisson_tail(sink->job->lfact,last-first+1,rate*T)/M_LN10;
+}
+
+static void poisson_surprise(burst_sink * sink)
+{
+  const aspa_burst_params * p = sink->job->params;
+  const gsl_vector * st = sink->st;
+  size_t n = st->size;
+  size_t m = GSL_MAX(p->min_spikes,2);
+  if (n < m)
+    return;
+  double mean_isi = (gsl_vector_get(st,n-1)-gsl_vector_get(st,0))/(n-1);
+  double rate = 1./mean_isi;
+  size_t short_run = 0; // consecutive intervals < mean_isi/2 ending at i
+  for (size_t i=0; i+1 < n; i++)
+  {
+    short_run = isi(st,i) < 0.5*mean_isi ? short_run+1 : 0;
+    if (short_run+1 < m)
+      continue;
+    size_t first = i+2-m, last = i+1;
+    double S = surprise(sink,rate,first,last);
+    while (last+1 < n)
+    {
+      double S_next = surprise(sink,rate,first,last+1);
+      if (!(S_next > S))
+	break;
+      S = S_next;
+      last++;
+    }
+    while (last-first+1 > m)
+    {
+      double S_next = surprise(sink,rate,first+1,last);
+      if (!(S_next > S))
+	break;
+      S = S_next;
+      first++;
+    }
+    if (S >= p->min_surprise)
+      emit(sink,first,last,S);
+    i = last;
+    short_run = 0;
+  }
+}
+
+static void burst_trial(const aspa_sta * sta, size_t t_idx, void * params)
+{
+  burst_job * job = params;
+  burst_sink sink = {.job=job, .t_idx=t_idx, .st=sta->st[t_idx], .n=0};
+  if (job->params->method == ASPA_BURST_MAX_INTERVAL)
+    max_interval(&sink);
+  else
+    poisson_surprise(&sink);
+  if (job->res == NULL)
+    job->count[t_idx] = sink.n;
+}
+
+/** @brief Returns the default parameters of a burst detection method
+ *
+ *  Max-interval: bursts start with an interval <= 0.17 s, go on with
+ *  intervals <= 0.3 s, are merged when less than 0.2 s apart and need
+ *  3 spikes and 0.01 s. Poisson surprise: bursts start with 3 spikes
+ *  and need a surprise of 3.
+ *
+ *  @param[in] method ASPA_BURST_MAX_INTERVAL or ASPA_BURST_POISSON_SURPRISE
+ *  @returns an aspa_burst_params
+*/
+aspa_burst_params aspa_burst_params_default(aspa_burst_method method)
+{
+  return (aspa_burst_params) {.method=method, .max_isi_start=0.17, .max_isi_end=0.3,
+      .min_ibi=0.2, .min_duration=0.01, .min_spikes=3, .min_surprise=3.};
+}
+
+/** @brief Frees an aspa_bursts
+ *
+ *  @param[in/out] bursts a pointer to an allocated aspa_bursts
+ *  @returns 0 if everything goes fine
+*/
+int aspa_bursts_free(aspa_bursts * bursts)
+{
+  free(bursts->trial);
+  free(bursts->start);
+  free(bursts);
+  return 0;
+}
+
+/** @brief Detects the bursts of the trials of an aspa_sta
+ *
+ *  See aspa_bursts.c for the methods. The bursts are ordered by trial
+ *  then by time; first and last are the indices of the first and last
+ *  spikes of a burst in its trial, surprise is NaN with the
+ *  max-interval method. The spike times of each trial must be sorted.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] params a pointer to the parameters of the method
+ *  @returns a pointer to an allocated aspa_bursts, NULL if the
+ *           allocation failed
+*/
+aspa_bursts * aspa_bursts_detect(const aspa_sta * sta, const aspa_burst_params * params)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  double * table = aspa_ctx_malloc(BURST_LFACT_MAX*sizeof(double)+
+				   (sta->n_trials+1)*sizeof(size_t));
+  if (table == NULL)
+    return NULL;
+  table[0] = 0.;
+  for (size_t k=1; k<BURST_LFACT_MAX; k++)
+    table[k] = table[k-1]+log((double) k);
+  size_t * count = (size_t *) (table+BURST_LFACT_MAX);
+  burst_job job = {.params=params, .lfact=table, .count=count, .res=NULL};
+  aspa_sta_parallel_for(sta,burst_trial,&job);
+  size_t n_bursts = 0;
+  for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
+  {
+    size_t c = count[t_idx];
+    count[t_idx] = n_bursts;
+    n_bursts += c;
+  }
+  aspa_bursts * res = malloc(sizeof(aspa_bursts));
+  size_t size = n_bursts > 0 ? n_bursts : 1;
+  if (res != NULL)
+  {
+    res->n_bursts = n_bursts;
+    res->trial = malloc(3*size*sizeof(size_t));
+    res->start = malloc(3*size*sizeof(double));
+  }
+  if (res == NULL || res->trial == NULL || res->start == NULL)
+  {
+    if (res != NULL)
+      aspa_bursts_free(res);
+    aspa_ctx_free(table);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the bursts failed.");
+    return NULL;
+  }
+  res->first = res->trial+size;
+  res->last = res->trial+2*size;
+  res->duration = res->start+size;
+  res->surprise = res->start+2*size;
+  job.res = res;
+  aspa_sta_parallel_for(sta,burst_trial,&job);
+  aspa_ctx_free(table);
+  return res;
+}
+
+/** @brief Prints the bursts, one row per burst after a header
+ *
+ *  @param[in/out] STREAM a pointer to an open file
+ *  @param[in] bursts a pointer to an aspa_bursts
+ *  @returns 0 if everything goes fine, ASPA_EIO if the writing failed
+*/
+int aspa_bursts_fprintf(FILE * STREAM, const aspa_bursts * bursts)
+{
+  fprintf(STREAM,"# trial first last n_spikes start duration surprise\n");
+  for (size_t b=0; b < bursts->n_bursts; b++)
+    fprintf(STREAM,"%zu %zu %zu %zu %g %g %g\n",bursts->trial[b],bursts->first[b],
+	    bursts->last[b],bursts->last[b]-bursts->first[b]+1,bursts->start[b],
+	    bursts->duration[b],bursts->surprise[b]);
+  if (ferror(STREAM))
+    return aspa_ctx_error(ASPA_EIO,"Writing the bursts failed.");
+  return 0;
+}
@@ -0,0 +1,113 @@
+/** @file aspa_bursts_test.c
+ *  @brief User program for testing function aspa_bursts_detect
+ *
+ *  Bursts of 8 spikes 5 ms apart are planted at known times in the 20
+ *  trials of an homogeneous Poisson train of rate 1 Hz: both methods
+ *  must find each of them, holding all the planted spikes and at most
+ *  50 ms of background on each side, and at most one other burst. On a simulated gamma
+ *  train every burst must hold at least the minimal number of spikes
+ *  of its trial, start at its first spike and not overlap the previous
+ *  burst of the trial; the Poisson surprise ones must reach the
+ *  surprise threshold.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa_test.h"
+
+#define N_TRIALS 20
+#define N_PLANTED 8
+#define PLANTED_ISI 0.005
+
+/** Returns the Poisson train with one planted burst per trial of 10 s,
+    the start of the burst of trial k is stored in planted[k] */
+aspa_sta * planted_sta(double * planted)
+{
+  gsl_rng * rng = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(rng,ASPA_TEST_SEED);
+  gsl_vector * background = aspa_sim_poisson(rng,3*N_TRIALS*10,1.);
+  size_t n_background = 0;
+  while (n_background < background->size &&
+	 gsl_vector_get(background,n_background) < 10.*N_TRIALS)
+    n_background++;
+  gsl_vector * train = gsl_vector_alloc(n_background+N_TRIALS*N_PLANTED);
+  for (size_t i=0; i<n_background; i++)
+    gsl_vector_set(train,i,gsl_vector_get(background,i));
+  for (size_t k=0; k<N_TRIALS; k++)
+  {
+    planted[k] = 1.+7.*gsl_rng_uniform(rng);
+    for (size_t j=0; j<N_PLANTED; j++)
+      gsl_vector_set(train,n_background+k*N_PLANTED+j,10.*k+planted[k]+j*PLANTED_ISI);
+  }
+  gsl_sort_vector(train);
+  aspa_sta * res = aspa_sim_sta(train,10.);
+  gsl_vector_free(train);
+  gsl_vector_free(background);
+  gsl_rng_free(rng);
+  return res;
+}
+
+int main()
+{
+  const char * name[2] = {"max interval","Poisson surprise"};
+  char label[64];
+  size_t n_failed = 0;
+  test_header("value");
+  // planted bursts
+  double planted[N_TRIALS];
+  aspa_sta * sta = planted_sta(planted);
+  for (int method=ASPA_BURST_MAX_INTERVAL; method<=ASPA_BURST_POISSON_SURPRISE; method++)
+  {
+    aspa_burst_params params = aspa_burst_params_default(method);
+    params.max_isi_start = 0.01;
+    params.max_isi_end = 0.02;
+    aspa_bursts * bursts = sta->n_trials == N_TRIALS ? aspa_bursts_detect(sta,&params) : NULL;
+    if (bursts == NULL)
+    {
+      n_failed++;
+      continue;
+    }
+    size_t n_found = 0;
+    for (size_t b=0; b<bursts->n_bursts; b++)
+    {
+      // all the planted spikes, at most 50 ms of background around
+      double start = bursts->start[b]-planted[bursts->trial[b]];
+      double end = start+bursts->duration[b]-(N_PLANTED-1)*PLANTED_ISI;
+      n_found += start <= 1e-9 && start >= -0.05 && end >= -1e-9 && end <= 0.05;
+    }
+    snprintf(label,sizeof(label),"%s, planted bursts missed",name[method]);
+    n_failed += test_report(label,N_TRIALS-n_found,0.);
+    snprintf(label,sizeof(label),"%s, other bursts",name[method]);
+    n_failed += test_report(label,bursts->n_bursts-n_found,1.);
+    aspa_bursts_free(bursts);
+  }
+  aspa_sta_free(sta);
+  // structure of the bursts of a gamma train
+  sta = test_sim_sta(ASPA_TEST_SEED,4000,15.,2.,10.);
+  for (int method=ASPA_BURST_MAX_INTERVAL; method<=ASPA_BURST_POISSON_SURPRISE; method++)
+  {
+    aspa_burst_params params = aspa_burst_params_default(method);
+    params.max_isi_start = 0.01;
+    params.max_isi_end = 0.02;
+    aspa_bursts * bursts = aspa_bursts_detect(sta,&params);
+    if (bursts == NULL)
+    {
+      n_failed++;
+      continue;
+    }
+    size_t n_invalid = 0;
+    for (size_t b=0; b<bursts->n_bursts; b++)
+    {
+      const gsl_vector * st = sta->st[bursts->trial[b]];
+      n_invalid += bursts->last[b]+1 < bursts->first[b]+params.min_spikes ||
+	bursts->last[b] >= st->size || bursts->start[b] != gsl_vector_get(st,bursts->first[b]) ||
+	(b > 0 && bursts->trial[b] == bursts->trial[b-1] && bursts->first[b] <= bursts->last[b-1]) ||
+	(method == ASPA_BURST_POISSON_SURPRISE && !(bursts->surprise[b] >= params.min_surprise));
+    }
+    snprintf(label,sizeof(label),"%s, gamma train, invalid bursts",name[method]);
+    n_failed += test_report(label,n_invalid,0.);
+    aspa_bursts_free(bursts);
+  }
+  aspa_sta_free(sta);
+  printf("Checks failed: %d (0 expected).\n",(int) n_failed);
+  return n_failed == 0 ? 0 : 1;
+}
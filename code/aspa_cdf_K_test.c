@@ -6,12 +6,16 @@
  *  with the some elements of the table of Z. Birnbaum (1952) JASA 47(229): 425-441 and reproduce table 1
  *  of Birnbaum and Tingey (1951) One-sided confidence contours for probability distribution functions
  *  _The Annals of Mathematical Statistics_ __22__: 592-596.
+ *  The 0.05 column of the latter is then obtained again from
+ *  aspa_cdf_Kplus_array on a grid of step 1e-4.
  * 
  *
  *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
 */
 #include "aspa.h"
 
+#define GRID_SIZE 10000
+
 int main()
 {
   char Birnbaum[] = "Birnbaum (1952)";
@@ -66,5 +70,21 @@ int main()
   printf("%5d %7g %7g %7g %g7\n\n", 50, aspa_cdf_Kplus(50,0.14840),
 	 aspa_cdf_Kplus(50,0.16959), aspa_cdf_Kplus(50,0.2107),
 	 aspa_cdf_Kplus(50,0.2581));
+  printf("Smallest d on a grid of step 1e-4 with aspa_cdf_Kplus_array(n,d) >= 0.95\n\n");
+  int n_tab[] = {5,8,10,20,40,50};
+  static double d[GRID_SIZE], res[GRID_SIZE];
+  size_t size = GRID_SIZE;
+  for (size_t i=0; i<size; i++)
+    d[i] = i*1e-4;
+  for (int t=0; t<6; t++)
+  {
+    if (aspa_cdf_Kplus_array(res,n_tab[t],d,size) != 0)
+      return 1;
+    size_t i=0;
+    while (i<size-1 && res[i] < 0.95)
+      i++;
+    printf("%5d %7g\n", n_tab[t], d[i]);
+  }
+  printf("\n");
   return 0;
 }
@@ -0,0 +1,325 @@
+/** @file aspa_correlogram.c
+ *  @brief Function definitions for cross- and auto-correlograms
+ *
+ *  The spike trains of each trial being sorted, the spikes of the
+ *  "target" train falling within `max_lag` of a given "reference" spike
+ *  form a window that slides monotonically along the target train.
+ *  Each trial is therefore processed in O(N + M + number of pairs within
+ *  the window) instead of O(N M). Groups of trials are processed in
+ *  parallel (see aspa_pool.c), each one with its own counts.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+/** @brief Allocates an aspa_ccg
+ *
+ *  The lag range [-max_lag,max_lag) is split into bins of width
+ *  `bin_width`, max_lag being rounded up to a multiple of `bin_width`.
+ *  The three count vectors are set to zero.
+ *
+ *  @param[in] max_lag the largest lag considered (in s)
+ *  @param[in] bin_width the bin width (in s)
+ *  @returns a pointer to an allocated aspa_ccg, NULL if the allocation
+ *           failed
+*/
+aspa_ccg * aspa_ccg_alloc(double max_lag, double bin_width)
+{
+  assert (max_lag > 0 && bin_width > 0);
+  aspa_ccg * res = malloc(sizeof(aspa_ccg));
+  if (res == NULL)
+  {
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the correlogram failed.");
+    return NULL;
+  }
+  size_t n_half = (size_t) ceil(max_lag/bin_width);
+  res->n_bins = 2*n_half;
+  res->bin_width = bin_width;
+  res->max_lag = n_half*bin_width;
+  res->n_trials = 0;
+  res->raw = gsl_vector_calloc(res->n_bins);
+  res->shift = gsl_vector_calloc(res->n_bins);
+  res->shuffled = gsl_vector_calloc(res->n_bins);
+  if (res->raw == NULL || res->shift == NULL || res->shuffled == NULL)
+  {
+    aspa_ccg_free(res);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the correlogram failed.");
+    return NULL;
+  }
+  return res;
+}
+
+/** @brief Frees an aspa_ccg
+ *
+ *  @param[in/out] ccg a pointer to an allocated aspa_ccg structure
+ *  @returns 0 if everything goes fine
+*/
+int aspa_ccg_free(aspa_ccg * ccg)
+{
+  if (ccg->raw != NULL)
+    gsl_vector_free(ccg->raw);
+  if (ccg->shift != NULL)
+    gsl_vector_free(ccg->shift);
+  if (ccg->shuffled != NULL)
+    gsl_vector_free(ccg->shuffled);
+  free(ccg);
+  return 0;
+}
+
+/** @brief Adds to `count` the pairs (a_i,b_j) with lag b_j-a_i
+ *         in [-max_lag,max_lag)
+ *
+ *  Both `a` and `b` must be sorted in increasing order.
+ *
+ *  @param[in] a reference spike times
+ *  @param[in] n_a number of elements of a
+ *  @param[in] b target spike times
+ *  @param[in] n_b number of elements of b
+ *  @param[in] max_lag the (bin width multiple) largest lag
+ *  @param[in] bin_width the bin width
+ *  @param[in] n_bins the number of bins of count
+ *  @param[in/out] count the bin counts
+ *  @returns nothing
+*/
+static void ccg_sweep(const double * a, size_t n_a,
+		      const double * b, size_t n_b,
+		      double max_lag, double bin_width,
+		      size_t n_bins, double * count)
+{
+  size_t lo = 0;
+  double inv_bw = 1./bin_width;
+  double n_half = n_bins/2;
+  for (size_t i=0; i<n_a; i++)
+  {
+    double left = a[i]-max_lag;
+    double right = a[i]+max_lag;
+    while (lo < n_b && b[lo] < left)
+      lo++;
+    for (size_t j=lo; j<n_b && b[j] < right; j++)
+    {
+      // binning on the lag itself so that a zero lag always ends up in bin n_half
+      double bin = n_half+floor((b[j]-a[i])*inv_bw);
+      if (bin >= 0 && bin < n_bins) // protects against round-off at both ends
+	count[(size_t) bin] += 1.;
+    }
+  }
+}
+
+/** @brief Specialization of ccg_sweep for the auto-correlogram
+ *
+ *  Only the pairs (a_i,a_j), j > i, are visited and each one is counted
+ *  at lags +(a_j-a_i) and -(a_j-a_i) with the window [-max_lag,max_lag)
+ *  of ccg_sweep: a pair exactly max_lag apart is counted once, in the
+ *  first bin. The self-pairs are not counted.
+*/
+static void acg_sweep(const double * a, size_t n_a,
+		      double max_lag, double bin_width,
+		      size_t n_bins, double * count)
+{
+  double inv_bw = 1./bin_width;
+  double n_half = n_bins/2;
+  for (size_t i=0; i<n_a; i++)
+  {
+    double right = a[i]+max_lag;
+    // the tests of ccg_sweep with a_j, then a_i, as reference
+    for (size_t j=i+1; j<n_a && a[j]-max_lag <= a[i]; j++)
+    {
+      double lag = (a[j]-a[i])*inv_bw;
+      double bin = n_half+floor(lag);
+      if (a[j] < right && bin < n_bins)
+	count[(size_t) bin] += 1.;
+      bin = n_half+floor(-lag);
+      if (bin >= 0)
+	count[(size_t) bin] += 1.;
+    }
+  }
+}
+
+/** Number of groups of trials with their own counts */
+#define CCG_N_CHUNKS 64
+
+typedef struct
+{
+  const aspa_sta * sta_a;
+  const aspa_sta * sta_b;
+  const gsl_vector * agg_b; //!< aggregated sta_b
+  bool is_auto;
+  size_t n_chunks;
+  double max_lag;
+  double bin_width;
+  size_t n_bins;
+  double * raw; //!< n_chunks x n_bins partial counts
+  double * shift;
+  double * all;
+} ccg_job;
+
+/** Sweeps of the trials of chunk c_idx, a contiguous group of trials,
+    in its own counts */
+static void ccg_chunk(size_t c_idx, void * params)
+{
+  ccg_job * job = params;
+  size_t offset = c_idx*job->n_bins;
+  double * raw = job->raw+offset;
+  double * shift = job->shift+offset;
+  double * all = job->all+offset;
+  size_t n_trials = job->sta_a->n_trials;
+  size_t first = c_idx*n_trials/job->n_chunks;
+  size_t last = (c_idx+1)*n_trials/job->n_chunks;
+  for (size_t t_idx=first; t_idx<last; t_idx++)
+  {
+    const gsl_vector * st_a = aspa_sta_get_st(job->sta_a,t_idx);
+    const gsl_vector * st_b = aspa_sta_get_st(job->sta_b,t_idx);
+    const gsl_vector * st_s = aspa_sta_get_st(job->sta_b,(t_idx+1)%n_trials);
+    if (job->is_auto)
+      acg_sweep(st_a->data,st_a->size,job->max_lag,job->bin_width,job->n_bins,raw);
+    else
+      ccg_sweep(st_a->data,st_a->size,st_b->data,st_b->size,
+		job->max_lag,job->bin_width,job->n_bins,raw);
+    if (n_trials > 1)
+    {
+      ccg_sweep(st_a->data,st_a->size,st_s->data,st_s->size,
+		job->max_lag,job->bin_width,job->n_bins,shift);
+      // All the (trial t_idx, any trial) pairs in one sweep
+      ccg_sweep(st_a->data,st_a->size,job->agg_b->data,job->agg_b->size,
+		job->max_lag,job->bin_width,job->n_bins,all);
+    }
+  }
+}
+
+static aspa_ccg * ccg_compute(const aspa_sta * sta_a, const aspa_sta * sta_b,
+			      bool is_auto, double max_lag, double bin_width)
+{
+  if (sta_a->n_trials != sta_b->n_trials)
+  {
+    aspa_ctx_error(ASPA_EINVAL,"Both spike train arrays must have the same number of trials.");
+    return NULL;
+  }
+  aspa_ccg * res = aspa_ccg_alloc(max_lag,bin_width);
+  if (res == NULL)
+    return NULL;
+  size_t n_trials = sta_a->n_trials;
+  res->n_trials = n_trials;
+  aspa_sta * asta_b = NULL;
+  if (n_trials > 1 && (asta_b = aspa_sta_aggregate(sta_b)) == NULL)
+  {
+    aspa_ccg_free(res);
+    return NULL;
+  }
+  size_t n_chunks = GSL_MAX(GSL_MIN(n_trials,CCG_N_CHUNKS),1);
+  size_t n_bins = res->n_bins;
+  size_t n_counts = 3*n_chunks*n_bins;
+  double * counts = aspa_ctx_malloc(n_counts*sizeof(double));
+  if (counts == NULL)
+  {
+    if (asta_b != NULL)
+      aspa_sta_free(asta_b);
+    aspa_ccg_free(res);
+    return NULL;
+  }
+  memset(counts,0,n_counts*sizeof(double));
+  ccg_job job = {.sta_a=sta_a, .sta_b=sta_b,
+		 .agg_b=asta_b ? aspa_sta_get_st(asta_b,0) : NULL,
+		 .is_auto=is_auto, .n_chunks=n_chunks, .max_lag=res->max_lag,
+		 .bin_width=bin_width, .n_bins=n_bins,
+		 .raw=counts, .shift=counts+n_chunks*n_bins,
+		 .all=counts+2*n_chunks*n_bins};
+  size_t work = n_trials+aspa_sta_n_spikes(sta_a)+aspa_sta_n_spikes(sta_b);
+  aspa_parallel_for(n_chunks,work,ccg_chunk,&job);
+  // Reduce the per chunk counts in chunk order, all counts are
+  // integers so the result does not depend on the scheduling
+  for (size_t i=0; i<n_chunks; i++)
+  {
+    for (size_t k=0; k<n_bins; k++)
+    {
+      res->raw->data[k] += job.raw[i*n_bins+k];
+      res->shift->data[k] += job.shift[i*n_bins+k];
+      res->shuffled->data[k] += job.all[i*n_bins+k];
+    }
+  }
+  if (n_trials > 1)
+  {
+    // The sweeps against the aggregated train counted the pairs from
+    // identical trials (and, for the auto-correlogram, the self-pairs)
+    // which are removed before averaging over the n_trials-1 other trials
+    for (size_t k=0; k<n_bins; k++)
+      res->shuffled->data[k] -= res->raw->data[k];
+    if (is_auto)
+      res->shuffled->data[n_bins/2] -= aspa_sta_n_spikes(sta_a);
+    gsl_vector_scale(res->shuffled,1./(n_trials-1));
+    aspa_sta_free(asta_b);
+  }
+  aspa_ctx_free(counts);
+  return res;
+}
+
+/** @brief Computes the cross-correlogram between two aspa_sta
+ *         structures
+ *
+ *  For each trial, the lags t_b - t_a between the spikes of trial i of
+ *  `sta_a` and those of trial i of `sta_b` falling in [-max_lag,max_lag)
+ *  are histogrammed (member `raw`, summed over trials). In the same pass
+ *  are obtained:
+ *   - the shift predictor (member `shift`): trial i of `sta_a` against
+ *   trial i+1 (circularly) of `sta_b`,
+ *   - the trial-shuffled predictor (member `shuffled`): trial i of `sta_a`
+ *   against all the trials j != i of `sta_b`, divided by the number of
+ *   trials minus one. It is computed by sweeping each trial of `sta_a`
+ *   against the aggregated `sta_b`.
+ *  Both predictors are on the same scale as `raw` and are zero when there
+ *  is a single trial. Both structures must have the same number of trials.
+ *
+ *  @param[in] sta_a pointer to the reference aspa_sta
+ *  @param[in] sta_b pointer to the target aspa_sta
+ *  @param[in] max_lag the largest lag considered (in s)
+ *  @param[in] bin_width the bin width (in s)
+ *  @returns a pointer to an allocated aspa_ccg
+*/
+aspa_ccg * aspa_correlogram(const aspa_sta * sta_a, const aspa_sta * sta_b,
+			    double max_lag, double bin_width)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta_a)+aspa_sta_n_spikes(sta_b));
+  return ccg_compute(sta_a,sta_b,false,max_lag,bin_width);
+}
+
+/** @brief Computes the auto-correlogram of an aspa_sta structure
+ *
+ *  Same as `aspa_correlogram(sta,sta,max_lag,bin_width)` without the
+ *  zero lag self-pairs, the symmetry of the raw auto-correlogram being
+ *  used to visit each pair once.
+ *
+ *  @param[in] sta pointer to an aspa_sta
+ *  @param[in] max_lag the largest lag considered (in s)
+ *  @param[in] bin_width the bin width (in s)
+ *  @returns a pointer to an allocated aspa_ccg
+*/
+aspa_ccg * aspa_autocorrelogram(const aspa_sta * sta, double max_lag, double bin_width)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  return ccg_compute(sta,sta,true,max_lag,bin_width);
+}
+
+/** @brief Prints to stream the content of an aspa_ccg structure
+ *
+ *  Five columns are printed: the left and right bin boundaries, the raw
+ *  counts, the shift predictor and the trial-shuffled predictor.
+ *
+ *  @param[in/out] STREAM a pointer to an open file
+ *  @param[in] ccg a pointer to an aspa_ccg structure
+ *  @returns 0 if everything goes fine, ASPA_EIO otherwise
+*/
+int aspa_ccg_fprintf(FILE * STREAM, const aspa_ccg * ccg)
+{
+  for (size_t k=0; k<ccg->n_bins; k++)
+  {
+    double left = -ccg->max_lag+k*ccg->bin_width;
+    fprintf(STREAM,"%g %g %g %g %g\n", left, left+ccg->bin_width,
+	    gsl_vector_get(ccg->raw,k), gsl_vector_get(ccg->shift,k),
+	    gsl_vector_get(ccg->shuffled,k));
+  }
+  if (ferror(STREAM))
+    return aspa_ctx_error(ASPA_EIO,"Writing the correlogram failed.");
+  return 0;
+}
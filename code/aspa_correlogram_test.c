@@ -0,0 +1,125 @@
+/** @file aspa_correlogram_test.c
+ *  @brief User program for testing functions aspa_correlogram and aspa_autocorrelogram
+ *
+ *  Two 20 trials aspa_sta are simulated, the second one containing
+ *  jittered copies of the spikes of the first one. The correlograms
+ *  and their predictors are compared with the ones obtained by
+ *  looking at every pair of spikes. Two spikes exactly max_lag apart
+ *  (the lags and bin widths are powers of 2) must be counted once, in
+ *  the first bin, by both correlograms.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa.h"
+
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+
+/** Adds to count the lags of all the pairs of a and b (self-pairs
+    excluded when a and b are the same train) */
+void naive_ccg(const gsl_vector * a, const gsl_vector * b, const aspa_ccg * ccg,
+	       gsl_vector * count)
+{
+  for (size_t i=0; i<a->size; i++)
+    for (size_t j=0; j<b->size; j++)
+    {
+      if (a == b && i == j)
+	continue;
+      double lag = gsl_vector_get(b,j)-gsl_vector_get(a,i);
+      if (lag < -ccg->max_lag || lag >= ccg->max_lag)
+	continue;
+      double bin = ccg->n_bins/2+floor(lag/ccg->bin_width);
+      if (bin >= 0 && bin < ccg->n_bins)
+	gsl_vector_set(count,(size_t) bin,gsl_vector_get(count,(size_t) bin)+1.);
+    }
+}
+
+double max_abs_diff(const gsl_vector * u, const gsl_vector * v)
+{
+  double res=0.;
+  for (size_t i=0; i<u->size; i++)
+    res = GSL_MAX_DBL(res,fabs(gsl_vector_get(u,i)-gsl_vector_get(v,i)));
+  return res;
+}
+
+void check(const aspa_sta * sta_a, const aspa_sta * sta_b, const aspa_ccg * ccg)
+{
+  size_t n_trials = sta_a->n_trials;
+  gsl_vector * raw = gsl_vector_calloc(ccg->n_bins);
+  gsl_vector * shift = gsl_vector_calloc(ccg->n_bins);
+  gsl_vector * shuffled = gsl_vector_calloc(ccg->n_bins);
+  for (size_t i=0; i<n_trials; i++)
+  {
+    gsl_vector * st_a = aspa_sta_get_st(sta_a,i);
+    naive_ccg(st_a,aspa_sta_get_st(sta_b,i),ccg,raw);
+    naive_ccg(st_a,aspa_sta_get_st(sta_b,(i+1)%n_trials),ccg,shift);
+    for (size_t j=0; j<n_trials; j++)
+      if (j != i)
+	naive_ccg(st_a,aspa_sta_get_st(sta_b,j),ccg,shuffled);
+  }
+  gsl_vector_scale(shuffled,1./(n_trials-1));
+  printf("  Total number of pairs: %g\n", gsl_stats_mean(raw->data,1,raw->size)*raw->size);
+  printf("  Max. abs. diff. raw: %g; shift: %g; shuffled: %g.\n",
+	 max_abs_diff(raw,ccg->raw), max_abs_diff(shift,ccg->shift),
+	 max_abs_diff(shuffled,ccg->shuffled));
+  gsl_vector_free(raw);
+  gsl_vector_free(shift);
+  gsl_vector_free(shuffled);
+}
+
+int main()
+{
+  gsl_rng * rng = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(rng,20061001);
+  size_t n_trials=20;
+  double duration=10.;
+  aspa_sta * sta_a = aspa_sta_alloc(n_trials,1,0,0,duration);
+  aspa_sta * sta_b = aspa_sta_alloc(n_trials,1,0,0,duration);
+  for (size_t i=0; i<n_trials; i++)
+  {
+    aspa_sta_set_st_start(sta_a,i,i*duration);
+    aspa_sta_set_st_start(sta_b,i,i*duration);
+    size_t n = gsl_ran_poisson(rng,20.*duration);
+    sta_a->st[i] = gsl_vector_alloc(n);
+    sta_b->st[i] = gsl_vector_alloc(n);
+    for (size_t j=0; j<n; j++)
+    {
+      double t = duration*gsl_rng_uniform(rng);
+      gsl_vector_set(sta_a->st[i],j,t);
+      gsl_vector_set(sta_b->st[i],j,t+0.005+0.002*gsl_ran_gaussian(rng,1.));
+    }
+    gsl_sort_vector(sta_a->st[i]);
+    gsl_sort_vector(sta_b->st[i]);
+  }
+  aspa_ccg * ccg = aspa_correlogram(sta_a,sta_b,0.1,0.002);
+  printf("Cross-correlogram, %d bins:\n", (int) ccg->n_bins);
+  check(sta_a,sta_b,ccg);
+  aspa_ccg_free(ccg);
+  ccg = aspa_autocorrelogram(sta_a,0.1,0.002);
+  printf("Auto-correlogram, %d bins:\n", (int) ccg->n_bins);
+  check(sta_a,sta_a,ccg);
+  aspa_ccg_free(ccg);
+  aspa_sta_free(sta_a);
+  aspa_sta_free(sta_b);
+  // pairs exactly max_lag apart
+  sta_a = aspa_sta_alloc(2,1,0,0,2.);
+  for (size_t i=0; i<2; i++)
+  {
+    aspa_sta_set_st_start(sta_a,i,i*2.);
+    sta_a->st[i] = gsl_vector_alloc(2);
+    gsl_vector_set(sta_a->st[i],0,1.);
+    gsl_vector_set(sta_a->st[i],1,1.125);
+  }
+  ccg = aspa_autocorrelogram(sta_a,0.125,0.03125);
+  printf("Auto-correlogram, spikes max_lag apart, %d bins:\n", (int) ccg->n_bins);
+  check(sta_a,sta_a,ccg);
+  printf("  First bin: %g (2 expected).\n", gsl_vector_get(ccg->raw,0));
+  aspa_ccg_free(ccg);
+  ccg = aspa_correlogram(sta_a,sta_a,0.125,0.03125);
+  printf("Cross-correlogram, spikes max_lag apart, %d bins:\n", (int) ccg->n_bins);
+  printf("  First bin: %g (2 expected).\n", gsl_vector_get(ccg->raw,0));
+  aspa_ccg_free(ccg);
+  aspa_sta_free(sta_a);
+  gsl_rng_free(rng);
+  return 0;
+}
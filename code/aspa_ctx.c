@@ -0,0 +1,137 @@
+/** @file aspa_ctx.c
+ *  @brief Function definitions for the library context
+ *
+ *  The library functions report their errors and get their temporary
+ *  buffers through the context of the calling thread: they never exit
+ *  and they write nothing to the stderr by themselves. A function that
+ *  fails returns a negative error code (int functions), NULL (functions
+ *  returning a pointer) or a NaN (functions returning a double); the code
+ *  and a message are then stored in the context (`status` and `message`
+ *  members, which are not reset by successful calls) and passed to its
+ *  error sink.
+ *
+ *  Each thread starts with its own zero initialized context, whose sink
+ *  writes the message to the stderr (which is what the command line
+ *  programs rely on). Another context can be attached to the thread
+ *  with `aspa_ctx_attach`, to collect the errors or to provide another
+ *  allocator. A context must not be attached to two threads at the same
+ *  time. The buffers obtained from the allocator are always released
+ *  before the library function returns, on the same thread; the returned
+ *  objects (aspa_sta, gsl_vector, etc.) are allocated with malloc /
+ *  GSL and freed with the corresponding `*_free` function.
+ *
+ *  There is no other global state in the library apart from the gnuplot
+ *  session, whose use is serialized (see aspa_gnuplot.c), and the
+ *  optional profiling counters, which are updated atomically. Note that
+ *  GSL's default error handler aborts the program: programs that must
+ *  survive bad inputs should call `gsl_set_error_handler_off()`.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+#include <stdarg.h>
+
+static __thread aspa_ctx ctx_default;
+static __thread aspa_ctx * ctx_attached = NULL;
+
+/** @brief Attaches a context to the calling thread
+ *
+ *  @param[in] ctx a pointer to a context (zero initialized or
+ *             initialized by a previous use), NULL to go back to
+ *             the thread's default context
+ *  @returns the previously attached context (NULL if it was the default)
+*/
+aspa_ctx * aspa_ctx_attach(aspa_ctx * ctx)
+{
+  aspa_ctx * previous = ctx_attached;
+  ctx_attached = ctx;
+  return previous;
+}
+
+/** @brief Returns the context of the calling thread
+ *
+ *  @returns a pointer to the attached context or to the default one
+*/
+aspa_ctx * aspa_ctx_current(void)
+{
+  return ctx_attached != NULL ? ctx_attached : &ctx_default;
+}
+
+/** @brief Reports an error to the context of the calling thread
+ *
+ *  The code and the formatted message are stored in the context
+ *  before being passed to its sink.
+ *
+ *  @param[in] status the error code (negative)
+ *  @param[in] format a printf format followed by its arguments
+ *  @returns status
+*/
+int aspa_ctx_error(int status, const char * format, ...)
+{
+  aspa_ctx * ctx = aspa_ctx_current();
+  va_list ap;
+  va_start(ap,format);
+  vsnprintf(ctx->message,sizeof(ctx->message),format,ap);
+  va_end(ap);
+  ctx->status = status;
+  if (ctx->sink != NULL)
+    (*ctx->sink)(status,ctx->message,ctx->sink_state);
+  else
+    fprintf(stderr,"%s\n",ctx->message);
+  return status;
+}
+
+/** @brief Allocates a temporary buffer with the allocator of the
+ *         context of the calling thread
+ *
+ *  An allocation failure is reported (ASPA_ENOMEM).
+ *
+ *  @param[in] size the size in bytes
+ *  @returns a pointer to the buffer, NULL if the allocation failed
+*/
+void * aspa_ctx_malloc(size_t size)
+{
+  aspa_ctx * ctx = aspa_ctx_current();
+  void * res;
+  if (ctx->alloc != NULL)
+    res = (*ctx->alloc)(size ? size : 1,ctx->alloc_state);
+  else
+    res = malloc(size ? size : 1);
+  if (res == NULL)
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of %zu bytes failed.",size);
+  return res;
+}
+
+/** @brief Frees a buffer obtained from `aspa_ctx_malloc`
+ *
+ *  @param[in] ptr a pointer to the buffer (or NULL)
+ *  @returns nothing
+*/
+void aspa_ctx_free(void * ptr)
+{
+  if (ptr == NULL)
+    return;
+  aspa_ctx * ctx = aspa_ctx_current();
+  if (ctx->release != NULL)
+    (*ctx->release)(ptr,ctx->alloc_state);
+  else
+    free(ptr);
+}
+
+/** @brief Returns a description of an error code
+ *
+ *  @param[in] status an error code
+ *  @returns a constant string
+*/
+const char * aspa_strerror(int status)
+{
+  switch (status) {
+  case ASPA_SUCCESS: return "success";
+  case ASPA_EINVAL: return "invalid argument";
+  case ASPA_ENOMEM: return "allocation failure";
+  case ASPA_EIO: return "read or write error";
+  case ASPA_EFORMAT: return "badly formatted input";
+  default: return "failure";
+  }
+}
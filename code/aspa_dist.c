@@ -38,6 +38,9 @@ void mMultiply(const double *A,const double *B,double *C,int m)
  *
  *  Code `mPower` of G. Marsaglia, Wai Wan 
  *  Tsang and Jingbo Wong, [J.Stat.Software. 8(18): 1-4](https://www.jstatsoft.org/article/view/v008i18).
+ *  The m x m work matrix B is allocated once by the caller instead of
+ *  at each recursion level: each level only uses it after the deeper
+ *  ones returned.
  *  
  *  @param[in] A pointer to mxm matrix whose nth power is looked for
  *  @param[in] eA an integer 
@@ -45,11 +48,12 @@ void mMultiply(const double *A,const double *B,double *C,int m)
  *  @param[out] eV pointer to an integer
  *  @param[in] m matrices size
  *  @param[in] n an integer (the sample size)
+ *  @param[out] B pointer to an m x m work matrix
  *  @returns nothing
 */
-void mPower(const double *A,int eA,double *V,int *eV,int m,int n)
+void mPower(const double *A,int eA,double *V,int *eV,int m,int n,double *B)
 {
-  double *B;int eB,i;
+  int eB,i;
   if(n==1)
   {
     for(i=0;i<m*m;i++)
@@ -57,8 +61,7 @@ void mPower(const double *A,int eA,double *V,int *eV,int m,int n)
     *eV=eA;
     return;
   }
-  mPower(A,eA,V,eV,m,n/2);
-  B=(double*)malloc((m*m)*sizeof(double));
+  mPower(A,eA,V,eV,m,n/2,B);
   mMultiply(V,V,B,m);
   eB=2*(*eV);
   if(n%2==0)
@@ -79,7 +82,6 @@ void mPower(const double *A,int eA,double *V,int *eV,int m,int n)
       V[i]=V[i]*1e-140;
     *eV+=140;
   }
-  free(B);
 }
 
 /** @brief Returns the Kolmogorov distribution function Prod{D_n <= d}
@@ -90,18 +92,22 @@ void mPower(const double *A,int eA,double *V,int *eV,int m,int n)
  *  
  *  @param[in] n an integer, the sample size
  *  @param[in] d a double the maximal deviation
- *  @results Prod{D_n <= d}
+ *  @results Prod{D_n <= d}, NaN if the work matrices could not be
+ *           allocated
 */
 double aspa_cdf_K(int n,double d)
 {
+  ASPA_PROF_SCOPE();
   int i,j,g,eH,eQ;
   double s=d*d*n;
   if(s>7.24||(s>3.76&&n>99)) return 1-2*exp(-(2.000071+.331/sqrt(n)+1.409/n)*s);
   int k=(int)ceil(n*d);
   int m=2*k-1;
   double h=k-n*d;
-  double *H=malloc((m*m)*sizeof(double));
-  double *Q=malloc((m*m)*sizeof(double));
+  double *H=aspa_ctx_malloc(3*(m*m)*sizeof(double));
+  if (H == NULL)
+    return GSL_NAN;
+  double *Q=H+m*m;
   for(i=0;i<m;i++)
     for(j=0;j<m;j++)
       if(i-j+1<0) H[i*m+j]=0;
@@ -117,7 +123,7 @@ double aspa_cdf_K(int n,double d)
       if(i-j+1>0)
         for(g=1;g<=i-j+1;g++) H[i*m+j]/=g;
   eH=0;
-  mPower(H,eH,Q,&eQ,m,n);
+  mPower(H,eH,Q,&eQ,m,n,Q+m*m);
   s=Q[(k-1)*m+k-1];
   for(i=1;i<=n;i++)
   {
@@ -125,11 +131,47 @@ double aspa_cdf_K(int n,double d)
     if(s<1e-140){s*=1e140; eQ-=140;}
   }
   s*=pow(10.,eQ);
-  free(H);
-  free(Q);
+  aspa_ctx_free(H);
   return s;
 }
 
+/** Adds the next ln((n-j)/(j+1)) to the compensated sum (s,c), that
+    goes from ln(n choose j) to ln(n choose j+1) */
+static inline void ln_choose_next(int n, int j, double * s, double * c)
+{
+  double y = log((double) (n-j)/(j+1))-*c;
+  double t = *s+y;
+  *c = (t-*s)-y;
+  *s = t;
+}
+
+/** Sum of equation 3 of Birnbaum and Tingey (1951) for d in (0,1);
+    ln_choose holds ln(n choose j) for j up to n*(1-d) or is NULL,
+    the values are then obtained by recurrence */
+static double kplus_sum(int n, double d, const double * ln_choose)
+{
+  int k = (int) floor(n*(1-d));
+  double nd=n*d;
+  double n_inv=1./n;
+  double lc=0., lc_c=0.; // ln(n choose j) and its compensation
+  double s=0., c=0.; // Neumaier's compensated sum
+  for (int j=0; j<=k; j++)
+  {
+    double lower = ((n-j)-nd)*n_inv; // 1-d-j/n without cancellation
+    if (lower <= 0.)
+      break;
+    if (ln_choose != NULL)
+      lc = ln_choose[j];
+    double term = exp(lc+(n-j)*log(lower)+(j-1)*log((nd+j)*n_inv));
+    double t = s+term;
+    c += fabs(s) >= term ? (s-t)+term : (term-t)+s;
+    s = t;
+    if (ln_choose == NULL)
+      ln_choose_next(n,j,&lc,&lc_c);
+  }
+  return s+c;
+}
+
 /** @brief Returns the Kolmogorov distribution function Prod{D_n_plus <= d}
  *         or Prod{D_n_minus <= d} where D_n_plus/minus are the one sided 
  *         Kolmogorov statistic and n the sample size
@@ -137,6 +179,8 @@ double aspa_cdf_K(int n,double d)
  *  The probability is given by equation 3 of Birnbaum and Tingey (1951)
  *  One-sided confidence contours for probability distribution functions
  *  _The Annals of Mathematical Statistics_ __22__: 592-596.
+ *  The binomial coefficients are obtained by recurrence and the terms
+ *  are added with compensated summation.
  *  
  *  @param[in] n an integer, the sample size
  *  @param[in] d a double the maximal one sided deviation
@@ -144,18 +188,178 @@ double aspa_cdf_K(int n,double d)
 */
 double aspa_cdf_Kplus(int n,double d)
 {
+  ASPA_PROF_SCOPE();
   if (d <= 0.)
     return 0.;
   if (d >= 1.)
     return 1.;
-  unsigned int k = (unsigned int) floor(n*(1-d));
-  double s=0.;
-  double n_inv=1./n;
-  for (int j=0; j<=k; j++)
-    s += exp(gsl_sf_lnchoose(n,j)+
-	     (n-j)*log(1.-d-j*n_inv)+
-	     (j-1)*log(d+j*n_inv));
-  return 1.-d*s;
+  return 1.-d*kplus_sum(n,d,NULL);
+}
+
+typedef struct
+{
+  int n;
+  const double * d;
+  const double * ln_choose;
+  double * res;
+} kplus_job;
+
+static void kplus_index(size_t idx, void * params)
+{
+  kplus_job * job = params;
+  double d = job->d[idx];
+  if (d <= 0.)
+    job->res[idx] = 0.;
+  else if (d >= 1.)
+    job->res[idx] = 1.;
+  else
+    job->res[idx] = 1.-d*kplus_sum(job->n,d,job->ln_choose);
+}
+
+/** @brief Returns aspa_cdf_Kplus for several deviations at the same
+ *         sample size
+ *
+ *  The logarithms of the binomial coefficients are computed once for
+ *  all the deviations and the deviations are processed in parallel,
+ *  this is meant for one sided confidence bands on fine grids.
+ *
+ *  @param[out] res the size probabilities Prod{D_n_plus/minus <= d[i]}
+ *  @param[in] n an integer, the sample size
+ *  @param[in] d the size maximal one sided deviations
+ *  @param[in] size the number of deviations
+ *  @returns 0 if everything goes fine, ASPA_ENOMEM otherwise
+*/
+int aspa_cdf_Kplus_array(double * res, int n, const double * d, size_t size)
+{
+  ASPA_PROF_SCOPE();
+  double d_min = 1.;
+  for (size_t i=0; i<size; i++)
+    if (d[i] > 0. && d[i] < d_min)
+      d_min = d[i];
+  int k = d_min < 1. ? (int) floor(n*(1-d_min)) : 0;
+  double * ln_choose = aspa_ctx_malloc((k+1)*sizeof(double));
+  if (ln_choose == NULL)
+    return ASPA_ENOMEM;
+  double s=0., c=0.;
+  ln_choose[0] = 0.;
+  for (int j=0; j<k; j++)
+  {
+    ln_choose_next(n,j,&s,&c);
+    ln_choose[j+1] = s;
+  }
+  kplus_job job = {.n=n, .d=d, .ln_choose=ln_choose, .res=res};
+  int status = aspa_parallel_for(size,size*(k+1),kplus_index,&job);
+  aspa_ctx_free(ln_choose);
+  return status;
+}
+
+/** Returns the aspa_ks_kind of "D", "D+" and "D-", reports an error
+    otherwise */
+static int ks_which(const char * what)
+{
+  const char * choices[] = {"D","D+","D-"};
+  const aspa_ks_kind kinds[] = {ASPA_KS_D,ASPA_KS_D_PLUS,ASPA_KS_D_MINUS};
+  for (int i=0; i<3; i++)
+    if (strcmp(what,choices[i]) == 0)
+      return kinds[i];
+  return aspa_ctx_error(ASPA_EINVAL,"Unknown Kolmogorov statistic %s.",what);
+}
+
+/** Copies data into data_s and sorts the copy, data_s holds
+    2*data->size doubles */
+static int sorted_copy(const gsl_vector * data, double * data_s)
+{
+  for (size_t i=0; i<data->size; i++)
+    data_s[i] = gsl_vector_get(data,i);
+  return aspa_sort_w(data_s,data->size,data_s+data->size);
+}
+
+/** True if the data can be used in place: sorted and contiguous */
+static bool ks_in_place(const gsl_vector * data, bool sorted)
+{
+  return sorted && data->stride == 1;
+}
+
+/** Kolmogorov's statistics of data, data_s holds 2*data->size doubles
+    unless ks_in_place is true */
+static aspa_ks_stats ks_compute(const gsl_vector * data, bool sorted, double * data_s)
+{
+  if (ks_in_place(data,sorted))
+    return aspa_ks_stats_array(data->data,data->size);
+  if (sorted)
+    for (size_t i=0; i<data->size; i++)
+      data_s[i] = gsl_vector_get(data,i);
+  else if (sorted_copy(data,data_s) != 0)
+    return (aspa_ks_stats) {.D=GSL_NAN, .D_plus=GSL_NAN, .D_minus=GSL_NAN};
+  return aspa_ks_stats_array(data_s,data->size);
+}
+
+/** @brief Returns one of Kolmogorov's statistics
+ *
+ *  @param[in] stats an aspa_ks_stats
+ *  @param[in] kind the statistic
+ *  @returns stats.D, stats.D_plus or stats.D_minus
+*/
+double aspa_ks_stats_select(aspa_ks_stats stats, aspa_ks_kind kind)
+{
+  switch (kind) {
+  case ASPA_KS_D_PLUS: return stats.D_plus;
+  case ASPA_KS_D_MINUS: return stats.D_minus;
+  default: return stats.D;
+  }
+}
+
+/** @brief Returns Kolmogorov's D, D+ and D- against the uniform
+ *         distribution on [0,1]
+ *
+ *  The three statistics are obtained in a single pass over the sorted
+ *  data (see `aspa_ks_stats_array`). If the content of `data` is not
+ *  sorted (`sorted==false`) the data are first copied before being
+ *  sorted; sorted data are used in place.
+ *
+ *  @param[in] data pointer to a `gsl_vector` containing the data
+ *  @param[in] sorted a boolean indicated if the `data` content is
+ *             already sorted (`true`) or not (`false`)
+ *  @returns an aspa_ks_stats, with NaN members if something went wrong
+*/
+aspa_ks_stats aspa_ks_stats_get(const gsl_vector * data, bool sorted)
+{
+  ASPA_PROF_SCOPE();
+  double * data_s = NULL;
+  if (!ks_in_place(data,sorted))
+  {
+    data_s = aspa_ctx_malloc(2*data->size*sizeof(double));
+    if (data_s == NULL)
+      return (aspa_ks_stats) {.D=GSL_NAN, .D_plus=GSL_NAN, .D_minus=GSL_NAN};
+  }
+  aspa_ks_stats res = ks_compute(data,sorted,data_s);
+  aspa_ctx_free(data_s);
+  return res;
+}
+
+/** @brief Returns Kolmogorov's D, D+ and D- computed with a workspace
+ *
+ *  Same as `aspa_ks_stats_get` but the copy of the data is made in `w`
+ *  (grown if needed) instead of a temporary buffer.
+ *
+ *  @param[in] data pointer to a `gsl_vector` containing the data
+ *  @param[in] sorted a boolean indicated if the `data` content is
+ *             already sorted (`true`) or not (`false`)
+ *  @param[in/out] w a pointer to an aspa_gof_workspace
+ *  @returns an aspa_ks_stats, with NaN members if something went wrong
+*/
+aspa_ks_stats aspa_ks_stats_get_w(const gsl_vector * data, bool sorted,
+				  aspa_gof_workspace * w)
+{
+  ASPA_PROF_SCOPE();
+  double * data_s = NULL;
+  if (!ks_in_place(data,sorted))
+  {
+    data_s = aspa_gof_workspace_reserve(w,2*data->size);
+    if (data_s == NULL)
+      return (aspa_ks_stats) {.D=GSL_NAN, .D_plus=GSL_NAN, .D_minus=GSL_NAN};
+  }
+  return ks_compute(data,sorted,data_s);
 }
 
 /** @brief Returns the Kolmogorov statistics
@@ -168,51 +372,49 @@ double aspa_cdf_Kplus(int n,double d)
  *  of the dominating part of the empirical cdf to the theoretical 
  *  one is returned, if "D-" the maximal distance of the dominated
  *  part of the empirical cdf to the theoretical one is returned.
- *  If what is given a "wrong" value, -1.0 is returned.
+ *  If what is given a "wrong" value, an error (ASPA_EINVAL) is
+ *  reported and NaN is returned. `aspa_ks_stats_get` returns the
+ *  three statistics for the cost of one.
  *
  *  @param[in] data pointer to a `gsl_vector` containing the data
  *  @param[in] sorted a boolean indicated if the `data` content is
  *             already sorted (`true`) or not (`false`)
  *  @param[in] what a character string, "D", "D+" or "D-"
- *  @returns a double with the Kolomogorov statistics of -1.0 if
+ *  @returns a double with the Kolomogorov statistics or NaN if
  *           a wrong value for `what` was given
 */
 double aspa_Kolmogorov_D(gsl_vector * data, bool sorted, char * what)
 {
-  char * choices[] = {"D","D+","D-"};
-  gsl_vector * data_s;
-  if (sorted == false)
-  {
-    data_s = gsl_vector_alloc(data->size);
-    gsl_vector_memcpy(data_s,data);
-    gsl_sort_vector(data_s);
-  }
-  else
-  {
-    data_s = data;
-  }
-  double D_p=0.;
-  double D_m=0.;
-  double inv_n = 1./data->size;
-  for (size_t i=0; i<data->size; i++)
-  {
-    double x = gsl_vector_get(data_s,i);
-    double diff = x-i*inv_n; 
-    if (diff > D_m)
-      D_m = diff;
-    diff = inv_n - diff;
-    if (diff > D_p)
-      D_p = diff;
-  }
-  if (sorted == false)
-    gsl_vector_free(data_s);
-  if (strcmp(what,choices[0])==0)
-    return GSL_MAX_DBL(D_p,D_m);
-  if (strcmp(what,choices[1])==0)
-    return D_p;
-  if (strcmp(what,choices[2])==0)
-    return D_m;
-  return -1.;
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(data->size);
+  int which = ks_which(what);
+  if (which < 0)
+    return GSL_NAN;
+  return aspa_ks_stats_select(aspa_ks_stats_get(data,sorted),which);
+}
+
+/** @brief Returns the Kolmogorov statistics computed with a workspace
+ *
+ *  Same as `aspa_Kolmogorov_D` but the sorted copy of the data is
+ *  made in `w` (grown if needed) instead of a temporary buffer.
+ *
+ *  @param[in] data pointer to a `gsl_vector` containing the data
+ *  @param[in] sorted a boolean indicated if the `data` content is
+ *             already sorted (`true`) or not (`false`)
+ *  @param[in] what a character string, "D", "D+" or "D-"
+ *  @param[in/out] w a pointer to an aspa_gof_workspace
+ *  @returns a double with the Kolomogorov statistics or NaN if
+ *           something went wrong
+*/
+double aspa_Kolmogorov_D_w(const gsl_vector * data, bool sorted, const char * what,
+			   aspa_gof_workspace * w)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(data->size);
+  int which = ks_which(what);
+  if (which < 0)
+    return GSL_NAN;
+  return aspa_ks_stats_select(aspa_ks_stats_get_w(data,sorted,w),which);
 }
 
 
@@ -235,12 +437,20 @@ double aspa_cdf_norm_P(double x)
 /** @brief Returns the complementary standard normal distribution function Prod{X > x}
  *
  *  Code `cPhi` of G. Marsaglia [J.Stat.Software. 11(4): 1-11](https://www.jstatsoft.org/article/view/v011i04).
+ *  Its table stops at |x| = 17, the array version (Cody's
+ *  approximation) is used beyond.
  *  
  *  @param[in] x a double the observec value
  *  @results Prod{X > x} where X is N(0,1)
 */
 double aspa_cdf_norm_Q(double x)
 {
+  if (!(fabs(x) < 17.))
+  {
+    double res;
+    aspa_cdf_norm_Q_array(&res,&x,1);
+    return res;
+  }
   long double R[9]={1.25331413731550025L,
 		    .421369229288054473L,
 		    .236652382913560671L,
@@ -266,6 +476,21 @@ double aspa_cdf_norm_Q(double x)
 }
 
 
+/** Anderson-Darling statistic of data, sorted or sorted in data_s */
+static double ad_compute(const gsl_vector * data, const double * data_s)
+{
+  size_t n = data->size;
+  double A=0.;
+  for (size_t i=0; i<n; i++)
+  {
+    double t = data_s != NULL ? data_s[i]*(1.-data_s[n-1-i]) :
+      gsl_vector_get(data,i)*(1.-gsl_vector_get(data,n-1-i));
+    A += (i+i+1)*log(t);
+  }
+  A *= -1./n;
+  return A-(double)n;
+}
+
 /** @brief Returns the Anderson-Darling statistics
  *
  *  The data are contained in the `gsl_vector` pointed to
@@ -279,28 +504,50 @@ double aspa_cdf_norm_Q(double x)
 */
 double aspa_AndersonDarling_W2(gsl_vector * data, bool sorted)
 {
-  gsl_vector * data_s;
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(data->size);
+  double * data_s = NULL;
   if (sorted == false)
   {
-    data_s = gsl_vector_alloc(data->size);
-    gsl_vector_memcpy(data_s,data);
-    gsl_sort_vector(data_s);
+    data_s = aspa_ctx_malloc(2*data->size*sizeof(double));
+    if (data_s == NULL)
+      return GSL_NAN;
+    if (sorted_copy(data,data_s) != 0)
+    {
+      aspa_ctx_free(data_s);
+      return GSL_NAN;
+    }
   }
-  else
+  double res = ad_compute(data,data_s);
+  aspa_ctx_free(data_s);
+  return res;
+}
+
+/** @brief Returns the Anderson-Darling statistics computed with a
+ *         workspace
+ *
+ *  Same as `aspa_AndersonDarling_W2` but the sorted copy of the data
+ *  is made in `w` (grown if needed) instead of a temporary buffer.
+ *
+ *  @param[in] data pointer to a `gsl_vector` containing the data
+ *  @param[in] sorted a boolean indicated if the `data` content is
+ *             already sorted (`true`) or not (`false`)
+ *  @param[in/out] w a pointer to an aspa_gof_workspace
+ *  @returns a double with the Anderson-Darling statistics, NaN if
+ *           the workspace could not be grown
+*/
+double aspa_AndersonDarling_W2_w(const gsl_vector * data, bool sorted, aspa_gof_workspace * w)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(data->size);
+  double * data_s = NULL;
+  if (sorted == false)
   {
-    data_s = data;
+    data_s = aspa_gof_workspace_reserve(w,2*data->size);
+    if (data_s == NULL || sorted_copy(data,data_s) != 0)
+      return GSL_NAN;
   }
-  size_t n = data->size;
-  double A=0.;
-  for (size_t i=0; i<n; i++)
-  {
-    double t = gsl_vector_get(data_s,i)*(1.-gsl_vector_get(data_s,n-1-i));
-    A += (i+i+1)*log(t);
-  }
-  A *= -1./n;
-  if (sorted == false)
-    gsl_vector_free(data_s);
-  return A-(double)n;
+  return ad_compute(data,data_s);
 }
 
 /** @brief Utility function called by `aspa_cdf_ADinf_P`
@@ -402,7 +649,7 @@ double aspa_errfix(int n, double x)
   {
     t=x/c;
     t=sqrt(t)*(1.-t)*(49*t-102);
-    return t*(.0037/(n*n)+.00078/n+.00006)/n;
+    return t*(.0037/((double) n*n)+.00078/n+.00006)/n;
   }
   t=(x-c)/(.8-c);
   t=-.00022633+(6.54034-(14.6538-(14.458-(8.259-1.91864*t)*t)*t)*t)*t;
@@ -411,6 +658,7 @@ double aspa_errfix(int n, double x)
 
 double aspa_cdf_AD_P(int n,double z)
 {
+  ASPA_PROF_SCOPE();
   double v;
   double x=aspa_adinf(z);
   if(x>.8)
@@ -423,49 +671,130 @@ double aspa_cdf_AD_P(int n,double z)
   {
     v=x/c;
     v=sqrt(v)*(1.-v)*(49*v-102);
-    return x+v*(.0037/(n*n)+.00078/n+.00006)/n;
+    return x+v*(.0037/((double) n*n)+.00078/n+.00006)/n;
   }
   v=(x-c)/(.8-c);
   v=-.00022633+(6.54034-(14.6538-(14.458-(8.259-1.91864*v)*v)*v)*v)*v;
   return x+v*(.04213+.01365/n)/n;
 }
 
+/** Durbin's modification of the n sorted values u[i*stride] in
+    place, work holds 2n+2 doubles, caller and arg name the public
+    function and its argument in the error messages */
+static int durbin_sorted(double * u, size_t n, size_t stride, double * work,
+			 const char * caller, const char * arg)
+{
+  if (n == 0)
+    return aspa_ctx_error(ASPA_EINVAL,"%s: %s should hold at least one element.",
+			  caller,arg);
+  if (u[0] < 0)
+    return aspa_ctx_error(ASPA_EINVAL,"%s: the elements of %s should all be >= 0.",
+			  caller,arg);
+  if (u[(n-1)*stride] > 1)
+    return aspa_ctx_error(ASPA_EINVAL,"%s: the elements of %s should all be <= 1.",
+			  caller,arg);
+  // the n+1 spacings c, sorted
+  // a negative spacing means unsorted values
+  double * c = work;
+  bool unsorted = false;
+  c[0] = u[0];
+  for (size_t i=1; i<n; i++)
+  {
+    c[i] = u[i*stride]-u[(i-1)*stride];
+    unsorted |= c[i] < 0;
+  }
+  if (unsorted)
+    return aspa_ctx_error(ASPA_EINVAL,"%s: the elements of %s should be sorted.",
+			  caller,arg);
+  c[n] = 1.-u[(n-1)*stride];
+  if (aspa_sort_w(c,n+1,work+n+1) != 0)
+    return ASPA_ENOMEM;
+  // u_r = sum_{j=1}^{r} (n+2-j)(c_(j)-c_(j-1)) with c_(0) = 0
+  double prev = 0., sum = 0.;
+  for (size_t r=1; r<=n; r++)
+  {
+    sum += (n+2-r)*(c[r-1]-prev);
+    prev = c[r-1];
+    u[(r-1)*stride] = sum;
+  }
+  return 0;
+}
+
+/** Durbin's modification of seq in res, work holds 2n+2 doubles */
+static int durbin_compute(const gsl_vector * seq, gsl_vector * res, double * work,
+			  const char * caller)
+{
+  gsl_vector_memcpy(res,seq);
+  if (res->stride != 1)
+    gsl_sort_vector(res);
+  else if (aspa_sort_w(res->data,res->size,work) != 0) // work is not in use yet
+    return ASPA_ENOMEM;
+  return durbin_sorted(res->data,res->size,res->stride,work,caller,"seq");
+}
+
 /** @brief Perform "Durbin's modification" on data contained in `seq`
  *
  *  The data are supposed to between 0 and 1. If such is not the case
- *  the function returns -1 and prints an error message to the stderr.
+ *  the function reports an error and returns ASPA_EINVAL.
  *
  *  @param[in] seq a pointer to a `gsl_vector` containing the data
  *  @param[out] res a pointer to a `gsl_vector` where the result is
  *              stored
- *  @results 0 if everything goes fine, -1 otherwise
+ *  @results 0 if everything goes fine, a negative error code otherwise
 */
 int aspa_durbin_modification(const gsl_vector * seq, gsl_vector * res)
 {
-  gsl_vector_memcpy(res,seq);
-  gsl_sort_vector(res);
-  size_t n=res->size;
-  if (gsl_vector_get(res,0) < 0)
-  {
-    fprintf(stderr,"The elements of seq should all be >= 0.\n");
-    return -1;
-  }
-  if (gsl_vector_get(res,n-1) > 1)
-  {
-    fprintf(stderr,"The elements of seq should all be <= 0.\n");
-    return -1;
-  }
-  gsl_vector *iei = gsl_vector_alloc(n+1);
-  gsl_vector_set(iei,0,gsl_vector_get(res,0));
-  for (size_t i=1; i < n; i++)
-    gsl_vector_set(iei,i,gsl_vector_get(res,i)-gsl_vector_get(res,i-1));
-  gsl_vector_set(iei,n,1.-gsl_vector_get(res,n-1));
-  gsl_sort_vector(iei);
-  for (size_t i=n+1; i>1; i--)
-    gsl_vector_set(iei,i,(n+2-i)*(gsl_vector_get(iei,i-1)-gsl_vector_get(iei,i-2)));
-  gsl_vector_set(res,0,gsl_vector_get(iei,0));
-  for (size_t i=1; i<n; i++)
-    gsl_vector_set(res,i,gsl_vector_get(res,i-1)+gsl_vector_get(iei,i));
-  gsl_vector_free(iei);
-  return 0;
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(seq->size);
+  // the n+1 spacings and the buffer of their sort
+  double *work = aspa_ctx_malloc((2*seq->size+2)*sizeof(double));
+  if (work == NULL)
+    return ASPA_ENOMEM;
+  int status = durbin_compute(seq,res,work,"aspa_durbin_modification");
+  aspa_ctx_free(work);
+  return status;
+}
+
+/** @brief Perform "Durbin's modification" with a workspace
+ *
+ *  Same as `aspa_durbin_modification` but the intervals are stored
+ *  in `w` (grown if needed) instead of a temporary buffer.
+ *
+ *  @param[in] seq a pointer to a `gsl_vector` containing the data
+ *  @param[out] res a pointer to a `gsl_vector` where the result is
+ *              stored
+ *  @param[in/out] w a pointer to an aspa_gof_workspace
+ *  @results 0 if everything goes fine, a negative error code otherwise
+*/
+int aspa_durbin_modification_w(const gsl_vector * seq, gsl_vector * res,
+			       aspa_gof_workspace * w)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(seq->size);
+  double *work = aspa_gof_workspace_reserve(w,2*seq->size+2);
+  if (work == NULL)
+    return ASPA_ENOMEM;
+  return durbin_compute(seq,res,work,"aspa_durbin_modification_w");
+}
+
+/** @brief Perform "Durbin's modification" in place on sorted data
+ *
+ *  The n values of u must be sorted and between 0 and 1, they are
+ *  replaced by their modification, which is sorted as well and can be
+ *  given to `aspa_Kolmogorov_D` or `aspa_AndersonDarling_W2` with
+ *  `sorted=true`. Only the spacings are sorted (see aspa_sort.c).
+ *  The function reports an error and returns ASPA_EINVAL, leaving u
+ *  unchanged, if n is 0 or if the values are not sorted (checked on
+ *  the spacings) or not between 0 and 1.
+ *
+ *  @param[in/out] u the n sorted values
+ *  @param[in] n the number of values
+ *  @param[in] work a buffer of 2n+2 doubles
+ *  @results 0 if everything goes fine, a negative error code otherwise
+*/
+int aspa_durbin_modification_sorted_w(double * u, size_t n, double * work)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(n);
+  return durbin_sorted(u,n,1,work,"aspa_durbin_modification_sorted_w","u");
 }
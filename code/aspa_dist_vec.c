@@ -0,0 +1,676 @@
+/** @file aspa_dist_vec.c
+ *  @brief Function definitions for the array versions of the normal
+ *         and Anderson-Darling distribution functions and of
+ *         Kolmogorov's statistics
+ *
+ *  The scalar functions of aspa_dist.c iterate until convergence, in
+ *  long double for the normal ones, which is accurate but slow when
+ *  thousands of units are scored. The array versions process 8 values
+ *  at a time with the GCC vector extensions and no data dependent
+ *  branch: all the branches of a function are computed and the results
+ *  blended; the iterations of `aspa_cdf_ADinf_P` run until all the
+ *  values of a block have converged.
+ *
+ *  - The normal distribution uses W. J. Cody's rational approximations
+ *    of the error function (1993) [ACM TOMS __19__: 22-32](https://doi.org/10.1145/151271.151273),
+ *    the ones of R's `pnorm`, with the exponential split in two as
+ *    there to keep the relative accuracy in the tails.
+ *  - The exponential is computed by reduction to [-ln(2)/2,ln(2)/2]
+ *    and a degree 13 Taylor polynomial.
+ *  - `aspa_cdf_ADinf_P` and `aspa_cdf_AD_P` follow the scalar code, with
+ *    the divisions by constants replaced by multiplications.
+ *    `aspa_cdf_ADinf_P_array` puts the values in blocks by magnitude
+ *    first, so that the values of a block need about the same number
+ *    of terms.
+ *
+ *  The block functions are inlined in an AVX-512, an AVX2 and a generic
+ *  version of each array function, the version used is chosen at run
+ *  time from the CPU (as in aspa_bitset.c). The results agree with the
+ *  scalar functions to about 1e-15 (absolute) for the normal distribution
+ *  and 1e-13 for the Anderson-Darling ones, see aspa_dist_vec_test.c.
+ *
+ *  Kolmogorov's D+ and D- are two max reductions done in the same
+ *  pass over the sorted data; these versions are compiled without
+ *  fused multiply-add so that the statistics are exactly the ones of
+ *  the scalar code.
+ *
+ *  The last section holds the sums of the Weibull likelihood
+ *  equations, evaluated at each Newton iteration of the fit of
+ *  aspa_renewal.c, which use the same exponential.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+#define VLEN 8
+typedef double vdouble __attribute__((vector_size(VLEN*sizeof(double))));
+typedef int64_t vlong __attribute__((vector_size(VLEN*sizeof(int64_t))));
+typedef uint64_t vulong __attribute__((vector_size(VLEN*sizeof(uint64_t))));
+typedef int vint __attribute__((vector_size(VLEN*sizeof(int))));
+
+/** The block functions are always inlined, the ABI of their vector
+    arguments does not matter (the tree is compiled with -Wno-psabi) */
+#define INLINE static inline __attribute__((always_inline))
+
+/** Kinds of array functions */
+enum {NORM_P, NORM_Q, ADINF_P, AD_P};
+
+INLINE vdouble vset(double a)
+{
+  vdouble v;
+  for (int l=0; l<VLEN; l++)
+    v[l] = a;
+  return v;
+}
+
+INLINE vdouble vselect(vlong mask, vdouble a, vdouble b)
+{
+  return (vdouble) (((vlong) a & mask) | ((vlong) b & ~mask));
+}
+
+/** All ones where the sign bit of x is set */
+INLINE vlong vneg(vdouble x)
+{
+  return -(vlong) ((vulong) x >> 63);
+}
+
+INLINE vdouble vabs(vdouble x)
+{
+  return (vdouble) ((vlong) x & INT64_MAX);
+}
+
+INLINE bool vany(vlong mask)
+{
+  for (int l=0; l<VLEN; l++)
+    if (mask[l])
+      return true;
+  return false;
+}
+
+INLINE vdouble vsqrt(vdouble x)
+{
+  for (int l=0; l<VLEN; l++)
+    x[l] = sqrt(x[l]);
+  return x;
+}
+
+/** x >= 0 rounded down, x < 2^51 (the conversions to integers are
+    not vector instructions before AVX-512DQ) */
+INLINE vdouble vfloor(vdouble x)
+{
+  const double magic = 0x1.8p52; // adding it rounds to an integer
+  vdouble r = (x+magic)-magic;
+  return vselect(x < r,r-1.,r);
+}
+
+/** exp(x), 0 below -745.2, inf above 709.8 */
+INLINE vdouble vexp(vdouble x)
+{
+  const double magic = 0x1.8p52; // adding it rounds to an integer
+  vdouble xc = vselect(x < -746.,vset(-746.),vselect(x > 710.,vset(710.),x));
+  vdouble t = xc*M_LOG2E+magic;
+  vdouble kd = t-magic;
+  vdouble r = xc-kd*6.93147180369123816490e-01-kd*1.90821492927058770002e-10;
+  // the Taylor polynomial by Estrin's scheme, its dependency chain is
+  // 4 operations long instead of 13
+  vdouble r2 = r*r, r4 = r2*r2;
+  vdouble p = (1.+r+(0.5+r*(1./6.))*r2)+((1./24.+r*(1./120.))+(1./720.+r*(1./5040.))*r2)*r4;
+  vdouble q = ((1./40320.+r*(1./362880.))+(1./3628800.+r*(1./39916800.))*r2)+
+    (1./479001600.+r*(1./6227020800.))*r4;
+  p += q*(r4*r4);
+  vlong magic_bits = (vlong) vset(magic);
+  vlong k = (vlong) t-magic_bits;
+  vlong k1 = (vlong) ((vulong) (k+2048) >> 1)-1024; // k/2 rounded down, without
+  // the 64-bit arithmetic shift that AVX2 does not have
+  vlong k2 = k-k1;
+  // 2^k in two factors, so that 2^k can be subnormal or 2^1024
+  vdouble s1 = (vdouble) ((k1+1023) << 52);
+  vdouble s2 = (vdouble) ((k2+1023) << 52);
+  return p*s1*s2;
+}
+
+/** Prob{X <= x} (lower == true) or Prob{X > x} of the standard normal
+    distribution, Cody's approximations */
+INLINE vdouble vnorm(bool lower, vdouble x)
+{
+  const double a[5] = {2.2352520354606839287,161.02823106855587881,
+		       1067.6894854603709582,18154.981253343561249,
+		       0.065682337918207449113};
+  const double b[4] = {47.20258190468824187,976.09855173777669322,
+		       10260.932208618978205,45507.789335026729956};
+  const double c[9] = {0.39894151208813466764,8.8831497943883759412,
+		       93.506656132177855979,597.27027639480026226,
+		       2494.5375852903726711,6848.1904505362823326,
+		       11602.651437647350124,9842.7148383839780218,
+		       1.0765576773720192317e-8};
+  const double d[8] = {22.266688044328115691,235.38790178262499861,
+		       1519.377599407554805,6485.558298266760755,
+		       18615.571640885098091,34900.952721145977266,
+		       38912.003286093271411,19685.429676859990727};
+  const double p[6] = {0.21589853405795699,0.1274011611602473639,
+		       0.022235277870649807,0.001421619193227893466,
+		       2.9112874951168792e-5,0.02307344176494017303};
+  const double q[5] = {1.28426009614491121,0.468238212480865118,
+		       0.0659881378689285515,0.00378239633202758244,
+		       7.29751555083966205e-5};
+  vdouble y = vabs(x);
+  y = vselect(y < 40.,y,vset(40.)); // the tails are 0 beyond, NaN included
+  // |x| <= 0.67448975
+  vdouble xsq = y*y;
+  vdouble xnum = a[4]*xsq;
+  vdouble xden = xsq;
+  for (int i=0; i<3; i++)
+  {
+    xnum = (xnum+a[i])*xsq;
+    xden = (xden+b[i])*xsq;
+  }
+  vdouble centre = x*(xnum+a[3])/(xden+b[3]);
+  // |x| <= sqrt(32)
+  xnum = c[8]*y;
+  xden = y;
+  for (int i=0; i<7; i++)
+  {
+    xnum = (xnum+c[i])*y;
+    xden = (xden+d[i])*y;
+  }
+  vdouble middle = (xnum+c[7])/(xden+d[7]);
+  // larger |x|
+  vdouble inv_sq = 1./(y*y);
+  xnum = p[5]*inv_sq;
+  xden = inv_sq;
+  for (int i=0; i<4; i++)
+  {
+    xnum = (xnum+p[i])*inv_sq;
+    xden = (xden+q[i])*inv_sq;
+  }
+  vdouble far = (M_SQRT1_2*M_2_SQRTPI*0.5-inv_sq*(xnum+p[4])/(xden+q[4]))/y;
+  // the upper tail of |x|
+  vdouble y16 = vfloor(y*16.)/16.;
+  vdouble del = (y-y16)*(y+y16);
+  vdouble tail = vexp(-y16*y16*0.5)*vexp(-del*0.5)*
+    vselect(y <= 5.656854249492380195206754896838,middle,far);
+  vdouble res;
+  if (lower)
+    res = vselect(x > 0.,1.-tail,tail);
+  else
+    res = vselect(x > 0.,tail,1.-tail);
+  res = vselect(y <= 0.67448975,lower ? 0.5+centre : 0.5-centre,res);
+  return vselect(x != x,x,res);
+}
+
+/** aspa_ADf on a block, the values of z must be > 0 */
+
+INLINE vdouble vADf(vdouble z, int j)
+{
+  vdouble t = (4*j+1)*(4*j+1)*1.23370055013617/z;
+  vlong active = t <= 150.;
+  t = vselect(active,t,vset(150.));
+  vdouble a = 2.22144146907918*vexp(-t)/vsqrt(t);
+  vdouble b = 3.93740248643060*2.*vnorm(false,vsqrt(2.*t));
+  vdouble r = z*.125;
+  vdouble f = a+b*r;
+  for (int i=1; i<200 && vany(active); i++)
+  {
+    vdouble c = ((i-.5-t)*b+t*a)*(1./i);
+    a = b;
+    b = c;
+    r *= z*(1./(8*i+8));
+    vdouble f_new = f+c*r;
+    // |r| >= 1e-40, |c| >= 1e-40 and f_new != f from sign bits, GCC
+    // makes the comparisons of this loop one lane at a time
+    active &= ~vneg(vabs(r)-1e-40) & ~vneg(vabs(c)-1e-40) & vneg(0.-vabs(f_new-f));
+    f = vselect(active,f_new,f);
+  }
+  return vselect((4*j+1)*(4*j+1)*1.23370055013617/z > 150.,vset(0.),f);
+}
+
+/** aspa_cdf_ADinf_P on a block */
+INLINE vdouble vADinf_P(vdouble z)
+{
+  vlong small = z < .01;
+  z = vselect(small,vset(1.),z);
+  vdouble r = 1./z;
+  vdouble ad = r*vADf(z,0);
+  vlong active = ~small;
+  for (int j=1; j<100 && vany(active); j++)
+  {
+    r *= (.5-j)/j;
+    vdouble ad_new = ad+(4*j+1)*r*vADf(z,j);
+    active &= ad_new != ad;
+    ad = vselect(active,ad_new,ad);
+  }
+  return vselect(small,vset(0.),ad);
+}
+
+/** aspa_cdf_AD_P on a block */
+INLINE vdouble vAD_P(vdouble n, vdouble z)
+{
+  vdouble inv_z = 1./z;
+  // 1/n, 1/c and 1/(.8-c) with c = .01265+.1757/n from a single division
+  vdouble c_num = .01265*n+.1757, mid_num = .78735*n-.1757;
+  vdouble d = 1./(n*c_num*mid_num);
+  vdouble inv_n = c_num*mid_num*d;
+  vdouble inv_c = n*n*mid_num*d;
+  vdouble inv_mid = n*n*c_num*d;
+  // aspa_adinf, the exponential of the lower branch is the inner one of the upper
+  vlong lower = z < 2.;
+  vdouble e = vexp(vselect(lower,-1.2337141*inv_z,
+			   1.0776-(2.30695-(.43424-(.082433-(.008056-.0003146*z)*z)*z)*z)*z));
+  vdouble x_small = e*vsqrt(inv_z)*
+    (2.00012+(.247105-(.0649821-(.0347962-(.011672-.00168691*z)*z)*z)*z)*z);
+  vdouble x = vselect(lower,x_small,vexp(-e));
+  // aspa_errfix
+  vdouble v_high = (-130.2137+(745.2337-(1705.091-(1950.646-(1116.360-255.7844*x)*x)*x)*x)*x)*inv_n;
+  vdouble c = .01265+.1757*inv_n;
+  vdouble v = x*inv_c;
+  vdouble v_low = vsqrt(v)*(1.-v)*(49*v-102)*((.0037*inv_n+.00078)*inv_n+.00006)*inv_n;
+  v = (x-c)*inv_mid;
+  v = -.00022633+(6.54034-(14.6538-(14.458-(8.259-1.91864*v)*v)*v)*v)*v;
+  vdouble v_mid = v*(.04213+.01365*inv_n)*inv_n;
+  return x+vselect(x > .8,v_high,vselect(x < c,v_low,v_mid));
+}
+
+/** Function kind on a block */
+INLINE vdouble vblock(int kind, vdouble nv, vdouble xv)
+{
+  switch (kind) {
+  case NORM_P: return vnorm(true,xv);
+  case NORM_Q: return vnorm(false,xv);
+  case ADINF_P: return vADinf_P(xv);
+  default: return vAD_P(nv,xv);
+  }
+}
+
+/** Applies function kind to size values of x (and n), in res */
+INLINE void vapply(int kind, double * res, const int * n, const double * x, size_t size)
+{
+  size_t i=0;
+  for (; i+VLEN <= size; i+=VLEN)
+  {
+    vdouble xv, nv = vset(1.);
+    memcpy(&xv,x+i,sizeof(xv));
+    if (n != NULL)
+    {
+      vint ni;
+      memcpy(&ni,n+i,sizeof(ni));
+      nv = __builtin_convertvector(ni,vdouble);
+    }
+    vdouble rv = vblock(kind,nv,xv);
+    memcpy(res+i,&rv,sizeof(rv));
+  }
+  if (i == size)
+    return;
+  // the last values, padded with valid ones
+  vdouble xv = vset(1.), nv = vset(1.);
+  for (size_t l=0; i+l<size; l++)
+  {
+    xv[l] = x[i+l];
+    if (n != NULL)
+      nv[l] = n[i+l];
+  }
+  vdouble rv = vblock(kind,nv,xv);
+  for (size_t l=0; i+l<size; l++)
+    res[i+l] = rv[l];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ASPA_HAVE_X86 1
+
+__attribute__((target("avx512f")))
+static void vapply_avx512(int kind, double * res, const int * n, const double * x, size_t size)
+{
+  vapply(kind,res,n,x,size);
+}
+
+__attribute__((target("avx2,fma")))
+static void vapply_avx2(int kind, double * res, const int * n, const double * x, size_t size)
+{
+  vapply(kind,res,n,x,size);
+}
+#endif
+
+static void vapply_generic(int kind, double * res, const int * n, const double * x, size_t size)
+{
+  vapply(kind,res,n,x,size);
+}
+
+/** Applies function kind with the best version for the CPU */
+static void apply(int kind, double * res, const int * n, const double * x, size_t size)
+{
+#ifdef ASPA_HAVE_X86
+  if (__builtin_cpu_supports("avx512f"))
+    vapply_avx512(kind,res,n,x,size);
+  else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    vapply_avx2(kind,res,n,x,size);
+  else
+#endif
+    vapply_generic(kind,res,n,x,size);
+}
+
+/** Largest F[i]-i/n (D-) and (i+1)/n-F[i] (D+) for i from i0 to
+    i0+m-1, accumulated in D_plus and D_minus with the arithmetic of
+    ks_compute (aspa_dist.c) */
+INLINE void vks(const double * F, size_t i0, size_t m, double inv_n,
+		double * D_plus, double * D_minus)
+{
+  vdouble dp = vset(*D_plus), dm = vset(*D_minus), iv;
+  for (int l=0; l<VLEN; l++)
+    iv[l] = i0+l;
+  size_t i=0;
+  for (; i+VLEN <= m; i+=VLEN, iv+=VLEN)
+  {
+    vdouble x;
+    memcpy(&x,F+i,sizeof(x));
+    vdouble diff = x-iv*inv_n;
+    dm = vselect(diff > dm,diff,dm);
+    diff = inv_n-diff;
+    dp = vselect(diff > dp,diff,dp);
+  }
+  for (int l=0; l<VLEN; l++)
+  {
+    if (dp[l] > *D_plus)
+      *D_plus = dp[l];
+    if (dm[l] > *D_minus)
+      *D_minus = dm[l];
+  }
+  for (; i<m; i++)
+  {
+    double diff = F[i]-(i0+i)*inv_n;
+    if (diff > *D_minus)
+      *D_minus = diff;
+    diff = inv_n-diff;
+    if (diff > *D_plus)
+      *D_plus = diff;
+  }
+}
+
+// no fused multiply-add, the statistics are the same in all versions
+#ifdef ASPA_HAVE_X86
+__attribute__((target("avx512f"),optimize("fp-contract=off")))
+static void vks_avx512(const double * F, size_t i0, size_t m, double inv_n,
+		       double * D_plus, double * D_minus)
+{
+  vks(F,i0,m,inv_n,D_plus,D_minus);
+}
+
+__attribute__((target("avx2,fma"),optimize("fp-contract=off")))
+static void vks_avx2(const double * F, size_t i0, size_t m, double inv_n,
+		     double * D_plus, double * D_minus)
+{
+  vks(F,i0,m,inv_n,D_plus,D_minus);
+}
+#endif
+
+__attribute__((optimize("fp-contract=off")))
+static void vks_generic(const double * F, size_t i0, size_t m, double inv_n,
+			double * D_plus, double * D_minus)
+{
+  vks(F,i0,m,inv_n,D_plus,D_minus);
+}
+
+/** vks with the best version for the CPU */
+static void ks(const double * F, size_t i0, size_t m, double inv_n,
+	       double * D_plus, double * D_minus)
+{
+#ifdef ASPA_HAVE_X86
+  if (__builtin_cpu_supports("avx512f"))
+    vks_avx512(F,i0,m,inv_n,D_plus,D_minus);
+  else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    vks_avx2(F,i0,m,inv_n,D_plus,D_minus);
+  else
+#endif
+    vks_generic(F,i0,m,inv_n,D_plus,D_minus);
+}
+
+/** Fills D from D+ and D-, NaN for an empty sample */
+static aspa_ks_stats ks_stats(size_t n, double D_plus, double D_minus)
+{
+  if (n == 0)
+    return (aspa_ks_stats) {.D=GSL_NAN, .D_plus=GSL_NAN, .D_minus=GSL_NAN};
+  return (aspa_ks_stats) {.D=GSL_MAX_DBL(D_plus,D_minus), .D_plus=D_plus,
+      .D_minus=D_minus};
+}
+
+/** @brief Returns Kolmogorov's D, D+ and D- from the values of a cdf
+ *         at the sorted data
+ *
+ *  F[i] is the hypothesized cdf at the i-th smallest datum (the sorted
+ *  data themselves for the uniform distribution); the three statistics
+ *  are obtained in one pass, the same as with `aspa_Kolmogorov_D`.
+ *
+ *  @param[in] F an array of n nondecreasing doubles in [0,1]
+ *  @param[in] n the sample size
+ *  @returns an aspa_ks_stats, with NaN members if n is 0
+*/
+aspa_ks_stats aspa_ks_stats_array(const double * F, size_t n)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(n);
+  double D_plus=0., D_minus=0.;
+  ks(F,0,n,1./n,&D_plus,&D_minus);
+  return ks_stats(n,D_plus,D_minus);
+}
+
+/** @brief Returns Kolmogorov's D, D+ and D- of sorted data against a
+ *         cdf
+ *
+ *  The cdf is evaluated on blocks of data that stay in the cache
+ *  together with the statistics, there is no transformed copy of the
+ *  data.
+ *
+ *  @param[in] x an array of n sorted doubles
+ *  @param[in] n the sample size
+ *  @param[in] cdf the hypothesized cdf
+ *  @param[in] params the last argument of cdf
+ *  @returns an aspa_ks_stats, with NaN members if n is 0
+*/
+aspa_ks_stats aspa_ks_stats_cdf(const double * x, size_t n, aspa_cdf_fn cdf, void * params)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(n);
+  double F[256];
+  double D_plus=0., D_minus=0.;
+  for (size_t i0=0; i0<n; i0+=256)
+  {
+    size_t m = GSL_MIN(256,n-i0);
+    for (size_t i=0; i<m; i++)
+      F[i] = cdf(x[i0+i],params);
+    ks(F,i0,m,1./n,&D_plus,&D_minus);
+  }
+  return ks_stats(n,D_plus,D_minus);
+}
+
+/** @brief Computes the standard normal distribution function
+ *         Prod{X <= x} on an array
+ *
+ *  Array version of `aspa_cdf_norm_P`, res and x can be the same
+ *  array.
+ *
+ *  @param[out] res an array of size doubles, the probabilities
+ *  @param[in] x an array of size doubles
+ *  @param[in] size the number of values
+*/
+void aspa_cdf_norm_P_array(double * res, const double * x, size_t size)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(size);
+  apply(NORM_P,res,NULL,x,size);
+}
+
+/** @brief Computes the complementary standard normal distribution
+ *         function Prod{X > x} on an array
+ *
+ *  Array version of `aspa_cdf_norm_Q`, res and x can be the same
+ *  array.
+ *
+ *  @param[out] res an array of size doubles, the probabilities
+ *  @param[in] x an array of size doubles
+ *  @param[in] size the number of values
+*/
+void aspa_cdf_norm_Q_array(double * res, const double * x, size_t size)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(size);
+  apply(NORM_Q,res,NULL,x,size);
+}
+
+/** Values of aspa_cdf_ADinf_P_array put in blocks together */
+#define ADINF_CHUNK 256
+#define ADINF_BINS 64
+
+/** Indices of the m values of z by increasing magnitude, to a factor
+    of 2^(1/4): the number of terms of aspa_cdf_ADinf_P grows with z and
+    the iterations of a block stop with its slowest value */
+static void adinf_order(const double * z, size_t m, uint16_t * order)
+{
+  size_t start[ADINF_BINS+1] = {0};
+  uint8_t bin[ADINF_CHUNK];
+  for (size_t i=0; i<m; i++)
+  {
+    uint64_t bits;
+    memcpy(&bits,z+i,sizeof(bits));
+    // exponent and first 2 bits of the mantissa, from 2^-8 to 2^8
+    int64_t b = (int64_t) (bits >> 50)-((1023-8) << 2);
+    bin[i] = (bits >> 63) ? 0 : GSL_MIN(GSL_MAX(b,0),ADINF_BINS-1);
+    start[bin[i]+1]++;
+  }
+  for (int b=0; b<ADINF_BINS; b++)
+    start[b+1] += start[b];
+  for (size_t i=0; i<m; i++)
+    order[start[bin[i]]++] = i;
+}
+
+/** @brief Computes the asymptotic cdf of the Anderson-Darling
+ *         statistics on an array
+ *
+ *  Array version of `aspa_cdf_ADinf_P`, res and z can be the same
+ *  array.
+ *
+ *  @param[out] res an array of size doubles, Prob{W2 <= z}
+ *  @param[in] z an array of size doubles, the statistics
+ *  @param[in] size the number of values
+*/
+void aspa_cdf_ADinf_P_array(double * res, const double * z, size_t size)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(size);
+  double zs[ADINF_CHUNK], rs[ADINF_CHUNK];
+  uint16_t order[ADINF_CHUNK];
+  for (size_t i0=0; i0<size; i0+=ADINF_CHUNK)
+  {
+    size_t m = GSL_MIN(ADINF_CHUNK,size-i0);
+    adinf_order(z+i0,m,order);
+    for (size_t i=0; i<m; i++)
+      zs[i] = z[i0+order[i]];
+    apply(ADINF_P,rs,NULL,zs,m);
+    for (size_t i=0; i<m; i++)
+      res[i0+order[i]] = rs[i];
+  }
+}
+
+
+/** @brief Computes the cdf of the Anderson-Darling statistics on an
+ *         array
+ *
+ *  Array version of `aspa_cdf_AD_P`, each statistic has its own sample
+ *  size; res and z can be the same array.
+ *
+ *  @param[out] res an array of size doubles, Prob{W2 <= z}
+ *  @param[in] n an array of size sample sizes
+ *  @param[in] z an array of size doubles, the statistics
+ *  @param[in] size the number of values
+*/
+void aspa_cdf_AD_P_array(double * res, const int * n, const double * z, size_t size)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(size);
+  apply(AD_P,res,n,z,size);
+}
+
+/** @name Sums of the Weibull likelihood equations
+ *
+ *  Not a distribution function: the sums evaluated at each Newton
+ *  iteration of the Weibull fit of aspa_renewal.c, here for vexp.
+ *  Compiled without fused multiply-add, as vks, so that the fits and
+ *  the model rankings do not depend on the CPU.
+*/
+/** @{ */
+
+/** Adds the sums of exp(k*y), y*exp(k*y) and y^2*exp(k*y) over the n
+    values of y to s */
+INLINE void vweibull(const double * y, size_t n, double k, double * s)
+{
+  vdouble s0 = vset(0.), s1 = vset(0.), s2 = vset(0.);
+  for (size_t i=0; i<n; i+=VLEN)
+  {
+    size_t m = GSL_MIN(VLEN,n-i);
+    vdouble yv = {0.}, w = {0.};
+    for (size_t l=0; l<m; l++)
+    {
+      yv[l] = y[i+l];
+      w[l] = 1.;
+    }
+    vdouble e = vexp(k*yv)*w;
+    s0 += e;
+    e *= yv;
+    s1 += e;
+    s2 += e*yv;
+  }
+  for (int l=0; l<VLEN; l++)
+  {
+    s[0] += s0[l];
+    s[1] += s1[l];
+    s[2] += s2[l];
+  }
+}
+
+#ifdef ASPA_HAVE_X86
+__attribute__((target("avx512f"),optimize("fp-contract=off")))
+static void vweibull_avx512(const double * y, size_t n, double k, double * s)
+{
+  vweibull(y,n,k,s);
+}
+
+__attribute__((target("avx2,fma"),optimize("fp-contract=off")))
+static void vweibull_avx2(const double * y, size_t n, double k, double * s)
+{
+  vweibull(y,n,k,s);
+}
+#endif
+
+__attribute__((optimize("fp-contract=off")))
+static void vweibull_generic(const double * y, size_t n, double k, double * s)
+{
+  vweibull(y,n,k,s);
+}
+
+/** @brief Computes the sums of the Weibull likelihood equations
+ *
+ *  With y[i] the log of the i-th datum (divided by a scale, so that
+ *  the exponentials stay finite), s[j] is the sum of
+ *  y[i]^j*exp(k*y[i]) for j = 0, 1, 2: the log-likelihood of the
+ *  shape k, the scale being profiled out, and its first two
+ *  derivatives follow (see aspa_renewal.c).
+ *
+ *  @param[in] y an array of n doubles
+ *  @param[in] n the number of values
+ *  @param[in] k the shape
+ *  @param[out] s an array of 3 doubles, the sums
+*/
+void aspa_weibull_sums(const double * y, size_t n, double k, double * s)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(n);
+  s[0] = s[1] = s[2] = 0.;
+#ifdef ASPA_HAVE_X86
+  if (__builtin_cpu_supports("avx512f"))
+    vweibull_avx512(y,n,k,s);
+  else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    vweibull_avx2(y,n,k,s);
+  else
+#endif
+    vweibull_generic(y,n,k,s);
+}
+
+/** @} */
@@ -0,0 +1,105 @@
+/** @file aspa_dist_vec_test.c
+ *  @brief User program for testing the array versions of the normal
+ *         and Anderson-Darling distribution functions
+ *
+ *  Compares `aspa_cdf_norm_P_array`, `aspa_cdf_norm_Q_array`,
+ *  `aspa_cdf_ADinf_P_array` and `aspa_cdf_AD_P_array` with the scalar
+ *  functions on dense grids and prints the largest absolute and
+ *  relative differences together with the ratio of the run times.
+ *  Marsaglia's Phi loses the relative accuracy of the lower tail,
+ *  norm_P is compared with cPhi(-x) instead; cPhi is only defined
+ *  for |x| < 17. The ratios of the run times are only meaningful in an
+ *  optimised build (make OPTIMIZE=1).
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa.h"
+
+#include <time.h>
+
+static double seconds(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return now.tv_sec+1e-9*now.tv_nsec;
+}
+
+/** Prints a row of the table, returns true if the largest absolute
+    difference is above tol */
+bool report(const char * name, const double * scalar, const double * array, size_t n,
+	    double t_scalar, double t_array, double tol)
+{
+  double max_abs = 0., max_rel = 0.;
+  for (size_t i=0; i<n; i++)
+  {
+    double diff = fabs(scalar[i]-array[i]);
+    max_abs = GSL_MAX(max_abs,diff);
+    if (scalar[i] > 1e-300)
+      max_rel = GSL_MAX(max_rel,diff/scalar[i]);
+  }
+  printf("%-12s %8zu %12.3g %12.3g %10.1f\n",name,n,max_abs,max_rel,t_scalar/t_array);
+  return !(max_abs <= tol);
+}
+
+int main()
+{
+  size_t n_max = 80001;
+  double * x = malloc(n_max*sizeof(double));
+  int * n = malloc(n_max*sizeof(int));
+  double * scalar = malloc(n_max*sizeof(double));
+  double * array = malloc(n_max*sizeof(double));
+  size_t n_failed = 0;
+  printf("%-12s %8s %12s %12s %10s\n","function","values","max abs diff","max rel diff","speed up");
+  // normal distribution on [-16,16]
+  size_t size = 32001;
+  for (size_t i=0; i<size; i++)
+    x[i] = -16.+i*1e-3;
+  double start = seconds();
+  for (size_t i=0; i<size; i++)
+    scalar[i] = aspa_cdf_norm_P(x[i]);
+  double t_scalar = seconds()-start;
+  for (size_t i=0; i<size; i++)
+    scalar[i] = aspa_cdf_norm_Q(-x[i]);
+  start = seconds();
+  aspa_cdf_norm_P_array(array,x,size);
+  n_failed += report("norm_P",scalar,array,size,t_scalar,seconds()-start,1e-14);
+  start = seconds();
+  for (size_t i=0; i<size; i++)
+    scalar[i] = aspa_cdf_norm_Q(x[i]);
+  t_scalar = seconds()-start;
+  start = seconds();
+  aspa_cdf_norm_Q_array(array,x,size);
+  n_failed += report("norm_Q",scalar,array,size,t_scalar,seconds()-start,1e-14);
+  // asymptotic Anderson-Darling distribution on [0.005,10]
+  size = 10000;
+  for (size_t i=0; i<size; i++)
+    x[i] = 0.005+i*1e-3;
+  start = seconds();
+  for (size_t i=0; i<size; i++)
+    scalar[i] = aspa_cdf_ADinf_P(x[i]);
+  t_scalar = seconds()-start;
+  start = seconds();
+  aspa_cdf_ADinf_P_array(array,x,size);
+  n_failed += report("ADinf_P",scalar,array,size,t_scalar,seconds()-start,1e-13);
+  // Anderson-Darling distribution on [0.01,10] for sample sizes from 5 to 10^6
+  size = 0;
+  for (int m=5; m<=1000000; m*=10)
+    for (size_t i=0; i<10000; i++, size++)
+    {
+      n[size] = m;
+      x[size] = 0.01+i*1e-3;
+    }
+  start = seconds();
+  for (size_t i=0; i<size; i++)
+    scalar[i] = aspa_cdf_AD_P(n[i],x[i]);
+  t_scalar = seconds()-start;
+  start = seconds();
+  aspa_cdf_AD_P_array(array,n,x,size);
+  n_failed += report("AD_P",scalar,array,size,t_scalar,seconds()-start,1e-12);
+  printf("Functions differing from the scalar ones: %d (0 expected).\n",(int) n_failed);
+  free(x);
+  free(n);
+  free(scalar);
+  free(array);
+  return n_failed == 0 ? 0 : 1;
+}
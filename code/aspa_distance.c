@@ -0,0 +1,443 @@
+/** @file aspa_distance.c
+ *  @brief Function definitions for the distances between the trials of
+ *         an aspa_sta
+ *
+ *  - Victor and Purpura (1996) J. Neurophysiol. 76: 1310-1326: the cost
+ *    of the cheapest transformation of a train into the other, a spike
+ *    insertion or deletion costs 1, a shift by dt costs q|dt|. The
+ *    dynamic program keeps a single row (and the diagonal element). The
+ *    multi-cost version runs the program for 8 values of q at once in
+ *    the lanes of GCC vectors, dispatched at run time on the CPU as in
+ *    aspa_dist_vec.c and compiled without fused multiply-add so that
+ *    all the versions give the same distances.
+ *  - van Rossum (2001) Neural Comput. 13: 751-763: the trains are
+ *    convolved with exp(-t/tau), the distance is the L2 norm of the
+ *    difference divided by tau. The integral is a sum of
+ *    exp(-|t_i-t_j|/tau) over the pairs of spikes, obtained in one
+ *    merge of the two sorted trains with running sums (Houghton and
+ *    Kreuz, 2012); the terms of each train with itself are computed
+ *    once per trial.
+ *  - The ISI-distance (Kreuz et al, 2007) and the SPIKE-distance
+ *    (Kreuz et al, 2013), time averages of piecewise constant or
+ *    piecewise linear dissimilarity profiles, computed in one merge of
+ *    the two trains. Auxiliary spikes are added at both ends of the
+ *    common time interval (from the earliest time, 0 or the first spike,
+ *    to the trial duration or the last spike).
+ *
+ *  The pairs of trials are cut in tiles of DIST_TILE x DIST_TILE
+ *  trials, the trains of a tile stay in the cache; the tiles of the
+ *  upper triangle are computed in parallel (see aspa_pool.c).
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+#define DIST_TILE 16
+
+#define VLEN 8
+typedef double vdouble __attribute__((vector_size(VLEN*sizeof(double))));
+typedef int64_t vlong __attribute__((vector_size(VLEN*sizeof(int64_t))));
+
+/** The block functions are always inlined, the ABI of their vector
+    arguments does not matter (the tree is compiled with -Wno-psabi) */
+#define INLINE static inline __attribute__((always_inline))
+
+INLINE vdouble vset(double a)
+{
+  vdouble v;
+  for (int l=0; l<VLEN; l++)
+    v[l] = a;
+  return v;
+}
+
+INLINE vdouble vmin(vdouble a, vdouble b)
+{
+  vlong mask = a < b;
+  return (vdouble) (((vlong) a & mask) | ((vlong) b & ~mask));
+}
+
+/** Victor-Purpura distances of a and b for the VLEN costs q, in the
+    last element of row (m+1 vectors) */
+INLINE void vvp(const double * a, size_t n, const double * b, size_t m, const double * q_ptr,
+		vdouble * row)
+{
+  vdouble q;
+  memcpy(&q,q_ptr,sizeof(q));
+  for (size_t j=0; j<=m; j++)
+    row[j] = vset(j);
+  for (size_t i=1; i<=n; i++)
+  {
+    vdouble diag = row[0];
+    row[0] = vset(i);
+    for (size_t j=1; j<=m; j++)
+    {
+      vdouble shift = diag+q*fabs(a[i-1]-b[j-1]);
+      vdouble edit = vmin(row[j],row[j-1])+1.;
+      diag = row[j];
+      row[j] = vmin(edit,shift);
+    }
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ASPA_HAVE_X86 1
+
+// no fused multiply-add, the distances are the same in all versions
+__attribute__((target("avx512f"),optimize("fp-contract=off")))
+static void vvp_avx512(const double * a, size_t n, const double * b, size_t m,
+		       const double * q, vdouble * row)
+{
+  vvp(a,n,b,m,q,row);
+}
+
+__attribute__((target("avx2"),optimize("fp-contract=off")))
+static void vvp_avx2(const double * a, size_t n, const double * b, size_t m,
+		     const double * q, vdouble * row)
+{
+  vvp(a,n,b,m,q,row);
+}
+#endif
+
+__attribute__((optimize("fp-contract=off")))
+static void vvp_generic(const double * a, size_t n, const double * b, size_t m,
+			const double * q, vdouble * row)
+{
+  vvp(a,n,b,m,q,row);
+}
+
+/** vvp with the best version for the CPU, the vectors are passed by
+    pointer between versions */
+static void victor_purpura(const double * a, size_t n, const double * b, size_t m,
+			   const double * q, vdouble * row)
+{
+#ifdef ASPA_HAVE_X86
+  if (__builtin_cpu_supports("avx512f"))
+    vvp_avx512(a,n,b,m,q,row);
+  else if (__builtin_cpu_supports("avx2"))
+    vvp_avx2(a,n,b,m,q,row);
+  else
+#endif
+    vvp_generic(a,n,b,m,q,row);
+}
+
+/** Sum of exp(-|a_i-a_j|/tau) over all the pairs of spikes of a */
+static double vr_self(const double * a, size_t n, double tau)
+{
+  double s = n, run = 0.;
+  for (size_t i=1; i<n; i++)
+  {
+    run = exp(-(a[i]-a[i-1])/tau)*(1.+run);
+    s += 2.*run;
+  }
+  return s;
+}
+
+/** Sum of exp(-(b_j-a_i)/tau) over the pairs with a_i <= b_j (strict
+    false) or a_i < b_j */
+static double vr_half(const double * a, size_t n, const double * b, size_t m, double tau,
+		      bool strict)
+{
+  double s = 0., run = 0., last = 0.;
+  size_t i = 0;
+  for (size_t j=0; j<m; j++)
+  {
+    for (; i<n && (strict ? a[i] < b[j] : a[i] <= b[j]); i++)
+    {
+      run = i > 0 ? run*exp(-(a[i]-last)/tau)+1. : 1.;
+      last = a[i];
+    }
+    if (i > 0)
+      s += run*exp(-(b[j]-last)/tau);
+  }
+  return s;
+}
+
+static double van_rossum(const double * a, size_t n, double self_a, const double * b,
+			 size_t m, double self_b, double tau)
+{
+  double cross = vr_half(a,n,b,m,tau,false)+vr_half(b,m,a,n,tau,true);
+  return sqrt(GSL_MAX(0.,0.5*(self_a+self_b-2.*cross)));
+}
+
+/** Copies the train st with auxiliary spikes at t_min and t_max in
+    res, returns the number of spikes */
+static size_t with_edges(const gsl_vector * st, double t_min, double t_max, double * res)
+{
+  size_t k = 0;
+  if (st->size == 0 || gsl_vector_get(st,0) > t_min)
+    res[k++] = t_min;
+  for (size_t i=0; i<st->size; i++)
+    res[k++] = gsl_vector_get(st,i);
+  if (res[k-1] < t_max)
+    res[k++] = t_max;
+  return k;
+}
+
+/** Distance of each spike of a to the nearest spike of b, in near */
+static void nearest(const double * a, size_t n, const double * b, size_t m, double * near)
+{
+  size_t j = 0;
+  for (size_t i=0; i<n; i++)
+  {
+    while (j+1 < m && b[j+1] <= a[i])
+      j++;
+    double d = fabs(a[i]-b[j]);
+    if (j+1 < m)
+      d = GSL_MIN(d,b[j+1]-a[i]);
+    near[i] = d;
+  }
+}
+
+/** The SPIKE dissimilarity of one train at time t, spikes p <= t < f of
+    nearest distances near_p and near_f */
+static double spike_local(double p, double f, double near_p, double near_f, double t)
+{
+  return (near_p*(f-t)+near_f*(t-p))/(f-p);
+}
+
+/** ISI-distance (spike == false) or SPIKE-distance of the trains a and
+    b with their auxiliary spikes, work holds n+m doubles */
+static double isi_spike(const double * a, size_t n, const double * b, size_t m, bool spike,
+			double * work)
+{
+  double * near_a = work;
+  double * near_b = work+n;
+  if (spike)
+  {
+    nearest(a,n,b,m,near_a);
+    nearest(b,m,a,n,near_b);
+  }
+  double t_min = GSL_MIN(a[0],b[0]);
+  double t = t_min;
+  double integral = 0.;
+  size_t i = 0, j = 0; // a[i] <= t < a[i+1], b[j] <= t < b[j+1]
+  while (i+1 < n && j+1 < m)
+  {
+    double next = GSL_MIN(a[i+1],b[j+1]);
+    double xa = a[i+1]-a[i], xb = b[j+1]-b[j];
+    if (!spike)
+      integral += (next-t)*fabs(xa-xb)/GSL_MAX(xa,xb);
+    else
+    {
+      double mean = 0.5*(xa+xb);
+      double s0 = spike_local(a[i],a[i+1],near_a[i],near_a[i+1],t)*xb+
+	spike_local(b[j],b[j+1],near_b[j],near_b[j+1],t)*xa;
+      double s1 = spike_local(a[i],a[i+1],near_a[i],near_a[i+1],next)*xb+
+	spike_local(b[j],b[j+1],near_b[j],near_b[j+1],next)*xa;
+      integral += (next-t)*0.5*(s0+s1)/(2.*mean*mean);
+    }
+    t = next;
+    while (i+1 < n && a[i+1] <= t)
+      i++;
+    while (j+1 < m && b[j+1] <= t)
+      j++;
+  }
+  return t > t_min ? integral/(t-t_min) : 0.;
+}
+
+typedef struct
+{
+  const aspa_sta * sta;
+  aspa_distance_kind kind;
+  double tau;
+  const double * q; //!< n_q costs, padded to a multiple of VLEN
+  size_t n_q;
+  gsl_matrix ** res; //!< n_q matrices for Victor-Purpura, 1 otherwise
+  const double * self; //!< van Rossum terms of each trial with itself
+  double t_min, t_max; //!< Common time interval
+  size_t max_size; //!< Largest number of spikes of a trial
+  size_t n_tiles; //!< Per side
+  int * status; //!< One per task
+} dist_job;
+
+/** Distances of trials i and j, in the work buffer of the task */
+static void dist_pair(const dist_job * job, size_t i, size_t j, double * work)
+{
+  const aspa_sta * sta = job->sta;
+  const gsl_vector * a = sta->st[i];
+  const gsl_vector * b = sta->st[j];
+  double d;
+  switch (job->kind) {
+  case ASPA_DIST_VICTOR_PURPURA:
+    for (size_t k=0; k<job->n_q; k+=VLEN)
+    {
+      victor_purpura(a->data,a->size,b->data,b->size,job->q+k,(vdouble *) work);
+      const double * v = work+VLEN*b->size;
+      for (size_t l=0; l<VLEN && k+l<job->n_q; l++)
+      {
+	gsl_matrix_set(job->res[k+l],i,j,v[l]);
+	gsl_matrix_set(job->res[k+l],j,i,v[l]);
+      }
+    }
+    return;
+  case ASPA_DIST_VAN_ROSSUM:
+    d = van_rossum(a->data,a->size,job->self[i],b->data,b->size,job->self[j],job->tau);
+    break;
+  default:
+    {
+      size_t n = with_edges(a,job->t_min,job->t_max,work);
+      size_t m = with_edges(b,job->t_min,job->t_max,work+n);
+      d = isi_spike(work,n,work+n,m,job->kind == ASPA_DIST_SPIKE,work+n+m);
+    }
+  }
+  gsl_matrix_set(job->res[0],i,j,d);
+  gsl_matrix_set(job->res[0],j,i,d);
+}
+
+/** Computes tile idx of the upper triangle of tiles */
+static void dist_tile(size_t idx, void * params)
+{
+  dist_job * job = params;
+  size_t task = idx;
+  size_t ti = 0, row = job->n_tiles;
+  while (idx >= row)
+  {
+    idx -= row;
+    ti++;
+    row--;
+  }
+  size_t tj = ti+idx;
+  // the dynamic program row or the trains with their edges
+  // (in vectors, aligned on their size)
+  size_t size = GSL_MAX(VLEN*(job->max_size+1),4*(job->max_size+2))+VLEN;
+  double * buffer = aspa_ctx_malloc(size*sizeof(double));
+  if (buffer == NULL)
+  {
+    job->status[task] = ASPA_ENOMEM;
+    return;
+  }
+  double * work = (double *) (((uintptr_t) buffer+sizeof(vdouble)-1) &
+			      ~(uintptr_t) (sizeof(vdouble)-1));
+  size_t n = job->sta->n_trials;
+  for (size_t i=ti*DIST_TILE; i < GSL_MIN((ti+1)*DIST_TILE,n); i++)
+    for (size_t j=GSL_MAX(tj*DIST_TILE,i+1); j < GSL_MIN((tj+1)*DIST_TILE,n); j++)
+      dist_pair(job,i,j,work);
+  aspa_ctx_free(buffer);
+}
+
+/** Fills the matrices of the kind, param is tau for van Rossum */
+static int dist_fill(const aspa_sta * sta, aspa_distance_kind kind, double param,
+		     const double * q, size_t n_q, gsl_matrix ** res)
+{
+  size_t n = sta->n_trials;
+  size_t n_tiles = (n+DIST_TILE-1)/DIST_TILE;
+  size_t n_tasks = n_tiles*(n_tiles+1)/2;
+  size_t n_q_pad = (n_q+VLEN-1)/VLEN*VLEN;
+  double * buffer = aspa_ctx_malloc((n+n_q_pad)*sizeof(double)+n_tasks*sizeof(int));
+  if (buffer == NULL)
+    return ASPA_ENOMEM;
+  dist_job job = {.sta=sta, .kind=kind, .tau=param, .q=buffer+n, .n_q=n_q, .res=res,
+		  .self=buffer, .t_min=0., .t_max=sta->trial_duration, .max_size=0,
+		  .n_tiles=n_tiles, .status=(int *) (buffer+n+n_q_pad)};
+  for (size_t k=0; k<n_q_pad; k++)
+    buffer[n+k] = k < n_q ? q[k] : 0.;
+  size_t work = 0;
+  for (size_t t_idx=0; t_idx<n; t_idx++)
+  {
+    const gsl_vector * st = sta->st[t_idx];
+    job.max_size = GSL_MAX(job.max_size,st->size);
+    work += st->size;
+    if (st->size > 0)
+    {
+      job.t_min = GSL_MIN(job.t_min,gsl_vector_get(st,0));
+      job.t_max = GSL_MAX(job.t_max,gsl_vector_get(st,st->size-1));
+    }
+    if (kind == ASPA_DIST_VAN_ROSSUM)
+      buffer[t_idx] = vr_self(st->data,st->size,param);
+  }
+  for (size_t k=0; k<n_tasks; k++)
+    job.status[k] = 0;
+  for (size_t k=0; k < (kind == ASPA_DIST_VICTOR_PURPURA ? n_q : 1); k++)
+    for (size_t t_idx=0; t_idx<n; t_idx++)
+      gsl_matrix_set(res[k],t_idx,t_idx,0.);
+  aspa_parallel_for(n_tasks,work*(n > 0 ? n : 1),dist_tile,&job);
+  int status = 0;
+  for (size_t k=0; k<n_tasks; k++)
+    if (job.status[k] != 0)
+      status = aspa_ctx_error(job.status[k],"Allocation of the distance workspace failed.");
+  aspa_ctx_free(buffer);
+  return status;
+}
+
+/** @brief Returns the matrix of the distances between the trials of an
+ *         aspa_sta
+ *
+ *  See aspa_distance.c for the distances. The spike times of each trial
+ *  must be sorted.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] kind ASPA_DIST_VICTOR_PURPURA, ASPA_DIST_VAN_ROSSUM,
+ *             ASPA_DIST_ISI or ASPA_DIST_SPIKE
+ *  @param[in] param the cost q (1/s) of Victor-Purpura, the time
+ *             constant tau (s) of van Rossum, ignored otherwise
+ *  @returns a pointer to an allocated n_trials x n_trials gsl_matrix,
+ *           NULL if something went wrong
+*/
+gsl_matrix * aspa_sta_distance_matrix(const aspa_sta * sta, aspa_distance_kind kind,
+				      double param)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  if (sta->n_trials == 0 || (kind == ASPA_DIST_VAN_ROSSUM && !(param > 0.)) ||
+      (kind == ASPA_DIST_VICTOR_PURPURA && !(param >= 0.)))
+  {
+    aspa_ctx_error(ASPA_EINVAL,"The distances need trials, a cost >= 0 or a time"
+		   " constant > 0.");
+    return NULL;
+  }
+  gsl_matrix * res = gsl_matrix_alloc(sta->n_trials,sta->n_trials);
+  if (res == NULL)
+  {
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the distance matrix failed.");
+    return NULL;
+  }
+  if (dist_fill(sta,kind,param,&param,1,&res) != 0)
+  {
+    gsl_matrix_free(res);
+    return NULL;
+  }
+  return res;
+}
+
+/** @brief Computes the Victor-Purpura distance matrices of an aspa_sta
+ *         for several costs
+ *
+ *  The dynamic program runs for 8 costs at once (see aspa_distance.c),
+ *  which costs about the time of a single cost.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] q the n_q costs (1/s), >= 0
+ *  @param[in] n_q the number of costs
+ *  @param[out] res an array of n_q pointers, set to allocated
+ *              n_trials x n_trials matrices (NULL if something went
+ *              wrong)
+ *  @returns 0 if everything goes fine, an error code otherwise
+*/
+int aspa_sta_victor_purpura_matrices(const aspa_sta * sta, const double * q, size_t n_q,
+				     gsl_matrix ** res)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  for (size_t k=0; k<n_q; k++)
+    res[k] = NULL;
+  if (sta->n_trials == 0)
+    return aspa_ctx_error(ASPA_EINVAL,"The distances need trials.");
+  for (size_t k=0; k<n_q; k++)
+    if (!(q[k] >= 0.))
+      return aspa_ctx_error(ASPA_EINVAL,"The costs should be >= 0.");
+  int status = 0;
+  for (size_t k=0; k<n_q && status == 0; k++)
+    if ((res[k] = gsl_matrix_alloc(sta->n_trials,sta->n_trials)) == NULL)
+      status = aspa_ctx_error(ASPA_ENOMEM,"Allocation of the distance matrices failed.");
+  if (status == 0)
+    status = dist_fill(sta,ASPA_DIST_VICTOR_PURPURA,0.,q,n_q,res);
+  if (status != 0)
+    for (size_t k=0; k<n_q; k++)
+      if (res[k] != NULL)
+      {
+	gsl_matrix_free(res[k]);
+	res[k] = NULL;
+      }
+  return status;
+}
@@ -0,0 +1,141 @@
+/** @file aspa_distance_test.c
+ *  @brief User program for testing functions aspa_sta_distance_matrix
+ *         and aspa_sta_victor_purpura_matrices
+ *
+ *  On the trains {0.1,0.5} and {0.12} the Victor-Purpura distance is
+ *  1.2 for a cost of 10 (shift 0.1 to 0.12, delete 0.5) and 3 for a
+ *  cost of 100 (delete the three spikes), the van Rossum distance of
+ *  time constant tau is sqrt(1-exp(-0.02/tau)) between {0.1} and
+ *  {0.12}. The distances between the trials of a simulated gamma train
+ *  are compared, on a subset of the pairs, with the full
+ *  Victor-Purpura dynamic program and with the van Rossum distance
+ *  summed over all the pairs of spikes. The costs 0 and 100 must give
+ *  the difference of the spike counts and at most their sum; the ISI-
+ *  and SPIKE-distance matrices must be symmetric, in [0,1], with a
+ *  null diagonal.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa_test.h"
+
+/** Returns an aspa_sta of n_trials trials of 1 s, trial i holding the
+    size[i] spike times of st[i] */
+aspa_sta * small_sta(size_t n_trials, const size_t * size, const double st[][2])
+{
+  aspa_sta * res = aspa_sta_alloc(n_trials,1,0.,0.,1.);
+  for (size_t i=0; i<n_trials; i++)
+  {
+    aspa_sta_set_st_start(res,i,i);
+    res->st[i] = gsl_vector_alloc(size[i]);
+    for (size_t j=0; j<size[i]; j++)
+      gsl_vector_set(res->st[i],j,st[i][j]);
+  }
+  return res;
+}
+
+/** Returns the Victor-Purpura distance of cost q from the full table */
+double naive_vp(const gsl_vector * a, const gsl_vector * b, double q)
+{
+  size_t m = b->size+1;
+  double * dp = malloc((a->size+1)*m*sizeof(double));
+  for (size_t k=0; k<=a->size; k++)
+    for (size_t l=0; l<=b->size; l++)
+      dp[k*m+l] = k == 0 || l == 0 ? k+l :
+	GSL_MIN(GSL_MIN(dp[(k-1)*m+l],dp[k*m+l-1])+1.,
+		dp[(k-1)*m+l-1]+q*fabs(gsl_vector_get(a,k-1)-gsl_vector_get(b,l-1)));
+  double res = dp[a->size*m+b->size];
+  free(dp);
+  return res;
+}
+
+/** Returns the sum of exp(-|x-y|/tau) over the spikes x of a and y of b */
+double kernel_sum(const gsl_vector * a, const gsl_vector * b, double tau)
+{
+  double res = 0.;
+  for (size_t k=0; k<a->size; k++)
+    for (size_t l=0; l<b->size; l++)
+      res += exp(-fabs(gsl_vector_get(a,k)-gsl_vector_get(b,l))/tau);
+  return res;
+}
+
+int main()
+{
+  size_t n_failed = 0;
+  test_header("value");
+  // known answers
+  const size_t size[3] = {2,1,1};
+  const double st[3][2] = {{0.1,0.5},{0.12},{0.1}};
+  aspa_sta * sta = small_sta(3,size,st);
+  gsl_matrix * vp_small = aspa_sta_distance_matrix(sta,ASPA_DIST_VICTOR_PURPURA,10.);
+  gsl_matrix * vp_small_100 = aspa_sta_distance_matrix(sta,ASPA_DIST_VICTOR_PURPURA,100.);
+  gsl_matrix * vr_small = aspa_sta_distance_matrix(sta,ASPA_DIST_VAN_ROSSUM,0.05);
+  n_failed += vp_small == NULL || vp_small_100 == NULL || vr_small == NULL;
+  if (n_failed == 0)
+  {
+    n_failed += test_report("Victor-Purpura {0.1,0.5} {0.12}, q=10 - 1.2",
+			    fabs(gsl_matrix_get(vp_small,0,1)-1.2),1e-12);
+    n_failed += test_report("Victor-Purpura {0.1,0.5} {0.12}, q=100 - 3",
+			    fabs(gsl_matrix_get(vp_small_100,1,0)-3.),1e-12);
+    n_failed += test_report("van Rossum {0.1} {0.12} / sqrt(1-exp(-0.4))",
+			    fabs(gsl_matrix_get(vr_small,1,2)-sqrt(1.-exp(-0.4))),1e-12);
+    gsl_matrix_free(vp_small);
+    gsl_matrix_free(vp_small_100);
+    gsl_matrix_free(vr_small);
+  }
+  aspa_sta_free(sta);
+  sta = test_sim_sta(ASPA_TEST_SEED,4000,15.,2.,10.);
+  const double costs[3] = {0.,10.,100.};
+  gsl_matrix * vp[3];
+  gsl_matrix * vr = aspa_sta_distance_matrix(sta,ASPA_DIST_VAN_ROSSUM,0.02);
+  gsl_matrix * vp_10 = aspa_sta_distance_matrix(sta,ASPA_DIST_VICTOR_PURPURA,10.);
+  if (aspa_sta_victor_purpura_matrices(sta,costs,3,vp) != 0 || vr == NULL || vp_10 == NULL)
+  {
+    fprintf(stderr,"The distance matrices could not be computed\n");
+    exit(EXIT_FAILURE);
+  }
+  double diff_vp = 0., diff_q = 0., diff_0 = 0., above_100 = 0., diff_vr = 0.;
+  for (size_t i=0; i<sta->n_trials; i+=9)
+    for (size_t j=0; j<sta->n_trials; j+=7)
+    {
+      const gsl_vector * a = sta->st[i];
+      const gsl_vector * b = sta->st[j];
+      double vr_direct = sqrt(GSL_MAX(0.,0.5*(kernel_sum(a,a,0.02)+kernel_sum(b,b,0.02)-
+					     2.*kernel_sum(a,b,0.02))));
+      diff_vp = GSL_MAX(diff_vp,fabs(gsl_matrix_get(vp_10,i,j)-naive_vp(a,b,10.)));
+      diff_q = GSL_MAX(diff_q,fabs(gsl_matrix_get(vp[1],i,j)-gsl_matrix_get(vp_10,i,j)));
+      diff_0 = GSL_MAX(diff_0,fabs(gsl_matrix_get(vp[0],i,j)-fabs((double) a->size-(double) b->size)));
+      above_100 = GSL_MAX(above_100,gsl_matrix_get(vp[2],i,j)-(a->size+b->size));
+      diff_vr = GSL_MAX(diff_vr,fabs(gsl_matrix_get(vr,i,j)-vr_direct)/(1.+vr_direct));
+    }
+  n_failed += test_report("Victor-Purpura, q=10 / dynamic program",diff_vp,1e-9);
+  n_failed += test_report("victor_purpura_matrices / distance_matrix",diff_q,0.);
+  n_failed += test_report("Victor-Purpura, q=0 / count difference",diff_0,0.);
+  n_failed += test_report("Victor-Purpura, q=100 - count sum",above_100,0.);
+  n_failed += test_report("van Rossum / all pairs (relative)",diff_vr,1e-6);
+  const char * name[2] = {"ISI-distance, entries invalid","SPIKE-distance, entries invalid"};
+  for (int kind=ASPA_DIST_ISI; kind<=ASPA_DIST_SPIKE; kind++)
+  {
+    gsl_matrix * dist = aspa_sta_distance_matrix(sta,kind,0.);
+    if (dist == NULL)
+    {
+      n_failed++;
+      continue;
+    }
+    double n_invalid = 0.;
+    for (size_t i=0; i<sta->n_trials; i++)
+      for (size_t j=0; j<sta->n_trials; j++)
+      {
+	double d = gsl_matrix_get(dist,i,j);
+	n_invalid += !(d >= 0. && d <= 1.) || d != gsl_matrix_get(dist,j,i) || (i == j && d != 0.);
+      }
+    n_failed += test_report(name[kind-ASPA_DIST_ISI],n_invalid,0.);
+    gsl_matrix_free(dist);
+  }
+  printf("Checks failed: %d (0 expected).\n",(int) n_failed);
+  for (size_t k=0; k<3; k++)
+    gsl_matrix_free(vp[k]);
+  gsl_matrix_free(vp_10);
+  gsl_matrix_free(vr);
+  aspa_sta_free(sta);
+  return n_failed == 0 ? 0 : 1;
+}
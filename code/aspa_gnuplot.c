@@ -0,0 +1,161 @@
+/** @file aspa_gnuplot.c
+ *  @brief Function definitions for the gnuplot session used by the
+ *         interactive (`*_plot_i`) plots
+ *
+ *  A single gnuplot process is started the first time an interactive
+ *  plot is requested and kept alive until the program exits; each plot
+ *  gets its own window in that session. The data are not formatted:
+ *  they are sent inline as pairs of native doubles with gnuplot's
+ *  `binary` format, which spares both the printf / scanf work and the
+ *  repeated process spawns when several plots are generated.
+ *
+ *  The command used to start gnuplot can be changed with the
+ *  environment variable ASPA_GNUPLOT (default "gnuplot -persist").
+ *
+ *  The session is shared by all the threads: a plot is written between
+ *  `aspa_gp_window` and `aspa_gp_end`, which hold a lock, so that plots
+ *  made concurrently do not interleave.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+#include <pthread.h>
+
+static pthread_mutex_t gp_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE * gp_session = NULL;
+static size_t gp_n_windows = 0;
+
+static void gp_atexit(void)
+{
+  aspa_gp_close();
+}
+
+/** @brief Returns the gnuplot session, starting it if necessary
+ *
+ *  Use `aspa_gp_window` instead when other threads may plot.
+ *
+ *  @returns a pipe to gnuplot, NULL if gnuplot could not be started
+*/
+FILE * aspa_gp_session(void)
+{
+  static bool registered = false;
+  if (gp_session != NULL)
+    return gp_session;
+  const char * command = getenv("ASPA_GNUPLOT");
+  gp_session = popen(command != NULL ? command : "gnuplot -persist","w");
+  if (gp_session == NULL) {
+    aspa_ctx_error(ASPA_FAILURE,"Couldn't open Gnuplot.");
+    return NULL;
+  }
+  if (!registered)
+  {
+    atexit(gp_atexit);
+    registered = true;
+  }
+  return gp_session;
+}
+
+/** @brief Opens a new plot window in the gnuplot session
+ *
+ *  The settings of the previous plot are reset and the common
+ *  ones (grid, no key) are set. The session is locked until
+ *  `aspa_gp_end` is called.
+ *
+ *  @returns a pipe to gnuplot, NULL if gnuplot could not be started
+*/
+FILE * aspa_gp_window(void)
+{
+  pthread_mutex_lock(&gp_lock);
+  FILE * gp = aspa_gp_session();
+  if (gp == NULL)
+  {
+    pthread_mutex_unlock(&gp_lock);
+    return NULL;
+  }
+  fprintf(gp,"reset; set term qt %d; set grid; unset key\n", (int) gp_n_windows++);
+  return gp;
+}
+
+/** @brief Ends a plot started with `aspa_gp_window`
+ *
+ *  The commands and data are flushed and the session is unlocked.
+ *
+ *  @param[in/out] gp the pipe returned by `aspa_gp_window`
+ *  @returns 0 if everything goes fine, ASPA_EIO otherwise
+*/
+int aspa_gp_end(FILE * gp)
+{
+  int status = 0;
+  if (fflush(gp) != 0 || ferror(gp))
+    status = aspa_ctx_error(ASPA_EIO,"Writing to gnuplot failed.");
+  pthread_mutex_unlock(&gp_lock);
+  return status;
+}
+
+/** @brief Writes the inline binary data specification of a plot element
+ *
+ *  What is written is the equivalent of `'-'` for `n` (x,y) pairs
+ *  written next with `aspa_gp_binary_write`, the caller adds the
+ *  `using` and `with` parts.
+ *
+ *  @param[in/out] gp a pipe to gnuplot
+ *  @param[in] n the number of (x,y) pairs
+ *  @returns 0 if everything goes fine
+*/
+int aspa_gp_binary_spec(FILE * gp, size_t n)
+{
+  fprintf(gp,"'-' binary record=%zu format='%%2double'", n);
+  return 0;
+}
+
+/** @brief Writes (x,y) pairs in gnuplot's binary format
+ *
+ *  If `x` is NULL, the abscissae are 0,1,2,... A NaN pair can be used
+ *  to break a line between two series of the same plot element.
+ *
+ *  @param[in/out] gp a pipe to gnuplot
+ *  @param[in] x the abscissae (or NULL)
+ *  @param[in] y the ordinates
+ *  @param[in] n the number of pairs
+ *  @returns 0 if everything goes fine, ASPA_EIO otherwise
+*/
+int aspa_gp_binary_write(FILE * gp, const double * x, const double * y, size_t n)
+{
+  double buffer[1024];
+  size_t n_pairs = sizeof(buffer)/sizeof(double)/2;
+  for (size_t i=0; i<n; i+=n_pairs)
+  {
+    size_t m = GSL_MIN(n_pairs,n-i);
+    for (size_t j=0; j<m; j++)
+    {
+      buffer[2*j] = x != NULL ? x[i+j] : (double) (i+j);
+      buffer[2*j+1] = y[i+j];
+    }
+    if (fwrite(buffer,2*sizeof(double),m,gp) != m)
+      return aspa_ctx_error(ASPA_EIO,"Writing to gnuplot failed.");
+  }
+  return 0;
+}
+
+/** @brief Closes the gnuplot session
+ *
+ *  This is done automatically when the program exits. The windows
+ *  stay open if gnuplot was started with -persist. A later
+ *  interactive plot starts a new session.
+ *
+ *  @returns 0 if everything goes fine
+*/
+int aspa_gp_close(void)
+{
+  pthread_mutex_lock(&gp_lock);
+  if (gp_session != NULL)
+  {
+    fflush(gp_session);
+    pclose(gp_session);
+    gp_session = NULL;
+    gp_n_windows = 0;
+  }
+  pthread_mutex_unlock(&gp_lock);
+  return 0;
+}
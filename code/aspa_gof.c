@@ -0,0 +1,231 @@
+/** @file aspa_gof.c
+ *  @brief Function definitions for the goodness of fit battery
+ *
+ *  Under a homogeneous Poisson hypothesis, the intervals between the
+ *  trial start and the successive spikes are exponential: as in
+ *  aspa_Durbin_test.c, the times of the spikes of a trial divided by
+ *  the time of its last spike are then, the last one excepted,
+ *  independent and uniform on [0,1), whatever the rate of the trial.
+ *  The battery pools the rescaled times of all the trials of a unit,
+ *  sorts them once and computes Kolmogorov's D, D+ and D- in a single
+ *  pass (`aspa_ks_stats_array`) and the Anderson-Darling W2 of
+ *  `aspa_AndersonDarling_W2` (with the same values). Durbin's
+ *  modification of the sorted times, done in place, is then tested
+ *  the same way; it is more sensitive to departures from the
+ *  exponential distribution of the intervals (see aspa_Durbin_test.c).
+ *
+ *  The trials are rescaled in parallel; with several units, the units
+ *  are processed in parallel instead.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+/** Exact Kolmogorov distribution up to that sample size, asymptotic
+    one above (the exact one costs a power of a matrix of size
+    2*n*D) */
+#define GOF_K_EXACT_MAX 2000
+
+typedef struct
+{
+  const aspa_sta * const * sta;
+  aspa_gof * gof;
+  int * status; //!< One per unit
+} gof_job;
+
+typedef struct
+{
+  const size_t * first; //!< Position of the first time of each trial
+  double * u; //!< The rescaled times
+} rescale_job;
+
+static void rescale_trial(const aspa_sta * sta, size_t t_idx, void * params)
+{
+  rescale_job * job = params;
+  gsl_vector * st = sta->st[t_idx];
+  double * u = job->u+job->first[t_idx];
+  for (size_t i=0; i+1 < st->size; i++)
+    u[i] = gsl_vector_get(st,i)/gsl_vector_get(st,st->size-1);
+}
+
+/** Number of rescaled times of a trial */
+static size_t trial_n_rescaled(const aspa_sta * sta, size_t t_idx)
+{
+  size_t n = sta->st[t_idx]->size;
+  return n > 0 ? n-1 : 0;
+}
+
+/** Anderson-Darling W2 of the n sorted values of u, computed as by
+    ad_compute */
+static double ad_pass(const double * u, size_t n)
+{
+  double A=0.;
+  for (size_t i=0; i<n; i++)
+    A += (i+i+1)*log(u[i]*(1.-u[n-1-i]));
+  A *= -1./n;
+  return A-(double)n;
+}
+
+/** Prob{sqrt(n) D_n > x} for large n, the Kolmogorov-Smirnov limit
+    distribution */
+static double kolmogorov_Q(double x)
+{
+  if (x < 0.2)
+    return 1.;
+  if (x < 1.)
+  { // the series in exp(-(2k-1)^2 pi^2/(8x^2)) converges faster there
+    double s = 0.;
+    for (int k=1; k<8; k+=2)
+      s += exp(-k*k*M_PI*M_PI/(8.*x*x));
+    return 1.-sqrt(2.*M_PI)/x*s;
+  }
+  double s = 0.;
+  for (int k=1; k<100; k++)
+  {
+    double term = exp(-2.*k*k*x*x);
+    s += k % 2 ? term : -term;
+    if (term < 1e-17)
+      break;
+  }
+  return 2.*s;
+}
+
+/** Prob{D_n > D}, with Stephens' correction above GOF_K_EXACT_MAX */
+static double kolmogorov_p(size_t n, double D)
+{
+  if (n <= GOF_K_EXACT_MAX)
+    return 1.-aspa_cdf_K((int) n,D);
+  double sqrt_n = sqrt((double) n);
+  return kolmogorov_Q((sqrt_n+0.12+0.11/sqrt_n)*D);
+}
+
+/** Fills the statistics of the n sorted values of u and their
+    p-values */
+static void gof_fill(const double * u, size_t n, double * D, double * p_D,
+		     double * D_plus, double * p_D_plus, double * D_minus,
+		     double * p_D_minus, double * W2, double * p_W2)
+{
+  aspa_ks_stats ks = aspa_ks_stats_array(u,n);
+  *D = ks.D;
+  *D_plus = ks.D_plus;
+  *D_minus = ks.D_minus;
+  *W2 = ad_pass(u,n);
+  *p_D = kolmogorov_p(n,*D);
+  if (p_D_plus != NULL)
+  {
+    *p_D_plus = 1.-aspa_cdf_Kplus((int) n,*D_plus);
+    *p_D_minus = 1.-aspa_cdf_Kplus((int) n,*D_minus);
+  }
+  // W2 is infinite when a value is 0 or 1 (tied spike times)
+  *p_W2 = isinf(*W2) ? 0. : 1.-aspa_cdf_AD_P((int) n,*W2);
+}
+
+/** Runs the battery on unit u_idx */
+static void gof_unit(size_t u_idx, void * params)
+{
+  gof_job * job = params;
+  const aspa_sta * sta = job->sta[u_idx];
+  aspa_gof * gof = job->gof+u_idx;
+  size_t n = 0;
+  for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
+    n += trial_n_rescaled(sta,t_idx);
+  *gof = (aspa_gof) {.n=n, .D=GSL_NAN, .p_D=GSL_NAN, .D_plus=GSL_NAN,
+		     .p_D_plus=GSL_NAN, .D_minus=GSL_NAN, .p_D_minus=GSL_NAN,
+		     .W2=GSL_NAN, .p_W2=GSL_NAN, .durbin_D=GSL_NAN,
+		     .p_durbin_D=GSL_NAN, .durbin_W2=GSL_NAN, .p_durbin_W2=GSL_NAN};
+  job->status[u_idx] = 0;
+  if (n == 0)
+    return;
+  // rescaled times, then the buffers of the sorts (2n+2 doubles for
+  // Durbin's modification)
+  double * u = aspa_ctx_malloc((3*n+2)*sizeof(double)+sta->n_trials*sizeof(size_t));
+  if (u == NULL)
+  {
+    job->status[u_idx] = ASPA_ENOMEM;
+    return;
+  }
+  size_t * first = (size_t *) (u+3*n+2);
+  first[0] = 0;
+  for (size_t t_idx=1; t_idx < sta->n_trials; t_idx++)
+    first[t_idx] = first[t_idx-1]+trial_n_rescaled(sta,t_idx-1);
+  rescale_job rescale = {.first=first, .u=u};
+  aspa_sta_parallel_for(sta,rescale_trial,&rescale);
+  int status = aspa_sort_w(u,n,u+n);
+  if (status == 0 && (u[0] < 0. || u[n-1] > 1.))
+    status = aspa_ctx_error(ASPA_EINVAL,"The spike times of unit %zu should all be"
+			    " >= 0 and sorted.",u_idx);
+  if (status == 0)
+  {
+    gof_fill(u,n,&gof->D,&gof->p_D,&gof->D_plus,&gof->p_D_plus,&gof->D_minus,
+	     &gof->p_D_minus,&gof->W2,&gof->p_W2);
+    status = aspa_durbin_modification_sorted_w(u,n,u+n);
+  }
+  if (status == 0)
+  {
+    double D_plus, D_minus;
+    gof_fill(u,n,&gof->durbin_D,&gof->p_durbin_D,&D_plus,NULL,&D_minus,
+	     NULL,&gof->durbin_W2,&gof->p_durbin_W2);
+  }
+  job->status[u_idx] = status;
+  aspa_ctx_free(u);
+}
+
+/** @brief Runs the goodness of fit battery on several units
+ *
+ *  For each unit, the spike times of each trial are divided by the
+ *  time of its last spike and pooled (the last spikes excepted);
+ *  Kolmogorov's statistics, the Anderson-Darling statistic and the
+ *  same statistics after Durbin's modification are computed on the
+ *  pooled times together with their p-values (see aspa_gof.c). The statistics of a unit whose trials
+ *  have at most one spike are NaN.
+ *
+ *  @param[in] sta an array of n_units pointers to aspa_sta structures
+ *  @param[in] n_units the number of units
+ *  @param[out] gof an array of n_units aspa_gof structures
+ *  @returns 0 if everything goes fine, the error code of the last unit
+ *           that failed otherwise (its statistics are then NaN)
+*/
+int aspa_gof_battery(const aspa_sta * const * sta, size_t n_units, aspa_gof * gof)
+{
+  ASPA_PROF_SCOPE();
+  int * status = aspa_ctx_malloc(n_units*sizeof(int));
+  if (status == NULL)
+    return ASPA_ENOMEM;
+  size_t work = 0;
+  for (size_t u_idx=0; u_idx < n_units; u_idx++)
+    work += aspa_sta_n_spikes(sta[u_idx]);
+  ASPA_PROF_SPIKES(work);
+  gof_job job = {.sta=sta, .gof=gof, .status=status};
+  aspa_parallel_for(n_units,work,gof_unit,&job);
+  int res = 0;
+  for (size_t u_idx=0; u_idx < n_units; u_idx++)
+    if (status[u_idx] != 0)
+      res = status[u_idx];
+  aspa_ctx_free(status);
+  return res;
+}
+
+/** @brief Prints the goodness of fit statistics of several units,
+ *         one row per unit after a header
+ *
+ *  @param[in/out] STREAM a pointer to an open file
+ *  @param[in] gof an array of n_units aspa_gof structures
+ *  @param[in] n_units the number of units
+ *  @returns 0 if everything goes fine, ASPA_EIO if the writing failed
+*/
+int aspa_gof_fprintf(FILE * STREAM, const aspa_gof * gof, size_t n_units)
+{
+  fprintf(STREAM,"# unit n D p_D D+ p_D+ D- p_D- W2 p_W2 Durbin_D p_Durbin_D"
+	  " Durbin_W2 p_Durbin_W2\n");
+  for (size_t u_idx=0; u_idx < n_units; u_idx++)
+  {
+    const aspa_gof * g = gof+u_idx;
+    fprintf(STREAM,"%zu %zu %g %g %g %g %g %g %g %g %g %g %g %g\n",u_idx,g->n,
+	    g->D,g->p_D,g->D_plus,g->p_D_plus,g->D_minus,g->p_D_minus,g->W2,g->p_W2,
+	    g->durbin_D,g->p_durbin_D,g->durbin_W2,g->p_durbin_W2);
+  }
+  if (ferror(STREAM))
+    return aspa_ctx_error(ASPA_EIO,"Writing the goodness of fit table failed.");
+  return 0;
+}
@@ -0,0 +1,142 @@
+/** @file aspa_gof_test.c
+ *  @brief User program for testing function aspa_gof_battery and the
+ *         statistics it is built on
+ *
+ *  aspa_ks_stats_get_w and aspa_ks_stats_cdf must give the statistics
+ *  of aspa_Kolmogorov_D on the cdf of the intervals of a simulated
+ *  gamma train, and the ones computed by hand on three values.
+ *  Durbin's modification in place (aspa_durbin_modification_sorted_w)
+ *  must give the values of aspa_durbin_modification_w on the cdf of the
+ *  intervals of a simulated gamma train and the ones computed by hand
+ *  on three values; empty and unsorted inputs must be rejected (the
+ *  two error messages are expected).
+ *  The statistics of the battery on the gamma train must be the ones of
+ *  aspa_Kolmogorov_D_w and aspa_AndersonDarling_W2_w on its rescaled
+ *  spike times. The battery is then run on 200 homogeneous Poisson
+ *  units, for which its null hypothesis holds: the p-values of each
+ *  statistic must be uniform.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa_test.h"
+
+#define N_UNITS 200
+
+/** The gamma cdf of the simulated intervals */
+double gamma_cdf(double x, void * params)
+{
+  return gsl_cdf_gamma_P(x,2.,1./30.);
+}
+
+int main()
+{
+  aspa_sta * sta = test_sim_sta(ASPA_TEST_SEED,4000,15.,2.,10.);
+  aspa_gof_workspace * w = aspa_gof_workspace_alloc(0);
+  size_t n_failed = 0;
+  test_header("value");
+  // Kolmogorov's statistics from one pass
+  gsl_vector * isi = aspa_sta_isi(sta);
+  gsl_vector * u = gsl_vector_alloc(isi->size);
+  for (size_t i=0; i<isi->size; i++)
+    gsl_vector_set(u,i,gamma_cdf(gsl_vector_get(isi,i),NULL));
+  aspa_ks_stats ks = aspa_ks_stats_get_w(u,false,w);
+  double diff = fabs(ks.D-aspa_Kolmogorov_D(u,false,"D"));
+  diff = GSL_MAX(diff,fabs(ks.D_plus-aspa_Kolmogorov_D(u,false,"D+")));
+  diff = GSL_MAX(diff,fabs(aspa_ks_stats_select(ks,ASPA_KS_D_MINUS)-aspa_Kolmogorov_D(u,false,"D-")));
+  diff = GSL_MAX(diff,fabs(aspa_Kolmogorov_D_w(u,false,"D",w)-ks.D));
+  n_failed += test_report("ks_stats_get_w / Kolmogorov_D",diff,0.);
+  gsl_vector * isi_s = gsl_vector_alloc(isi->size);
+  gsl_vector_memcpy(isi_s,isi);
+  gsl_sort_vector(isi_s);
+  aspa_ks_stats ks_cdf = aspa_ks_stats_cdf(isi_s->data,isi_s->size,gamma_cdf,NULL);
+  diff = GSL_MAX(fabs(ks_cdf.D-ks.D),GSL_MAX(fabs(ks_cdf.D_plus-ks.D_plus),fabs(ks_cdf.D_minus-ks.D_minus)));
+  n_failed += test_report("ks_stats_cdf / ks_stats_get_w",diff,0.);
+  gsl_vector_free(isi_s);
+  gsl_vector_free(u);
+  // D+ = max(1/3-0.1,2/3-0.4,1-0.7), D- = max(0.1,0.4-1/3,0.7-2/3)
+  double u3[3] = {0.1,0.4,0.7};
+  ks = aspa_ks_stats_array(u3,3);
+  diff = GSL_MAX(fabs(ks.D-0.3),GSL_MAX(fabs(ks.D_plus-0.3),fabs(ks.D_minus-0.1)));
+  n_failed += test_report("ks_stats of {0.1,0.4,0.7} / 0.3, 0.3, 0.1",diff,1e-15);
+  // Durbin's modification, in place on the sorted values
+  size_t n = 1000;
+  gsl_vector * durbin = gsl_vector_alloc(n);
+  gsl_vector * sorted = gsl_vector_alloc(n);
+  double * work = malloc((2*n+2)*sizeof(double));
+  for (size_t i=0; i<n; i++)
+    gsl_vector_set(sorted,i,gamma_cdf(gsl_vector_get(isi,i),NULL));
+  n_failed += aspa_durbin_modification_w(sorted,durbin,w) != 0;
+  gsl_sort_vector(sorted);
+  n_failed += aspa_durbin_modification_sorted_w(sorted->data,n,work) != 0;
+  double n_unsorted = 0.;
+  diff = 0.;
+  for (size_t i=0; i<n; i++)
+  {
+    diff = GSL_MAX(diff,fabs(gsl_vector_get(sorted,i)-gsl_vector_get(durbin,i)));
+    n_unsorted += i > 0 && gsl_vector_get(sorted,i) < gsl_vector_get(sorted,i-1);
+  }
+  n_failed += test_report("Durbin in place / durbin_modification_w",diff,0.);
+  n_failed += test_report("Durbin in place, unsorted pairs",n_unsorted,0.);
+  n_failed += test_report("Durbin in place, largest value - 1",gsl_vector_get(sorted,n-1)-1.,1e-12);
+  // spacings 0.2, 0.3, 0.4, 0.1, sorted 0.1, 0.2, 0.3, 0.4:
+  // 4*0.1, then + 3*0.1, then + 2*0.1
+  u3[0] = 0.2;
+  u3[1] = 0.5;
+  u3[2] = 0.9;
+  n_failed += aspa_durbin_modification_sorted_w(u3,3,work) != 0;
+  diff = GSL_MAX(fabs(u3[0]-0.4),GSL_MAX(fabs(u3[1]-0.7),fabs(u3[2]-0.9)));
+  n_failed += test_report("Durbin of {0.2,0.5,0.9} / {0.4,0.7,0.9}",diff,1e-15);
+  double bad[3] = {0.5,0.2,0.9};
+  n_failed += test_report("Durbin, empty and unsorted inputs accepted",
+			  (aspa_durbin_modification_sorted_w(u3,0,work) != ASPA_EINVAL)+
+			  (aspa_durbin_modification_sorted_w(bad,3,work) != ASPA_EINVAL),0.);
+  free(work);
+  gsl_vector_free(sorted);
+  gsl_vector_free(durbin);
+  gsl_vector_free(isi);
+  // the battery against the single functions on the rescaled times
+  const aspa_sta * units[N_UNITS] = {sta};
+  aspa_gof gof[N_UNITS];
+  n_failed += aspa_gof_battery(units,1,gof) != 0;
+  u = gsl_vector_alloc(gof[0].n);
+  for (size_t t_idx=0, i=0; t_idx<sta->n_trials; t_idx++)
+  {
+    gsl_vector * st = sta->st[t_idx];
+    for (size_t j=0; j+1 < st->size; j++, i++)
+      gsl_vector_set(u,i,gsl_vector_get(st,j)/gsl_vector_get(st,st->size-1));
+  }
+  diff = GSL_MAX(fabs(gof[0].D-aspa_Kolmogorov_D_w(u,false,"D",w)),
+		 fabs(gof[0].D_minus-aspa_Kolmogorov_D_w(u,false,"D-",w)));
+  n_failed += test_report("D, D- / Kolmogorov_D_w",diff,0.);
+  n_failed += test_report("W2 / AndersonDarling_W2_w",
+			  fabs(gof[0].W2-aspa_AndersonDarling_W2_w(u,false,w)),0.);
+  gsl_vector_free(u);
+  aspa_sta_free(sta);
+  // Poisson units, uniform p-values
+  for (size_t k=0; k<N_UNITS; k++)
+    units[k] = test_sim_sta(ASPA_TEST_SEED+k,300,15.,1.,2.);
+  n_failed += aspa_gof_battery(units,N_UNITS,gof) != 0;
+  double p[6][N_UNITS], n_outside = 0.;
+  for (size_t k=0; k<N_UNITS; k++)
+  {
+    p[0][k] = gof[k].p_D;
+    p[1][k] = gof[k].p_D_plus;
+    p[2][k] = gof[k].p_D_minus;
+    p[3][k] = gof[k].p_W2;
+    p[4][k] = gof[k].p_durbin_D;
+    p[5][k] = gof[k].p_durbin_W2;
+    for (size_t i=0; i<6; i++)
+      n_outside += !(p[i][k] >= 0. && p[i][k] <= 1.);
+    aspa_sta_free((aspa_sta *) units[k]);
+  }
+  n_failed += test_report("Poisson units, p-values outside [0,1]",n_outside,0.);
+  const char * name[6] = {"Poisson units, uniform p of D","Poisson units, uniform p of D+",
+			  "Poisson units, uniform p of D-","Poisson units, uniform p of W2",
+			  "Poisson units, uniform p of Durbin D",
+			  "Poisson units, uniform p of Durbin W2"};
+  for (size_t i=0; i<6 && n_outside == 0.; i++)
+    n_failed += test_report_p(name[i],test_uniform_p(p[i],N_UNITS),0.01);
+  printf("Checks failed: %d (0 expected).\n",(int) n_failed);
+  aspa_gof_workspace_free(w);
+  return n_failed == 0 ? 0 : 1;
+}
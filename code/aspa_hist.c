@@ -18,6 +18,7 @@ int read_args(int argc, char ** argv,
 
 int main(int argc, char ** argv)
 {
+  aspa_profile_init(argv[0]); // JSON report on the stderr if ASPA_PROFILE is set
   size_t use_log, n_bins, prob;
   int status = read_args(argc,argv,&use_log,&n_bins,&prob);
   if (status == -1) exit (EXIT_FAILURE);
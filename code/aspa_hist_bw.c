@@ -21,6 +21,7 @@ int read_args(int argc, char ** argv,
 
 int main(int argc, char ** argv)
 {
+  aspa_profile_init(argv[0]); // JSON report on the stderr if ASPA_PROFILE is set
   size_t use_log, from, to, best;
   int status = read_args(argc,argv,&use_log,&from,&to,&best);
   if (status == -1) exit (EXIT_FAILURE);
@@ -0,0 +1,723 @@
+/** @file aspa_lod.c
+ *  @brief Function definitions for level of detail (decimated) raster
+ *         and counting process plots
+ *
+ *  A plot made of N points drawn on a window W pixels wide cannot show
+ *  more than a few points per pixel column. For each column, keeping the
+ *  first and last points as well as the ones with the smallest and
+ *  largest ordinates is enough for a line, step or dot plot to look
+ *  identical, so at most 4 W points per trial are sent to gnuplot.
+ *  A "pyramid" of decimations with 2, 4, 8,... times more columns is
+ *  also available so that zooms can pick a level with just enough
+ *  details instead of going back to the full data.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+/** @brief Decimates a series of points for display on a given
+ *         number of pixel columns
+ *
+ *  The abscissae in `x` must be sorted in increasing order. The interval
+ *  [x_min,x_max] is split into `width` columns and, for each column, the
+ *  first, last, lowest and highest points are kept (in their original
+ *  order, without repetition). Points outside [x_min,x_max] are put
+ *  in the first or last column.
+ *
+ *  @param[in] x the abscissae
+ *  @param[in] y the ordinates
+ *  @param[in] n the number of points
+ *  @param[in] x_min the left end of the display
+ *  @param[in] x_max the right end of the display
+ *  @param[in] width the number of pixel columns
+ *  @param[out] x_out the abscissae of the kept points (at least min(n,4 width) elements)
+ *  @param[out] y_out the ordinates of the kept points
+ *  @returns the number of kept points
+*/
+size_t aspa_lod_decimate(const double * x, const double * y, size_t n,
+			 double x_min, double x_max, size_t width,
+			 double * x_out, double * y_out)
+{
+  if (n == 0)
+    return 0;
+  double scale = x_max > x_min ? width/(x_max-x_min) : 0.;
+  size_t n_out = 0;
+  size_t first = 0, last = 0, lowest = 0, highest = 0;
+  long column = -1;
+  for (size_t i=0; i<=n; i++)
+  {
+    long c = column;
+    if (i < n)
+    {
+      double pos = (x[i]-x_min)*scale;
+      c = pos < 0 ? 0 : (pos >= width ? (long) width-1 : (long) pos);
+    }
+    if (i == n || c != column)
+    { // flush the current column
+      if (column >= 0)
+      {
+	size_t keep[4] = {first, lowest, highest, last};
+	// sort the (at most 4) indices and drop the repetitions
+	for (size_t a=1; a<4; a++)
+	  for (size_t b=a; b>0 && keep[b-1] > keep[b]; b--)
+	  {
+	    size_t tmp = keep[b];
+	    keep[b] = keep[b-1];
+	    keep[b-1] = tmp;
+	  }
+	for (size_t a=0; a<4; a++)
+	{
+	  if (a > 0 && keep[a] == keep[a-1])
+	    continue;
+	  x_out[n_out] = x[keep[a]];
+	  y_out[n_out] = y[keep[a]];
+	  n_out++;
+	}
+      }
+      if (i == n)
+	break;
+      column = c;
+      first = last = lowest = highest = i;
+    }
+    else
+    {
+      last = i;
+      if (y[i] < y[lowest])
+	lowest = i;
+      if (y[i] > y[highest])
+	highest = i;
+    }
+  }
+  return n_out;
+}
+
+/** @brief Allocates an aspa_lod with empty levels and copies the
+ *         description of an aspa_sta, NULL if the allocation failed
+*/
+static aspa_lod * lod_alloc(const aspa_sta * sta, size_t n_series, size_t base_width, size_t n_levels)
+{
+  aspa_lod * res = malloc(sizeof(aspa_lod));
+  if (res == NULL)
+  {
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the level of detail plot failed.");
+    return NULL;
+  }
+  res->n_trials = sta->n_trials;
+  res->n_aggregated = sta->n_aggregated;
+  res->onset = sta->onset;
+  res->offset = sta->offset;
+  res->trial_duration = sta->trial_duration;
+  res->n_series = n_series;
+  res->base_width = base_width;
+  res->n_levels = n_levels;
+  res->n_points = calloc(n_levels,sizeof(size_t *));
+  res->x = calloc(n_levels,sizeof(double *));
+  res->y = calloc(n_levels,sizeof(double *));
+  bool failed = res->n_points == NULL || res->x == NULL || res->y == NULL;
+  for (size_t l=0; l<n_levels && !failed; l++)
+    failed = (res->n_points[l] = calloc(n_series+1,sizeof(size_t))) == NULL;
+  if (failed)
+  {
+    aspa_lod_free(res);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the level of detail plot failed.");
+    return NULL;
+  }
+  return res;
+}
+
+/** @brief Fills the levels of an aspa_lod from the full resolution
+ *         series
+ *
+ *  The series are given one after the other in x and y, series s
+ *  occupying elements offset[s] to offset[s+1]-1. If `keep_raw` is true,
+ *  the last level receives the full resolution series (x and y are then
+ *  owned by the aspa_lod), the other levels being decimated from the
+ *  next finer one. Otherwise all levels are decimated and x and y are
+ *  freed. Returns 0 or ASPA_ENOMEM, the aspa_lod being then freed
+ *  by the caller.
+*/
+static int lod_fill(aspa_lod * lod, double * x, double * y, size_t * offset, bool keep_raw)
+{
+  int status = 0;
+  size_t n_series = lod->n_series;
+  size_t finest = lod->n_levels-1;
+  double * fx = x;
+  double * fy = y;
+  size_t * foffset = offset;
+  for (size_t l=lod->n_levels; l-- > 0;)
+  {
+    if (keep_raw && l == finest)
+    {
+      lod->x[l] = x;
+      lod->y[l] = y;
+      memcpy(lod->n_points[l],offset,(n_series+1)*sizeof(size_t));
+      continue;
+    }
+    size_t width = lod->base_width << l;
+    size_t max_points = 0;
+    for (size_t s=0; s<n_series; s++)
+      max_points += GSL_MIN(foffset[s+1]-foffset[s],4*width);
+    lod->x[l] = malloc((max_points ? max_points : 1)*sizeof(double));
+    lod->y[l] = malloc((max_points ? max_points : 1)*sizeof(double));
+    if (lod->x[l] == NULL || lod->y[l] == NULL)
+    {
+      status = aspa_ctx_error(ASPA_ENOMEM,"Allocation of the level of detail plot failed.");
+      break;
+    }
+    size_t * loffset = lod->n_points[l];
+    loffset[0] = 0;
+    for (size_t s=0; s<n_series; s++)
+    {
+      size_t n = aspa_lod_decimate(fx+foffset[s],fy+foffset[s],foffset[s+1]-foffset[s],
+				   lod->x_min,lod->x_max,width,
+				   lod->x[l]+loffset[s],lod->y[l]+loffset[s]);
+      loffset[s+1] = loffset[s]+n;
+    }
+    fx = lod->x[l];
+    fy = lod->y[l];
+    foffset = loffset;
+  }
+  if (!keep_raw)
+  {
+    free(x);
+    free(y);
+  }
+  free(offset);
+  return status;
+}
+
+/** @brief Returns the number of levels used when it is not specified */
+static size_t lod_auto_levels(const size_t * offset, size_t n_series, size_t base_width)
+{
+  size_t longest = 0;
+  for (size_t s=0; s<n_series; s++)
+    longest = GSL_MAX(longest,offset[s+1]-offset[s]);
+  // add levels until a decimation could not reduce the longest series,
+  // the last level holding the full resolution data
+  size_t n_levels = 1;
+  while (4*(base_width << (n_levels-1)) < longest && n_levels < 30)
+    n_levels++;
+  return n_levels+1;
+}
+
+/** @brief Builds the (decimated) raster plot of an aspa_sta structure
+ *
+ *  Trial i is the series of points (spike time, i+1) on the within trial
+ *  time, displayed over [0,trial_duration]. Level l of the result is
+ *  decimated on base_width 2^l columns. If `n_levels` is 0, levels are
+ *  added until the data cannot be reduced any further and a last level
+ *  holding the full resolution data is appended.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] base_width the number of columns of the coarsest level
+ *  @param[in] n_levels the number of levels (0 for automatic)
+ *  @returns a pointer to an allocated aspa_lod, NULL if the allocation
+ *           failed
+*/
+aspa_lod * aspa_lod_raster(const aspa_sta * sta, size_t base_width, size_t n_levels)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  size_t n_series = sta->n_trials;
+  size_t n_total = aspa_sta_n_spikes(sta);
+  size_t * offset = malloc((n_series+1)*sizeof(size_t));
+  double * x = malloc((n_total ? n_total : 1)*sizeof(double));
+  double * y = malloc((n_total ? n_total : 1)*sizeof(double));
+  if (offset == NULL || x == NULL || y == NULL)
+  {
+    free(offset);
+    free(x);
+    free(y);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the level of detail plot failed.");
+    return NULL;
+  }
+  offset[0] = 0;
+  for (size_t t_idx=0; t_idx < n_series; t_idx++)
+  {
+    gsl_vector * st = aspa_sta_get_st(sta,t_idx);
+    for (size_t i=0; i < st->size; i++)
+    {
+      x[offset[t_idx]+i] = gsl_vector_get(st,i);
+      y[offset[t_idx]+i] = t_idx+1;
+    }
+    offset[t_idx+1] = offset[t_idx]+st->size;
+  }
+  bool keep_raw = n_levels == 0;
+  if (keep_raw)
+    n_levels = lod_auto_levels(offset,n_series,base_width);
+  aspa_lod * res = lod_alloc(sta,n_series,base_width,n_levels);
+  if (res == NULL)
+  {
+    free(offset);
+    free(x);
+    free(y);
+    return NULL;
+  }
+  res->cp = false;
+  res->flat = false;
+  res->normalized = false;
+  res->x_min = 0.;
+  res->x_max = sta->trial_duration;
+  res->y_max = sta->n_trials+1;
+  if (lod_fill(res,x,y,offset,keep_raw) != 0)
+  {
+    aspa_lod_free(res);
+    return NULL;
+  }
+  return res;
+}
+
+/** @brief Builds the (decimated) observed counting process plot of an
+ *         aspa_sta structure
+ *
+ *  The series are the ones of `aspa_cp_plot_g`: a single series on the
+ *  actual time if `flat` or `normalized` is true (the count increasing
+ *  by 1/n_aggregated at each spike), one series per trial on the within
+ *  trial time otherwise. See `aspa_lod_raster` for the levels.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] flat boolean controlling if actual or within trial
+ *             time is used
+ *  @param[in] normalized boolean controlling if the mean OCP is
+ *             is displayed
+ *  @param[in] base_width the number of columns of the coarsest level
+ *  @param[in] n_levels the number of levels (0 for automatic)
+ *  @returns a pointer to an allocated aspa_lod, NULL if the allocation
+ *           failed
+*/
+aspa_lod * aspa_lod_cp(const aspa_sta * sta, bool flat, bool normalized,
+		       size_t base_width, size_t n_levels)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  bool single = normalized == true || flat == true;
+  size_t n_series = single ? 1 : sta->n_trials;
+  size_t n_total = aspa_sta_n_spikes(sta);
+  size_t * offset = malloc((n_series+1)*sizeof(size_t));
+  double * x = malloc((n_total ? n_total : 1)*sizeof(double));
+  double * y = malloc((n_total ? n_total : 1)*sizeof(double));
+  if (offset == NULL || x == NULL || y == NULL)
+  {
+    free(offset);
+    free(x);
+    free(y);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the level of detail plot failed.");
+    return NULL;
+  }
+  offset[0] = 0;
+  double step = 1.0/sta->n_aggregated;
+  double count = step;
+  size_t p_idx = 0;
+  for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
+  {
+    gsl_vector * st = aspa_sta_get_st(sta,t_idx);
+    double start_time = single ? aspa_sta_get_st_start(sta,t_idx) : 0.;
+    if (!single)
+      count = 1.;
+    for (size_t i=0; i < st->size; i++)
+    {
+      x[p_idx] = gsl_vector_get(st,i)+start_time;
+      y[p_idx] = count;
+      count += single ? step : 1.;
+      p_idx++;
+    }
+    if (!single)
+      offset[t_idx+1] = p_idx;
+  }
+  if (single)
+    offset[1] = p_idx;
+  bool keep_raw = n_levels == 0;
+  if (keep_raw)
+    n_levels = lod_auto_levels(offset,n_series,base_width);
+  aspa_lod * res = lod_alloc(sta,n_series,base_width,n_levels);
+  if (res == NULL)
+  {
+    free(offset);
+    free(x);
+    free(y);
+    return NULL;
+  }
+  res->cp = true;
+  res->flat = flat;
+  res->normalized = normalized;
+  if (single && p_idx > 0)
+  {
+    res->x_min = GSL_MIN_DBL(0.,x[0]);
+    res->x_max = GSL_MAX_DBL(sta->trial_duration,x[p_idx-1]);
+  }
+  else
+  {
+    res->x_min = 0.;
+    res->x_max = sta->trial_duration;
+  }
+  res->y_max = aspa_sta_n_spikes_max(sta);
+  if (normalized == true)
+    res->y_max /= sta->n_aggregated;
+  if (lod_fill(res,x,y,offset,keep_raw) != 0)
+  {
+    aspa_lod_free(res);
+    return NULL;
+  }
+  return res;
+}
+
+/** @brief Frees an aspa_lod
+ *
+ *  @param[in/out] lod a pointer to an allocated aspa_lod structure
+ *  @returns 0 if everything goes fine
+*/
+int aspa_lod_free(aspa_lod * lod)
+{
+  for (size_t l=0; l<lod->n_levels; l++)
+  {
+    if (lod->n_points != NULL)
+      free(lod->n_points[l]);
+    if (lod->x != NULL)
+      free(lod->x[l]);
+    if (lod->y != NULL)
+      free(lod->y[l]);
+  }
+  free(lod->n_points);
+  free(lod->x);
+  free(lod->y);
+  free(lod);
+  return 0;
+}
+
+/** Index of the first of the n sorted values of x >= from in first,
+    of the first one > to in end */
+static void lod_range(const double * x, size_t n, double from, double to,
+		      size_t * first, size_t * end)
+{
+  size_t lo = 0, hi = n;
+  while (lo < hi)
+  {
+    size_t mid = (lo+hi)/2;
+    if (x[mid] < from) lo = mid+1; else hi = mid;
+  }
+  *first = lo;
+  hi = n;
+  while (lo < hi)
+  {
+    size_t mid = (lo+hi)/2;
+    if (x[mid] <= to) lo = mid+1; else hi = mid;
+  }
+  *end = lo;
+}
+
+/** @brief Returns the points of a series to display over [from,to]
+ *         on `width` pixel columns
+ *
+ *  The coarsest level whose columns are not wider than the requested
+ *  pixels is used (the finest one if none is) and its points within
+ *  [from,to] are decimated again on the requested columns. The last
+ *  point before `from` and the first one after `to` are added so that
+ *  lines and steps reach the edges of the display. If `from >= to`,
+ *  the whole series range is used.
+ *
+ *  @param[in] lod a pointer to an aspa_lod
+ *  @param[in] s_idx the series index
+ *  @param[in] from the left end of the display
+ *  @param[in] to the right end of the display
+ *  @param[in] width the number of pixel columns
+ *  @param[out] x the abscissae (at least 4 width + 2 elements)
+ *  @param[out] y the ordinates (at least 4 width + 2 elements)
+ *  @returns the number of points
+*/
+size_t aspa_lod_query(const aspa_lod * lod, size_t s_idx, double from, double to,
+		      size_t width, double * x, double * y)
+{
+  assert (s_idx < lod->n_series && width > 0);
+  if (from >= to)
+  {
+    from = lod->x_min;
+    to = lod->x_max;
+  }
+  double pixel = (to-from)/width;
+  size_t l = 0;
+  while (l+1 < lod->n_levels &&
+	 (lod->x_max-lod->x_min)/(lod->base_width << l) > pixel)
+    l++;
+  const double * lx = lod->x[l]+lod->n_points[l][s_idx];
+  const double * ly = lod->y[l]+lod->n_points[l][s_idx];
+  size_t n = lod->n_points[l][s_idx+1]-lod->n_points[l][s_idx];
+  size_t first, end;
+  lod_range(lx,n,from,to,&first,&end);
+  size_t n_out = 0;
+  if (first > 0)
+  {
+    x[0] = lx[first-1];
+    y[0] = ly[first-1];
+    n_out++;
+  }
+  n_out += aspa_lod_decimate(lx+first,ly+first,end-first,from,to,width,x+n_out,y+n_out);
+  if (end < n)
+  {
+    x[n_out] = lx[end];
+    y[n_out] = ly[end];
+    n_out++;
+  }
+  return n_out;
+}
+
+/** @brief Writes the stimulus box and the decimated series of an
+ *         aspa_lod in a gnuplot friendly format
+ *
+ *  The layout is the one of `aspa_raster_plot_g` and `aspa_cp_plot_g`.
+ *  If `width` is 0, the points of the finest level within [from,to]
+ *  are written, all of them if `from >= to`.
+ *
+ *  @param[in/out] STREAM an open file
+ *  @param[in] lod a pointer to an aspa_lod
+ *  @param[in] from the left end of the display
+ *  @param[in] to the right end of the display
+ *  @param[in] width the number of pixel columns
+ *  @returns 0 if everything goes fine, a negative error code otherwise
+*/
+int aspa_lod_fprintf(FILE * STREAM, const aspa_lod * lod, double from, double to, size_t width)
+{
+  bool single = lod->cp && (lod->normalized == true || lod->flat == true);
+  if (lod->onset < lod->offset && !(lod->cp && lod->flat))
+  { // The stimulus timing is specified
+    fprintf(STREAM,"%g %g\n", lod->onset, 0.0);
+    fprintf(STREAM,"%g %g\n", lod->onset, lod->y_max);
+    fprintf(STREAM,"%g %g\n", lod->offset, lod->y_max);
+    fprintf(STREAM,"%g %g\n", lod->offset, 0.0);
+    fprintf(STREAM,"\n\n");
+  }
+  size_t finest = lod->n_levels-1;
+  size_t n_max = 4*width+2;
+  if (width == 0)
+  {
+    for (size_t s=0; s<lod->n_series; s++)
+      n_max = GSL_MAX(n_max,lod->n_points[finest][s+1]-lod->n_points[finest][s]);
+  }
+  double * x = aspa_ctx_malloc(2*n_max*sizeof(double));
+  if (x == NULL)
+    return ASPA_ENOMEM;
+  double * y = x+n_max;
+  for (size_t s=0; s<lod->n_series; s++)
+  {
+    size_t n;
+    if (width == 0)
+    {
+      const double * lx = lod->x[finest]+lod->n_points[finest][s];
+      const double * ly = lod->y[finest]+lod->n_points[finest][s];
+      size_t first = 0, end = lod->n_points[finest][s+1]-lod->n_points[finest][s];
+      if (from < to)
+	lod_range(lx,end,from,to,&first,&end);
+      n = end-first;
+      memcpy(x,lx+first,n*sizeof(double));
+      memcpy(y,ly+first,n*sizeof(double));
+    }
+    else
+    {
+      n = aspa_lod_query(lod,s,from,to,width,x,y);
+    }
+    for (size_t i=0; i<n; i++)
+      fprintf(STREAM,"%g %g\n", x[i], y[i]);
+    if (!single)
+      fprintf(STREAM,"\n\n");
+  }
+  aspa_ctx_free(x);
+  if (ferror(STREAM))
+    return aspa_ctx_error(ASPA_EIO,"Writing the plot failed.");
+  return 0;
+}
+
+/** @brief Writes the decimated series of an aspa_lod to gnuplot
+ *
+ *  The series are written one after the other in binary, separated
+ *  by a NaN pair so that lines and steps are broken between trials.
+ *  The plot element specification ends the plot command, the data of
+ *  the `n_box` points of a preceding plot element (if any) are written
+ *  before the series. Returns 0 or ASPA_ENOMEM.
+*/
+static int lod_plot_series(FILE * gp, const aspa_lod * lod, double from, double to,
+			   size_t width, const char * with,
+			   const double * box_x, const double * box_y, size_t n_box)
+{
+  size_t n_max = 4*width+2;
+  double * x = aspa_ctx_malloc(2*n_max*sizeof(double));
+  if (x == NULL)
+    return ASPA_ENOMEM;
+  double * y = x+n_max;
+  size_t n_total = lod->n_series-1;
+  for (size_t s=0; s<lod->n_series; s++)
+    n_total += aspa_lod_query(lod,s,from,to,width,x,y);
+  aspa_gp_binary_spec(gp,n_total);
+  fprintf(gp," using 1:2 with %s lc 'black'\n", with);
+  if (n_box > 0)
+    aspa_gp_binary_write(gp,box_x,box_y,n_box);
+  double nan = GSL_NAN;
+  for (size_t s=0; s<lod->n_series; s++)
+  {
+    if (s > 0)
+      aspa_gp_binary_write(gp,&nan,&nan,1);
+    size_t n = aspa_lod_query(lod,s,from,to,width,x,y);
+    aspa_gp_binary_write(gp,x,y,n);
+  }
+  aspa_ctx_free(x);
+  return 0;
+}
+
+/** @brief Generates a (decimated) raster or counting process plot
+ *         from an aspa_lod
+ *
+ *  A new window of the gnuplot session pops up. The plot is the one
+ *  of `aspa_raster_plot_i` or `aspa_cp_plot_i` restricted to [from,to]
+ *  (the whole range if from >= to) with at most 4 width + 2 points per
+ *  trial.
+ *
+ *  @param[in] lod a pointer to an aspa_lod
+ *  @param[in] from the left end of the display
+ *  @param[in] to the right end of the display
+ *  @param[in] width the number of pixel columns
+ *  @returns 0 if everything goes fine, a negative error code otherwise
+*/
+int aspa_lod_plot_i(const aspa_lod * lod, double from, double to, size_t width)
+{
+  FILE * gp = aspa_gp_window();
+  if (!gp)
+    return ASPA_FAILURE;
+  if (from >= to)
+  {
+    from = lod->cp && lod->flat ? lod->x_min : 0.;
+    to = lod->cp && lod->flat ? lod->x_max : lod->trial_duration;
+  }
+  bool box = lod->onset < lod->offset && !(lod->cp && lod->flat);
+  fprintf(gp,"set xlabel 'Time (s)'\n");
+  if (lod->cp == false)
+  {
+    fprintf(gp,"set ylabel 'Trial'\n");
+  }
+  else if (lod->flat == true)
+  {
+    fprintf(gp,"set title 'Observed counting process'\n");
+    fprintf(gp,"set ylabel 'Events count'\n");
+  }
+  else if (lod->normalized == true)
+  {
+    fprintf(gp,"set title 'Observed mean counting process'\n");
+    fprintf(gp,"set ylabel 'Mean events count'\n");
+  }
+  else
+  {
+    fprintf(gp,"set title 'Observed counting processes'\n");
+    fprintf(gp,"set ylabel 'Events count'\n");
+  }
+  if (lod->cp && lod->flat)
+    fprintf(gp," plot [%g:%g] ", from, to);
+  else
+    fprintf(gp," plot [%g:%g] [0:%g] ", from, to, lod->y_max);
+  // The stimulus box, if the stimulus timing is specified
+  double box_x[4] = {lod->onset,lod->onset,lod->offset,lod->offset};
+  double box_y[4] = {0.0,lod->y_max,lod->y_max,0.0};
+  if (box)
+  {
+    aspa_gp_binary_spec(gp,4);
+    fprintf(gp," using 1:2 with filledcurve closed lc 'grey', ");
+  }
+  int status = lod_plot_series(gp,lod,from,to,width,lod->cp ? "steps" : "dots",
+			       box_x,box_y,box ? 4 : 0);
+  if (status != 0)
+    fprintf(gp,"\n"); // the plot command is left without data
+  int gp_status = aspa_gp_end(gp);
+  return status != 0 ? status : gp_status;
+}
+
+/** @brief Writes in binary to stream the content of an aspa_lod
+ *
+ *  The description (number of trials and of aggregated trials, onset,
+ *  offset, trial duration, kind, ranges, number of series, base width
+ *  and number of levels) is written first, followed for each level by
+ *  the series offsets (size_t) and the abscissae and ordinates (double).
+ *
+ *  @param[in/out] stream a pointer to an opened file
+ *  @param[in] lod pointer to the aspa_lod to be written
+ *  @returns 0 if successful, ASPA_EIO otherwise
+*/
+int aspa_lod_fwrite(FILE * stream, const aspa_lod * lod)
+{
+  size_t kind[3] = {lod->cp, lod->flat, lod->normalized};
+  double range[3] = {lod->x_min, lod->x_max, lod->y_max};
+  size_t ok = 0;
+  ok += fwrite(&(lod->n_trials),sizeof(size_t),1,stream);
+  ok += fwrite(&(lod->n_aggregated),sizeof(size_t),1,stream);
+  ok += fwrite(&(lod->onset),sizeof(double),1,stream);
+  ok += fwrite(&(lod->offset),sizeof(double),1,stream);
+  ok += fwrite(&(lod->trial_duration),sizeof(double),1,stream);
+  ok += fwrite(kind,sizeof(size_t),3,stream);
+  ok += fwrite(range,sizeof(double),3,stream);
+  ok += fwrite(&(lod->n_series),sizeof(size_t),1,stream);
+  ok += fwrite(&(lod->base_width),sizeof(size_t),1,stream);
+  ok += fwrite(&(lod->n_levels),sizeof(size_t),1,stream);
+  if (ok != 14)
+    return aspa_ctx_error(ASPA_EIO,"Writing the level of detail plot failed.");
+  for (size_t l=0; l<lod->n_levels; l++)
+  {
+    size_t n = lod->n_points[l][lod->n_series];
+    if (fwrite(lod->n_points[l],sizeof(size_t),lod->n_series+1,stream) != lod->n_series+1 ||
+	fwrite(lod->x[l],sizeof(double),n,stream) != n ||
+	fwrite(lod->y[l],sizeof(double),n,stream) != n)
+      return aspa_ctx_error(ASPA_EIO,"Writing the level of detail plot failed.");
+  }
+  return 0;
+}
+
+/** @brief Reads an aspa_lod written by `aspa_lod_fwrite`
+ *
+ *  @param[in/out] STREAM a pointer to an opened file
+ *  @returns a pointer to an allocated aspa_lod or NULL if the
+ *           stream could not be read
+*/
+aspa_lod * aspa_lod_fread(FILE * STREAM)
+{
+  aspa_sta desc;
+  size_t kind[3];
+  double range[3];
+  size_t n_series, base_width, n_levels;
+  size_t ok = 0;
+  ok += fread(&(desc.n_trials),sizeof(size_t),1,STREAM);
+  ok += fread(&(desc.n_aggregated),sizeof(size_t),1,STREAM);
+  ok += fread(&(desc.onset),sizeof(double),1,STREAM);
+  ok += fread(&(desc.offset),sizeof(double),1,STREAM);
+  ok += fread(&(desc.trial_duration),sizeof(double),1,STREAM);
+  ok += fread(kind,sizeof(size_t),3,STREAM);
+  ok += fread(range,sizeof(double),3,STREAM);
+  ok += fread(&n_series,sizeof(size_t),1,STREAM);
+  ok += fread(&base_width,sizeof(size_t),1,STREAM);
+  ok += fread(&n_levels,sizeof(size_t),1,STREAM);
+  if (ok != 14 || n_levels == 0 || n_levels > 64)
+  {
+    aspa_ctx_error(ASPA_EFORMAT,"Badly formatted level of detail plot header.");
+    return NULL;
+  }
+  aspa_lod * res = lod_alloc(&desc,n_series,base_width,n_levels);
+  if (res == NULL)
+    return NULL;
+  res->cp = kind[0];
+  res->flat = kind[1];
+  res->normalized = kind[2];
+  res->x_min = range[0];
+  res->x_max = range[1];
+  res->y_max = range[2];
+  for (size_t l=0; l<n_levels; l++)
+  {
+    bool failed = fread(res->n_points[l],sizeof(size_t),n_series+1,STREAM) != n_series+1;
+    size_t n = failed ? 0 : res->n_points[l][n_series];
+    failed = failed ||
+      (res->x[l] = malloc((n ? n : 1)*sizeof(double))) == NULL ||
+      (res->y[l] = malloc((n ? n : 1)*sizeof(double))) == NULL ||
+      fread(res->x[l],sizeof(double),n,STREAM) != n ||
+      fread(res->y[l],sizeof(double),n,STREAM) != n;
+    if (failed)
+    {
+      aspa_lod_free(res);
+      aspa_ctx_error(ASPA_EFORMAT,"Badly formatted level of detail plot (level %zu).",l);
+      return NULL;
+    }
+  }
+  return res;
+}
@@ -17,6 +17,7 @@ void print_usage();
 
 int main(int argc, char ** argv)
 {
+  aspa_profile_init(argv[0]); // JSON report on the stderr if ASPA_PROFILE is set
   size_t in_bin,out_bin;
   int status = read_args(argc,argv,&in_bin,&out_bin);
   if (status == -1) exit (EXIT_FAILURE);
@@ -25,13 +26,16 @@ int main(int argc, char ** argv)
       sta = aspa_sta_fscanf(stdin);
   else
     sta = aspa_sta_fread(stdin);
+  if (sta == NULL) exit (EXIT_FAILURE);
   aspa_sta * asta = aspa_sta_aggregate(sta);
   aspa_sta_free(sta);
+  if (asta == NULL) exit (EXIT_FAILURE);
   if (out_bin == 0)
-    aspa_sta_fprintf(stdout,asta,false);
+    status = aspa_sta_fprintf(stdout,asta,false);
   else
-    aspa_sta_fwrite(stdout,asta,false);
+    status = aspa_sta_fwrite(stdout,asta,false);
   aspa_sta_free(asta);
+  if (status != 0) exit (EXIT_FAILURE);
   return 0;
 }
 
@@ -2,6 +2,13 @@
  *  @brief User program for printing five number summaries together
  *         with a few extra-statistics for spike trains
  *
+ *  With --n_boot, bootstrap confidence intervals of the statistics are
+ *  added and a permutation p-value of the lag 1 Spearman rank
+ *  correlation replaces its normal approximation interval (see
+ *  aspa_resample.c). With --renewal, the exponential,
+ *  gamma, inverse Gaussian, lognormal and Weibull models are fitted to
+ *  the intervals (see aspa_renewal.c).
+ *
  *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
 */
 #include "aspa.h"
@@ -10,21 +17,30 @@
 #include <getopt.h>
 
 int read_args(int argc, char ** argv,
-	      size_t * in_bin);
+	      size_t * in_bin,
+	      size_t * n_boot,
+	      bool * by_trial,
+	      bool * renewal,
+	      unsigned long * seed);
 
 void print_usage();
 
 int main(int argc, char ** argv)
 {
-  size_t in_bin;
-  int status = read_args(argc,argv,&in_bin);
+  aspa_profile_init(argv[0]); // JSON report on the stderr if ASPA_PROFILE is set
+  size_t in_bin, n_boot;
+  bool by_trial, renewal;
+  unsigned long seed;
+  int status = read_args(argc,argv,&in_bin,&n_boot,&by_trial,&renewal,&seed);
   if (status == -1) exit (EXIT_FAILURE);
   aspa_sta * sta;
   if (in_bin == 0)
       sta = aspa_sta_fscanf(stdin);
   else
     sta = aspa_sta_fread(stdin);
+  if (sta == NULL) exit (EXIT_FAILURE);
   gsl_vector * isi = aspa_sta_isi(sta);
+  if (isi == NULL) exit (EXIT_FAILURE);
   aspa_fns isi_fns = aspa_fns_get(isi);
   if (sta->n_aggregated == 1)
     fprintf(stdout,"Data from %d trials.\n", (int) sta->n_trials);
@@ -33,9 +49,35 @@ int main(int argc, char ** argv)
   fprintf(stdout,"The mean rate is: %4g Hz.\n", aspa_sta_rate(sta));
   fprintf(stdout,"The inter spike interval statistics are:\n"),
   aspa_fns_fprintf(stdout,&isi_fns);
+  if (n_boot > 0)
+  {
+    aspa_fns_ci ci;
+    if (by_trial)
+      status = aspa_sta_fns_bootstrap(sta,n_boot,0.95,seed,&ci);
+    else
+      status = aspa_fns_bootstrap(isi,n_boot,0.95,seed,&ci);
+    if (status != 0) exit (EXIT_FAILURE);
+    aspa_fns_ci_fprintf(stdout,&ci);
+  }
   double src = aspa_lagged_spearman(isi, 1);
-  fprintf(stdout,"A 95%% confidence interval for the lag 1 Spearman rank correlation is: [%g,%g].\n",
-	 src-1.96*0.6325/sqrt(isi->size-1),src+1.96*0.6325/sqrt(isi->size-1));
+  if (n_boot > 0)
+  { // the permutation test replaces the normal approximation
+    double p_value = aspa_lagged_spearman_test(isi,1,n_boot,seed);
+    if (isnan(p_value)) exit (EXIT_FAILURE);
+    fprintf(stdout,"The lag 1 Spearman rank correlation is: %g.\n",src);
+    fprintf(stdout,"Its permutation p-value (%zu permutations) is: %g.\n",n_boot,p_value);
+  }
+  else
+    fprintf(stdout,"A 95%% confidence interval for the lag 1 Spearman rank correlation is: [%g,%g]\n"
+	    "(normal approximation under independence, use --n_boot for a permutation test).\n",
+	    src-1.96*0.6325/sqrt(isi->size-1),src+1.96*0.6325/sqrt(isi->size-1));
+  if (renewal)
+  {
+    aspa_renewal_fit fit;
+    if (aspa_renewal_fit_isi(isi,&fit) != 0) exit (EXIT_FAILURE);
+    fprintf(stdout,"The renewal model fits are:\n");
+    aspa_renewal_fit_fprintf(stdout,&fit,1);
+  }
   gsl_vector_free(isi);
   aspa_sta_free(sta);
   return 0;
@@ -46,25 +88,51 @@ int main(int argc, char ** argv)
  *  @param[in] argc argument of main
  *  @param[in] argv argument of main
  *  @param[out] in_bin input format, O for "txt" 1 for "bin" (default 0)
+ *  @param[out] n_boot number of bootstrap resamples and of permutations
+ *              (default 0, none)
+ *  @param[out] by_trial resample the trials instead of the ISI
+ *              (default false)
+ *  @param[out] renewal fit the renewal models (default false)
+ *  @param[out] seed seed of the random numbers (default 20061001)
  *  @return 0 when everything goes fine
 */
 int read_args(int argc, char ** argv,
-	      size_t * in_bin)
+	      size_t * in_bin,
+	      size_t * n_boot,
+	      bool * by_trial,
+	      bool * renewal,
+	      unsigned long * seed)
 {
   // Define default values
   *in_bin=0;
+  *n_boot=0;
+  *by_trial=false;
+  *renewal=false;
+  *seed=20061001;
   {int opt;
     static struct option long_options[] = {
       {"in_bin",no_argument,NULL,'i'},
+      {"n_boot",required_argument,NULL,'n'},
+      {"by_trial",no_argument,NULL,'t'},
+      {"renewal",no_argument,NULL,'r'},
+      {"seed",required_argument,NULL,'s'},
       {"help",no_argument,NULL,'h'},
       {NULL,0,NULL,0}
     };
     int long_index =0;
-    while ((opt = getopt_long(argc,argv,"hi",long_options,\
+    while ((opt = getopt_long(argc,argv,"hin:trs:",long_options,\
 			      &long_index)) != -1) {
       switch(opt) {
       case 'i': *in_bin=1;
 	break;
+      case 'n': *n_boot=strtoul(optarg,NULL,10);
+	break;
+      case 't': *by_trial=true;
+	break;
+      case 'r': *renewal=true;
+	break;
+      case 's': *seed=strtoul(optarg,NULL,10);
+	break;
       case 'h': print_usage();
 	return -1;
       default : print_usage();
@@ -82,6 +150,11 @@ void print_usage()
 {
   printf("Usage: \n"
 	 "  --in_bin: specify binary data input\n"
+	 "  --n_boot <positive integer>: number of bootstrap resamples and\n"
+	 "    of permutations (default 0, no resampling)\n"
+	 "  --by_trial: resample the trials instead of the ISI\n"
+	 "  --renewal: fit renewal models to the ISI\n"
+	 "  --seed <positive integer>: seed of the random numbers (default 20061001)\n"
 	 "\n"
 	 "Returns five number summary and additional stats.\n");
 }
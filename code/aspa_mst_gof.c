@@ -0,0 +1,153 @@
+/** @file aspa_mst_gof.c
+ *  @brief User program for testing multi trials spike trains against
+ *         a homogeneous Poisson process
+ *
+ *  Each file given on the command line holds the spike trains of a
+ *  unit (the stdin is read if no file is given); the goodness of fit
+ *  battery (see aspa_gof.c) is run on all the units and a table with
+ *  one row per unit is written to the stdout. With --psth, the spike
+ *  times of each unit are first rescaled by its peri-stimulus time
+ *  histogram (see aspa_rescale.c): the units are then tested against
+ *  an inhomogeneous Poisson process.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa.h"
+
+#include <getopt.h>
+
+int read_args(int argc, char ** argv,
+	      size_t * in_bin,
+	      double * psth);
+
+void print_usage();
+
+aspa_sta * read_sta(FILE * fp, size_t in_bin);
+
+int main(int argc, char ** argv)
+{
+  aspa_profile_init(argv[0]); // JSON report on the stderr if ASPA_PROFILE is set
+  size_t in_bin;
+  double psth;
+  int status = read_args(argc,argv,&in_bin,&psth);
+  if (status == -1) exit (EXIT_FAILURE);
+  size_t n_units = optind < argc ? (size_t) (argc-optind) : 1;
+  aspa_sta ** sta = calloc(n_units,sizeof(aspa_sta *));
+  aspa_gof * gof = malloc(n_units*sizeof(aspa_gof));
+  if (sta == NULL || gof == NULL) exit (EXIT_FAILURE);
+  if (optind == argc)
+    sta[0] = read_sta(stdin,in_bin);
+  for (int i=optind; i<argc; i++)
+  {
+    FILE * fp = fopen(argv[i],in_bin == 0 ? "r" : "rb");
+    if (fp == NULL)
+    {
+      fprintf(stderr,"Can't open file %s\n",argv[i]);
+      exit (EXIT_FAILURE);
+    }
+    sta[i-optind] = read_sta(fp,in_bin);
+    fclose(fp);
+    if (sta[i-optind] == NULL)
+    {
+      fprintf(stderr,"Can't read the spike trains of file %s\n",argv[i]);
+      exit (EXIT_FAILURE);
+    }
+  }
+  if (sta[0] == NULL) exit (EXIT_FAILURE);
+  for (size_t u_idx=0; u_idx < n_units && psth > 0.; u_idx++)
+  {
+    aspa_intensity * intensity = aspa_intensity_psth(sta[u_idx],psth);
+    if (intensity == NULL) exit (EXIT_FAILURE);
+    aspa_sta * rescaled = aspa_time_rescale(sta[u_idx],intensity);
+    aspa_intensity_free(intensity);
+    if (rescaled == NULL) exit (EXIT_FAILURE);
+    aspa_sta_free(sta[u_idx]);
+    sta[u_idx] = rescaled;
+  }
+  status = aspa_gof_battery((const aspa_sta * const *) sta,n_units,gof);
+  if (status == 0)
+    status = aspa_gof_fprintf(stdout,gof,n_units);
+  for (size_t u_idx=0; u_idx < n_units; u_idx++)
+    aspa_sta_free(sta[u_idx]);
+  free(sta);
+  free(gof);
+  if (status != 0) exit (EXIT_FAILURE);
+  return 0;
+}
+
+/** @brief Reads an aspa_sta in text or binary format
+ *
+ *  @param[in] fp a pointer to an open file
+ *  @param[in] in_bin input format, O for "txt" 1 for "bin"
+ *  @return a pointer to the aspa_sta, NULL if the reading failed
+*/
+aspa_sta * read_sta(FILE * fp, size_t in_bin)
+{
+  if (in_bin == 0)
+    return aspa_sta_fscanf(fp);
+  return aspa_sta_fread(fp);
+}
+
+/** @brief Reads command line arguments.
+ *
+ *  @param[in] argc argument of main
+ *  @param[in] argv argument of main
+ *  @param[out] in_bin input format, O for "txt" 1 for "bin" (default 0)
+ *  @param[out] psth bin width of the PSTH used for the time rescaling,
+ *              0 for no rescaling (default 0)
+ *  @return 0 when everything goes fine
+*/
+int read_args(int argc, char ** argv,
+	      size_t * in_bin,
+	      double * psth)
+{
+  // Define default values
+  *in_bin=0;
+  *psth=0.;
+  {int opt;
+    static struct option long_options[] = {
+      {"in_bin",no_argument,NULL,'i'},
+      {"psth",required_argument,NULL,'p'},
+      {"help",no_argument,NULL,'h'},
+      {NULL,0,NULL,0}
+    };
+    int long_index =0;
+    while ((opt = getopt_long(argc,argv,"hip:",long_options,\
+			      &long_index)) != -1) {
+      switch(opt) {
+      case 'i': *in_bin=1;
+	break;
+      case 'p': *psth=atof(optarg);
+	if (*psth <= 0.)
+	{
+	  fprintf(stderr,"The PSTH bin width should be > 0.\n");
+	  return -1;
+	}
+	break;
+      case 'h': print_usage();
+	return -1;
+      default : print_usage();
+	return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+/** @brief Prints usage to command line.
+ *
+*/
+void print_usage()
+{
+  printf("Usage: aspa_mst_gof [--in_bin] [--psth=real] [file ...]\n"
+	 "  --in_bin: specify binary data input\n"
+	 "  --psth <positive real>: rescale the spike times by the PSTH\n"
+	 "    of the unit with that bin width (s) before the tests\n"
+	 "\n"
+	 "Reads the spike trains of one unit per file (from the stdin if\n"
+	 "no file is given) and tests each unit against a homogeneous\n"
+	 "Poisson process: Kolmogorov's D, D+, D-, the Anderson-Darling W2\n"
+	 "and the same D and W2 after Durbin's modification, with their\n"
+	 "p-values. Prints one row per unit, numbered from 0 in the order\n"
+	 "of the files.\n");
+}
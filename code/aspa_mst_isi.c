@@ -12,6 +12,7 @@ int read_args(int argc, char ** argv,
 
 int main(int argc, char ** argv)
 {
+  aspa_profile_init(argv[0]); // JSON report on the stderr if ASPA_PROFILE is set
   size_t in_bin;
   int status = read_args(argc,argv,&in_bin);
   if (status == -1) exit (EXIT_FAILURE);
@@ -20,8 +21,10 @@ int main(int argc, char ** argv)
       sta = aspa_sta_fscanf(stdin);
   else
     sta = aspa_sta_fread(stdin);
+  if (sta == NULL) exit (EXIT_FAILURE);
 
   gsl_vector * isi = aspa_sta_isi(sta);
+  if (isi == NULL) exit (EXIT_FAILURE);
   fprintf(stdout,"%d\n",(int) isi->size);
   for (size_t i=0; i<isi->size; i++)
     fprintf(stdout,"%g\n",gsl_vector_get(isi,i));
@@ -7,107 +7,352 @@
 
 #include <getopt.h>
 
-#define NUM_WHAT 5
+#define NUM_WHAT 6
 // Define allowed values for what
 char * good_what[] = {"raster",
 		      "cp_rt",
 		      "cp_wt",
 		      "cp_norm",
-		      "lrank"};
+		      "lrank",
+		      "fano"};
+
+// Counting windows of the 'fano' plot, from VT_FIRST to half the
+// counted range (the trial or [from,to]) in geometric progression
+#define VT_N_WINDOWS 32
+#define VT_FIRST 0.001
 
 int read_args(int argc, char ** argv,
 	      size_t * in_bin,
 	      char * what,
 	      size_t * text,
-	      size_t * lag);
+	      size_t * lag,
+	      size_t * width,
+	      double * from,
+	      double * to,
+	      char ** lod_file,
+	      char ** png_file,
+	      char ** svg_file,
+	      size_t * image_width,
+	      size_t * image_height);
 
 void print_usage();
 
+aspa_lod * get_lod(const char * what, size_t in_bin, const char * lod_file);
+
+aspa_image * get_image(const aspa_sta * sta, const char * what, size_t lag,
+		       size_t image_width, size_t image_height);
+
+int write_image(const char * file_name, const aspa_image * img, bool png);
+
+aspa_variance_time * get_variance_time(const aspa_sta * sta, double from, double to);
+
 int main(int argc, char ** argv)
 {
-  size_t in_bin, text, lag;
+  aspa_profile_init(argv[0]); // JSON report on the stderr if ASPA_PROFILE is set
+  size_t in_bin, text, lag, width, image_width, image_height;
+  double from, to;
+  char * lod_file, * png_file, * svg_file;
   char what[8];
-  int status = read_args(argc,argv,&in_bin,what,&text,&lag);
+  int status = read_args(argc,argv,&in_bin,what,&text,&lag,&width,&from,&to,&lod_file,
+			 &png_file,&svg_file,&image_width,&image_height);
   if (status == -1) exit (EXIT_FAILURE);
+  bool image = png_file != NULL || svg_file != NULL;
+  if (!image && (width > 0 || from < to || lod_file != NULL) && strcmp(what,good_what[4]) != 0 &&
+      strcmp(what,good_what[5]) != 0)
+  { // Multi-resolution version of the raster and counting process plots
+    aspa_lod * lod = get_lod(what,in_bin,lod_file);
+    if (lod == NULL) exit (EXIT_FAILURE);
+    if (text == 0)
+      status = aspa_lod_plot_i(lod,from,to,width > 0 ? width : ASPA_LOD_WIDTH);
+    else
+      status = aspa_lod_fprintf(stdout,lod,from,to,width);
+    aspa_lod_free(lod);
+    if (status != 0) exit (EXIT_FAILURE);
+    return 0;
+  }
   aspa_sta * sta;
   if (in_bin == 0)
       sta = aspa_sta_fscanf(stdin);
   else
     sta = aspa_sta_fread(stdin);
+  if (sta == NULL) exit (EXIT_FAILURE);
 
+  if (image)
+  { // Plot rendered without gnuplot
+    aspa_image * img = get_image(sta,what,lag,image_width,image_height);
+    aspa_sta_free(sta);
+    if (img == NULL) exit (EXIT_FAILURE);
+    if (png_file != NULL)
+      status = write_image(png_file,img,true);
+    if (svg_file != NULL && status == 0)
+      status = write_image(svg_file,img,false);
+    aspa_image_free(img);
+    if (status == -1) exit (EXIT_FAILURE);
+    return 0;
+  }
   if (text == 0)
   { // Interactive use of gnuplot
     if (strcmp(what,good_what[0])==0)
-      aspa_raster_plot_i(sta); // raster plot
+      status = aspa_raster_plot_i(sta); // raster plot
     if (strcmp(what,good_what[1])==0)
-      aspa_cp_plot_i(sta, true, false); // cp_rt
+      status = aspa_cp_plot_i(sta, true, false); // cp_rt
     if (strcmp(what,good_what[2])==0)
-      aspa_cp_plot_i(sta, false, false); // cp_wt
+      status = aspa_cp_plot_i(sta, false, false); // cp_wt
     if (strcmp(what,good_what[3])==0)
     { // normalized counting process, cp_norm
       if (sta->n_aggregated == 1)
       { // must aggregate first
 	aspa_sta * asta = aspa_sta_aggregate(sta);
-	aspa_cp_plot_i(asta,false,true);
-	aspa_sta_free(asta);
+	status = asta != NULL ? aspa_cp_plot_i(asta,false,true) : ASPA_ENOMEM;
+	if (asta != NULL)
+	  aspa_sta_free(asta);
       }
       else
       {
-	aspa_cp_plot_i(sta,true,true);
+	status = aspa_cp_plot_i(sta,true,true);
       }
     }
     if (strcmp(what,good_what[4])==0) // lrank
-      aspa_lagged_rank_plot_i(sta, lag);
+      status = aspa_lagged_rank_plot_i(sta, lag);
+    if (strcmp(what,good_what[5])==0)
+    { // variance-time curves, fano
+      aspa_variance_time * vt = get_variance_time(sta,from,to);
+      status = vt != NULL ? aspa_variance_time_plot_i(vt) : ASPA_FAILURE;
+      if (vt != NULL)
+	aspa_variance_time_free(vt);
+    }
   }
   else
   { // Print to stdout
     if (strcmp(what,good_what[0])==0)
-      aspa_raster_plot_g(stdout,sta); // raster plot
+      status = aspa_raster_plot_g(stdout,sta); // raster plot
     if (strcmp(what,good_what[1])==0)
-      aspa_cp_plot_g(stdout,sta, true, false); // cp_rt
+      status = aspa_cp_plot_g(stdout,sta, true, false); // cp_rt
     if (strcmp(what,good_what[2])==0)
-      aspa_cp_plot_g(stdout,sta, false, false); // cp_wt
+      status = aspa_cp_plot_g(stdout,sta, false, false); // cp_wt
     if (strcmp(what,good_what[3])==0)
     { // normalized counting process, cp_norm
       if (sta->n_aggregated == 1)
       { // must aggregate first
 	aspa_sta * asta = aspa_sta_aggregate(sta);
-	aspa_cp_plot_g(stdout,asta,false,true);
-	aspa_sta_free(asta);
+	status = asta != NULL ? aspa_cp_plot_g(stdout,asta,false,true) : ASPA_ENOMEM;
+	if (asta != NULL)
+	  aspa_sta_free(asta);
       }
       else
       {
-	aspa_cp_plot_g(stdout,sta,true,true);
+	status = aspa_cp_plot_g(stdout,sta,true,true);
       }
     }
     if (strcmp(what,good_what[4])==0)
-      aspa_lagged_rank_plot_g(stdout,sta, lag); // lrank
+      status = aspa_lagged_rank_plot_g(stdout,sta, lag); // lrank
+    if (strcmp(what,good_what[5])==0)
+    { // variance-time curves, fano
+      aspa_variance_time * vt = get_variance_time(sta,from,to);
+      status = vt != NULL ? aspa_variance_time_plot_g(stdout,vt) : ASPA_FAILURE;
+      if (vt != NULL)
+	aspa_variance_time_free(vt);
+    }
   }
   aspa_sta_free(sta);
+  if (status != 0) exit (EXIT_FAILURE);
   return 0;
 }
 
+/** @brief Returns the multi-resolution version of the requested plot
+ *
+ *  If `lod_file` names a file containing a pyramid of the requested
+ *  type, it is read from there. Otherwise the aspa_sta is read from
+ *  the stdin, the pyramid is built and, if `lod_file` is not NULL,
+ *  written to `lod_file` for the next calls.
+ *
+ *  @param[in] what the type of plot
+ *  @param[in] in_bin input format, O for "txt" 1 for "bin"
+ *  @param[in] lod_file name of the pyramid file (or NULL)
+ *  @returns a pointer to an allocated aspa_lod, NULL if something went wrong
+*/
+aspa_lod * get_lod(const char * what, size_t in_bin, const char * lod_file)
+{
+  bool cp = strcmp(what,good_what[0]) != 0;
+  bool flat = strcmp(what,good_what[1]) == 0;
+  bool normalized = strcmp(what,good_what[3]) == 0;
+  if (lod_file != NULL)
+  {
+    FILE * fp = fopen(lod_file,"rb");
+    if (fp != NULL)
+    {
+      aspa_lod * lod = aspa_lod_fread(fp);
+      fclose(fp);
+      if (lod != NULL && lod->cp == cp && lod->normalized == normalized &&
+	  (normalized || lod->flat == flat))
+	return lod;
+      fprintf(stderr,"%s does not contain a '%s' plot, rebuilding it.\n",lod_file,what);
+      if (lod != NULL)
+	aspa_lod_free(lod);
+    }
+  }
+  aspa_sta * sta;
+  if (in_bin == 0)
+    sta = aspa_sta_fscanf(stdin);
+  else
+    sta = aspa_sta_fread(stdin);
+  if (sta == NULL)
+    return NULL;
+  aspa_lod * lod;
+  if (cp == false)
+    lod = aspa_lod_raster(sta,ASPA_LOD_WIDTH/8,0);
+  else if (normalized == false)
+    lod = aspa_lod_cp(sta,flat,false,ASPA_LOD_WIDTH/8,0);
+  else if (sta->n_aggregated == 1)
+  { // must aggregate first
+    aspa_sta * asta = aspa_sta_aggregate(sta);
+    lod = asta != NULL ? aspa_lod_cp(asta,false,true,ASPA_LOD_WIDTH/8,0) : NULL;
+    if (asta != NULL)
+      aspa_sta_free(asta);
+  }
+  else
+  {
+    lod = aspa_lod_cp(sta,true,true,ASPA_LOD_WIDTH/8,0);
+  }
+  aspa_sta_free(sta);
+  if (lod != NULL && lod_file != NULL)
+  {
+    FILE * fp = fopen(lod_file,"wb");
+    if (fp == NULL || aspa_lod_fwrite(fp,lod) != 0)
+      fprintf(stderr,"Could not write %s.\n",lod_file);
+    if (fp != NULL)
+      fclose(fp);
+  }
+  return lod;
+}
+
+/** @brief Renders the requested plot in memory
+ *
+ *  @param[in] sta a pointer to an aspa_sta
+ *  @param[in] what the type of plot
+ *  @param[in] lag the lag used in ranked plot
+ *  @param[in] image_width the image width
+ *  @param[in] image_height the image height
+ *  @returns a pointer to an allocated aspa_image, NULL if something went wrong
+*/
+aspa_image * get_image(const aspa_sta * sta, const char * what, size_t lag,
+		       size_t image_width, size_t image_height)
+{
+  if (strcmp(what,good_what[0])==0)
+    return aspa_raster_image(sta,image_width,image_height);
+  if (strcmp(what,good_what[1])==0)
+    return aspa_cp_image(sta,true,false,image_width,image_height);
+  if (strcmp(what,good_what[2])==0)
+    return aspa_cp_image(sta,false,false,image_width,image_height);
+  if (strcmp(what,good_what[3])==0)
+  { // normalized counting process, cp_norm
+    if (sta->n_aggregated == 1)
+    { // must aggregate first
+      aspa_sta * asta = aspa_sta_aggregate(sta);
+      if (asta == NULL)
+	return NULL;
+      aspa_image * img = aspa_cp_image(asta,false,true,image_width,image_height);
+      aspa_sta_free(asta);
+      return img;
+    }
+    return aspa_cp_image(sta,true,true,image_width,image_height);
+  }
+  if (strcmp(what,good_what[5])==0)
+  {
+    aspa_ctx_error(ASPA_EINVAL,"There is no image version of the '%s' plot.",what);
+    return NULL;
+  }
+  return aspa_lagged_rank_image(sta,lag,image_width,image_height);
+}
+
+/** @brief Returns the variance-time curves of the 'fano' plot
+ *
+ *  @param[in] sta a pointer to an aspa_sta
+ *  @param[in] from the left end of the counted range
+ *  @param[in] to the right end of the counted range, the whole trial
+ *             is used if from >= to
+ *  @returns a pointer to an allocated aspa_variance_time, NULL if
+ *           something went wrong
+*/
+aspa_variance_time * get_variance_time(const aspa_sta * sta, double from, double to)
+{
+  double last = 0.5*(from < to ? to-from : sta->trial_duration);
+  if (!(last > VT_FIRST))
+  {
+    aspa_ctx_error(ASPA_EINVAL,"The counted range is too short for the 'fano' plot.");
+    return NULL;
+  }
+  double windows[VT_N_WINDOWS];
+  for (size_t w_idx=0; w_idx<VT_N_WINDOWS; w_idx++)
+    windows[w_idx] = VT_FIRST*pow(last/VT_FIRST,w_idx/(VT_N_WINDOWS-1.));
+  return aspa_sta_variance_time(sta,from,to,windows,VT_N_WINDOWS);
+}
+
+/** @brief Writes an aspa_image to a file
+ *
+ *  @param[in] file_name the name of the file
+ *  @param[in] img a pointer to an aspa_image
+ *  @param[in] png PNG (true) or SVG (false) format
+ *  @returns 0 if everything goes fine, -1 otherwise
+*/
+int write_image(const char * file_name, const aspa_image * img, bool png)
+{
+  FILE * fp = fopen(file_name,"wb");
+  if (fp == NULL) {
+    fprintf(stderr,"Could not open %s.\n",file_name);
+    return -1;
+  }
+  int status = png ? aspa_image_png(fp,img) : aspa_image_svg(fp,img);
+  if (fclose(fp) != 0)
+    status = -1;
+  return status;
+}
+
 /** @brief Reads command line arguments.
  *  
  *  @param[in] argc argument of main
  *  @param[in] argv argument of main
  *  @param[out] in_bin input format, O for "txt" 1 for "bin" (default 0)
  *  @param[out] what the type of plot, one of:
- *              "raster", "cp_rt", "cp_wt", "cp_norm", "lrank"
+ *              "raster", "cp_rt", "cp_wt", "cp_norm", "lrank", "fano"
  *  @param[out] text output, O for interactive window 1 for "text" (default 0)
  *  @param[out] lag lag used in ranked plot (default 1)
+ *  @param[out] width number of pixel columns of decimated plots (default 0)
+ *  @param[out] from left end of the displayed time range (default 0)
+ *  @param[out] to right end of the displayed time range (default 0)
+ *  @param[out] lod_file name of the multi-resolution pyramid file (default NULL)
+ *  @param[out] png_file name of the PNG file (default NULL)
+ *  @param[out] svg_file name of the SVG file (default NULL)
+ *  @param[out] image_width width of the PNG / SVG image (default 800)
+ *  @param[out] image_height height of the PNG / SVG image (default 600)
  *  @returns 0 when everything goes fine
 */
 int read_args(int argc, char ** argv,
 	      size_t * in_bin,
 	      char * what,
 	      size_t * text,
-	      size_t * lag)
+	      size_t * lag,
+	      size_t * width,
+	      double * from,
+	      double * to,
+	      char ** lod_file,
+	      char ** png_file,
+	      char ** svg_file,
+	      size_t * image_width,
+	      size_t * image_height)
 {
   // Define default values
   *in_bin=0;
   *text=0;
   *lag=1;
+  *width=0;
+  *from=0;
+  *to=0;
+  *lod_file=NULL;
+  *png_file=NULL;
+  *svg_file=NULL;
+  *image_width=800;
+  *image_height=600;
   strcpy(what,"cp_rt");
   {int opt;
     static struct option long_options[] = {
@@ -115,11 +360,19 @@ int read_args(int argc, char ** argv,
       {"text",no_argument,NULL,'t'},
       {"what",optional_argument,NULL,'w'},
       {"lag",optional_argument,NULL,'l'},
+      {"width",required_argument,NULL,'W'},
+      {"from",required_argument,NULL,'f'},
+      {"to",required_argument,NULL,'T'},
+      {"lod",required_argument,NULL,'L'},
+      {"png",required_argument,NULL,'p'},
+      {"svg",required_argument,NULL,'s'},
+      {"image_width",required_argument,NULL,'x'},
+      {"image_height",required_argument,NULL,'y'},
       {"help",no_argument,NULL,'h'},
       {NULL,0,NULL,0}
     };
     int long_index =0;
-    while ((opt = getopt_long(argc,argv,"hitl:w:",long_options,\
+    while ((opt = getopt_long(argc,argv,"hitl:w:W:f:T:L:p:s:x:y:",long_options,\
 			      &long_index)) != -1) {
       switch(opt) {
       case 'w':
@@ -144,6 +397,22 @@ int read_args(int argc, char ** argv,
 	break;
       case 'l': *lag=atoi(optarg);
 	break;
+      case 'W': *width=atoi(optarg);
+	break;
+      case 'f': *from=atof(optarg);
+	break;
+      case 'T': *to=atof(optarg);
+	break;
+      case 'L': *lod_file=optarg;
+	break;
+      case 'p': *png_file=optarg;
+	break;
+      case 's': *svg_file=optarg;
+	break;
+      case 'x': *image_width=atoi(optarg);
+	break;
+      case 'y': *image_height=atoi(optarg);
+	break;
       case 'h': print_usage();
 	return -1;
       default : print_usage();
@@ -163,9 +432,26 @@ void print_usage()
 	 "  --in_bin: specify binary data input\n"
 	 "  --text: specify text output\n"
 	 "  --what <string>: one of 'raster', 'cp_rt', 'cp_wt',\n"
-	 "  'cp_norm', 'lrank', the type of plot (see bellow)\n"
+	 "  'cp_norm', 'lrank', 'fano', the type of plot (see bellow)\n"
 	 "  --lag <positive integer>: the lag used in lagged\n"
 	 "    ranked plots (default at 1).\n"
+	 "  --width <positive integer>: the number of pixel columns\n"
+	 "    the raster and counting process plots are decimated on\n"
+	 "    (default 2048 for interactive plots, no decimation for text).\n"
+	 "  --from <real> --to <real>: the displayed time range\n"
+	 "    (default the whole range).\n"
+	 "  --lod <file name>: a file holding the multi-resolution version\n"
+	 "    of the plot. If the file exists, it is used instead of the\n"
+	 "    stdin, otherwise it is created. Successive zooms with --from\n"
+	 "    and --to on the same file are then fast.\n"
+	 "  --png <file name>: write the plot in PNG format to the file\n"
+	 "    instead (gnuplot is not used).\n"
+	 "  --svg <file name>: write the plot in SVG format to the file\n"
+	 "    instead (gnuplot is not used).\n"
+	 "  --image_width <positive integer>: the width of the PNG / SVG\n"
+	 "    image (default 800).\n"
+	 "  --image_height <positive integer>: the height of the PNG / SVG\n"
+	 "    image (default 600).\n"
 	 "\n"
 	 "An interactive plot is generated.\n"
 	 "If what is set to 'raster' a raster plot is generated.\n"
@@ -179,6 +465,13 @@ void print_usage()
 	 "due to each spike in each trial is 1/number of trials; in a sense\n"
 	 "the 'mean' counting process is displayed).\n"
 	 "If what is set to 'lrank', isi are ranked from the smallest to\n"
-	 "the largest and the rank of isi i+lag is plotted against the\n"
-	 "lag of isi i.\n");
+	 "the largest (tied isi in their order of occurrence) and the rank\n"
+	 "of isi i+lag is plotted against the lag of isi i.\n"
+	 "If what is set to 'fano', the Fano factors of the spike counts\n"
+	 "within trial and across trials are plotted against the width of\n"
+	 "the counting windows, from 1 ms to half the trial duration (the\n"
+	 "text output adds the mean counts, the variances and the Allan\n"
+	 "factors, see aspa_vartime.c). With --from and --to, only the\n"
+	 "spikes of that range are counted, the windows go up to half\n"
+	 "its length.\n");
 }
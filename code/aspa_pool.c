@@ -0,0 +1,334 @@
+/** @file aspa_pool.c
+ *  @brief Function definitions for the parallel loops, per trial over
+ *         an aspa_sta or over a range of indices
+ *
+ *  The trials of an aspa_sta are independent, so most per trial work
+ *  can be spread over the cores; so can the work on the chunks of a
+ *  large array (see aspa_sort.c). A pool of helper threads, one per
+ *  online CPU minus one (the environment variable ASPA_THREADS gives
+ *  the total number of threads instead), is started the first time a
+ *  parallel loop is large enough to need it and kept until the program
+ *  exits. The calling thread works as well.
+ *
+ *  The trials (or indices) are split into one contiguous range per
+ *  thread. A thread takes its trials one at a time from the front of its
+ *  range; when the range is empty it steals the back half of the range
+ *  of another thread, so that uneven trials (a few long ones) do not
+ *  leave threads idle. The trials processed by each thread are therefore
+ *  not known in advance: the functions built on the loops write per
+ *  trial results at fixed places and combine them in trial order, which
+ *  keeps their output identical to the serial one.
+ *
+ *  Loops too small to benefit from the threads, loops started while the
+ *  pool is busy with a loop of another thread and loops nested in the
+ *  function of a parallel loop are run serially by the calling thread.
+ *  The helper threads use a context with the sink of the calling
+ *  thread's context (which must then accept calls from several threads)
+ *  and malloc as allocator; the last error they report is copied to the
+ *  calling thread's context at the end of the loop.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#define POOL_MAX_THREADS 256
+
+/** Range of indices owned by a thread */
+typedef struct
+{
+  pthread_mutex_t lock;
+  size_t from; //!< Next index to process
+  size_t to; //!< One past the last index
+} pool_range;
+
+typedef struct
+{
+  aspa_index_fn fn;
+  void * params;
+  aspa_ctx * caller; //!< Context of the thread that started the loop
+  int status; //!< Last error reported by a helper
+  char message[sizeof(((aspa_ctx *) NULL)->message)]; //!< Its message
+  pool_range range[POOL_MAX_THREADS];
+} pool_job;
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static size_t pool_n_threads = 1; //!< Helpers plus the calling thread
+static pool_job * pool_current = NULL;
+static unsigned long pool_generation = 0;
+static size_t pool_n_running = 0;
+static bool pool_busy = false;
+static __thread bool pool_inside = false;
+
+/** Takes the next index of range k, false if the range is empty */
+static bool range_take(pool_range * range, size_t * t_idx)
+{
+  pthread_mutex_lock(&range->lock);
+  bool res = range->from < range->to;
+  if (res)
+    *t_idx = range->from++;
+  pthread_mutex_unlock(&range->lock);
+  return res;
+}
+
+/** Moves the back half of the range of another thread to range k,
+    false if all the ranges are empty */
+static bool range_steal(pool_job * job, size_t k)
+{
+  for (size_t i=1; i<pool_n_threads; i++)
+  {
+    pool_range * victim = job->range+(k+i)%pool_n_threads;
+    pthread_mutex_lock(&victim->lock);
+    size_t left = victim->to-victim->from;
+    if (left == 0)
+    {
+      pthread_mutex_unlock(&victim->lock);
+      continue;
+    }
+    size_t middle = victim->to-(left+1)/2;
+    size_t to = victim->to;
+    victim->to = middle;
+    pthread_mutex_unlock(&victim->lock);
+    pthread_mutex_lock(&job->range[k].lock);
+    job->range[k].from = middle;
+    job->range[k].to = to;
+    pthread_mutex_unlock(&job->range[k].lock);
+    return true;
+  }
+  return false;
+}
+
+/** Processes indices as thread k until none is left */
+static void pool_work(pool_job * job, size_t k)
+{
+  size_t idx;
+  do
+  {
+    while (range_take(job->range+k,&idx))
+      (*job->fn)(idx,job->params);
+  } while (range_steal(job,k));
+}
+
+static void * pool_helper(void * arg)
+{
+  size_t k = (size_t) arg;
+  unsigned long seen = 0;
+  pool_inside = true;
+  for (;;)
+  {
+    pthread_mutex_lock(&pool_lock);
+    while (pool_generation == seen)
+      pthread_cond_wait(&pool_start,&pool_lock);
+    seen = pool_generation;
+    pool_job * job = pool_current;
+    pthread_mutex_unlock(&pool_lock);
+    aspa_ctx ctx = {.sink=job->caller->sink, .sink_state=job->caller->sink_state};
+    aspa_ctx_attach(&ctx);
+    pool_work(job,k);
+    aspa_ctx_attach(NULL);
+    pthread_mutex_lock(&pool_lock);
+    if (ctx.status != ASPA_SUCCESS)
+    {
+      job->status = ctx.status;
+      memcpy(job->message,ctx.message,sizeof(ctx.message));
+    }
+    if (--pool_n_running == 0)
+      pthread_cond_signal(&pool_done);
+    pthread_mutex_unlock(&pool_lock);
+  }
+  return NULL;
+}
+
+static void pool_setup(void)
+{
+  const char * env = getenv("ASPA_THREADS");
+  long n = env != NULL ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+  size_t wanted = n > 0 ? GSL_MIN((size_t) n,POOL_MAX_THREADS) : 1;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+  // Helpers that cannot be created are simply not counted
+  for (size_t k=1; k<wanted; k++)
+  {
+    pthread_t thread;
+    if (pthread_create(&thread,&attr,pool_helper,(void *) k) != 0)
+      break;
+    pool_n_threads = k+1;
+  }
+  pthread_attr_destroy(&attr);
+}
+
+/** Runs fn serially on indices 0 to n-1 */
+static void serial_for(size_t n, aspa_index_fn fn, void * params)
+{
+  for (size_t idx=0; idx < n; idx++)
+    (*fn)(idx,params);
+}
+
+/** Runs fn on indices 0 to n-1, in parallel if work is large enough */
+static void pool_for(size_t n, aspa_index_fn fn, void * params, size_t work)
+{
+  if (n < 2 || work < ASPA_PARALLEL_MIN_WORK || pool_inside)
+  {
+    serial_for(n,fn,params);
+    return;
+  }
+  pthread_once(&pool_once,pool_setup);
+  pthread_mutex_lock(&pool_lock);
+  bool busy = pool_n_threads == 1 || pool_busy; // or working for another thread
+  if (!busy)
+    pool_busy = true;
+  pthread_mutex_unlock(&pool_lock);
+  if (busy)
+  {
+    serial_for(n,fn,params);
+    return;
+  }
+  pool_job job = {.fn=fn, .params=params, .caller=aspa_ctx_current(),
+		  .status=ASPA_SUCCESS};
+  for (size_t k=0; k<pool_n_threads; k++)
+  {
+    pthread_mutex_init(&job.range[k].lock,NULL);
+    job.range[k].from = k*n/pool_n_threads;
+    job.range[k].to = (k+1)*n/pool_n_threads;
+  }
+  pthread_mutex_lock(&pool_lock);
+  pool_current = &job;
+  pool_n_running = pool_n_threads-1;
+  pool_generation++;
+  pthread_cond_broadcast(&pool_start);
+  pthread_mutex_unlock(&pool_lock);
+  pool_inside = true;
+  pool_work(&job,0);
+  pool_inside = false;
+  pthread_mutex_lock(&pool_lock);
+  while (pool_n_running > 0)
+    pthread_cond_wait(&pool_done,&pool_lock);
+  pool_current = NULL;
+  pool_busy = false;
+  pthread_mutex_unlock(&pool_lock);
+  for (size_t k=0; k<pool_n_threads; k++)
+    pthread_mutex_destroy(&job.range[k].lock);
+  if (job.status != ASPA_SUCCESS)
+  {
+    job.caller->status = job.status;
+    memcpy(job.caller->message,job.message,sizeof(job.message));
+  }
+}
+
+/** @brief Returns the number of threads used by the parallel loops
+ *
+ *  The calling thread is included, the pool is started if needed.
+ *
+ *  @returns the number of threads
+*/
+size_t aspa_pool_size(void)
+{
+  pthread_once(&pool_once,pool_setup);
+  return pool_n_threads;
+}
+
+/** @brief Calls a function on each index of a range, in parallel
+ *
+ *  `fn(idx,params)` is called once for each idx from 0 to n-1, from
+ *  the calling thread or from the pool threads, in no particular
+ *  order: it must only write to the per index parts of `params`. The
+ *  function returns once all the calls are done. Loops whose work (in
+ *  arbitrary units, the number of elements processed for instance) is
+ *  smaller than ASPA_PARALLEL_MIN_WORK are run serially.
+ *
+ *  @param[in] n the number of indices
+ *  @param[in] work an estimate of the total work
+ *  @param[in] fn the per index function
+ *  @param[in/out] params the last argument of fn
+ *  @returns 0 if everything goes fine
+*/
+int aspa_parallel_for(size_t n, size_t work, aspa_index_fn fn, void * params)
+{
+  pool_for(n,fn,params,work);
+  return 0;
+}
+
+typedef struct
+{
+  const aspa_sta * sta;
+  aspa_trial_fn fn;
+  void * params;
+} trial_job;
+
+static void trial_task(size_t t_idx, void * params)
+{
+  trial_job * job = params;
+  (*job->fn)(job->sta,t_idx,job->params);
+}
+
+/** @brief Calls a function on each trial of an aspa_sta, in parallel
+ *
+ *  `fn(sta,t_idx,params)` is called once for each trial, from the
+ *  calling thread or from the pool threads, in no particular order:
+ *  it must only write to the per trial parts of `params`. The function
+ *  returns once all the calls are done. Small loops are run serially.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] fn the per trial function
+ *  @param[in/out] params the last argument of fn
+ *  @returns 0 if everything goes fine
+*/
+int aspa_sta_parallel_for(const aspa_sta * sta, aspa_trial_fn fn, void * params)
+{
+  size_t work = sta->n_trials;
+  for (size_t t_idx=0; t_idx < sta->n_trials && work < ASPA_PARALLEL_MIN_WORK; t_idx++)
+    work += sta->st[t_idx]->size;
+  trial_job job = {.sta=sta, .fn=fn, .params=params};
+  pool_for(sta->n_trials,trial_task,&job,work);
+  return 0;
+}
+
+typedef struct
+{
+  aspa_trial_map map;
+  void * params;
+  double * value; //!< One value per trial
+} reduce_job;
+
+static void reduce_trial(const aspa_sta * sta, size_t t_idx, void * params)
+{
+  reduce_job * job = params;
+  job->value[t_idx] = (*job->map)(sta,t_idx,job->params);
+}
+
+/** @brief Reduces the trials of an aspa_sta, mapping them in parallel
+ *
+ *  `map(sta,t_idx,params)` is called on each trial as with
+ *  `aspa_sta_parallel_for`, then the values are combined in trial
+ *  order: op(...op(op(init,v_0),v_1)...,v_{n-1}). The result does not
+ *  depend on the number of threads.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] map the per trial function
+ *  @param[in] op the combining function
+ *  @param[in] init the initial value
+ *  @param[in/out] params the last argument of map
+ *  @returns the reduced value, NaN if the per trial values could not be
+ *           stored
+*/
+double aspa_sta_parallel_reduce(const aspa_sta * sta, aspa_trial_map map,
+				double (* op)(double a, double b), double init,
+				void * params)
+{
+  reduce_job job = {.map=map, .params=params};
+  job.value = aspa_ctx_malloc(sta->n_trials*sizeof(double));
+  if (job.value == NULL)
+    return GSL_NAN;
+  aspa_sta_parallel_for(sta,reduce_trial,&job);
+  double res = init;
+  for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
+    res = (*op)(res,job.value[t_idx]);
+  aspa_ctx_free(job.value);
+  return res;
+}
@@ -0,0 +1,220 @@
+/** @file aspa_profile.c
+ *  @brief Function definitions for the optional instrumentation of
+ *         the library
+ *
+ *  When the library is compiled with ASPA_PROFILE defined (`make
+ *  PROFILE=1`), the main entry points open a scoped timer with
+ *  `ASPA_PROF_SCOPE()` and count what they process with
+ *  `ASPA_PROF_SPIKES`, `ASPA_PROF_BYTES` and `ASPA_PROF_ALLOC`. Otherwise
+ *  these macros expand to nothing and cost nothing.
+ *
+ *  Even when compiled in, nothing is measured unless the environment
+ *  variable ASPA_PROFILE is set (to anything but "0"). If its value
+ *  contains "hw", the cycles and instructions hardware counters are
+ *  read as well (with `perf_event_open`, Linux only). When the program
+ *  exits, a JSON report is written to the stderr: for each entry point
+ *  the number of calls, the time spent (inclusive of the nested entry
+ *  points), the spikes, bytes and allocations counted, plus the program
+ *  elapsed time and peak resident memory. Programs call
+ *  `aspa_profile_init` first to get the report even when no entry point
+ *  is instrumented. Entries are updated with atomic operations, so
+ *  instrumented functions can be called from several threads.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static pthread_once_t prof_once = PTHREAD_ONCE_INIT;
+static bool prof_enabled = false;
+static bool prof_hw = false;
+static int prof_hw_fd[2] = {-1,-1};
+static const char * prof_program = "aspa";
+static uint64_t prof_start_ns = 0;
+static aspa_prof_entry * prof_head = NULL;
+
+static uint64_t prof_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return now.tv_sec*1000000000ull+now.tv_nsec;
+}
+
+#ifdef __linux__
+/** Opens a hardware counter of the calling process, -1 on failure */
+static int prof_hw_open(uint64_t config)
+{
+  struct perf_event_attr attr;
+  memset(&attr,0,sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.inherit = 1;
+  return (int) syscall(SYS_perf_event_open,&attr,0,-1,-1,0);
+}
+#endif
+
+/** Reads the hardware counters (0 if not available) */
+static void prof_hw_read(uint64_t * value)
+{
+  for (size_t k=0; k<2; k++)
+  {
+    value[k] = 0;
+#ifdef __linux__
+    if (prof_hw_fd[k] >= 0 && read(prof_hw_fd[k],value+k,sizeof(uint64_t)) != sizeof(uint64_t))
+      value[k] = 0;
+#endif
+  }
+}
+
+static void prof_report(void);
+
+static void prof_setup(void)
+{
+  const char * env = getenv("ASPA_PROFILE");
+  prof_enabled = env != NULL && strcmp(env,"0") != 0 && env[0] != '\0';
+  if (!prof_enabled)
+    return;
+  prof_start_ns = prof_now();
+#ifdef __linux__
+  if (strstr(env,"hw") != NULL)
+  {
+    prof_hw_fd[0] = prof_hw_open(PERF_COUNT_HW_CPU_CYCLES);
+    prof_hw_fd[1] = prof_hw_open(PERF_COUNT_HW_INSTRUCTIONS);
+    prof_hw = prof_hw_fd[0] >= 0 || prof_hw_fd[1] >= 0;
+    if (!prof_hw)
+      fprintf(stderr,"Hardware counters are not available.\n");
+  }
+#endif
+  atexit(prof_report);
+}
+
+/** @brief Starts the profiling of a program if ASPA_PROFILE is set
+ *
+ *  The program elapsed time is measured from this call and the
+ *  report, written at exit, is labelled with `program`.
+ *
+ *  @param[in] program the program name (argv[0] typically)
+ *  @returns true if profiling is enabled
+*/
+bool aspa_profile_init(const char * program)
+{
+  prof_program = program;
+  pthread_once(&prof_once,prof_setup);
+  return prof_enabled;
+}
+
+/** @brief Opens a profiling scope
+ *
+ *  Called by the ASPA_PROF_SCOPE macro, the entry is added to the
+ *  report the first time it is used.
+ *
+ *  @param[in/out] entry the static entry of the instrumented function
+ *  @param[in] name the name of the instrumented function
+ *  @returns the scope, with a NULL entry if profiling is disabled
+*/
+aspa_prof_scope aspa_prof_scope_begin(aspa_prof_entry * entry, const char * name)
+{
+  pthread_once(&prof_once,prof_setup);
+  aspa_prof_scope res = {.entry=NULL};
+  if (!prof_enabled)
+    return res;
+  if (!__atomic_exchange_n(&entry->registered,true,__ATOMIC_ACQ_REL))
+  {
+    entry->name = name;
+    entry->next = __atomic_load_n(&prof_head,__ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&prof_head,&entry->next,entry,false,
+					__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE))
+      ;
+  }
+  res.entry = entry;
+  if (prof_hw)
+    prof_hw_read(res.start_hw);
+  res.start_ns = prof_now();
+  return res;
+}
+
+/** @brief Closes a profiling scope
+ *
+ *  Called automatically when a variable declared by ASPA_PROF_SCOPE
+ *  goes out of scope.
+ *
+ *  @param[in] scope the scope
+ *  @returns nothing
+*/
+void aspa_prof_scope_end(aspa_prof_scope * scope)
+{
+  aspa_prof_entry * entry = scope->entry;
+  if (entry == NULL)
+    return;
+  __atomic_fetch_add(&entry->ns,prof_now()-scope->start_ns,__ATOMIC_RELAXED);
+  __atomic_fetch_add(&entry->calls,1,__ATOMIC_RELAXED);
+  if (prof_hw)
+  {
+    uint64_t stop[2];
+    prof_hw_read(stop);
+    __atomic_fetch_add(&entry->cycles,stop[0]-scope->start_hw[0],__ATOMIC_RELAXED);
+    __atomic_fetch_add(&entry->instructions,stop[1]-scope->start_hw[1],__ATOMIC_RELAXED);
+  }
+}
+
+/** @brief Adds to a counter of a profiling scope
+ *
+ *  @param[in] scope the scope
+ *  @param[in] counter 0 for spikes, 1 for bytes, 2 for allocations
+ *  @param[in] value the value added (bytes allocated for allocations)
+ *  @returns nothing
+*/
+void aspa_prof_count(aspa_prof_scope * scope, int counter, uint64_t value)
+{
+  aspa_prof_entry * entry = scope->entry;
+  if (entry == NULL)
+    return;
+  switch (counter) {
+  case 0: __atomic_fetch_add(&entry->spikes,value,__ATOMIC_RELAXED);
+    break;
+  case 1: __atomic_fetch_add(&entry->bytes,value,__ATOMIC_RELAXED);
+    break;
+  default: __atomic_fetch_add(&entry->allocs,1,__ATOMIC_RELAXED);
+    __atomic_fetch_add(&entry->alloc_bytes,value,__ATOMIC_RELAXED);
+  }
+}
+
+/** Writes the JSON report to the stderr */
+static void prof_report(void)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF,&usage);
+  const char * program = strrchr(prof_program,'/');
+  program = program != NULL ? program+1 : prof_program;
+  fprintf(stderr,"{\"program\": \"%s\", \"elapsed_s\": %.9g, \"peak_rss_kb\": %ld,"
+	  " \"hw_counters\": %s, \"entries\": [",
+	  program, (prof_now()-prof_start_ns)*1e-9, usage.ru_maxrss,
+	  prof_hw ? "true" : "false");
+  for (aspa_prof_entry * entry=prof_head; entry != NULL; entry=entry->next)
+  {
+    fprintf(stderr,"\n  {\"name\": \"%s\", \"calls\": %llu, \"seconds\": %.9g,"
+	    " \"spikes\": %llu, \"bytes\": %llu, \"allocations\": %llu,"
+	    " \"allocated_bytes\": %llu",
+	    entry->name, (unsigned long long) entry->calls, entry->ns*1e-9,
+	    (unsigned long long) entry->spikes, (unsigned long long) entry->bytes,
+	    (unsigned long long) entry->allocs, (unsigned long long) entry->alloc_bytes);
+    if (prof_hw)
+      fprintf(stderr,", \"cycles\": %llu, \"instructions\": %llu",
+	      (unsigned long long) entry->cycles, (unsigned long long) entry->instructions);
+    fprintf(stderr,"}%s", entry->next != NULL ? "," : "");
+  }
+  fprintf(stderr,"]}\n");
+}
@@ -0,0 +1,184 @@
+/** @file aspa_rate.c
+ *  @brief Function definitions for the firing rate curves
+ *
+ *  The rate curves are estimated from the aggregated train (the spike
+ *  times of all the trials, within trial, sorted) on a grid of times
+ *  k*step. With a rectangular window, the window moves forward with
+ *  the grid and its two ends move forward in the sorted train: each
+ *  spike enters and leaves the window once, a curve costs the number
+ *  of spikes plus the number of grid points whatever the width. With
+ *  the exponential kernel, the rate is a first order recursive filter:
+ *  from one grid time to the next the rate is multiplied by
+ *  exp(-step/width) and the spikes of the step are added.
+ *
+ *  The grid of each width is cut in chunks of RATE_CHUNK times, the
+ *  chunks of all the widths are computed in parallel (see aspa_pool.c);
+ *  a chunk starts with a binary search in the train.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+#define RATE_CHUNK 4096 //!< Grid times per parallel task
+#define RATE_EXP_SPAN 40. //!< Spikes older than that many time constants are ignored
+
+typedef struct
+{
+  const double * x; //!< The sorted spike times
+  size_t n; //!< Number of spike times
+  const double * widths;
+  double step;
+  aspa_rate_kernel kernel;
+  double n_real; //!< Number of real trials
+  size_t n_chunks; //!< Per width
+  gsl_matrix * res;
+} rate_job;
+
+/** First index i of the sorted x with x[i] > v (strict) or x[i] >= v,
+    from index i */
+static size_t advance(const double * x, size_t n, size_t i, double v, bool strict)
+{
+  while (i < n && (strict ? x[i] <= v : x[i] < v))
+    i++;
+  return i;
+}
+
+/** First index i of the sorted x with x[i] > v (strict) or x[i] >= v */
+static size_t bsearch_from(const double * x, size_t n, double v, bool strict)
+{
+  size_t lo = 0, hi = n;
+  while (lo < hi)
+  {
+    size_t mid = lo+(hi-lo)/2;
+    if (strict ? x[mid] <= v : x[mid] < v)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/** Window counts of grid times k0 to k1-1: (t-width,t] if causal,
+    [t-width/2,t+width/2) if centred */
+static void rate_window(const rate_job * job, double width, size_t k0, size_t k1,
+			double * row)
+{
+  bool causal = job->kernel == ASPA_RATE_CAUSAL;
+  double before = causal ? width : 0.5*width;
+  double after = causal ? 0. : 0.5*width;
+  double t = k0*job->step;
+  size_t lo = bsearch_from(job->x,job->n,t-before,causal);
+  size_t hi = bsearch_from(job->x,job->n,t+after,causal);
+  double scale = 1./(width*job->n_real);
+  for (size_t k=k0; k<k1; k++)
+  {
+    t = k*job->step;
+    lo = advance(job->x,job->n,lo,t-before,causal);
+    hi = advance(job->x,job->n,hi,t+after,causal);
+    row[k] = (hi-lo)*scale;
+  }
+}
+
+/** Exponential kernel rates of grid times k0 to k1-1 */
+static void rate_exponential(const rate_job * job, double width, size_t k0, size_t k1,
+			     double * row)
+{
+  const double * x = job->x;
+  double inv_width = 1./width;
+  double decay = exp(-job->step*inv_width);
+  double t = k0*job->step;
+  size_t i = bsearch_from(x,job->n,t-RATE_EXP_SPAN*width,true);
+  double r = 0.;
+  for (; i < job->n && x[i] <= t; i++)
+    r += exp((x[i]-t)*inv_width);
+  double scale = inv_width/job->n_real;
+  row[k0] = r*scale;
+  for (size_t k=k0+1; k<k1; k++)
+  {
+    t = k*job->step;
+    r *= decay;
+    for (; i < job->n && x[i] <= t; i++)
+      r += exp((x[i]-t)*inv_width);
+    row[k] = r*scale;
+  }
+}
+
+static void rate_chunk(size_t idx, void * params)
+{
+  rate_job * job = params;
+  size_t w_idx = idx/job->n_chunks;
+  size_t k0 = (idx%job->n_chunks)*RATE_CHUNK;
+  size_t k1 = GSL_MIN(k0+RATE_CHUNK,job->res->size2);
+  double * row = gsl_matrix_ptr(job->res,w_idx,0);
+  if (job->kernel == ASPA_RATE_EXPONENTIAL)
+    rate_exponential(job,job->widths[w_idx],k0,k1,row);
+  else
+    rate_window(job,job->widths[w_idx],k0,k1,row);
+}
+
+/** @brief Returns firing rate curves of an aspa_sta for several window
+ *         widths
+ *
+ *  The rate (Hz, per real trial) is estimated at the within trial
+ *  times k*step, for k from 0 to trial_duration/step, from the spikes
+ *  of all the trials:
+ *   - ASPA_RATE_CAUSAL: spikes in (t-width,t] divided by width,
+ *   - ASPA_RATE_CENTRED: spikes in [t-width/2,t+width/2) divided by width,
+ *   - ASPA_RATE_EXPONENTIAL: sum of exp(-(t-s)/width)/width over the
+ *     spikes s <= t, width is then the time constant.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] widths the n_widths window widths (s), > 0
+ *  @param[in] n_widths the number of widths
+ *  @param[in] step the step of the time grid (s), > 0
+ *  @param[in] kernel ASPA_RATE_CAUSAL, ASPA_RATE_CENTRED or
+ *             ASPA_RATE_EXPONENTIAL
+ *  @returns a pointer to an allocated gsl_matrix with one row per width
+ *           and one column per grid time, NULL if something went wrong
+*/
+gsl_matrix * aspa_sta_rate_curve(const aspa_sta * sta, const double * widths,
+				 size_t n_widths, double step, aspa_rate_kernel kernel)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  if (sta->n_trials == 0 || n_widths == 0 || !(step > 0.) || !(sta->trial_duration >= 0.))
+  {
+    aspa_ctx_error(ASPA_EINVAL,"The rate curves need trials, widths, a step > 0 and a"
+		   " trial duration >= 0.");
+    return NULL;
+  }
+  for (size_t w_idx=0; w_idx < n_widths; w_idx++)
+    if (!(widths[w_idx] > 0.))
+    {
+      aspa_ctx_error(ASPA_EINVAL,"The widths of the rate curves should be > 0.");
+      return NULL;
+    }
+  // a single trial is already sorted
+  aspa_sta * asta = NULL;
+  const gsl_vector * train = sta->st[0];
+  if (sta->n_trials > 1)
+  {
+    asta = aspa_sta_aggregate(sta);
+    if (asta == NULL)
+      return NULL;
+    train = asta->st[0];
+  }
+  size_t n_points = (size_t) floor(sta->trial_duration/step)+1;
+  gsl_matrix * res = gsl_matrix_alloc(n_widths,n_points);
+  if (res == NULL)
+  {
+    if (asta != NULL)
+      aspa_sta_free(asta);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the rate curves failed.");
+    return NULL;
+  }
+  rate_job job = {.x=train->data, .n=train->size, .widths=widths, .step=step,
+		  .kernel=kernel, .n_real=(double) sta->n_trials*sta->n_aggregated,
+		  .n_chunks=(n_points+RATE_CHUNK-1)/RATE_CHUNK, .res=res};
+  aspa_parallel_for(n_widths*job.n_chunks,n_widths*(train->size+n_points),
+		    rate_chunk,&job);
+  if (asta != NULL)
+    aspa_sta_free(asta);
+  return res;
+}
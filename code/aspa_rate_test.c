@@ -0,0 +1,80 @@
+/** @file aspa_rate_test.c
+ *  @brief User program for testing function aspa_sta_rate_curve
+ *
+ *  The rate curves of a simulated gamma train are computed for three
+ *  window widths and each kernel, and compared at a few grid times with
+ *  the spikes of the aggregated train counted (or weighted) one by
+ *  one. On an homogeneous Poisson train of rate 20 Hz, the average of
+ *  each curve over the grid times at least 1 s away from the trial
+ *  boundaries must be 20 Hz within 3%.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa_test.h"
+
+int main()
+{
+  aspa_sta * sta = test_sim_sta(ASPA_TEST_SEED,4000,15.,2.,10.);
+  aspa_sta * merged = aspa_sta_aggregate(sta);
+  const double widths[3] = {0.05,0.2,1.};
+  const char * name[3] = {"causal window / direct (relative)",
+			  "centred window / direct (relative)",
+			  "causal exponential / direct (relative)"};
+  size_t n_failed = 0;
+  test_header("value");
+  for (int kernel=ASPA_RATE_CAUSAL; kernel<=ASPA_RATE_EXPONENTIAL; kernel++)
+  {
+    gsl_matrix * rate = aspa_sta_rate_curve(sta,widths,3,0.001,kernel);
+    if (rate == NULL)
+    {
+      n_failed++;
+      continue;
+    }
+    double diff = 0.;
+    for (size_t w_idx=0; w_idx<3; w_idx++)
+      for (size_t k=0; k<rate->size2; k+=997)
+      {
+	double t = k*0.001, w = widths[w_idx], direct = 0.;
+	for (size_t i=0; i<merged->st[0]->size; i++)
+	{
+	  double x = gsl_vector_get(merged->st[0],i);
+	  if (kernel == ASPA_RATE_CAUSAL)
+	    direct += x > t-w && x <= t;
+	  else if (kernel == ASPA_RATE_CENTRED)
+	    direct += x >= t-w/2 && x < t+w/2;
+	  else if (x <= t)
+	    direct += exp((x-t)/w);
+	}
+	direct /= w*sta->n_trials*sta->n_aggregated;
+	diff = GSL_MAX(diff,fabs(gsl_matrix_get(rate,w_idx,k)-direct)/(1.+direct));
+      }
+    n_failed += test_report(name[kernel-ASPA_RATE_CAUSAL],diff,1e-9);
+    gsl_matrix_free(rate);
+  }
+  aspa_sta_free(merged);
+  aspa_sta_free(sta);
+  // homogeneous Poisson train, about 200 trials of 10 s
+  sta = test_sim_sta(ASPA_TEST_SEED,40000,20.,1.,10.);
+  const char * poisson_name[3] = {"Poisson, causal window mean / 20 Hz - 1",
+				  "Poisson, centred window mean / 20 Hz - 1",
+				  "Poisson, exponential mean / 20 Hz - 1"};
+  for (int kernel=ASPA_RATE_CAUSAL; kernel<=ASPA_RATE_EXPONENTIAL; kernel++)
+  {
+    gsl_matrix * rate = aspa_sta_rate_curve(sta,widths+1,1,0.01,kernel);
+    if (rate == NULL)
+    {
+      n_failed++;
+      continue;
+    }
+    double mean = 0.;
+    size_t n = 0;
+    for (size_t k=100; k+100<rate->size2; k++, n++)
+      mean += gsl_matrix_get(rate,0,k);
+    mean /= n;
+    n_failed += test_report(poisson_name[kernel-ASPA_RATE_CAUSAL],fabs(mean/20.-1.),0.03);
+    gsl_matrix_free(rate);
+  }
+  aspa_sta_free(sta);
+  printf("Checks failed: %d (0 expected).\n",(int) n_failed);
+  return n_failed == 0 ? 0 : 1;
+}
@@ -22,6 +22,7 @@ void print_usage();
 
 int main(int argc, char ** argv)
 {
+  aspa_profile_init(argv[0]); // JSON report on the stderr if ASPA_PROFILE is set
   size_t in_bin,out_bin;
   double inter_trial_interval=0;
   double stim_onset,stim_offset,sample2second;
@@ -34,6 +35,7 @@ int main(int argc, char ** argv)
   if (trial_duration > 0)
   { // Read flat test file with spike times one after the other
     gsl_vector * st_flat = aspa_raw_fscanf(stdin,sample2second);
+    if (st_flat == NULL) exit (EXIT_FAILURE);
     sta = aspa_sta_from_raw(st_flat, inter_trial_interval,
 			    stim_onset, stim_offset,
 			    trial_duration);
@@ -46,13 +48,15 @@ int main(int argc, char ** argv)
     else
       sta = aspa_sta_fread(stdin);
   }
+  if (sta == NULL) exit (EXIT_FAILURE);
   
   if (out_bin == 0)
-    aspa_sta_fprintf(stdout,sta,false);
+    status = aspa_sta_fprintf(stdout,sta,false);
   else
-    aspa_sta_fwrite(stdout,sta,false);
+    status = aspa_sta_fwrite(stdout,sta,false);
   
   aspa_sta_free(sta);
+  if (status != 0) exit (EXIT_FAILURE);
   return 0;
 }
 
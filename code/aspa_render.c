@@ -0,0 +1,639 @@
+/** @file aspa_render.c
+ *  @brief Function definitions for raster, counting process and lagged
+ *         rank plots rendered in memory and written as PNG or SVG
+ *
+ *  These plots do not require gnuplot (nor any display) and are meant
+ *  for batch report generation. The data are accumulated in a single
+ *  pass in a "density" buffer counting the hits of each pixel of the
+ *  plot area: a spike (raster), a pair of ranks (lagged rank plot) or
+ *  a pixel crossed by a step (counting process plots) adds one to the
+ *  corresponding pixel. The grey level of a pixel then grows with the
+ *  logarithm of its count, so overplotted regions remain readable.
+ *  The cost is linear in the number of spikes and does not depend on
+ *  the output format.
+ *
+ *  The PNG files are 8 bits grey level images compressed with "stored"
+ *  (uncompressed) deflate blocks, so no compression library is needed;
+ *  the title, the axis labels and ranges are printed on them with a
+ *  3 x 5 font (capital letters only). The SVG files contain the non
+ *  empty pixels as runs of rectangles, the same texts as text elements.
+ *  The left margin grows with the widest ordinate range label so that
+ *  it is never cut.
+ *  The functions keep no global state and can be called from several
+ *  threads.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+#include <ctype.h>
+#include <gsl/gsl_permutation.h>
+#include <gsl/gsl_sort_vector.h>
+
+#define IMG_LEFT 64 //!< Smallest left margin
+#define IMG_YLABEL 20 //!< Width of the ordinate label column
+#define IMG_RIGHT 16
+#define IMG_TOP 32
+#define IMG_BOTTOM 40
+#define IMG_BOX_GREY 221
+
+/** @brief Allocates an aspa_image with an empty plot area
+ *
+ *  @param[in] width the image width (at least 120 pixels)
+ *  @param[in] height the image height (at least 100 pixels)
+ *  @param[in] x_min the left end of the abscissa
+ *  @param[in] x_max the right end of the abscissa
+ *  @param[in] y_min the bottom end of the ordinate
+ *  @param[in] y_max the top end of the ordinate
+ *  @returns a pointer to an allocated aspa_image, NULL if the image
+ *           is too small or could not be allocated
+*/
+aspa_image * aspa_image_alloc(size_t width, size_t height,
+			      double x_min, double x_max,
+			      double y_min, double y_max)
+{
+  if (width < 120 || height < 100) {
+    aspa_ctx_error(ASPA_EINVAL,"Images must be at least 120 x 100 pixels.");
+    return NULL;
+  }
+  aspa_image * res = malloc(sizeof(aspa_image));
+  if (res == NULL) {
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the image failed.");
+    return NULL;
+  }
+  res->width = width;
+  res->height = height;
+  res->x_min = x_min;
+  res->x_max = x_max > x_min ? x_max : x_min+1.;
+  res->y_min = y_min;
+  res->y_max = y_max > y_min ? y_max : y_min+1.;
+  // the ordinate label, the widest range label (8 pixels per
+  // character) and the ticks, at most half the image
+  char text[32];
+  size_t n_char = GSL_MAX(snprintf(text,sizeof(text),"%g",res->y_min),
+			  snprintf(text,sizeof(text),"%g",res->y_max));
+  res->left = GSL_MIN(GSL_MAX(IMG_LEFT,IMG_YLABEL+8*n_char+8),width/2);
+  res->plot_width = width-res->left-IMG_RIGHT;
+  res->plot_height = height-IMG_TOP-IMG_BOTTOM;
+  res->box_from = 0.;
+  res->box_to = 0.;
+  res->count = calloc(res->plot_width*res->plot_height,sizeof(uint32_t));
+  if (res->count == NULL) {
+    free(res);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the image failed.");
+    return NULL;
+  }
+  res->title[0] = '\0';
+  res->xlabel[0] = '\0';
+  res->ylabel[0] = '\0';
+  return res;
+}
+
+/** @brief Frees an aspa_image
+ *
+ *  @param[in/out] img a pointer to an allocated aspa_image
+ *  @returns 0 if everything goes fine
+*/
+int aspa_image_free(aspa_image * img)
+{
+  free(img->count);
+  free(img);
+  return 0;
+}
+
+/** Returns the plot area column of abscissa x (clipped) */
+static inline size_t img_col(const aspa_image * img, double x)
+{
+  double c = (x-img->x_min)/(img->x_max-img->x_min)*img->plot_width;
+  if (c < 0.) return 0;
+  if (c >= img->plot_width) return img->plot_width-1;
+  return (size_t) c;
+}
+
+/** Returns the plot area row of ordinate y (clipped, row 0 at the top) */
+static inline size_t img_row(const aspa_image * img, double y)
+{
+  double r = (img->y_max-y)/(img->y_max-img->y_min)*img->plot_height;
+  if (r < 0.) return 0;
+  if (r >= img->plot_height) return img->plot_height-1;
+  return (size_t) r;
+}
+
+/** Adds a hit at point (x,y) */
+static inline void img_dot(aspa_image * img, double x, double y)
+{
+  img->count[img_row(img,y)*img->plot_width+img_col(img,x)]++;
+}
+
+/** The current pixel of a step plot being drawn */
+typedef struct
+{
+  bool started;
+  size_t col;
+  size_t row;
+} img_pen;
+
+/** @brief Draws the step from the pen position to point (x,y)
+ *
+ *  Like gnuplot's `steps`: horizontal at the pen ordinate up to x
+ *  then vertical up to y.
+*/
+static void img_step_to(aspa_image * img, img_pen * pen, double x, double y)
+{
+  size_t col = img_col(img,x);
+  size_t row = img_row(img,y);
+  uint32_t * count = img->count;
+  size_t pw = img->plot_width;
+  if (!pen->started)
+  {
+    count[row*pw+col]++;
+    *pen = (img_pen) {.started=true,.col=col,.row=row};
+    return;
+  }
+  for (size_t c=pen->col+1; c<=col; c++)
+    count[pen->row*pw+c]++;
+  if (row < pen->row)
+    for (size_t r=row; r<pen->row; r++)
+      count[r*pw+col]++;
+  else
+    for (size_t r=pen->row+1; r<=row; r++)
+      count[r*pw+col]++;
+  pen->col = col;
+  pen->row = row;
+}
+
+/** @brief Renders the raster plot of an aspa_sta structure
+ *
+ *  The plot is the one of `aspa_raster_plot_i`: trial i is drawn at
+ *  ordinate i+1 on the within trial time and the stimulus (if any) is
+ *  shown as a grey box.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] width the image width
+ *  @param[in] height the image height
+ *  @returns a pointer to an allocated aspa_image, NULL if something went wrong
+*/
+aspa_image * aspa_raster_image(const aspa_sta * sta, size_t width, size_t height)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  aspa_image * img = aspa_image_alloc(width,height,0.,sta->trial_duration,
+				      0.,sta->n_trials+1);
+  if (img == NULL)
+    return NULL;
+  if (sta->onset < sta->offset)
+  {
+    img->box_from = sta->onset;
+    img->box_to = sta->offset;
+  }
+  strcpy(img->xlabel,"Time (s)");
+  strcpy(img->ylabel,"Trial");
+  for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
+  {
+    gsl_vector * st = aspa_sta_get_st(sta,t_idx);
+    uint32_t * line = img->count+img_row(img,t_idx+1)*img->plot_width;
+    for (size_t i=0; i < st->size; i++)
+      line[img_col(img,gsl_vector_get(st,i))]++;
+  }
+  return img;
+}
+
+/** @brief Renders an observed counting process plot of an aspa_sta structure
+ *
+ *  The plot is the one of `aspa_cp_plot_i` (see there for the meaning
+ *  of `flat` and `normalized`).
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] flat boolean controlling if actual or within trial
+ *             time is used
+ *  @param[in] normalized boolean controlling if the mean OCP is
+ *             is displayed
+ *  @param[in] width the image width
+ *  @param[in] height the image height
+ *  @returns a pointer to an allocated aspa_image, NULL if something went wrong
+*/
+aspa_image * aspa_cp_image(const aspa_sta * sta, bool flat, bool normalized,
+			   size_t width, size_t height)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  bool single = normalized == true || flat == true;
+  double x_min = 0., x_max = sta->trial_duration;
+  if (single && sta->n_trials > 0)
+  {
+    gsl_vector * first = aspa_sta_get_st(sta,0);
+    gsl_vector * last = aspa_sta_get_st(sta,sta->n_trials-1);
+    if (first->size > 0)
+      x_min = GSL_MIN_DBL(x_min,gsl_vector_get(first,0)+aspa_sta_get_st_start(sta,0));
+    x_max = GSL_MAX_DBL(x_max,aspa_sta_get_st_start(sta,sta->n_trials-1)+
+			(last->size > 0 ? gsl_vector_get(last,last->size-1) : 0.));
+  }
+  double step = 1.0/sta->n_aggregated;
+  double y_max = single ? aspa_sta_n_spikes(sta)*step : aspa_sta_n_spikes_max(sta);
+  aspa_image * img = aspa_image_alloc(width,height,x_min,x_max,0.,y_max);
+  if (img == NULL)
+    return NULL;
+  if (!flat && sta->onset < sta->offset)
+  {
+    img->box_from = sta->onset;
+    img->box_to = sta->offset;
+  }
+  strcpy(img->xlabel,"Time (s)");
+  if (flat == true)
+    strcpy(img->title,"Observed counting process");
+  else if (normalized == true)
+    strcpy(img->title,"Observed mean counting process");
+  else
+    strcpy(img->title,"Observed counting processes");
+  strcpy(img->ylabel,normalized == true ? "Mean events count" : "Events count");
+  img_pen pen = {.started=false};
+  double count = step;
+  for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
+  {
+    gsl_vector * st = aspa_sta_get_st(sta,t_idx);
+    double start_time = single ? aspa_sta_get_st_start(sta,t_idx) : 0.;
+    if (!single)
+    {
+      count = 1.;
+      pen.started = false;
+    }
+    for (size_t i=0; i < st->size; i++)
+    {
+      img_step_to(img,&pen,gsl_vector_get(st,i)+start_time,count);
+      count += single ? step : 1.;
+    }
+  }
+  return img;
+}
+
+/** @brief Renders the lagged rank plot of an aspa_sta structure
+ *
+ *  The plot is the one of `aspa_lagged_rank_plot_i`.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] lag the lag
+ *  @param[in] width the image width
+ *  @param[in] height the image height
+ *  @returns a pointer to an allocated aspa_image, NULL if something went wrong
+*/
+aspa_image * aspa_lagged_rank_image(const aspa_sta * sta, size_t lag,
+				    size_t width, size_t height)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  gsl_permutation * rank = aspa_sta_isi_rank(sta);
+  if (rank == NULL)
+    return NULL;
+  size_t n = rank->size;
+  aspa_image * img = NULL;
+  if (lag+1 >= n) // make sure the lag is small enough
+    aspa_ctx_error(ASPA_EINVAL,"The lag (%zu) must be smaller than the number of ISI minus one (%zu).",lag,n);
+  else
+    img = aspa_image_alloc(width,height,0.,n-1,0.,n-1);
+  if (img == NULL) {
+    gsl_permutation_free(rank);
+    return NULL;
+  }
+  strcpy(img->xlabel,"Rank i");
+  snprintf(img->ylabel,sizeof(img->ylabel),"Rank i + %d",(int) lag);
+  for (size_t i=0; i < n-lag-1; i++)
+    img_dot(img,rank->data[i],rank->data[i+lag]);
+  gsl_permutation_free(rank);
+  return img;
+}
+
+/** 3 x 5 glyphs of the characters used for numbers and of the
+    capital letters, one row per element, bit 2 is the leftmost column;
+    lower case letters are printed as capitals */
+static const char img_glyph_chars[] = "0123456789.-+ABCDEFGHIJKLMNOPQRSTUVWXYZ()";
+static const uint8_t img_glyphs[][5] = {
+  {7,5,5,5,7},{2,6,2,2,7},{7,1,7,4,7},{7,1,7,1,7},{5,5,7,1,1},
+  {7,4,7,1,7},{7,4,7,5,7},{7,1,1,1,1},{7,5,7,5,7},{7,5,7,1,7},
+  {0,0,0,0,2},{0,0,7,0,0},{0,2,7,2,0},
+  {2,5,7,5,5},{6,5,6,5,6},{3,4,4,4,3},{6,5,5,5,6},{7,4,6,4,7},
+  {7,4,6,4,4},{3,4,5,5,3},{5,5,7,5,5},{7,2,2,2,7},{1,1,1,5,2},
+  {5,5,6,5,5},{4,4,4,4,7},{5,7,7,5,5},{6,5,5,5,5},{2,5,5,5,2},
+  {6,5,6,4,4},{2,5,5,6,3},{6,5,6,5,5},{3,4,2,1,6},{7,2,2,2,2},
+  {5,5,5,5,7},{5,5,5,5,2},{5,5,7,7,5},{5,5,2,5,5},{5,5,2,2,2},
+  {7,1,2,4,7},{1,2,2,2,1},{4,2,2,2,4}};
+
+/** @brief Prints a text with the 3 x 5 font scaled twice on a grey
+ *         level image
+ *
+ *  Characters are 8 pixels wide. Horizontal text starts at (x,y), its
+ *  top left corner; vertical text (rotated a quarter turn counter
+ *  clockwise) starts at (x,y), its bottom left corner, and goes up.
+ *  Characters without a glyph are printed as spaces, the text is
+ *  clipped to the image.
+*/
+static void img_text(uint8_t * grey, size_t width, size_t height,
+		     long x, long y, const char * text, bool vertical)
+{
+  for (size_t k=0; text[k] != '\0'; k++)
+  {
+    const char * c = strchr(img_glyph_chars,toupper((unsigned char) text[k]));
+    for (long r=0; r<10 && c != NULL; r++)
+      for (long s=0; s<6; s++)
+	if ((img_glyphs[c-img_glyph_chars][r/2] >> (2-s/2)) & 1)
+	{
+	  long px = vertical ? x+r : x+8*(long) k+s;
+	  long py = vertical ? y-8*(long) k-s : y+r;
+	  if (px >= 0 && py >= 0 && (size_t) px < width && (size_t) py < height)
+	    grey[py*width+px] = 0;
+	}
+  }
+}
+
+/** Prints a number with img_text, returns its number of characters */
+static long img_number(uint8_t * grey, size_t width, size_t height,
+		       long x, long y, double value)
+{
+  char text[32];
+  long n_char = snprintf(text,sizeof(text),"%g",value);
+  img_text(grey,width,height,x,y,text,false);
+  return n_char;
+}
+
+/** Returns the grey level of the plot area pixels, from the counts */
+static void img_levels(const aspa_image * img, uint8_t * level)
+{
+  size_t n = img->plot_width*img->plot_height;
+  uint32_t c_max = 0;
+  for (size_t i=0; i<n; i++)
+    c_max = GSL_MAX(c_max,img->count[i]);
+  // lightest hit at 160, most hit pixels black
+  double scale = c_max > 1 ? 160./log(c_max) : 0.;
+  uint8_t lut[64];
+  for (size_t c=1; c<64; c++)
+    lut[c] = (uint8_t) (160.-scale*log(c)+0.5);
+  size_t box_from = img->box_from < img->box_to ? img_col(img,img->box_from) : 1;
+  size_t box_to = img->box_from < img->box_to ? img_col(img,img->box_to) : 0;
+  for (size_t r=0; r<img->plot_height; r++)
+    for (size_t c=0; c<img->plot_width; c++)
+    {
+      uint32_t k = img->count[r*img->plot_width+c];
+      if (k == 0)
+	level[r*img->plot_width+c] = c >= box_from && c <= box_to ? IMG_BOX_GREY : 255;
+      else
+	level[r*img->plot_width+c] = k < 64 ? lut[k] : (uint8_t) (160.-scale*log(k)+0.5);
+    }
+}
+
+/** @brief Returns the full grey level image: plot area, frame, ticks,
+ *         axis ranges and labels and title
+ *
+ *  The result is a context buffer (NULL if the allocation failed).
+*/
+static uint8_t * img_grey(const aspa_image * img)
+{
+  size_t w = img->width, h = img->height;
+  size_t pw = img->plot_width, ph = img->plot_height, left = img->left;
+  uint8_t * grey = aspa_ctx_malloc(w*h+pw*ph);
+  if (grey == NULL)
+    return NULL;
+  memset(grey,255,w*h);
+  uint8_t * level = grey+w*h;
+  img_levels(img,level);
+  for (size_t r=0; r<ph; r++)
+    memcpy(grey+(IMG_TOP+r)*w+left,level+r*pw,pw);
+  // frame
+  for (size_t c=left-1; c<=left+pw; c++)
+  {
+    grey[(IMG_TOP-1)*w+c] = 0;
+    grey[(IMG_TOP+ph)*w+c] = 0;
+  }
+  for (size_t r=IMG_TOP-1; r<=IMG_TOP+ph; r++)
+  {
+    grey[r*w+left-1] = 0;
+    grey[r*w+left+pw] = 0;
+  }
+  // ticks at the ends of the axes and the ranges
+  for (size_t k=1; k<=4; k++)
+  {
+    grey[(IMG_TOP+ph+k)*w+left-1] = 0;
+    grey[(IMG_TOP+ph+k)*w+left+pw] = 0;
+    grey[(IMG_TOP-1)*w+left-1-k] = 0;
+    grey[(IMG_TOP+ph)*w+left-1-k] = 0;
+  }
+  char text[32];
+  long y_text = IMG_TOP+ph+8;
+  img_number(grey,w,h,left-4,y_text,img->x_min);
+  long n_char = snprintf(text,sizeof(text),"%g",img->x_max);
+  img_number(grey,w,h,left+pw+4-8*n_char,y_text,img->x_max);
+  n_char = snprintf(text,sizeof(text),"%g",img->y_max);
+  img_number(grey,w,h,left-8-8*n_char,IMG_TOP-6,img->y_max);
+  n_char = snprintf(text,sizeof(text),"%g",img->y_min);
+  img_number(grey,w,h,left-8-8*n_char,IMG_TOP+ph-6,img->y_min);
+  // the texts of aspa_image_svg, centred
+  n_char = strlen(img->xlabel);
+  img_text(grey,w,h,left+pw/2-4*n_char,h-14,img->xlabel,false);
+  n_char = strlen(img->ylabel);
+  img_text(grey,w,h,4,IMG_TOP+ph/2+4*n_char,img->ylabel,true);
+  n_char = strlen(img->title);
+  img_text(grey,w,h,w/2-4*n_char,10,img->title,false);
+  return grey;
+}
+
+/** Writes a 32 bits unsigned integer in network byte order */
+static void png_u32(uint8_t * buffer, uint32_t value)
+{
+  buffer[0] = value >> 24;
+  buffer[1] = value >> 16;
+  buffer[2] = value >> 8;
+  buffer[3] = value;
+}
+
+/** Updates a CRC-32 (the one of PNG and zlib) with n bytes */
+static uint32_t png_crc(const uint32_t * table, uint32_t crc, const uint8_t * data, size_t n)
+{
+  for (size_t i=0; i<n; i++)
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+/** Writes a PNG chunk */
+static int png_chunk(FILE * stream, const uint32_t * table, const char * type,
+		     const uint8_t * data, size_t n)
+{
+  uint8_t head[8];
+  png_u32(head,n);
+  memcpy(head+4,type,4);
+  uint32_t crc = png_crc(table,0xffffffffu,head+4,4);
+  crc = png_crc(table,crc,data,n) ^ 0xffffffffu;
+  uint8_t tail[4];
+  png_u32(tail,crc);
+  if (fwrite(head,1,8,stream) != 8 || fwrite(data,1,n,stream) != n ||
+      fwrite(tail,1,4,stream) != 4)
+    return -1;
+  return 0;
+}
+
+/** @brief Writes an aspa_image to a stream in PNG format
+ *
+ *  The image is a 8 bits grey level one, the pixels are stored in
+ *  uncompressed deflate blocks of a zlib stream.
+ *
+ *  @param[in/out] stream an open file
+ *  @param[in] img a pointer to an aspa_image
+ *  @returns 0 if everything goes fine, a negative error code otherwise
+*/
+int aspa_image_png(FILE * stream, const aspa_image * img)
+{
+  ASPA_PROF_SCOPE();
+  uint32_t table[256];
+  for (uint32_t n=0; n<256; n++)
+  {
+    uint32_t c = n;
+    for (size_t k=0; k<8; k++)
+      c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+    table[n] = c;
+  }
+  size_t w = img->width, h = img->height;
+  uint8_t * grey = img_grey(img);
+  if (grey == NULL)
+    return ASPA_ENOMEM;
+  // raw scanlines: filter type 0 followed by the pixels
+  size_t n_raw = (w+1)*h;
+  uint8_t * raw = aspa_ctx_malloc(n_raw);
+  if (raw == NULL)
+  {
+    aspa_ctx_free(grey);
+    return ASPA_ENOMEM;
+  }
+  for (size_t r=0; r<h; r++)
+  {
+    raw[r*(w+1)] = 0;
+    memcpy(raw+r*(w+1)+1,grey+r*w,w);
+  }
+  aspa_ctx_free(grey);
+  size_t n_blocks = n_raw/65535+1;
+  size_t n_zlib = 2+5*n_blocks+n_raw+4;
+  uint8_t * zlib = aspa_ctx_malloc(n_zlib);
+  if (zlib == NULL)
+  {
+    aspa_ctx_free(raw);
+    return ASPA_ENOMEM;
+  }
+  size_t pos = 0;
+  zlib[pos++] = 0x78;
+  zlib[pos++] = 0x01;
+  uint32_t a = 1, b = 0;
+  for (size_t k=0; k<n_blocks; k++)
+  {
+    size_t from = k*65535;
+    size_t n = GSL_MIN(65535,n_raw-from);
+    zlib[pos++] = k+1 == n_blocks; // BFINAL, BTYPE 00
+    zlib[pos++] = n & 0xff;
+    zlib[pos++] = n >> 8;
+    zlib[pos++] = ~n & 0xff;
+    zlib[pos++] = (~n >> 8) & 0xff;
+    memcpy(zlib+pos,raw+from,n);
+    pos += n;
+    for (size_t i=from; i<from+n; i++)
+    { // Adler-32
+      a = (a+raw[i]) % 65521;
+      b = (b+a) % 65521;
+    }
+  }
+  png_u32(zlib+pos,(b << 16) | a);
+  pos += 4;
+  aspa_ctx_free(raw);
+  static const uint8_t signature[8] = {137,80,78,71,13,10,26,10};
+  uint8_t ihdr[13];
+  png_u32(ihdr,w);
+  png_u32(ihdr+4,h);
+  ihdr[8] = 8; // bit depth
+  ihdr[9] = 0; // grey level
+  ihdr[10] = 0;
+  ihdr[11] = 0;
+  ihdr[12] = 0;
+  int status = 0;
+  if (fwrite(signature,1,8,stream) != 8 ||
+      png_chunk(stream,table,"IHDR",ihdr,13) != 0 ||
+      png_chunk(stream,table,"IDAT",zlib,pos) != 0 ||
+      png_chunk(stream,table,"IEND",NULL,0) != 0)
+    status = aspa_ctx_error(ASPA_EIO,"Writing the PNG image failed.");
+  aspa_ctx_free(zlib);
+  return status;
+}
+
+/** @brief Writes an aspa_image to a stream in SVG format
+ *
+ *  Consecutive non empty pixels of a row with the same grey level are
+ *  written as a single rectangle. The title, axis labels and ranges are
+ *  written as text.
+ *
+ *  @param[in/out] stream an open file
+ *  @param[in] img a pointer to an aspa_image
+ *  @returns 0 if everything goes fine, a negative error code otherwise
+*/
+int aspa_image_svg(FILE * stream, const aspa_image * img)
+{
+  ASPA_PROF_SCOPE();
+  size_t w = img->width, h = img->height;
+  size_t pw = img->plot_width, ph = img->plot_height, left = img->left;
+  uint8_t * level = aspa_ctx_malloc(pw*ph);
+  if (level == NULL)
+    return ASPA_ENOMEM;
+  img_levels(img,level);
+  fprintf(stream,"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+  fprintf(stream,"<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%zu\" height=\"%zu\""
+	  " viewBox=\"0 0 %zu %zu\" font-family=\"sans-serif\" font-size=\"12\""
+	  " shape-rendering=\"crispEdges\">\n", w, h, w, h);
+  fprintf(stream,"<rect width=\"%zu\" height=\"%zu\" fill=\"white\"/>\n", w, h);
+  if (img->box_from < img->box_to)
+  {
+    size_t from = img_col(img,img->box_from), to = img_col(img,img->box_to);
+    fprintf(stream,"<rect x=\"%zu\" y=\"%d\" width=\"%zu\" height=\"%zu\" fill=\"#%02x%02x%02x\"/>\n",
+	    left+from, IMG_TOP, to-from+1, ph, IMG_BOX_GREY, IMG_BOX_GREY, IMG_BOX_GREY);
+  }
+  // one path per grey level
+  bool present[256] = {false};
+  for (size_t i=0; i<pw*ph; i++)
+    if (img->count[i] > 0)
+      present[level[i]] = true;
+  for (size_t g=0; g<255; g++)
+  {
+    if (!present[g])
+      continue;
+    fprintf(stream,"<path fill=\"#%02zx%02zx%02zx\" d=\"", g, g, g);
+    for (size_t r=0; r<ph; r++)
+    {
+      const uint8_t * line = level+r*pw;
+      const uint32_t * hits = img->count+r*pw;
+      for (size_t c=0; c<pw; c++)
+      {
+	if (hits[c] == 0 || line[c] != g)
+	  continue;
+	size_t start = c;
+	while (c+1 < pw && hits[c+1] > 0 && line[c+1] == g)
+	  c++;
+	fprintf(stream,"M%zu %zuh%zuv1h-%zuz", left+start, IMG_TOP+r,
+		c-start+1, c-start+1);
+      }
+    }
+    fprintf(stream,"\"/>\n");
+  }
+  aspa_ctx_free(level);
+  fprintf(stream,"<rect x=\"%zu\" y=\"%d\" width=\"%zu\" height=\"%zu\" fill=\"none\""
+	  " stroke=\"black\"/>\n", left, IMG_TOP, pw, ph);
+  fprintf(stream,"<text x=\"%zu\" y=\"%zu\" text-anchor=\"middle\">%g</text>\n",
+	  left, IMG_TOP+ph+16, img->x_min);
+  fprintf(stream,"<text x=\"%zu\" y=\"%zu\" text-anchor=\"middle\">%g</text>\n",
+	  left+pw, IMG_TOP+ph+16, img->x_max);
+  fprintf(stream,"<text x=\"%zu\" y=\"%zu\" text-anchor=\"end\">%g</text>\n",
+	  left-4, IMG_TOP+ph+4, img->y_min);
+  fprintf(stream,"<text x=\"%zu\" y=\"%d\" text-anchor=\"end\">%g</text>\n",
+	  left-4, IMG_TOP+4, img->y_max);
+  fprintf(stream,"<text x=\"%zu\" y=\"%zu\" text-anchor=\"middle\">%s</text>\n",
+	  left+pw/2, h-8, img->xlabel);
+  fprintf(stream,"<text transform=\"translate(16 %zu) rotate(-90)\" text-anchor=\"middle\">%s</text>\n",
+	  IMG_TOP+ph/2, img->ylabel);
+  if (img->title[0] != '\0')
+    fprintf(stream,"<text x=\"%zu\" y=\"20\" text-anchor=\"middle\">%s</text>\n",
+	    w/2, img->title);
+  fprintf(stream,"</svg>\n");
+  if (ferror(stream))
+    return aspa_ctx_error(ASPA_EIO,"Writing the SVG image failed.");
+  return 0;
+}
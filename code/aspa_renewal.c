@@ -0,0 +1,313 @@
+/** @file aspa_renewal.c
+ *  @brief Function definitions for the maximum likelihood fits of
+ *         renewal models to the inter spike intervals
+ *
+ *  Five interval distributions are fitted: the exponential (a Poisson
+ *  process), the gamma, the inverse Gaussian, the lognormal and the
+ *  Weibull. The intervals are reduced once, in one pass, to their sum,
+ *  the sum of their logs and the sum of their inverses:
+ *   - the exponential, inverse Gaussian and lognormal estimators are
+ *     explicit functions of these sums (with the variance of the logs,
+ *     computed in a second pass to avoid a cancellation);
+ *   - the gamma shape k solves log(k)-psi(k) = log(mean)-mean(log),
+ *     a few Newton iterations from Minka's approximation;
+ *   - the Weibull shape has no sufficient statistics, the scale is
+ *     profiled out and each Newton iteration on the shape takes one
+ *     pass over the logs of the intervals, with the vector kernel
+ *     `aspa_weibull_sums` (aspa_dist_vec.c).
+ *
+ *  The models are compared by their AIC and BIC. The fitted cdf of
+ *  each model is evaluated at the sorted intervals (with
+ *  `aspa_cdf_norm_P_array` for the lognormal) and given to the one pass
+ *  Kolmogorov statistic `aspa_ks_stats_array` and to the
+ *  Anderson-Darling statistic; the p-values of the latter are computed
+ *  together with `aspa_cdf_AD_P_array`. They ignore the estimation of
+ *  the parameters and are therefore conservative.
+ *
+ *  With several units, the units are fitted in parallel.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+#define RENEWAL_MAX_ITER 100 //!< Newton iterations
+#define RENEWAL_TOL 1e-12 //!< Relative change of a shape at convergence
+
+/** Number of parameters of each model */
+static const size_t n_par[ASPA_RENEWAL_N_MODELS] = {1,2,2,2,2};
+
+static const char * model_name[ASPA_RENEWAL_N_MODELS] =
+  {"exponential","gamma","inverse_gaussian","lognormal","weibull"};
+
+/** Shape of the gamma distribution, s = log(mean)-mean(log) > 0 */
+static double gamma_shape(double s)
+{
+  double k = (3.-s+sqrt((s-3.)*(s-3.)+24.*s))/(12.*s);
+  for (int iter=0; iter<RENEWAL_MAX_ITER; iter++)
+  {
+    double f = log(k)-gsl_sf_psi(k)-s;
+    double k_new = k-f/(1./k-gsl_sf_psi_1(k));
+    if (!(k_new > 0.))
+      k_new = 0.5*k;
+    bool done = fabs(k_new-k) <= RENEWAL_TOL*k;
+    k = k_new;
+    if (done)
+      break;
+  }
+  return k;
+}
+
+/** Shape of the Weibull distribution from the n logs y of the
+    intervals divided by their mean, of mean y_mean and standard
+    deviation y_sd; s receives the sums of aspa_weibull_sums */
+static double weibull_shape(const double * y, size_t n, double y_mean, double y_sd,
+			    double * s)
+{
+  // the logs of Weibull intervals have a Gumbel distribution
+  double k = M_PI/(sqrt(6.)*y_sd);
+  for (int iter=0; iter<RENEWAL_MAX_ITER; iter++)
+  {
+    aspa_weibull_sums(y,n,k,s);
+    double a = s[1]/s[0];
+    double g = a-1./k-y_mean;
+    double k_new = k-g/(s[2]/s[0]-a*a+1./(k*k));
+    if (!(k_new > 0.))
+      k_new = 0.5*k;
+    bool done = fabs(k_new-k) <= RENEWAL_TOL*k;
+    k = k_new;
+    if (done)
+      break;
+  }
+  aspa_weibull_sums(y,n,k,s);
+  return k;
+}
+
+/** Fitted cdf at x > 0 */
+static double renewal_cdf(const aspa_renewal_model_fit * fit, double x)
+{
+  const double * par = fit->par;
+  switch (fit->model) {
+  case ASPA_RENEWAL_EXPONENTIAL:
+    return -expm1(-x/par[0]);
+  case ASPA_RENEWAL_GAMMA:
+    return gsl_cdf_gamma_P(x,par[0],par[1]);
+  case ASPA_RENEWAL_INVERSE_GAUSSIAN:
+    {
+      double r = sqrt(par[1]/x);
+      // the second term is a huge exponential times a tiny tail, the
+      // sum can round above 1
+      return GSL_MIN(gsl_cdf_gaussian_P(r*(x/par[0]-1.),1.)+
+		     exp(2.*par[1]/par[0]-M_LN2+gsl_sf_log_erfc(r*(x/par[0]+1.)*M_SQRT1_2)),1.);
+    }
+  case ASPA_RENEWAL_LOGNORMAL:
+    return gsl_cdf_gaussian_P((log(x)-par[0])/par[1],1.);
+  default:
+    return -expm1(-pow(x/par[1],par[0]));
+  }
+}
+
+/** Fits the models to the n sorted intervals x, y and u are buffers of
+    n doubles */
+static int renewal_fill(const double * x, size_t n, double * y, double * u,
+			aspa_renewal_fit * res)
+{
+  res->n = n;
+  res->best = ASPA_RENEWAL_EXPONENTIAL;
+  for (int m=0; m<ASPA_RENEWAL_N_MODELS; m++)
+    res->fit[m] = (aspa_renewal_model_fit) {.model=m, .par={GSL_NAN,GSL_NAN},
+					     .loglik=GSL_NAN, .aic=GSL_NAN, .bic=GSL_NAN,
+					     .D=GSL_NAN, .W2=GSL_NAN, .p_W2=GSL_NAN};
+  if (n < 2)
+    return 0;
+  if (!(x[0] > 0.))
+    return aspa_ctx_error(ASPA_EINVAL,"The intervals should be > 0 (tied spike times).");
+  // the sufficient statistics
+  double S = 0., L = 0., R = 0.;
+  for (size_t i=0; i<n; i++)
+  {
+    S += x[i];
+    y[i] = log(x[i]);
+    L += y[i];
+    R += 1./x[i];
+  }
+  double nd = n;
+  double mean = S/nd, log_mean = log(mean), y_mean = L/nd, V = 0.;
+  for (size_t i=0; i<n; i++)
+  {
+    double d = y[i]-y_mean;
+    V += d*d;
+    y[i] -= log_mean;
+  }
+  V /= nd;
+  aspa_renewal_model_fit * fit = res->fit;
+  fit[ASPA_RENEWAL_EXPONENTIAL].par[0] = mean;
+  fit[ASPA_RENEWAL_EXPONENTIAL].loglik = -nd*(log_mean+1.);
+  double k = gamma_shape(log_mean-y_mean);
+  double theta = mean/k;
+  fit[ASPA_RENEWAL_GAMMA].par[0] = k;
+  fit[ASPA_RENEWAL_GAMMA].par[1] = theta;
+  fit[ASPA_RENEWAL_GAMMA].loglik = (k-1.)*L-S/theta-nd*(k*log(theta)+gsl_sf_lngamma(k));
+  double lambda = 1./(R/nd-1./mean);
+  fit[ASPA_RENEWAL_INVERSE_GAUSSIAN].par[0] = mean;
+  fit[ASPA_RENEWAL_INVERSE_GAUSSIAN].par[1] = lambda;
+  fit[ASPA_RENEWAL_INVERSE_GAUSSIAN].loglik = 0.5*nd*(log(lambda/(2.*M_PI))-1.)-1.5*L;
+  fit[ASPA_RENEWAL_LOGNORMAL].par[0] = y_mean;
+  fit[ASPA_RENEWAL_LOGNORMAL].par[1] = sqrt(V);
+  fit[ASPA_RENEWAL_LOGNORMAL].loglik = -L-0.5*nd*(log(2.*M_PI*V)+1.);
+  double s[3];
+  k = weibull_shape(y,n,y_mean-log_mean,sqrt(V),s);
+  double scale = mean*pow(s[0]/nd,1./k);
+  fit[ASPA_RENEWAL_WEIBULL].par[0] = k;
+  fit[ASPA_RENEWAL_WEIBULL].par[1] = scale;
+  fit[ASPA_RENEWAL_WEIBULL].loglik = nd*(log(k)-k*log(scale)-1.)+(k-1.)*L;
+  // information criteria and tests against the fitted cdf
+  double W2[ASPA_RENEWAL_N_MODELS];
+  int sizes[ASPA_RENEWAL_N_MODELS];
+  for (int m=0; m<ASPA_RENEWAL_N_MODELS; m++)
+  {
+    fit[m].aic = 2.*n_par[m]-2.*fit[m].loglik;
+    fit[m].bic = n_par[m]*log(nd)-2.*fit[m].loglik;
+    if (fit[m].aic < fit[res->best].aic)
+      res->best = m;
+    if (m == ASPA_RENEWAL_LOGNORMAL)
+    {
+      for (size_t i=0; i<n; i++)
+	u[i] = (y[i]+log_mean-y_mean)/fit[m].par[1];
+      aspa_cdf_norm_P_array(u,u,n);
+    }
+    else
+      for (size_t i=0; i<n; i++)
+	u[i] = renewal_cdf(fit+m,x[i]);
+    fit[m].D = aspa_ks_stats_array(u,n).D;
+    gsl_vector_view u_v = gsl_vector_view_array(u,n);
+    fit[m].W2 = aspa_AndersonDarling_W2(&u_v.vector,true);
+    W2[m] = isfinite(fit[m].W2) ? fit[m].W2 : 1.;
+    sizes[m] = (int) n;
+  }
+  aspa_cdf_AD_P_array(W2,sizes,W2,ASPA_RENEWAL_N_MODELS);
+  for (int m=0; m<ASPA_RENEWAL_N_MODELS; m++)
+    // W2 is infinite when a fitted cdf rounds to 0 or 1
+    fit[m].p_W2 = isfinite(fit[m].W2) ? 1.-W2[m] : isnan(fit[m].W2) ? GSL_NAN : 0.;
+  return 0;
+}
+
+/** @brief Returns the fitted cdf of a renewal model
+ *
+ *  The signature is the one of an aspa_cdf_fn, so that the intervals
+ *  can be tested against the fit with `aspa_ks_stats_cdf`.
+ *
+ *  @param[in] x an interval (s)
+ *  @param[in] params a pointer to an aspa_renewal_model_fit
+ *  @returns Prob{X <= x}
+*/
+double aspa_renewal_cdf(double x, void * params)
+{
+  const aspa_renewal_model_fit * fit = params;
+  return x > 0. ? renewal_cdf(fit,x) : 0.;
+}
+
+/** @brief Fits the renewal models to inter spike intervals
+ *
+ *  See aspa_renewal.c. The fits are NaN with less than two intervals.
+ *
+ *  @param[in] isi a pointer to a gsl_vector of intervals, > 0
+ *  @param[out] res a pointer to an aspa_renewal_fit
+ *  @returns 0 if everything goes fine, an error code otherwise (the
+ *           fits are then NaN)
+*/
+int aspa_renewal_fit_isi(const gsl_vector * isi, aspa_renewal_fit * res)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(isi->size);
+  size_t n = isi->size;
+  double * x = aspa_ctx_malloc(3*(n > 0 ? n : 1)*sizeof(double));
+  if (x == NULL)
+    return ASPA_ENOMEM;
+  for (size_t i=0; i<n; i++)
+    x[i] = gsl_vector_get(isi,i);
+  int status = aspa_sort_w(x,n,x+n);
+  if (status == 0)
+    status = renewal_fill(x,n,x+n,x+2*n,res);
+  aspa_ctx_free(x);
+  return status;
+}
+
+typedef struct
+{
+  const aspa_sta * const * sta;
+  aspa_renewal_fit * res;
+  int * status; //!< One per unit
+} renewal_job;
+
+static void renewal_unit(size_t u_idx, void * params)
+{
+  renewal_job * job = params;
+  gsl_vector * isi = aspa_sta_isi(job->sta[u_idx]);
+  if (isi == NULL)
+  {
+    renewal_fill(NULL,0,NULL,NULL,job->res+u_idx);
+    job->status[u_idx] = ASPA_ENOMEM;
+    return;
+  }
+  job->status[u_idx] = aspa_renewal_fit_isi(isi,job->res+u_idx);
+  gsl_vector_free(isi);
+}
+
+/** @brief Fits the renewal models to the intervals of several units
+ *
+ *  The intervals of each unit are the within trial intervals of
+ *  `aspa_sta_isi`, see `aspa_renewal_fit_isi`.
+ *
+ *  @param[in] sta an array of n_units pointers to aspa_sta structures
+ *  @param[in] n_units the number of units
+ *  @param[out] res an array of n_units aspa_renewal_fit structures
+ *  @returns 0 if everything goes fine, the error code of the last unit
+ *           that failed otherwise (its fits are then NaN)
+*/
+int aspa_renewal_fit_units(const aspa_sta * const * sta, size_t n_units,
+			   aspa_renewal_fit * res)
+{
+  ASPA_PROF_SCOPE();
+  int * status = aspa_ctx_malloc(n_units*sizeof(int));
+  if (status == NULL)
+    return ASPA_ENOMEM;
+  size_t work = 0;
+  for (size_t u_idx=0; u_idx < n_units; u_idx++)
+    work += aspa_sta_n_spikes(sta[u_idx]);
+  ASPA_PROF_SPIKES(work);
+  renewal_job job = {.sta=sta, .res=res, .status=status};
+  aspa_parallel_for(n_units,work,renewal_unit,&job);
+  int ret = 0;
+  for (size_t u_idx=0; u_idx < n_units; u_idx++)
+    if (status[u_idx] != 0)
+      ret = status[u_idx];
+  aspa_ctx_free(status);
+  return ret;
+}
+
+/** @brief Prints the renewal fits of several units, one row per unit
+ *         and model after a header
+ *
+ *  The last column is 1 for the model of smallest AIC.
+ *
+ *  @param[in/out] STREAM a pointer to an open file
+ *  @param[in] res an array of n_units aspa_renewal_fit structures
+ *  @param[in] n_units the number of units
+ *  @returns 0 if everything goes fine, ASPA_EIO if the writing failed
+*/
+int aspa_renewal_fit_fprintf(FILE * STREAM, const aspa_renewal_fit * res, size_t n_units)
+{
+  fprintf(STREAM,"# unit model n par1 par2 loglik AIC BIC D W2 p_W2 best\n");
+  for (size_t u_idx=0; u_idx < n_units; u_idx++)
+    for (int m=0; m<ASPA_RENEWAL_N_MODELS; m++)
+    {
+      const aspa_renewal_model_fit * f = res[u_idx].fit+m;
+      fprintf(STREAM,"%zu %s %zu %g %g %g %g %g %g %g %g %d\n",u_idx,model_name[m],
+	      res[u_idx].n,f->par[0],f->par[1],f->loglik,f->aic,f->bic,f->D,f->W2,
+	      f->p_W2,res[u_idx].best == m);
+    }
+  if (ferror(STREAM))
+    return aspa_ctx_error(ASPA_EIO,"Writing the renewal fits failed.");
+  return 0;
+}
@@ -0,0 +1,82 @@
+/** @file aspa_renewal_test.c
+ *  @brief User program for testing the renewal model fits
+ *
+ *  The models are fitted to a simulated gamma train (shape 2, rate
+ *  15 Hz) and to a Poisson one (rate 15 Hz). The gamma model must be
+ *  the best one of the first unit, with a shape within 10% of 2 and a
+ *  scale within 10% of 1/30 s, the exponential mean of the second unit
+ *  must be within 5% of 1/15 s. The fits of aspa_renewal_fit_units
+ *  must be the ones of aspa_renewal_fit_isi, the Weibull shape must
+ *  maximise the likelihood and the Kolmogorov statistic of each fit
+ *  must be the one of its cdf.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa_test.h"
+
+/** Returns the Weibull log likelihood of the sample x */
+double weibull_loglik(const gsl_vector * x, double k, double lambda)
+{
+  double res = 0.;
+  for (size_t i=0; i<x->size; i++)
+  {
+    double z = gsl_vector_get(x,i)/lambda;
+    res += log(k/lambda)+(k-1.)*log(z)-pow(z,k);
+  }
+  return res;
+}
+
+int main()
+{
+  aspa_sta * sta = test_sim_sta(ASPA_TEST_SEED,4000,15.,2.,10.);
+  aspa_sta * sta_b = test_sim_sta(ASPA_TEST_SEED+1,2000,15.,1.,10.);
+  const aspa_sta * units[2] = {sta, sta_b};
+  aspa_renewal_fit renewal[2];
+  if (aspa_renewal_fit_units(units,2,renewal) != 0)
+  {
+    fprintf(stderr,"aspa_renewal_fit_units failed\n");
+    exit(EXIT_FAILURE);
+  }
+  size_t n_failed = 0;
+  test_header("value");
+  const aspa_renewal_model_fit * gamma = renewal[0].fit+ASPA_RENEWAL_GAMMA;
+  n_failed += test_report("gamma train, best model is not gamma",
+			  renewal[0].best != ASPA_RENEWAL_GAMMA,0.);
+  n_failed += test_report("gamma train, shape / 2 - 1",fabs(gamma->par[0]/2.-1.),0.1);
+  n_failed += test_report("gamma train, scale / (1/30) - 1",fabs(gamma->par[1]*30.-1.),0.1);
+  n_failed += test_report("Poisson train, exponential mean / (1/15) - 1",
+			  fabs(renewal[1].fit[ASPA_RENEWAL_EXPONENTIAL].par[0]*15.-1.),0.05);
+  for (size_t u_idx=0; u_idx<2; u_idx++)
+  {
+    printf("Unit %d:\n",(int) u_idx);
+    gsl_vector * x = aspa_sta_isi(units[u_idx]);
+    aspa_renewal_fit single;
+    n_failed += aspa_renewal_fit_isi(x,&single) != 0;
+    double diff = 0.;
+    for (int m=0; m<ASPA_RENEWAL_N_MODELS; m++)
+      diff = GSL_MAX(diff,fabs(single.fit[m].loglik-renewal[u_idx].fit[m].loglik));
+    n_failed += test_report("  fit_isi / fit_units log likelihoods",diff,0.);
+    const aspa_renewal_model_fit * weibull = renewal[u_idx].fit+ASPA_RENEWAL_WEIBULL;
+    double gain = -INFINITY;
+    for (int side=-1; side<=1; side+=2)
+      gain = GSL_MAX(gain,weibull_loglik(x,weibull->par[0]*(1.+side*1e-3),weibull->par[1])-
+		     weibull->loglik);
+    n_failed += test_report("  Weibull, loglik gain at shape*(1+-1e-3)",gain,0.);
+    gsl_sort_vector(x);
+    double diff_D = 0., n_outside = 0.;
+    for (int m=0; m<ASPA_RENEWAL_N_MODELS; m++)
+    {
+      aspa_renewal_model_fit * fit = renewal[u_idx].fit+m;
+      aspa_ks_stats ks = aspa_ks_stats_cdf(x->data,x->size,aspa_renewal_cdf,fit);
+      diff_D = GSL_MAX(diff_D,fabs(ks.D-fit->D));
+      n_outside += !(fit->p_W2 >= 0. && fit->p_W2 <= 1.);
+    }
+    n_failed += test_report("  D / ks_stats_cdf of the fitted cdf",diff_D,1e-12);
+    n_failed += test_report("  p-values of W2 outside [0,1]",n_outside,0.);
+    gsl_vector_free(x);
+  }
+  printf("Checks failed: %d (0 expected).\n",(int) n_failed);
+  aspa_sta_free(sta);
+  aspa_sta_free(sta_b);
+  return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,276 @@
+/** @file aspa_rescale.c
+ *  @brief Function definitions for the time rescaling of spike trains
+ *         by an intensity
+ *
+ *  If the spikes of a trial are an inhomogeneous Poisson process of
+ *  intensity lambda(t), the times Lambda(t_i), where Lambda is the
+ *  integral of lambda, are a homogeneous Poisson process of rate 1
+ *  (the time rescaling theorem). The rescaled spike trains can then be
+ *  given to the tests of the homogeneous Poisson hypothesis, the
+ *  goodness of fit battery of aspa_gof.c in particular.
+ *
+ *  The intensity is piecewise constant (a PSTH, a Bayesian Blocks
+ *  histogram) or piecewise linear between knots. The integral of the
+ *  intensity up to each knot is tabulated once, Lambda(t) then costs
+ *  one polynomial of degree 1 or 2 from the knot just before t. The
+ *  spike times of a trial are sorted: the knot of each spike is found
+ *  by moving forward from the knot of the previous spike (a merge of
+ *  the spike times with the knots), the trials are rescaled in
+ *  parallel.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+/** @brief Allocates an intensity
+ *
+ *  The intensity is rate[i] on [t[i],t[i+1]) (ASPA_INTENSITY_STEP) or
+ *  linear between (t[i],rate[i]) and (t[i+1],rate[i+1])
+ *  (ASPA_INTENSITY_LINEAR); it is rate[0] before t[0] and rate[n-1]
+ *  after t[n-1]. The integral of the intensity is taken from t[0].
+ *
+ *  @param[in] kind ASPA_INTENSITY_STEP or ASPA_INTENSITY_LINEAR
+ *  @param[in] t the n increasing knots (s, within trial time)
+ *  @param[in] rate the n intensities (Hz), >= 0
+ *  @param[in] n the number of knots, > 0
+ *  @returns a pointer to an allocated aspa_intensity, NULL if the
+ *           knots or intensities are not valid (ASPA_EINVAL) or if the
+ *           allocation failed (ASPA_ENOMEM)
+*/
+aspa_intensity * aspa_intensity_alloc(aspa_intensity_kind kind, const double * t,
+				      const double * rate, size_t n)
+{
+  if (n == 0)
+  {
+    aspa_ctx_error(ASPA_EINVAL,"An intensity needs at least one knot.");
+    return NULL;
+  }
+  for (size_t i=0; i<n; i++)
+  {
+    if (!(rate[i] >= 0.) || (i > 0 && !(t[i] > t[i-1])))
+    {
+      aspa_ctx_error(ASPA_EINVAL,"The knots of an intensity should be increasing"
+		     " and its values >= 0 (knot %zu).",i);
+      return NULL;
+    }
+  }
+  aspa_intensity * res = malloc(sizeof(aspa_intensity));
+  double * buffer = malloc(3*n*sizeof(double));
+  if (res == NULL || buffer == NULL)
+  {
+    free(res);
+    free(buffer);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the intensity failed.");
+    return NULL;
+  }
+  res->kind = kind;
+  res->n = n;
+  res->t = buffer;
+  res->rate = buffer+n;
+  res->cum = buffer+2*n;
+  memcpy(res->t,t,n*sizeof(double));
+  memcpy(res->rate,rate,n*sizeof(double));
+  res->cum[0] = 0.;
+  for (size_t i=1; i<n; i++)
+  {
+    double dt = t[i]-t[i-1];
+    double mean = kind == ASPA_INTENSITY_STEP ? rate[i-1] : 0.5*(rate[i-1]+rate[i]);
+    res->cum[i] = res->cum[i-1]+mean*dt;
+  }
+  return res;
+}
+
+/** @brief Frees an aspa_intensity
+ *
+ *  @param[in/out] intensity a pointer to an allocated aspa_intensity
+ *  @returns 0 if everything goes fine
+*/
+int aspa_intensity_free(aspa_intensity * intensity)
+{
+  free(intensity->t);
+  free(intensity);
+  return 0;
+}
+
+/** @brief Returns a piecewise constant intensity from a histogram
+ *
+ *  The intensity of each bin is its content times scale divided by
+ *  its width: with a histogram of the spike times of n trials (a
+ *  Bayesian Blocks one for instance, see `aspa_bayesian_blocks`),
+ *  scale=1/n gives the intensity in Hz.
+ *
+ *  @param[in] h a pointer to a gsl_histogram
+ *  @param[in] scale the factor of the bin contents
+ *  @returns a pointer to an allocated aspa_intensity, NULL if
+ *           something went wrong
+*/
+aspa_intensity * aspa_intensity_histogram(const gsl_histogram * h, double scale)
+{
+  double * rate = aspa_ctx_malloc(h->n*sizeof(double));
+  if (rate == NULL)
+    return NULL;
+  for (size_t b=0; b<h->n; b++)
+    rate[b] = h->bin[b]*scale/(h->range[b+1]-h->range[b]);
+  aspa_intensity * res = aspa_intensity_alloc(ASPA_INTENSITY_STEP,h->range,rate,h->n);
+  aspa_ctx_free(rate);
+  return res;
+}
+
+/** @brief Returns the peri-stimulus time histogram of an aspa_sta as
+ *         a piecewise constant intensity
+ *
+ *  The trial duration is cut in bins of width bin_width (the last one
+ *  can be shorter), the intensity of a bin is the number of spikes it
+ *  contains divided by its width and by the number of real trials
+ *  (n_trials times n_aggregated).
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] bin_width the width of the bins (s), > 0
+ *  @returns a pointer to an allocated aspa_intensity, NULL if
+ *           something went wrong
+*/
+aspa_intensity * aspa_intensity_psth(const aspa_sta * sta, double bin_width)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  if (!(bin_width > 0.) || !(sta->trial_duration > 0.))
+  {
+    aspa_ctx_error(ASPA_EINVAL,"The bin width and the trial duration should be > 0.");
+    return NULL;
+  }
+  size_t n_bins = (size_t) ceil(sta->trial_duration/bin_width);
+  double * t = aspa_ctx_malloc(2*n_bins*sizeof(double));
+  if (t == NULL)
+    return NULL;
+  double * rate = t+n_bins;
+  for (size_t b=0; b<n_bins; b++)
+  {
+    t[b] = b*bin_width;
+    rate[b] = 0.;
+  }
+  for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
+    for (size_t i=0; i < sta->st[t_idx]->size; i++)
+    {
+      double x = gsl_vector_get(sta->st[t_idx],i);
+      if (x >= 0. && x < sta->trial_duration)
+	rate[GSL_MIN((size_t) (x/bin_width),n_bins-1)] += 1.;
+    }
+  double n_real = (double) sta->n_trials*sta->n_aggregated;
+  for (size_t b=0; b<n_bins; b++)
+  {
+    double width = GSL_MIN(bin_width,sta->trial_duration-t[b]);
+    rate[b] /= n_real*width;
+  }
+  aspa_intensity * res = aspa_intensity_alloc(ASPA_INTENSITY_STEP,t,rate,n_bins);
+  aspa_ctx_free(t);
+  return res;
+}
+
+/** Lambda(x) from knot i, the last knot <= x (0 if x < t[0]) */
+static double integral_from(const aspa_intensity * intensity, size_t i, double x)
+{
+  const double * t = intensity->t;
+  const double * rate = intensity->rate;
+  double dx = x-t[i];
+  if (intensity->kind == ASPA_INTENSITY_STEP || dx < 0. || i+1 == intensity->n)
+    return intensity->cum[i]+rate[i]*dx;
+  double slope = (rate[i+1]-rate[i])/(t[i+1]-t[i]);
+  return intensity->cum[i]+(rate[i]+0.5*slope*dx)*dx;
+}
+
+/** The last knot <= x, searched from knot i <= that knot (0 if x <
+    t[0]) */
+static size_t knot_from(const aspa_intensity * intensity, size_t i, double x)
+{
+  const double * t = intensity->t;
+  size_t n = intensity->n;
+  if (i+1 == n || x < t[i+1])
+    return i;
+  if (i+2 == n || x < t[i+2])
+    return i+1;
+  // far away, bisection on (i+1,n)
+  size_t lo = i+1, hi = n;
+  while (hi-lo > 1)
+  {
+    size_t mid = lo+(hi-lo)/2;
+    if (x < t[mid])
+      hi = mid;
+    else
+      lo = mid;
+  }
+  return lo;
+}
+
+/** @brief Returns the integral of an intensity
+ *
+ *  @param[in] intensity a pointer to an aspa_intensity
+ *  @param[in] x the time (s)
+ *  @returns Lambda(x), the integral of the intensity from its first
+ *           knot to x
+*/
+double aspa_intensity_integral(const aspa_intensity * intensity, double x)
+{
+  return integral_from(intensity,knot_from(intensity,0,x),x);
+}
+
+typedef struct
+{
+  const aspa_intensity * intensity;
+  aspa_sta * res;
+} rescale_job;
+
+static void rescale_trial(const aspa_sta * sta, size_t t_idx, void * params)
+{
+  rescale_job * job = params;
+  const gsl_vector * st = sta->st[t_idx];
+  gsl_vector * rt = job->res->st[t_idx];
+  size_t knot = 0;
+  for (size_t i=0; i < st->size; i++)
+  {
+    double x = gsl_vector_get(st,i);
+    knot = knot_from(job->intensity,knot,x);
+    gsl_vector_set(rt,i,integral_from(job->intensity,knot,x));
+  }
+}
+
+/** @brief Rescales the spike times of an aspa_sta by an intensity
+ *
+ *  Each spike time t (within trial) is replaced by Lambda(t), the
+ *  integral of the intensity (see aspa_rescale.c); so are the onset,
+ *  the offset and the trial duration, the trial start times are kept.
+ *  If the intensity is the one of the trials, the result is a
+ *  homogeneous Poisson process of rate 1 and can be tested as such
+ *  with `aspa_gof_battery`. The spike times of each trial must be
+ *  sorted.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] intensity a pointer to an aspa_intensity
+ *  @returns a pointer to an allocated aspa_sta, NULL if the
+ *           allocation failed
+*/
+aspa_sta * aspa_time_rescale(const aspa_sta * sta, const aspa_intensity * intensity)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  aspa_sta * res = aspa_sta_alloc(sta->n_trials,sta->n_aggregated,
+				  aspa_intensity_integral(intensity,sta->onset),
+				  aspa_intensity_integral(intensity,sta->offset),
+				  aspa_intensity_integral(intensity,sta->trial_duration));
+  if (res == NULL)
+    return NULL;
+  for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
+  {
+    aspa_sta_set_st_start(res,t_idx,aspa_sta_get_st_start(sta,t_idx));
+    res->st[t_idx] = gsl_vector_alloc(sta->st[t_idx]->size);
+    if (res->st[t_idx] == NULL)
+    {
+      aspa_sta_free(res);
+      aspa_ctx_error(ASPA_ENOMEM,"Allocation of the rescaled spike trains failed.");
+      return NULL;
+    }
+  }
+  rescale_job job = {.intensity=intensity, .res=res};
+  aspa_sta_parallel_for(sta,rescale_trial,&job);
+  return res;
+}
@@ -0,0 +1,95 @@
+/** @file aspa_rescale_test.c
+ *  @brief User program for testing function aspa_time_rescale
+ *
+ *  A simulated gamma train is rescaled by its PSTH and by a linear
+ *  intensity. Each rescaled time must be the integral of the intensity
+ *  up to the spike time, and the integral of the linear intensity is
+ *  compared with the area of its two trapezoids. An homogeneous
+ *  Poisson train of rate 20 Hz rescaled by its rate must have
+ *  exponential intervals of mean 1: the p-values of Kolmogorov's test
+ *  of the intervals of each trial must be uniform. Rescaled by 25 Hz
+ *  instead, they must not.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa_test.h"
+
+/** Returns the largest difference between the rescaled times and the
+    integral of intensity at the spike times of sta */
+double max_diff(const aspa_sta * sta, const aspa_sta * rescaled, const aspa_intensity * intensity)
+{
+  double res = 0.;
+  for (size_t t_idx=0; t_idx<sta->n_trials; t_idx++)
+    for (size_t i=0; i<sta->st[t_idx]->size; i++)
+    {
+      double x = gsl_vector_get(sta->st[t_idx],i);
+      res = GSL_MAX(res,fabs(gsl_vector_get(rescaled->st[t_idx],i)-aspa_intensity_integral(intensity,x)));
+    }
+  return res;
+}
+
+/** The exponential cdf of mean 1 */
+double exp_cdf(double x, void * params)
+{
+  return 1.-exp(-x);
+}
+
+/** Returns the p-value of the uniformity test of the p-values of
+    Kolmogorov's test of the intervals of each trial of sta rescaled
+    by the constant intensity rate */
+double rescaled_p(const aspa_sta * sta, double rate)
+{
+  const double knot[1] = {0.};
+  aspa_intensity * constant = aspa_intensity_alloc(ASPA_INTENSITY_STEP,knot,&rate,1);
+  aspa_sta * rescaled = aspa_time_rescale(sta,constant);
+  double * p = malloc(sta->n_trials*sizeof(double));
+  for (size_t t_idx=0; t_idx<sta->n_trials; t_idx++)
+  {
+    gsl_vector * st = rescaled->st[t_idx];
+    gsl_vector * isi = gsl_vector_alloc(st->size);
+    for (size_t i=0; i<st->size; i++)
+      gsl_vector_set(isi,i,gsl_vector_get(st,i)-(i > 0 ? gsl_vector_get(st,i-1) : 0.));
+    gsl_sort_vector(isi);
+    aspa_ks_stats ks = aspa_ks_stats_cdf(isi->data,isi->size,exp_cdf,NULL);
+    p[t_idx] = 1.-aspa_cdf_K((int) isi->size,ks.D);
+    gsl_vector_free(isi);
+  }
+  double res = test_uniform_p(p,sta->n_trials);
+  free(p);
+  aspa_sta_free(rescaled);
+  aspa_intensity_free(constant);
+  return res;
+}
+
+int main()
+{
+  aspa_sta * sta = test_sim_sta(ASPA_TEST_SEED,4000,15.,2.,10.);
+  size_t n_failed = 0;
+  test_header("value");
+  aspa_intensity * psth = aspa_intensity_psth(sta,0.5);
+  const double knot[3] = {0.,5.,20.}, knot_rate[3] = {10.,40.,5.};
+  aspa_intensity * linear = aspa_intensity_alloc(ASPA_INTENSITY_LINEAR,knot,knot_rate,3);
+  aspa_sta * rescaled = aspa_time_rescale(sta,psth);
+  aspa_sta * rescaled_b = aspa_time_rescale(sta,linear);
+  if (rescaled == NULL || rescaled_b == NULL)
+  {
+    fprintf(stderr,"aspa_time_rescale failed\n");
+    exit(EXIT_FAILURE);
+  }
+  n_failed += test_report("PSTH rescaling / intensity_integral",max_diff(sta,rescaled,psth),0.);
+  n_failed += test_report("linear rescaling / intensity_integral",max_diff(sta,rescaled_b,linear),0.);
+  n_failed += test_report("linear integral on [0,20] / trapezoids",
+			  fabs(aspa_intensity_integral(linear,20.)-(125.+337.5)),1e-12);
+  aspa_sta_free(rescaled);
+  aspa_sta_free(rescaled_b);
+  aspa_intensity_free(psth);
+  aspa_intensity_free(linear);
+  aspa_sta_free(sta);
+  // homogeneous Poisson train, about 200 trials of 200 spikes
+  sta = test_sim_sta(ASPA_TEST_SEED,40000,20.,1.,10.);
+  n_failed += test_report_p("Poisson rescaled by its rate, uniform p",rescaled_p(sta,20.),0.01);
+  n_failed += test_report("Poisson rescaled by 25 Hz, uniform p",rescaled_p(sta,25.),0.01);
+  aspa_sta_free(sta);
+  printf("Checks failed: %d (0 expected).\n",(int) n_failed);
+  return n_failed == 0 ? 0 : 1;
+}
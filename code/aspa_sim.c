@@ -0,0 +1,175 @@
+/** @file aspa_sim.c
+ *  @brief Function definitions for the simulation of spike trains
+ *
+ *  Each generator returns a `gsl_vector` holding exactly `n` increasing
+ *  spike times (in s) starting from time 0, so that the size of the
+ *  data can be controlled directly (for benchmarks in particular).
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+
+/** @brief Simulates an homogeneous Poisson process
+ *
+ *  @param[in] rng a pointer to an initialized gsl_rng
+ *  @param[in] n the number of spikes
+ *  @param[in] rate the rate (Hz)
+ *  @returns a pointer to an allocated gsl_vector
+*/
+gsl_vector * aspa_sim_poisson(const gsl_rng * rng, size_t n, double rate)
+{
+  assert (n > 0 && rate > 0.);
+  gsl_vector * res = gsl_vector_alloc(n);
+  double t = 0.;
+  for (size_t i=0; i<n; i++)
+  {
+    t += gsl_ran_exponential(rng,1./rate);
+    gsl_vector_set(res,i,t);
+  }
+  return res;
+}
+
+/** @brief Simulates a gamma renewal process
+ *
+ *  The inter spike intervals follow a gamma distribution with shape
+ *  parameter `shape` and mean 1/rate (shape > 1 gives more regular trains
+ *  than a Poisson process, shape < 1 more irregular ones).
+ *
+ *  @param[in] rng a pointer to an initialized gsl_rng
+ *  @param[in] n the number of spikes
+ *  @param[in] rate the rate (Hz)
+ *  @param[in] shape the shape parameter
+ *  @returns a pointer to an allocated gsl_vector
+*/
+gsl_vector * aspa_sim_gamma(const gsl_rng * rng, size_t n, double rate, double shape)
+{
+  assert (n > 0 && rate > 0. && shape > 0.);
+  gsl_vector * res = gsl_vector_alloc(n);
+  double scale = 1./(rate*shape);
+  double t = 0.;
+  for (size_t i=0; i<n; i++)
+  {
+    t += gsl_ran_gamma(rng,shape,scale);
+    gsl_vector_set(res,i,t);
+  }
+  return res;
+}
+
+/** @brief Simulates an inhomogeneous Poisson process by thinning
+ *
+ *  The events of an homogeneous Poisson process with rate `rate_max`
+ *  are kept with probability intensity(t)/rate_max, see Lewis and
+ *  Shedler (1979) Simulation of nonhomogeneous poisson processes by
+ *  thinning [_Naval Research Logistics Quarterly_ __26__: 403-413](https://doi.org/10.1002/nav.3800260304).
+ *
+ *  @param[in] rng a pointer to an initialized gsl_rng
+ *  @param[in] n the number of spikes
+ *  @param[in] intensity the intensity function (Hz), called with the
+ *             time and `params`
+ *  @param[in] params the parameters of `intensity`
+ *  @param[in] rate_max an upper bound of `intensity`
+ *  @returns a pointer to an allocated gsl_vector
+*/
+gsl_vector * aspa_sim_thinning(const gsl_rng * rng, size_t n,
+			       double (* intensity)(double t, void * params),
+			       void * params, double rate_max)
+{
+  assert (n > 0 && rate_max > 0.);
+  gsl_vector * res = gsl_vector_alloc(n);
+  double t = 0.;
+  size_t i = 0;
+  while (i < n)
+  {
+    t += gsl_ran_exponential(rng,1./rate_max);
+    if (gsl_rng_uniform(rng)*rate_max <= (*intensity)(t,params))
+      gsl_vector_set(res,i++,t);
+  }
+  return res;
+}
+
+/** @brief Simulates a bursting neuron
+ *
+ *  Bursts are separated by exponential silent periods with mean
+ *  1/burst_rate. A burst contains 1 + a Poisson number (with mean
+ *  spikes_per_burst-1) of spikes separated by exponential intervals
+ *  with mean 1/intra_rate.
+ *
+ *  @param[in] rng a pointer to an initialized gsl_rng
+ *  @param[in] n the number of spikes
+ *  @param[in] burst_rate the rate of the bursts (Hz)
+ *  @param[in] spikes_per_burst the mean number of spikes per burst (>= 1)
+ *  @param[in] intra_rate the rate within bursts (Hz)
+ *  @returns a pointer to an allocated gsl_vector
+*/
+gsl_vector * aspa_sim_bursting(const gsl_rng * rng, size_t n, double burst_rate,
+			       double spikes_per_burst, double intra_rate)
+{
+  assert (n > 0 && burst_rate > 0. && spikes_per_burst >= 1. && intra_rate > 0.);
+  gsl_vector * res = gsl_vector_alloc(n);
+  double t = 0.;
+  size_t i = 0;
+  while (i < n)
+  {
+    t += gsl_ran_exponential(rng,1./burst_rate);
+    size_t n_burst = 1+gsl_ran_poisson(rng,spikes_per_burst-1.);
+    for (size_t j=0; j<n_burst && i<n; j++)
+    {
+      if (j > 0)
+	t += gsl_ran_exponential(rng,1./intra_rate);
+      gsl_vector_set(res,i++,t);
+    }
+  }
+  return res;
+}
+
+/** @brief Cuts a long spike train into trials
+ *
+ *  Trial i covers [k_i trial_duration,(k_i+1) trial_duration) and
+ *  only the trials containing spikes are kept, like with
+ *  `aspa_sta_from_raw` and an inter trial interval equal to the trial
+ *  duration; the spike times of the result are relative to the trial
+ *  start. Unlike `aspa_sta_from_raw` no copy of the spike train is
+ *  made on the stack, so very long trains can be used.
+ *
+ *  @param[in] train a pointer to a gsl_vector of increasing spike times
+ *  @param[in] trial_duration the trial duration (s)
+ *  @returns a pointer to an allocated aspa_sta, NULL if the allocation
+ *           failed
+*/
+aspa_sta * aspa_sim_sta(const gsl_vector * train, double trial_duration)
+{
+  assert (train->size > 0 && trial_duration > 0.);
+  size_t n = train->size;
+  size_t n_trials = 1;
+  for (size_t i=1; i<n; i++)
+    if (floor(gsl_vector_get(train,i)/trial_duration) >
+	floor(gsl_vector_get(train,i-1)/trial_duration))
+      n_trials++;
+  aspa_sta * res = aspa_sta_alloc(n_trials,1,0.,0.,trial_duration);
+  if (res == NULL)
+    return NULL;
+  size_t first = 0;
+  for (size_t t_idx=0; t_idx<n_trials; t_idx++)
+  {
+    double k = floor(gsl_vector_get(train,first)/trial_duration);
+    size_t last = first+1;
+    while (last < n && floor(gsl_vector_get(train,last)/trial_duration) == k)
+      last++;
+    double start = k*trial_duration;
+    aspa_sta_set_st_start(res,t_idx,start);
+    res->st[t_idx] = gsl_vector_alloc(last-first);
+    if (res->st[t_idx] == NULL)
+    {
+      aspa_sta_free(res);
+      aspa_ctx_error(ASPA_ENOMEM,"Allocation of the spike train array failed.");
+      return NULL;
+    }
+    for (size_t i=first; i<last; i++)
+      gsl_vector_set(res->st[t_idx],i-first,gsl_vector_get(train,i)-start);
+    first = last;
+  }
+  return res;
+}
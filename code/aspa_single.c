@@ -15,34 +15,56 @@
  *
  *  @param[in] STREAM a pointer to an opened text file
  *  @param[in] sampling_frequency as its name says (in Hz)
- *  @returns a pointer to an initialized gsl_vector
+ *  @returns a pointer to an initialized gsl_vector, NULL if the
+ *           stream could not be read or was empty
 */
 gsl_vector * aspa_raw_fscanf(FILE * STREAM,
 			     double sampling_frequency)
 {
+  ASPA_PROF_SCOPE();
   size_t buffer_length = default_length;
-  double *buffer=calloc(buffer_length, sizeof(double));
+  double *buffer=aspa_ctx_malloc(buffer_length*sizeof(double));
+  if (buffer == NULL)
+    return NULL;
   size_t counter=0;
   char line[BUFSIZ];
   while (fgets (line, BUFSIZ, STREAM))
   {
     buffer[counter] = atof(line)/sampling_frequency;
+    ASPA_PROF_BYTES(strlen(line));
     counter++;
     if (counter>=buffer_length)
     {
+      double * larger = aspa_ctx_malloc(2*buffer_length*sizeof(double));
+      if (larger == NULL)
+      {
+	aspa_ctx_free(buffer);
+	return NULL;
+      }
+      memcpy(larger,buffer,buffer_length*sizeof(double));
+      aspa_ctx_free(buffer);
+      buffer=larger;
       buffer_length*=2;
-      buffer=realloc(buffer,buffer_length*sizeof(double));
     }
   }
-  if (!feof(STREAM))
+  if (!feof(STREAM) || counter == 0)
   {
-    fprintf (stderr, "Reading problem\n");
-    exit (EXIT_FAILURE);
+    aspa_ctx_free(buffer);
+    aspa_ctx_error(feof(STREAM) ? ASPA_EFORMAT : ASPA_EIO, "Reading problem");
+    return NULL;
   }
   gsl_vector * res = gsl_vector_alloc(counter);
+  if (res == NULL)
+  {
+    aspa_ctx_free(buffer);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the spike train failed.");
+    return NULL;
+  }
+  ASPA_PROF_ALLOC(counter*sizeof(double));
+  ASPA_PROF_SPIKES(counter);
   for (size_t i=0; i<counter; i++)
     gsl_vector_set(res,i,buffer[i]);
-  free(buffer);
+  aspa_ctx_free(buffer);
   return res;
 }
 
@@ -61,27 +83,48 @@ gsl_vector * aspa_raw_fscanf(FILE * STREAM,
 */
 aspa_sta * aspa_sta_alloc(size_t n_trials, size_t n_aggregated, double onset, double offset, double trial_duration)
 {
+  ASPA_PROF_SCOPE();
   aspa_sta * res = malloc(sizeof(aspa_sta));
+  if (res == NULL)
+  {
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the spike train array failed.");
+    return NULL;
+  }
   res->n_trials = n_trials;
   res->n_aggregated = n_aggregated;
   res->onset = onset;
   res->offset = offset;
   res->trial_duration = trial_duration;
-  res->trial_start_time = malloc(n_trials*sizeof(double));
-  res->st = malloc(n_trials*sizeof(gsl_vector *));
+  res->cache = NULL;
+  res->trial_start_time = malloc((n_trials ? n_trials : 1)*sizeof(double));
+  res->st = calloc(n_trials ? n_trials : 1,sizeof(gsl_vector *));
+  if (res->trial_start_time == NULL || res->st == NULL)
+  {
+    free(res->trial_start_time);
+    free(res->st);
+    free(res);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the spike train array failed.");
+    return NULL;
+  }
+  ASPA_PROF_ALLOC(sizeof(aspa_sta)+n_trials*(sizeof(double)+sizeof(gsl_vector *)));
   return res;
 }
 
 /** @brief Frees an aspa_sta
+ *
+ *  The spike trains not allocated yet (NULL) are skipped, so that
+ *  a partially filled aspa_sta can be freed.
  *
  *  @param[in/out] A pointer to an allocated aspa_sta structure
- *  @returns 0 if everything goes fine 
+ *  @returns 0 if everything goes fine
 */
 int aspa_sta_free(aspa_sta * sta)
 {
+  aspa_sta_cache_disable(sta);
   free(sta->trial_start_time);
   for (size_t i=0; i < sta->n_trials; i++)
-    gsl_vector_free(sta->st[i]);
+    if (sta->st[i] != NULL)
+      gsl_vector_free(sta->st[i]);
   free(sta->st);
   free(sta);
   return 0;
@@ -134,6 +177,83 @@ int aspa_sta_set_st_start(aspa_sta * sta, size_t st_index, double time)
 {
   assert (st_index < sta->n_trials);
   sta->trial_start_time[st_index]=time;
+  aspa_sta_cache_invalidate(sta);
+  return 0;
+}
+
+#define CACHE_N_SPIKES 1
+#define CACHE_N_SPIKES_MAX 2
+
+/** Quantities derived from the spike trains of an aspa_sta */
+struct aspa_sta_cache
+{
+  unsigned valid; //!< CACHE_* bits of the counts computed
+  size_t n_spikes; //!< Total number of spikes
+  size_t n_spikes_max; //!< Largest number of spikes in a trial
+  gsl_vector * isi; //!< Inter spike intervals
+  gsl_permutation * isi_rank; //!< Their ranks
+  aspa_sta * aggregated; //!< Aggregated spike train
+};
+
+/** @brief Makes an aspa_sta keep the quantities derived from its
+ *         spike trains
+ *
+ *  Once enabled, the number of spikes (total and largest per trial),
+ *  the ISI, their ranks and the aggregated train are computed the
+ *  first time they are needed and kept until the cache is invalidated:
+ *  `aspa_sta_isi`, `aspa_sta_isi_rank` and `aspa_sta_aggregate` then
+ *  return copies of the kept objects. The setters invalidate the
+ *  cache; code modifying the spike trains directly (through
+ *  `aspa_sta_get_st` for instance) must call
+ *  `aspa_sta_cache_invalidate`. A cached aspa_sta is modified by the
+ *  functions reading it and must therefore be used by a single thread
+ *  at a time.
+ *
+ *  @param[in/out] sta a pointer to an aspa_sta structure
+ *  @returns 0 if everything goes fine, ASPA_ENOMEM if the cache could
+ *           not be allocated
+*/
+int aspa_sta_cache_enable(aspa_sta * sta)
+{
+  if (sta->cache != NULL)
+    return 0;
+  sta->cache = calloc(1,sizeof(struct aspa_sta_cache));
+  if (sta->cache == NULL)
+    return aspa_ctx_error(ASPA_ENOMEM,"Allocation of the spike train array cache failed.");
+  return 0;
+}
+
+/** @brief Drops the quantities kept by the cache of an aspa_sta
+ *
+ *  Nothing is done if the cache is not enabled.
+ *
+ *  @param[in/out] sta a pointer to an aspa_sta structure
+ *  @returns nothing
+*/
+void aspa_sta_cache_invalidate(aspa_sta * sta)
+{
+  struct aspa_sta_cache * cache = sta->cache;
+  if (cache == NULL)
+    return;
+  if (cache->isi != NULL)
+    gsl_vector_free(cache->isi);
+  if (cache->isi_rank != NULL)
+    gsl_permutation_free(cache->isi_rank);
+  if (cache->aggregated != NULL)
+    aspa_sta_free(cache->aggregated);
+  memset(cache,0,sizeof(struct aspa_sta_cache));
+}
+
+/** @brief Frees the cache of an aspa_sta
+ *
+ *  @param[in/out] sta a pointer to an aspa_sta structure
+ *  @returns 0 if everything goes fine
+*/
+int aspa_sta_cache_disable(aspa_sta * sta)
+{
+  aspa_sta_cache_invalidate(sta);
+  free(sta->cache);
+  sta->cache = NULL;
   return 0;
 }
 
@@ -156,6 +276,13 @@ int aspa_sta_set_st_start(aspa_sta * sta, size_t st_index, double time)
 */
 aspa_sta * aspa_sta_from_raw(gsl_vector * raw, double inter_trial_interval, double onset, double offset, double trial_duration)
 {
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(raw->size);
+  if (raw->size == 0 || inter_trial_interval <= 0)
+  {
+    aspa_ctx_error(ASPA_EINVAL,"The spike train must not be empty and the inter trial interval must be > 0.");
+    return NULL;
+  }
   size_t n_spikes=raw->size; // Number of spikes in raw
   double iti = inter_trial_interval;
   // Find out the number of trials
@@ -173,29 +300,30 @@ aspa_sta * aspa_sta_from_raw(gsl_vector * raw, double inter_trial_interval, doub
     }
   }
   aspa_sta * res = aspa_sta_alloc(n_trials, 1, onset, offset, trial_duration);
-  double current_train[n_spikes];
+  if (res == NULL)
+    return NULL;
   size_t s_idx=0;
   for (size_t t_idx=0; t_idx<n_trials; t_idx++)
   {
-    double current_st = gsl_vector_get(raw,s_idx);
-    size_t current_idx = floor(current_st/iti);
+    size_t first=s_idx;
+    size_t current_idx = floor(gsl_vector_get(raw,first)/iti);
     aspa_sta_set_st_start(res,t_idx,current_idx*iti);
-    size_t within_index=0;
-    while (floor(current_st/iti) == current_idx)
-    {
-      current_train[within_index] = current_st-current_idx*iti;
-      within_index++;
+    // Find the end of the trial
+    while (s_idx < n_spikes && floor(gsl_vector_get(raw,s_idx)/iti) == current_idx)
       s_idx++;
-      if (s_idx == n_spikes)
-	break;
-      current_st = gsl_vector_get(raw,s_idx);
+    res->st[t_idx] = gsl_vector_alloc(s_idx-first);
+    if (res->st[t_idx] == NULL)
+    {
+      aspa_sta_free(res);
+      aspa_ctx_error(ASPA_ENOMEM,"Allocation of the spike train array failed.");
+      return NULL;
     }
-    res->st[t_idx] = gsl_vector_alloc(within_index);
+    ASPA_PROF_ALLOC((s_idx-first)*sizeof(double));
     gsl_vector * st = aspa_sta_get_st(res,t_idx);
-    for (size_t i=0; i<within_index; i++)
-      gsl_vector_set(st,i,current_train[i]);
+    for (size_t i=first; i<s_idx; i++)
+      gsl_vector_set(st,i-first,gsl_vector_get(raw,i)-current_idx*iti);
     if (s_idx == n_spikes)
-	break;
+      break;
   }
   return res;
 }
@@ -225,10 +353,12 @@ aspa_sta * aspa_sta_from_raw(gsl_vector * raw, double inter_trial_interval, doub
  *  @param[in/out] stream a pointer to an opened text file
  *  @param[in] sta pointer to the aspa_sta structure to be written
  *  @param[in] flat boolean indicator controlling what is written
- *  @returns0 if successful  
+ *  @returns 0 if successful, ASPA_EIO otherwise
 */
 int aspa_sta_fprintf(FILE * stream, const aspa_sta * sta, bool flat)
 {
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
   if (flat == false) {
     fprintf(stream,"# Number of trials: %d\n",(int) sta->n_trials);
     fprintf(stream,"# Number of aggregated trials: %d\n",(int) sta->n_aggregated);
@@ -254,6 +384,8 @@ int aspa_sta_fprintf(FILE * stream, const aspa_sta * sta, bool flat)
 	fprintf(stream,"%g\n", gsl_vector_get(st,s_idx)+t_start);
     }
   }
+  if (ferror(stream))
+    return aspa_ctx_error(ASPA_EIO,"Writing the spike train array failed.");
   return 0;
 }
 
@@ -278,30 +410,37 @@ int aspa_sta_fprintf(FILE * stream, const aspa_sta * sta, bool flat)
  *  \# End of trial:  
  *
  *  @param[in/out] stream a pointer to an opened text file
- *  @returnsa pointer to an allocated aspa_sta structure
+ *  @returns a pointer to an allocated aspa_sta structure, NULL if
+ *           the input does not follow this layout
 */
 aspa_sta * aspa_sta_fscanf(FILE * STREAM)
 {
+  ASPA_PROF_SCOPE();
   char buffer[256];
-  char value[128];
+  char value[5][128];
+  const char * header[] = {"# Number of trials:  %127s",
+			   "# Number of aggregated trials:  %127s",
+			   "# Stimulus onset:  %127s",
+			   "# Stimulus offset:  %127s",
+			   "# Single trial duration:  %127s"};
   // Read line per line
-  fgets(buffer, sizeof(buffer), STREAM);
-  sscanf(buffer, "# Number of trials:  %127s", value);
-  size_t n_trials = atoi(value);
-  fgets(buffer, sizeof(buffer), STREAM);
-  sscanf(buffer, "# Number of aggregated trials:  %127s", value);
-  size_t n_aggregated = atoi(value);
-  fgets(buffer, sizeof(buffer), STREAM);
-  sscanf(buffer, "# Stimulus onset:  %127s", value);
-  double onset = atof(value);
-  fgets(buffer, sizeof(buffer), STREAM);
-  sscanf(buffer, "# Stimulus offset:  %127s", value);
-  double offset = atof(value);
-  fgets(buffer, sizeof(buffer), STREAM);
-  sscanf(buffer, "# Single trial duration:  %127s", value);
-  double trial_duration = atof(value);
+  for (size_t i=0; i<5; i++)
+    if (fgets(buffer, sizeof(buffer), STREAM) == NULL ||
+	sscanf(buffer, header[i], value[i]) != 1)
+    {
+      aspa_ctx_error(ASPA_EFORMAT,"Badly formatted spike train array header.");
+      return NULL;
+    }
+  size_t n_trials = atoi(value[0]);
+  size_t n_aggregated = atoi(value[1]);
+  double onset = atof(value[2]);
+  double offset = atof(value[3]);
+  double trial_duration = atof(value[4]);
   aspa_sta * res = aspa_sta_alloc(n_trials, n_aggregated, onset, offset, trial_duration);
-  for (size_t t_idx=0; t_idx < n_trials; t_idx++)
+  if (res == NULL)
+    return NULL;
+  size_t t_idx;
+  for (t_idx=0; t_idx < n_trials; t_idx++)
   {
     // Read two blank lines
     fgets(buffer, sizeof(buffer), STREAM);
@@ -309,43 +448,88 @@ aspa_sta * aspa_sta_fscanf(FILE * STREAM)
     // Read line with trial number
     fgets(buffer, sizeof(buffer), STREAM);
     // Read line with trial start time
-    fgets(buffer, sizeof(buffer), STREAM);
-    sscanf(buffer, "# Trial start time:  %127s", value);
-    aspa_sta_set_st_start(res,t_idx,(double) atof(value));
+    if (fgets(buffer, sizeof(buffer), STREAM) == NULL ||
+	sscanf(buffer, "# Trial start time:  %127s", value[0]) != 1)
+      break;
+    aspa_sta_set_st_start(res,t_idx,(double) atof(value[0]));
     // Read line with the number of spikes
-    fgets(buffer, sizeof(buffer), STREAM);
-    sscanf(buffer, "# Number of spikes:  %127s", value);
-    size_t n_spikes = atoi(value);
+    if (fgets(buffer, sizeof(buffer), STREAM) == NULL ||
+	sscanf(buffer, "# Number of spikes:  %127s", value[0]) != 1 ||
+	atoi(value[0]) <= 0)
+      break;
+    size_t n_spikes = atoi(value[0]);
     // Allocate spike times vector
     res->st[t_idx] = gsl_vector_alloc(n_spikes);
+    if (res->st[t_idx] == NULL)
+      break;
+    ASPA_PROF_ALLOC(n_spikes*sizeof(double));
+    ASPA_PROF_SPIKES(n_spikes);
     // Loop over the spike times
-    for (size_t s_idx=0; s_idx < n_spikes; s_idx++)
+    size_t s_idx;
+    for (s_idx=0; s_idx < n_spikes; s_idx++)
     {
       float spike_time;
-      fgets(buffer, sizeof(buffer), STREAM);
-      sscanf(buffer,"%f",&spike_time);
-      //fscanf(STREAM,"%f",&spike_time);
+      if (fgets(buffer, sizeof(buffer), STREAM) == NULL ||
+	  sscanf(buffer,"%f",&spike_time) != 1)
+	break;
+      ASPA_PROF_BYTES(strlen(buffer));
       gsl_vector_set(res->st[t_idx],s_idx,(double) spike_time);
     }
+    if (s_idx < n_spikes)
+      break;
     // Read line with trial number
     fgets(buffer, sizeof(buffer), STREAM);
   }
+  if (n_trials == 0 || t_idx < n_trials)
+  {
+    aspa_sta_free(res);
+    aspa_ctx_error(ASPA_EFORMAT,"Badly formatted spike train array (trial %zu).",t_idx);
+    return NULL;
+  }
   return res;
 }
 
+static double trial_n_spikes(const aspa_sta * sta, size_t t_idx, void * params)
+{
+  return aspa_sta_get_st(sta,t_idx)->size;
+}
+
+static double sum_op(double a, double b)
+{
+  return a+b;
+}
+
 /** @brief Returns the total number of spikes contained in 
  *         an aspa_sta structure
  *
+ *  The trials are counted in parallel when there are many of them.
+ *
  *  @param[in] sta a pointer to an aspa_sta structure
  *  @result the total number of spikes
 */
 size_t aspa_sta_n_spikes(const aspa_sta * sta)
 {
+  struct aspa_sta_cache * cache = sta->cache;
+  if (cache != NULL && (cache->valid & CACHE_N_SPIKES))
+    return cache->n_spikes;
+  double n = GSL_NAN;
+  if (sta->n_trials >= ASPA_PARALLEL_MIN_WORK) // counts are exact as doubles
+    n = aspa_sta_parallel_reduce(sta,trial_n_spikes,sum_op,0.,NULL);
   size_t n_total = 0;
-  for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
+  if (!isnan(n))
+    n_total = (size_t) n;
+  else
   {
-    gsl_vector * st = aspa_sta_get_st(sta,t_idx);
-    n_total += st->size;
+    for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
+    {
+      gsl_vector * st = aspa_sta_get_st(sta,t_idx);
+      n_total += st->size;
+    }
+  }
+  if (cache != NULL)
+  {
+    cache->n_spikes = n_total;
+    cache->valid |= CACHE_N_SPIKES;
   }
   return n_total;
 }
@@ -358,6 +542,9 @@ size_t aspa_sta_n_spikes(const aspa_sta * sta)
 */
 size_t aspa_sta_n_spikes_max(const aspa_sta * sta)
 {
+  struct aspa_sta_cache * cache = sta->cache;
+  if (cache != NULL && (cache->valid & CACHE_N_SPIKES_MAX))
+    return cache->n_spikes_max;
   gsl_vector * st = aspa_sta_get_st(sta,0);
   size_t n_total = st->size;
   if (sta->n_trials > 1)
@@ -371,6 +558,11 @@ size_t aspa_sta_n_spikes_max(const aspa_sta * sta)
       }
     }
   }
+  if (cache != NULL)
+  {
+    cache->n_spikes_max = n_total;
+    cache->valid |= CACHE_N_SPIKES_MAX;
+  }
   return n_total;
 }
 
@@ -385,32 +577,95 @@ double aspa_sta_rate(const aspa_sta * sta)
   return aspa_sta_n_spikes(sta)/total_obs_time/sta->n_aggregated;
 }
 
+typedef struct
+{
+  double * isi;
+  size_t * offset; //!< Index of the first ISI of each trial
+} isi_job;
+
+static void isi_trial(const aspa_sta * sta, size_t t_idx, void * params)
+{
+  isi_job * job = params;
+  gsl_vector * st = aspa_sta_get_st(sta,t_idx);
+  double * isi = job->isi+job->offset[t_idx];
+  double present = gsl_vector_get(st,0);
+  for (size_t i=0; i < (st->size-1); i++)
+  {
+    double next = gsl_vector_get(st,i+1);
+    isi[i] = next-present;
+    present=next;
+  }
+}
+
+/** Writes the inter spike intervals of sta to isi, the trials are
+    processed in parallel */
+static int isi_fill(const aspa_sta * sta, double * isi)
+{
+  isi_job job = {.isi=isi, .offset=aspa_ctx_malloc(sta->n_trials*sizeof(size_t))};
+  if (job.offset == NULL)
+    return ASPA_ENOMEM;
+  size_t isi_idx=0;
+  for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
+  {
+    job.offset[t_idx] = isi_idx;
+    isi_idx += aspa_sta_get_st(sta,t_idx)->size-1;
+  }
+  aspa_sta_parallel_for(sta,isi_trial,&job);
+  aspa_ctx_free(job.offset);
+  return 0;
+}
+
+/** Returns the ISI of sta in a new gsl_vector, ignoring the cache */
+static gsl_vector * isi_compute(const aspa_sta * sta)
+{
+  if (aspa_sta_n_spikes(sta) <= sta->n_trials)
+  {
+    aspa_ctx_error(ASPA_EINVAL,"There are no inter spike intervals, all trials have a single spike.");
+    return NULL;
+  }
+  gsl_vector * isi = gsl_vector_alloc(aspa_sta_n_spikes(sta)-sta->n_trials);
+  if (isi == NULL)
+  {
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the inter spike intervals failed.");
+    return NULL;
+  }
+  if (isi_fill(sta,isi->data) != 0)
+  {
+    gsl_vector_free(isi);
+    return NULL;
+  }
+  return isi;
+}
+
 /** @brief Return a gsl_vector containing the inter spike intervals
  *         (ISI) of an aspa_sta structure.
  *
  *  The ISI from each trial are obtained and put together, one after
- *  the other.
+ *  the other. Large arrays are processed in parallel (see aspa_pool.c),
+ *  the result is the same.
+ *  If the cache of sta is enabled, a copy of the kept ISI is returned.
  *
  *  @param[in] sta a pointer to an apsa_sta structure
- *  @returns a pointer to a gsl_vector with the ISI
+ *  @returns a pointer to a gsl_vector with the ISI, NULL if there
+ *           is none
 */
 gsl_vector * aspa_sta_isi(const aspa_sta * sta)
 {
-  gsl_vector * isi = gsl_vector_alloc(aspa_sta_n_spikes(sta)-sta->n_trials);
-  size_t isi_idx=0;
-  for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  struct aspa_sta_cache * cache = sta->cache;
+  if (cache == NULL)
+    return isi_compute(sta);
+  if (cache->isi == NULL && (cache->isi = isi_compute(sta)) == NULL)
+    return NULL;
+  gsl_vector * res = gsl_vector_alloc(cache->isi->size);
+  if (res == NULL)
   {
-    gsl_vector * st = aspa_sta_get_st(sta,t_idx);
-    double present = gsl_vector_get(st,0);
-    for (size_t i=0; i < (st->size-1); i++)
-    {
-      double next = gsl_vector_get(st,i+1);
-      gsl_vector_set(isi,isi_idx,next-present);
-      present=next;
-      isi_idx++;
-    }
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the inter spike intervals failed.");
+    return NULL;
   }
-  return isi;
+  gsl_vector_memcpy(res,cache->isi);
+  return res;
 }
 
 /** @brief Prints in binary to stream the content of an aspa_sta structure
@@ -429,10 +684,13 @@ gsl_vector * aspa_sta_isi(const aspa_sta * sta)
  *  @param[in/out] stream a pointer to an opened text file
  *  @param[in] sta pointer to the aspa_sta structure to be written
  *  @param[in] flat boolean indicator controlling what is written
- *  @returns 0 if successful  
+ *  @returns 0 if successful, ASPA_EIO otherwise
 */
 int aspa_sta_fwrite(FILE * stream, const aspa_sta * sta, bool flat)
 {
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  ASPA_PROF_BYTES(aspa_sta_n_spikes(sta)*sizeof(double));
   if (flat == true) {
     // find out the total number of spikes
     size_t n_total = aspa_sta_n_spikes(sta);
@@ -463,6 +721,8 @@ int aspa_sta_fwrite(FILE * stream, const aspa_sta * sta, bool flat)
     fwrite(&(st->size),sizeof(size_t),1,stream);
     gsl_vector_fwrite(stream,st);
   }
+  if (ferror(stream))
+    return aspa_ctx_error(ASPA_EIO,"Writing the spike train array failed.");
   return 0;
 }
 
@@ -478,47 +738,60 @@ int aspa_sta_fwrite(FILE * stream, const aspa_sta * sta, bool flat)
  *  trial (size_t) followed by the within trials spike times.
  *
  *  @param[in/out] stream a pointer to an opened text file
- *  @returns a pointer to an allocated aspa_sta structure
+ *  @returns a pointer to an allocated aspa_sta structure, NULL if
+ *           the input does not follow this layout
 */
 aspa_sta * aspa_sta_fread(FILE * STREAM)
 {
-  size_t n_trials;
-  fread(&n_trials, sizeof(size_t),1,STREAM);
-  size_t n_aggregated;
-  fread(&n_aggregated, sizeof(size_t),1,STREAM);
-  double onset;
-  fread(&onset, sizeof(double),1,STREAM);
-  double offset;
-  fread(&offset, sizeof(double),1,STREAM);
-  double trial_duration;
-  fread(&trial_duration, sizeof(double),1,STREAM);
-  aspa_sta * res = aspa_sta_alloc(n_trials, n_aggregated, onset, offset, trial_duration);
+  ASPA_PROF_SCOPE();
+  size_t n[2]; // number of trials and of aggregated trials
+  double times[3]; // onset, offset and single trial duration
+  if (fread(n, sizeof(size_t),2,STREAM) != 2 ||
+      fread(times, sizeof(double),3,STREAM) != 3 || n[0] == 0)
+  {
+    aspa_ctx_error(ASPA_EFORMAT,"Badly formatted spike train array header.");
+    return NULL;
+  }
+  size_t n_trials = n[0];
+  aspa_sta * res = aspa_sta_alloc(n_trials, n[1], times[0], times[1], times[2]);
+  if (res == NULL)
+    return NULL;
   for (size_t t_idx=0; t_idx < n_trials; t_idx++)
   {
     double start_time;
-    fread(&start_time, sizeof(double),1,STREAM);
-    aspa_sta_set_st_start(res,t_idx,start_time);
     size_t n_spikes;
-    fread(&n_spikes, sizeof(size_t),1,STREAM);
-    // Allocate spike times vector
-    res->st[t_idx] = gsl_vector_alloc(n_spikes);
-    gsl_vector * st = aspa_sta_get_st(res,t_idx);
-    gsl_vector_fread(STREAM,st);
+    if (fread(&start_time, sizeof(double),1,STREAM) != 1 ||
+	fread(&n_spikes, sizeof(size_t),1,STREAM) != 1 || n_spikes == 0 ||
+	(res->st[t_idx] = gsl_vector_alloc(n_spikes)) == NULL ||
+	gsl_vector_fread(STREAM,res->st[t_idx]) != 0)
+    {
+      aspa_sta_free(res);
+      aspa_ctx_error(ASPA_EFORMAT,"Badly formatted spike train array (trial %zu).",t_idx);
+      return NULL;
+    }
+    aspa_sta_set_st_start(res,t_idx,start_time);
+    ASPA_PROF_ALLOC(n_spikes*sizeof(double));
+    ASPA_PROF_SPIKES(n_spikes);
+    ASPA_PROF_BYTES(n_spikes*sizeof(double));
   }
   return res;
 }
 
-/** @brief Aggregates many trials of a spike train
- *
- *  @param[in] sta pointer to the aspa_sta to aggregate
- *  @returns a pointer to new "aggregated" aspa_sta if everyhing goes fine.
-*/
-aspa_sta * aspa_sta_aggregate(const aspa_sta * sta)
+/** Returns the aggregated train of sta, ignoring the cache */
+static aspa_sta * aggregate_compute(const aspa_sta * sta)
 {
   aspa_sta * res = aspa_sta_alloc(1, sta->n_trials, sta->onset, sta->offset, sta->trial_duration);
+  if (res == NULL)
+    return NULL;
   aspa_sta_set_st_start(res,0,aspa_sta_get_st_start(sta,0));
   size_t n_trials = sta->n_trials;
   res->st[0] = gsl_vector_alloc(aspa_sta_n_spikes(sta));
+  if (res->st[0] == NULL)
+  {
+    aspa_sta_free(res);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the aggregated spike train failed.");
+    return NULL;
+  }
   gsl_vector * rst = aspa_sta_get_st(res,0);
   size_t s_idx=0;
   for (size_t t_idx=0; t_idx<n_trials; t_idx++)
@@ -530,7 +803,45 @@ aspa_sta * aspa_sta_aggregate(const aspa_sta * sta)
       s_idx++;
     }
   }
-  gsl_sort_vector(rst);
+  if (aspa_sort(rst->data,rst->size) != 0)
+  {
+    aspa_sta_free(res);
+    return NULL;
+  }
+  return res;
+}
+
+/** @brief Aggregates many trials of a spike train
+ *
+ *  If the cache of sta is enabled, a copy of the kept aggregated
+ *  train is returned.
+ *
+ *  @param[in] sta pointer to the aspa_sta to aggregate
+ *  @returns a pointer to new "aggregated" aspa_sta if everyhing goes fine,
+ *           NULL otherwise
+*/
+aspa_sta * aspa_sta_aggregate(const aspa_sta * sta)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  struct aspa_sta_cache * cache = sta->cache;
+  if (cache == NULL)
+    return aggregate_compute(sta);
+  if (cache->aggregated == NULL && (cache->aggregated = aggregate_compute(sta)) == NULL)
+    return NULL;
+  const aspa_sta * asta = cache->aggregated;
+  aspa_sta * res = aspa_sta_alloc(1, asta->n_aggregated, asta->onset, asta->offset, asta->trial_duration);
+  if (res == NULL)
+    return NULL;
+  aspa_sta_set_st_start(res,0,aspa_sta_get_st_start(asta,0));
+  res->st[0] = gsl_vector_alloc(asta->st[0]->size);
+  if (res->st[0] == NULL)
+  {
+    aspa_sta_free(res);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the aggregated spike train failed.");
+    return NULL;
+  }
+  gsl_vector_memcpy(res->st[0],asta->st[0]);
   return res;
 }
 
@@ -547,100 +858,25 @@ aspa_sta * aspa_sta_aggregate(const aspa_sta * sta)
  *   count increase due to each spike is 1 / number_of_trials can
  *   be displayed (param normalized -> true).
  *
+ *  Each counting process is decimated (see `aspa_lod_cp`) on
+ *  ASPA_LOD_WIDTH pixel columns before being sent to gnuplot.
+ *
  *  @param[in] sta a pointer to the sta structure
  *  @param[in] flat boolean controlling if actual or within trial
  *             time is used
  *  @param[in] normalized boolean controlling if the mean OCP is
  *             is displayed 
- *  @returns nothing the function is only used for its side effect
+ *  @returns 0 if everything goes fine, a negative error code otherwise
 */
-void aspa_cp_plot_i(const aspa_sta * sta, bool flat, bool normalized)
+int aspa_cp_plot_i(const aspa_sta * sta, bool flat, bool normalized)
 {
-  FILE *gp=NULL;
-  if (!gp)
-    gp = popen("gnuplot -persist","w");
-  if (!gp) {
-    printf("Couldn't open Gnuplot.\n");
-    return;
-  }
-  // We use an heredocs here since in the general case we want to
-  // show several data sets (see Janert pp 251-252).
-  fprintf(gp,"$d << EOD\n");
-  if (sta->onset < sta->offset)
-  {
-    double n_max = aspa_sta_n_spikes_max(sta);
-    if (normalized == true)
-      n_max /= sta->n_aggregated;
-    fprintf(gp,"%g %g\n", sta->onset, 0.0);
-    fprintf(gp,"%g %g\n", sta->onset, n_max);
-    fprintf(gp,"%g %g\n", sta->offset, n_max);
-    fprintf(gp,"%g %g\n", sta->offset, 0.0);
-    fprintf(gp,"\n\n");
-  }
-  if (normalized == true || flat == true) {
-    double step = 1.0/sta->n_aggregated;
-    double s_idx = step;
-    for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
-    {
-      gsl_vector * st = aspa_sta_get_st(sta,t_idx);
-      double start_time = aspa_sta_get_st_start(sta,t_idx);
-      for (size_t i=0; i < st->size; i++)
-      {
-	fprintf(gp,"%g %g\n", gsl_vector_get(st,i)+start_time, s_idx);
-	s_idx+=step;
-      }
-    }
-  } else {
-    for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
-    {
-      int s_idx = 1;
-      gsl_vector * st = aspa_sta_get_st(sta,t_idx);
-      for (size_t i=0; i < st->size; i++)
-      {
-	fprintf(gp,"%g %d\n", gsl_vector_get(st,i), (int) s_idx);
-	s_idx++;
-      }
-      fprintf(gp,"\n\n");
-    }
-  }
-  fprintf(gp,"EOD\n\n");
-  fprintf(gp,"set term qt; set grid; unset key\n");
-  fprintf(gp,"set xlabel 'Time (s)'\n");
-  if (normalized == true || flat == true) {
-    if (flat == true)
-    {
-      fprintf(gp,"set title 'Observed counting process'\n");
-      fprintf(gp,"set ylabel 'Events count'\n");
-      if (sta->onset < sta->offset)
-	fprintf(gp," plot $d index 1:%d using 1:2 with steps lc 'black'\n",(int) sta->n_trials);
-      else
-	fprintf(gp," plot $d using 1:2 with steps lc 'black'\n");
-    } else {
-      fprintf(gp,"set title 'Observed mean counting process'\n");
-      fprintf(gp,"set ylabel 'Mean events count'\n");
-      double n_max = aspa_sta_n_spikes_max(sta)/sta->n_aggregated;
-      if (sta->onset < sta->offset)
-      fprintf(gp," plot [0:%g] [0:%g] $d index 0 using 1:2 with filledcurve closed lc 'grey',"
-	      "$d index 1:%d using 1:2 with steps lc 'black'\n",
-	      sta->trial_duration, n_max, (int) sta->n_trials);
-      else
-	fprintf(gp," plot [0:%g] [0:%g] $d using 1:2 with steps lc 'black'\n",
-		sta->trial_duration, n_max);
-    }
-  } else {
-    fprintf(gp,"set title 'Observed counting processes'\n");
-    fprintf(gp,"set ylabel 'Events count'\n");
-    int n_max = aspa_sta_n_spikes_max(sta);
-    if (sta->onset < sta->offset)
-      fprintf(gp," plot [0:%g] [0:%d] $d index 0 using 1:2 with filledcurve closed lc 'grey',"
-	      "$d index 1:%d using 1:2 with steps lc 'black'\n",
-	      sta->trial_duration, n_max, (int) sta->n_trials);
-      else
-	fprintf(gp," plot [0:%g] [0:%d] $d using 1:2 with steps lc 'black'\n",
-		sta->trial_duration, n_max);
-  }
-  fflush(gp);
-  pclose(gp);
+  // A single level decimated on the default window width is enough
+  aspa_lod * lod = aspa_lod_cp(sta, flat, normalized, ASPA_LOD_WIDTH, 1);
+  if (lod == NULL)
+    return aspa_ctx_current()->status;
+  int status = aspa_lod_plot_i(lod, 0., 0., ASPA_LOD_WIDTH);
+  aspa_lod_free(lod);
+  return status;
 }
 
 /** @brief Writes the observed counting process assiociated with
@@ -666,6 +902,8 @@ void aspa_cp_plot_i(const aspa_sta * sta, bool flat, bool normalized)
 */
 int aspa_cp_plot_g(FILE * STREAM, const aspa_sta * sta, bool flat, bool normalized)
 {
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
   if ((sta->onset < sta->offset) && (flat == false))
   { // The stimulus timing is specified
     double n_max = aspa_sta_n_spikes_max(sta);
@@ -706,60 +944,29 @@ int aspa_cp_plot_g(FILE * STREAM, const aspa_sta * sta, bool flat, bool normaliz
       fprintf(STREAM,"\n\n");
     }
   }
+  if (ferror(STREAM))
+    return aspa_ctx_error(ASPA_EIO,"Writing the counting process plot failed.");
   return 0;
 }
 
 /** @brief Generates a raster plot from an aspa_sta structure
  *
- *  Gnuplot is called. An interactive window pops up.
+ *  A new window of the gnuplot session (see `aspa_gp_window`) pops up.
+ *  Each trial is decimated (see `aspa_lod_raster`) on ASPA_LOD_WIDTH
+ *  pixel columns before being sent to gnuplot.
  *
  *  @param[in] sta a pointer to an aspa_sta structure
- *  @returns nothing the function is only used for its side effect
+ *  @returns 0 if everything goes fine, a negative error code otherwise
 */
-void aspa_raster_plot_i(const aspa_sta * sta)
+int aspa_raster_plot_i(const aspa_sta * sta)
 {
-  FILE *gp=NULL;
-  if (!gp)
-    gp = popen("gnuplot -persist","w");
-  if (!gp) {
-    printf("Couldn't open Gnuplot.\n");
-    return;
-  }
-  // We use an heredocs here since in the general case we want to
-  // show several data sets (see Janert pp 251-252).
-  fprintf(gp,"$d << EOD\n");
-  if (sta->onset < sta->offset)
-  {
-    fprintf(gp,"%g %d\n", sta->onset, 0);
-    fprintf(gp,"%g %d\n", sta->onset, (int) sta->n_trials+1);
-    fprintf(gp,"%g %d\n", sta->offset, (int) sta->n_trials+1);
-    fprintf(gp,"%g %d\n", sta->offset, 0);
-    fprintf(gp,"\n\n");
-  }
-  for (size_t t_idx=0; t_idx < sta->n_trials; t_idx++)
-  {
-    gsl_vector * st = aspa_sta_get_st(sta,t_idx);
-    for (size_t i=0; i < st->size; i++)
-      fprintf(gp,"%g %d\n", gsl_vector_get(st,i), (int) t_idx+1);
-    fprintf(gp,"\n\n");
-  }
-  fprintf(gp,"EOD\n\n");
-  fprintf(gp,"set term qt; set grid; unset key\n");
-  fprintf(gp,"set xlabel 'Time (s)'\n");
-  fprintf(gp,"set ylabel 'Trial'\n");
-  if (sta->onset < sta->offset)
-  {
-    fprintf(gp," plot [0:%g] [0:%d] $d index 0 using 1:2 with filledcurve closed lc 'grey',"
-	    "$d index 1:%d using 1:2 with dots lc 'black'\n",
-	    sta->trial_duration, (int) sta->n_trials+1, (int) sta->n_trials);
-  }
-  else
-  {
-    fprintf(gp," plot [0:%g] [0:%d] $d using 1:2 with dots lc 'black'\n",
-	    sta->trial_duration, (int) sta->n_trials+1);
-  }
-  fflush(gp);
-  pclose(gp);
+  // A single level decimated on the default window width is enough
+  aspa_lod * lod = aspa_lod_raster(sta, ASPA_LOD_WIDTH, 1);
+  if (lod == NULL)
+    return aspa_ctx_current()->status;
+  int status = aspa_lod_plot_i(lod, 0., 0., ASPA_LOD_WIDTH);
+  aspa_lod_free(lod);
+  return status;
 }
 
 /** @brief Writes a raster plot from an aspa_sta structure
@@ -771,6 +978,8 @@ void aspa_raster_plot_i(const aspa_sta * sta)
 */
 int aspa_raster_plot_g(FILE * STREAM, const aspa_sta * sta)
 {
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
   if (sta->onset < sta->offset)
   { // The stimulus timing is specified
     fprintf(STREAM,"%g %d\n", sta->onset, 0);
@@ -786,9 +995,45 @@ int aspa_raster_plot_g(FILE * STREAM, const aspa_sta * sta)
       fprintf(STREAM,"%g %d\n", gsl_vector_get(st,i), (int) t_idx+1);
     fprintf(STREAM,"\n\n");
   }
+  if (ferror(STREAM))
+    return aspa_ctx_error(ASPA_EIO,"Writing the raster plot failed.");
   return 0;
 }
 
+/** Summary returned when the statistics cannot be computed */
+static const aspa_fns fns_failed = {.n=0,.mean=GSL_NAN,.min=GSL_NAN,
+				    .max=GSL_NAN,.upperq=GSL_NAN,.lowerq=GSL_NAN,
+				    .median=GSL_NAN,.mad=GSL_NAN,.var=GSL_NAN};
+
+/** Computes the summary of data with the work buffer tmp of 2n
+    doubles (NULL if the data are empty or the allocation failed) */
+static aspa_fns fns_compute(const gsl_vector * data, double * tmp)
+{
+  size_t n = data->size;
+  for (size_t i=0; i<n && tmp != NULL; i++)
+    tmp[i] = gsl_vector_get(data,i);
+  if (tmp == NULL || aspa_sort_w(tmp,n,tmp+n) != 0)
+  {
+    aspa_ctx_error(n > 0 ? ASPA_ENOMEM : ASPA_EINVAL,"The five number summary of %zu elements could not be computed.",n);
+    return fns_failed;
+  }
+  double median = gsl_stats_median_from_sorted_data(tmp,1,n);
+  double upperq = gsl_stats_quantile_from_sorted_data(tmp,1,n,0.75);
+  double lowerq = gsl_stats_quantile_from_sorted_data(tmp,1,n,0.25);
+  double min = tmp[0];
+  double max = tmp[n-1];
+  double mean = gsl_stats_mean(tmp,1,n);
+  double var = gsl_stats_variance(tmp,1,n);
+  for (size_t i=0; i<n; i++)
+    tmp[i] = fabs(tmp[i]-median);
+  if (aspa_sort_w(tmp,n,tmp+n) != 0)
+    return fns_failed;
+  double mad = 1.4826*gsl_stats_median_from_sorted_data(tmp,1,n);
+  return (aspa_fns) {.n=n,.mean=mean,.min=min,
+      .max=max,.upperq=upperq,.lowerq=lowerq,
+      .median=median,.mad=mad,.var=var};
+}
+
 /** @brief Compute five number summary of a gsl_vector
  *         as well as some other basic statistics
  *
@@ -797,30 +1042,34 @@ int aspa_raster_plot_g(FILE * STREAM, const aspa_sta * sta)
  *  (MAD), the mean and variance are computed.
  *
  *  @param[in] data a pointer to a `gsl_vector`
- *  @returnsan `aspa_fns` structure
+ *  @returns an `aspa_fns` structure, with n = 0 and NaN statistics
+ *           if the summary could not be computed
 */
 aspa_fns aspa_fns_get(const gsl_vector * data)
 {
-  size_t n = data->size;
-  gsl_vector * tmp = gsl_vector_alloc(n);
-  gsl_vector_memcpy(tmp,data);
-  gsl_sort_vector(tmp);
-  double median = gsl_stats_median_from_sorted_data(tmp->data,1,n);
-  double upperq = gsl_stats_quantile_from_sorted_data(tmp->data,1,n,0.75);
-  double lowerq = gsl_stats_quantile_from_sorted_data(tmp->data,1,n,0.25);
-  double min = gsl_vector_get(tmp,0);
-  double max = gsl_vector_get(tmp,n-1);
-  double mean = gsl_stats_mean(tmp->data,1,n);
-  double var = gsl_stats_variance(tmp->data,1,n);
-  gsl_vector_add_constant(tmp,-median);
-  for (size_t i=0; i<n; i++)
-    gsl_vector_set(tmp,i,fabs(gsl_vector_get(tmp,i)));
-  gsl_sort_vector(tmp);
-  double mad = 1.4826*gsl_stats_median_from_sorted_data(tmp->data,1,n);
-  gsl_vector_free(tmp);
-  return (aspa_fns) {.n=n,.mean=mean,.min=min,
-      .max=max,.upperq=upperq,.lowerq=lowerq,
-      .median=median,.mad=mad,.var=var};
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(data->size);
+  double * tmp = data->size > 0 ? aspa_ctx_malloc(2*data->size*sizeof(double)) : NULL;
+  aspa_fns res = fns_compute(data,tmp);
+  aspa_ctx_free(tmp);
+  return res;
+}
+
+/** @brief Returns an `aspa_fns` structure computed with a workspace
+ *
+ *  Same as `aspa_fns_get` but the copy of the data is made in `w`
+ *  (grown if needed) instead of a temporary buffer.
+ *
+ *  @param[in] data a pointer to a `gsl_vector` containing the data
+ *  @param[in/out] w a pointer to an aspa_fns_workspace
+ *  @returns an `aspa_fns` structure (n=0 and NaN if something went wrong)
+*/
+aspa_fns aspa_fns_get_w(const gsl_vector * data, aspa_fns_workspace * w)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(data->size);
+  double * tmp = data->size > 0 ? aspa_fns_workspace_reserve(w,2*data->size) : NULL;
+  return fns_compute(data,tmp);
 }
 
 /** @brief Prints to stream the content of an `aspa_fns` structure
@@ -851,15 +1100,96 @@ int aspa_fns_fprintf(FILE * STREAM, aspa_fns * fns)
  *
  *  @param[in] data a pointer to a gsl_vector
  *  @param[in] lag the lag at which the correlation is computed
- *  @returns the correlation coefficient
+ *  @returns the correlation coefficient, NaN if lag is too large
 */
 double aspa_lagged_spearman(const gsl_vector * data, size_t lag)
 {
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(data->size);
   size_t n = data->size;
-  assert (lag < n); // make sure the lag is small enough
+  if (lag+1 >= n) // make sure the lag is small enough
+  {
+    aspa_ctx_error(ASPA_EINVAL,"The lag (%zu) must be smaller than the sample size minus one (%zu).",lag,n);
+    return GSL_NAN;
+  }
   gsl_vector_const_view lagged = gsl_vector_const_subvector(data,lag,n-lag);
-  double work[2*(n-lag)];
-  return gsl_stats_spearman(data->data,1,(&lagged.vector)->data,1,n-lag,work);
+  double * work = aspa_ctx_malloc(2*(n-lag)*sizeof(double));
+  if (work == NULL)
+    return GSL_NAN;
+  double res = gsl_stats_spearman(data->data,data->stride,(&lagged.vector)->data,
+				  data->stride,n-lag,work);
+  aspa_ctx_free(work);
+  return res;
+}
+
+/** Returns the ISI ranks of sta, ignoring the cached ranks (the cached
+    ISI are used if they are there) */
+static gsl_permutation * isi_rank_compute(const aspa_sta * sta)
+{
+  if (aspa_sta_n_spikes(sta) <= sta->n_trials)
+  {
+    aspa_ctx_error(ASPA_EINVAL,"There are no inter spike intervals, all trials have a single spike.");
+    return NULL;
+  }
+  size_t n = aspa_sta_n_spikes(sta)-sta->n_trials;
+  const gsl_vector * cached = sta->cache != NULL ? sta->cache->isi : NULL;
+  double * isi = cached == NULL ? aspa_ctx_malloc(n*sizeof(double)) : NULL;
+  if (cached == NULL && isi == NULL)
+    return NULL;
+  gsl_permutation * rank = gsl_permutation_alloc(n);
+  if (rank == NULL)
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the ISI ranks failed.");
+  else if ((cached == NULL && isi_fill(sta,isi) != 0) ||
+	   aspa_rank(rank->data,cached == NULL ? isi : cached->data,n) != 0)
+  {
+    gsl_permutation_free(rank);
+    rank = NULL;
+  }
+  aspa_ctx_free(isi);
+  return rank;
+}
+
+/** @brief Returns the ranks of the inter spike intervals of an
+ *         aspa_sta structure
+ *
+ *  Element i of the result is the rank of the ith ISI of
+ *  `aspa_sta_isi`. Tied ISI get consecutive ranks in their order in
+ *  `aspa_sta_isi` (see `aspa_rank`). If the cache of sta is enabled, a
+ *  copy of the kept ranks is returned.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @returns a pointer to an allocated gsl_permutation, NULL if the
+ *           ranks could not be computed
+*/
+gsl_permutation * aspa_sta_isi_rank(const aspa_sta * sta)
+{
+  struct aspa_sta_cache * cache = sta->cache;
+  if (cache == NULL)
+    return isi_rank_compute(sta);
+  if (cache->isi_rank == NULL && (cache->isi_rank = isi_rank_compute(sta)) == NULL)
+    return NULL;
+  gsl_permutation * res = gsl_permutation_alloc(cache->isi_rank->size);
+  if (res == NULL)
+  {
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the ISI ranks failed.");
+    return NULL;
+  }
+  gsl_permutation_memcpy(res,cache->isi_rank);
+  return res;
+}
+
+/** Returns the ISI ranks if the lag is small enough for a lagged rank plot */
+static gsl_permutation * lagged_ranks(const aspa_sta * sta, size_t lag)
+{
+  gsl_permutation * rank = aspa_sta_isi_rank(sta);
+  if (rank != NULL && lag+1 >= rank->size) // make sure the lag is small enough
+  {
+    aspa_ctx_error(ASPA_EINVAL,"The lag (%zu) must be smaller than the number of ISI minus one (%zu).",
+		   lag,rank->size);
+    gsl_permutation_free(rank);
+    return NULL;
+  }
+  return rank;
 }
 
 /** @brief Generates a lagged rank plot
@@ -867,40 +1197,41 @@ double aspa_lagged_spearman(const gsl_vector * data, size_t lag)
  *  The data are ranked and the rank of the (i+l)th
  *  isi is plotted agains the rank of the ith isi,
  *  where l is the lag.
- *  Gnuplot is called. An interactive window pops up.
+ *  A new window of the gnuplot session pops up.
  *
  *  @param[in] sta a pointer to an aspa_sta structure
  *  @param[in] lag the lag 
- *  @returns nothing the function is only used for its side effect
+ *  @returns 0 if everything goes fine, a negative error code otherwise
 */
-void aspa_lagged_rank_plot_i(const aspa_sta * sta, size_t lag)
+int aspa_lagged_rank_plot_i(const aspa_sta * sta, size_t lag)
 {
-  gsl_vector * isi = aspa_sta_isi(sta);
-  size_t n = isi->size;
-  assert (lag < n); // make sure the lag is small enough
-  gsl_permutation * perm = gsl_permutation_alloc(n);
-  gsl_permutation * rank = gsl_permutation_alloc(n);
-  gsl_sort_vector_index(perm,isi);
-  gsl_permutation_inverse(rank,perm);
-  FILE *gp=NULL;
-  if (!gp)
-    gp = popen("gnuplot -persist","w");
-  if (!gp) {
-    printf("Couldn't open Gnuplot.\n");
-    return;
+  gsl_permutation * rank = lagged_ranks(sta,lag);
+  if (rank == NULL)
+    return aspa_ctx_current()->status;
+  size_t n = rank->size;
+  FILE * gp = aspa_gp_window();
+  int status = ASPA_FAILURE;
+  if (gp) {
+    fprintf(gp,"set xlabel 'Rank i'\n");
+    fprintf(gp,"set ylabel 'Rank i + %d'\n",(int) lag);
+    fprintf(gp," plot ");
+    aspa_gp_binary_spec(gp,n-lag-1);
+    fprintf(gp," u 1:2 with dots\n");
+    double x[512], y[512];
+    for (size_t i=0; i < n-lag-1; i+=512)
+    {
+      size_t m = GSL_MIN(512,n-lag-1-i);
+      for (size_t j=0; j<m; j++)
+      {
+	x[j] = rank->data[i+j];
+	y[j] = rank->data[i+j+lag];
+      }
+      aspa_gp_binary_write(gp,x,y,m);
+    }
+    status = aspa_gp_end(gp);
   }
-  fprintf(gp,"set term qt; set grid; unset key\n");
-  fprintf(gp,"set xlabel 'Rank i'\n");
-  fprintf(gp,"set ylabel 'Rank i + %d'\n",(int) lag);
-  fprintf(gp," plot '-' u 1:2 with dots\n");
-  for (size_t i=0; i < n-lag-1; i++)
-    fprintf(gp,"%d %d\n", (int) rank->data[i], (int) rank->data[i+lag]);
-  fprintf(gp,"e\n");
-  fflush(gp);
-  pclose(gp);
-  gsl_permutation_free(perm);
   gsl_permutation_free(rank);
-  gsl_vector_free(isi);
+  return status;
 }
 
 /** @brief Writes a lagged rank plot from an aspa_sta structure
@@ -909,22 +1240,19 @@ void aspa_lagged_rank_plot_i(const aspa_sta * sta, size_t lag)
  *  @param[in/out] STREAM an open file
  *  @param[in] sta a pointer to an aspa_sta structure
  *  @param[in] lag the lag value (positive integer)
- *  @returns 0 if everything goes fine
+ *  @returns 0 if everything goes fine, a negative error code otherwise
 */
 int aspa_lagged_rank_plot_g(FILE * STREAM, const aspa_sta * sta, size_t lag)
 {
-  gsl_vector * isi = aspa_sta_isi(sta);
-  size_t n = isi->size;
-  assert (lag < n); // make sure the lag is small enough
-  gsl_permutation * perm = gsl_permutation_alloc(n);
-  gsl_permutation * rank = gsl_permutation_alloc(n);
-  gsl_sort_vector_index(perm,isi);
-  gsl_permutation_inverse(rank,perm);
+  gsl_permutation * rank = lagged_ranks(sta,lag);
+  if (rank == NULL)
+    return aspa_ctx_current()->status;
+  size_t n = rank->size;
   for (size_t i=0; i < n-lag-1; i++)
     fprintf(STREAM,"%d %d\n", (int) rank->data[i], (int) rank->data[i+lag]);
   fprintf(STREAM,"\n\n");
-  gsl_permutation_free(perm);
   gsl_permutation_free(rank);
-  gsl_vector_free(isi);
+  if (ferror(STREAM))
+    return aspa_ctx_error(ASPA_EIO,"Writing the lagged rank plot failed.");
   return 0;
 }
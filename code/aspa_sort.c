@@ -0,0 +1,312 @@
+/** @file aspa_sort.c
+ *  @brief Function definitions for sorting and ranking doubles
+ *
+ *  The library sorts spike times, intervals and uniform variates, many
+ *  of them: a least significant digit radix sort does it in a fixed
+ *  number of linear passes instead of the n log n comparisons of
+ *  `gsl_sort`. The bit pattern of each double is first mapped on an
+ *  unsigned 64 bit key with the same order (the sign bit is flipped for
+ *  the positive numbers, all the bits for the negative ones); the keys
+ *  are then sorted 11 bits at a time, in 6 passes (8 bits at a time for
+ *  the smaller samples, whose counts then fit in the L1 cache). A pass
+ *  where all the keys share the same digit (the high bits of the
+ *  exponent of positive times for instance) is skipped. The sort is
+ *  stable, so that the index and rank variants break ties by position.
+ *
+ *  Samples smaller than ASPA_SORT_RADIX_MIN are sorted with `gsl_sort`
+ *  (the index sort, which must be stable, uses an insertion sort on
+ *  the very small ones). From ASPA_SORT_PARALLEL_MIN elements on, the array is cut
+ *  into chunks and each pass counts and scatters the chunks in parallel
+ *  (see aspa_pool.c), the result is the same. The order of NaN is not
+ *  specified.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+#define RADIX_BITS 11 //!< Digit size of the large samples
+#define RADIX_SMALL_BITS 8 //!< Digit size below RADIX_SMALL_MAX elements
+#define RADIX_SMALL_MAX 65536
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define SIGN_BIT ((uint64_t) 1 << 63)
+#define CHUNKS_PER_THREAD 4
+#define INSERTION_MAX 64 //!< Index sorts of fewer elements use insertion
+
+/** The sort works on the memory of the doubles */
+typedef uint64_t __attribute__((may_alias)) radix_key;
+
+static inline uint64_t key_of(double x)
+{
+  uint64_t u;
+  memcpy(&u,&x,sizeof(u));
+  return (u & SIGN_BIT) ? ~u : u | SIGN_BIT;
+}
+
+static inline double double_of(uint64_t key)
+{
+  uint64_t u = (key & SIGN_BIT) ? key & ~SIGN_BIT : ~key;
+  double x;
+  memcpy(&x,&u,sizeof(x));
+  return x;
+}
+
+/** The state of a radix sort, keys and (optional) indices are moved
+    from src to dst at each pass */
+typedef struct
+{
+  size_t n;
+  size_t n_chunks;
+  unsigned bits; //!< Digit size
+  unsigned shift; //!< Position of the digit of the pass
+  radix_key * src;
+  radix_key * dst;
+  size_t * src_idx; //!< NULL for a plain sort
+  size_t * dst_idx;
+  const double * data; //!< Input of an index sort
+  size_t * count; //!< n_chunks digit counts, then offsets
+} radix_job;
+
+static inline size_t chunk_from(const radix_job * job, size_t c)
+{
+  return c*job->n/job->n_chunks;
+}
+
+/** Maps the doubles of chunk c on keys, in place */
+static void chunk_keys(size_t c, void * params)
+{
+  radix_job * job = params;
+  for (size_t i=chunk_from(job,c); i<chunk_from(job,c+1); i++)
+  {
+    double x;
+    memcpy(&x,job->src+i,sizeof(x));
+    job->src[i] = key_of(x);
+  }
+}
+
+/** Maps the doubles of chunk c of job->data on keys and indices */
+static void chunk_index_keys(size_t c, void * params)
+{
+  radix_job * job = params;
+  for (size_t i=chunk_from(job,c); i<chunk_from(job,c+1); i++)
+  { // -0 and 0 are tied
+    job->src[i] = key_of(job->data[i] == 0. ? 0. : job->data[i]);
+    job->src_idx[i] = i;
+  }
+}
+
+/** Maps the keys of chunk c back on doubles, in place */
+static void chunk_doubles(size_t c, void * params)
+{
+  radix_job * job = params;
+  for (size_t i=chunk_from(job,c); i<chunk_from(job,c+1); i++)
+  {
+    double x = double_of(job->src[i]);
+    memcpy(job->src+i,&x,sizeof(x));
+  }
+}
+
+static void chunk_count(size_t c, void * params)
+{
+  radix_job * job = params;
+  size_t * count = job->count+c*RADIX_SIZE;
+  uint64_t mask = ((uint64_t) 1 << job->bits)-1;
+  memset(count,0,(mask+1)*sizeof(size_t));
+  for (size_t i=chunk_from(job,c); i<chunk_from(job,c+1); i++)
+    count[(job->src[i] >> job->shift) & mask]++;
+}
+
+static void chunk_scatter(size_t c, void * params)
+{
+  radix_job * job = params;
+  size_t * offset = job->count+c*RADIX_SIZE;
+  uint64_t mask = ((uint64_t) 1 << job->bits)-1;
+  for (size_t i=chunk_from(job,c); i<chunk_from(job,c+1); i++)
+  {
+    size_t pos = offset[(job->src[i] >> job->shift) & mask]++;
+    job->dst[pos] = job->src[i];
+    if (job->src_idx != NULL)
+      job->dst_idx[pos] = job->src_idx[i];
+  }
+}
+
+/** Turns the chunk counts into the positions of the first key of each
+    (digit, chunk) pair, false if all the keys have the same digit */
+static bool count_to_offset(radix_job * job)
+{
+  size_t pos = 0;
+  for (size_t d=0; d < ((size_t) 1 << job->bits); d++)
+  {
+    size_t total = 0;
+    for (size_t c=0; c<job->n_chunks; c++)
+    {
+      size_t * count = job->count+c*RADIX_SIZE+d;
+      size_t k = *count;
+      *count = pos+total;
+      total += k;
+    }
+    if (total == job->n)
+      return false;
+    pos += total;
+  }
+  return true;
+}
+
+/** Runs the passes of a radix sort, the keys (and indices) end in
+    job->src */
+static void radix_run(radix_job * job)
+{
+  for (job->shift=0; job->shift < 64; job->shift += job->bits)
+  {
+    aspa_parallel_for(job->n_chunks,job->n,chunk_count,job);
+    if (!count_to_offset(job))
+      continue;
+    aspa_parallel_for(job->n_chunks,job->n,chunk_scatter,job);
+    radix_key * keys = job->src;
+    job->src = job->dst;
+    job->dst = keys;
+    size_t * idx = job->src_idx;
+    job->src_idx = job->dst_idx;
+    job->dst_idx = idx;
+  }
+}
+
+/** Sets the number of chunks of job and its count buffer, count holds
+    RADIX_SIZE elements for a serial sort; false if the buffer of a
+    parallel sort could not be allocated */
+static bool radix_chunks(radix_job * job, size_t * count)
+{
+  job->bits = job->n < RADIX_SMALL_MAX ? RADIX_SMALL_BITS : RADIX_BITS;
+  job->n_chunks = 1;
+  job->count = count;
+  if (job->n < ASPA_SORT_PARALLEL_MIN || aspa_pool_size() == 1)
+    return true;
+  job->n_chunks = CHUNKS_PER_THREAD*aspa_pool_size();
+  job->count = aspa_ctx_malloc(job->n_chunks*RADIX_SIZE*sizeof(size_t));
+  return job->count != NULL;
+}
+
+/** @brief Sorts an array of doubles in ascending order with a work
+ *         buffer
+ *
+ *  @param[in/out] data the array
+ *  @param[in] n the number of elements
+ *  @param[in] work a buffer of n doubles
+ *  @returns 0 if everything goes fine, ASPA_ENOMEM if the buffer of a
+ *           parallel sort could not be allocated (the data are then
+ *           not sorted)
+*/
+int aspa_sort_w(double * data, size_t n, double * work)
+{
+  if (n < ASPA_SORT_RADIX_MIN)
+  {
+    gsl_sort(data,1,n);
+    return 0;
+  }
+  size_t count[RADIX_SIZE];
+  radix_job job = {.n=n, .src=(radix_key *) data, .dst=(radix_key *) work};
+  if (!radix_chunks(&job,count))
+    return ASPA_ENOMEM;
+  aspa_parallel_for(job.n_chunks,n,chunk_keys,&job);
+  radix_run(&job);
+  aspa_parallel_for(job.n_chunks,n,chunk_doubles,&job);
+  if (job.src != (radix_key *) data)
+    memcpy(data,job.src,n*sizeof(double));
+  if (job.count != count)
+    aspa_ctx_free(job.count);
+  return 0;
+}
+
+/** @brief Sorts an array of doubles in ascending order
+ *
+ *  @param[in/out] data the array
+ *  @param[in] n the number of elements
+ *  @returns 0 if everything goes fine, ASPA_ENOMEM if a work buffer
+ *           could not be allocated (the data are then not sorted)
+*/
+int aspa_sort(double * data, size_t n)
+{
+  if (n < ASPA_SORT_RADIX_MIN)
+  {
+    gsl_sort(data,1,n);
+    return 0;
+  }
+  double * work = aspa_ctx_malloc(n*sizeof(double));
+  if (work == NULL)
+    return ASPA_ENOMEM;
+  int status = aspa_sort_w(data,n,work);
+  aspa_ctx_free(work);
+  return status;
+}
+
+/** @brief Finds the permutation sorting an array of doubles
+ *
+ *  `data[order[0]]` is the smallest element and so on; tied elements
+ *  keep their order.
+ *
+ *  @param[out] order an array of n indices
+ *  @param[in] data the array
+ *  @param[in] n the number of elements
+ *  @returns 0 if everything goes fine, ASPA_ENOMEM if a work buffer
+ *           could not be allocated
+*/
+int aspa_sort_index(size_t * order, const double * data, size_t n)
+{
+  if (n < INSERTION_MAX)
+  { // gsl_sort_index is not stable
+    for (size_t i=0; i<n; i++)
+      order[i] = i;
+    for (size_t i=1; i<n; i++)
+    {
+      size_t k = order[i], j = i;
+      for (; j > 0 && data[order[j-1]] > data[k]; j--)
+	order[j] = order[j-1];
+      order[j] = k;
+    }
+    return 0;
+  }
+  // keys, keys and indices of the other buffer
+  radix_key * keys = aspa_ctx_malloc(n*(2*sizeof(radix_key)+sizeof(size_t)));
+  if (keys == NULL)
+    return ASPA_ENOMEM;
+  size_t count[RADIX_SIZE];
+  radix_job job = {.n=n, .data=data, .src=keys, .dst=keys+n,
+		   .src_idx=order, .dst_idx=(size_t *) (keys+2*n)};
+  if (!radix_chunks(&job,count))
+  {
+    aspa_ctx_free(keys);
+    return ASPA_ENOMEM;
+  }
+  aspa_parallel_for(job.n_chunks,n,chunk_index_keys,&job);
+  radix_run(&job);
+  if (job.src_idx != order)
+    memcpy(order,job.src_idx,n*sizeof(size_t));
+  if (job.count != count)
+    aspa_ctx_free(job.count);
+  aspa_ctx_free(keys);
+  return 0;
+}
+
+/** @brief Returns the ranks of the elements of an array of doubles
+ *
+ *  `rank[i]` is the position of `data[i]` in the sorted array (from 0),
+ *  tied elements are ranked by position.
+ *
+ *  @param[out] rank an array of n indices
+ *  @param[in] data the array
+ *  @param[in] n the number of elements
+ *  @returns 0 if everything goes fine, ASPA_ENOMEM if a work buffer
+ *           could not be allocated
+*/
+int aspa_rank(size_t * rank, const double * data, size_t n)
+{
+  size_t * order = aspa_ctx_malloc(n*sizeof(size_t));
+  if (order == NULL)
+    return ASPA_ENOMEM;
+  int status = aspa_sort_index(order,data,n);
+  if (status == 0)
+    for (size_t i=0; i<n; i++)
+      rank[order[i]] = i;
+  aspa_ctx_free(order);
+  return status;
+}
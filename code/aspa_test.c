@@ -0,0 +1,92 @@
+/** @file aspa_test.c
+ *  @brief Function definitions of the helpers shared by the module test
+ *         programs
+ *
+ *  Each test program prints a table with one row per check, the row
+ *  giving the largest difference found (or the number of failures for
+ *  the checks counting them) and whether it is within its tolerance.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa_test.h"
+
+/** @brief Prints the header of the table of checks
+ *
+ *  @param[in] title the title of the second column
+*/
+void test_header(const char * title)
+{
+  printf("%-44s %12s\n","check",title);
+}
+
+/** @brief Prints a row of the table of checks
+ *
+ *  @param[in] name the name of the check
+ *  @param[in] diff the largest difference (or number of failures)
+ *  @param[in] tol the largest acceptable value of diff
+ *  @returns true if diff is above tol or NaN
+*/
+bool test_report(const char * name, double diff, double tol)
+{
+  printf("%-44s %12.3g %s\n",name,diff,diff <= tol ? "ok" : "FAILED");
+  return !(diff <= tol);
+}
+
+/** @brief Prints a row of the table of checks for a statistical test
+ *
+ *  @param[in] name the name of the check
+ *  @param[in] p the p-value of the test
+ *  @param[in] level the smallest acceptable p-value
+ *  @returns true if p is below level or NaN
+*/
+bool test_report_p(const char * name, double p, double level)
+{
+  printf("%-44s %12.3g %s\n",name,p,p >= level ? "ok" : "FAILED");
+  return !(p >= level);
+}
+
+/** @brief Simulates a gamma renewal train cut into trials
+ *
+ *  A shape of 1 gives an homogeneous Poisson train.
+ *
+ *  @param[in] seed the seed of the generator
+ *  @param[in] n the number of spikes
+ *  @param[in] rate the rate (Hz)
+ *  @param[in] shape the shape of the interval distribution
+ *  @param[in] trial_duration the trial duration (s)
+ *  @returns a pointer to an allocated aspa_sta
+*/
+aspa_sta * test_sim_sta(unsigned long seed, size_t n, double rate, double shape, double trial_duration)
+{
+  gsl_rng * rng = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(rng,seed);
+  gsl_vector * train = aspa_sim_gamma(rng,n,rate,shape);
+  aspa_sta * res = aspa_sim_sta(train,trial_duration);
+  gsl_vector_free(train);
+  gsl_rng_free(rng);
+  if (res == NULL)
+  {
+    fprintf(stderr,"The simulation of the spike trains failed\n");
+    exit(EXIT_FAILURE);
+  }
+  return res;
+}
+
+/** @brief Returns the p-value of Kolmogorov's test of uniformity of
+ *         the n values of p
+ *
+ *  The values are p-values of tests whose null hypothesis is true, they
+ *  should be uniform on [0,1].
+ *
+ *  @param[in] p the values
+ *  @param[in] n their number
+ *  @returns Prob{D_n > D}
+*/
+double test_uniform_p(const double * p, size_t n)
+{
+  gsl_vector * v = gsl_vector_alloc(n);
+  memcpy(v->data,p,n*sizeof(double));
+  double D = aspa_Kolmogorov_D(v,false,"D");
+  gsl_vector_free(v);
+  return 1.-aspa_cdf_K((int) n,D);
+}
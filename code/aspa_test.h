@@ -0,0 +1,20 @@
+/** @file aspa_test.h
+ *  @brief Function prototypes of the helpers shared by the module test
+ *         programs (aspa_*_test.c)
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa.h"
+
+/** Seed of the simulated data of the tests */
+#define ASPA_TEST_SEED 20061001
+
+void test_header(const char * title);
+
+bool test_report(const char * name, double diff, double tol);
+
+bool test_report_p(const char * name, double p, double level);
+
+aspa_sta * test_sim_sta(unsigned long seed, size_t n, double rate, double shape, double trial_duration);
+
+double test_uniform_p(const double * p, size_t n);
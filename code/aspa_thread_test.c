@@ -0,0 +1,467 @@
+/** @file aspa_thread_test.c
+ *  @brief User program for testing the library from several threads
+ *
+ *  Each thread attaches its own context, simulates the same data (its
+ *  own generator with the same seed) and calls the non interactive
+ *  functions of the library: the summaries obtained by the threads must
+ *  be identical. A few calls are made on bad inputs, the errors must be
+ *  reported to the context of the calling thread only. The temporary
+ *  buffers come from an arena reset after each round: no block must be
+ *  added to it after the first round. The cached quantities of an
+ *  aspa_sta must be equal to the computed ones, the bootstrap and
+ *  permutation results must not depend on the threads. The results of
+ *  the analysis modules (goodness of fit battery, rescaling, rates,
+ *  bursts, distances, renewal fits, variance-time curves) are only
+ *  compared between the threads here, their own test programs check
+ *  their values. Meanwhile the main thread runs
+ *  the parallel per trial loops on a large aspa_sta and compares them
+ *  with serial computations. Build it with `make tsan` to run it under
+ *  ThreadSanitizer.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa.h"
+
+#include <pthread.h>
+
+#define N_THREADS 8
+#define N_ROUNDS 4
+#define N_VALUES 34
+
+typedef struct
+{
+  size_t n_errors; //!< Number of errors passed to the sink
+  double value[N_VALUES]; //!< Summary of the results
+  bool failed; //!< A call that should work did not
+  size_t n_mallocs; //!< Arena blocks allocated after the first round
+} thread_data;
+
+/** Error sink counting the errors instead of printing them */
+void count_errors(int status, const char * message, void * state)
+{
+  thread_data * data = state;
+  data->n_errors++;
+}
+
+/** Returns a checksum of a vector */
+double sum(const gsl_vector * v)
+{
+  double res = 0.;
+  for (size_t i=0; i<v->size; i++)
+    res += gsl_vector_get(v,i)*(1.+i%7);
+  return res;
+}
+
+/** Returns a checksum of a matrix */
+double matrix_sum(const gsl_matrix * m)
+{
+  double res = 0.;
+  for (size_t i=0; i<m->size1; i++)
+    for (size_t j=0; j<m->size2; j++)
+      res += gsl_matrix_get(m,i,j)*(1.+(i+j)%7);
+  return res;
+}
+
+/** The gamma cdf of the intervals of one_round */
+double gamma_cdf(double x, void * params)
+{
+  return gsl_cdf_gamma_P(x,2.,1./30.);
+}
+
+/** Returns a checksum of the spike times of an aspa_sta */
+double sta_sum(const aspa_sta * sta)
+{
+  double res = 0.;
+  for (size_t t_idx=0; t_idx<sta->n_trials; t_idx++)
+    res += sum(aspa_sta_get_st(sta,t_idx))+aspa_sta_get_st_start(sta,t_idx);
+  return res;
+}
+
+/** Returns the size of a file */
+double file_size(FILE * fp)
+{
+  fflush(fp);
+  fseek(fp,0,SEEK_END);
+  double res = ftell(fp);
+  rewind(fp);
+  return res;
+}
+
+/** Returns true if the ISI, their ranks and the aggregated train
+    differ once the cache of sta is enabled */
+bool cache_differs(aspa_sta * sta)
+{
+  gsl_vector * isi = aspa_sta_isi(sta);
+  gsl_permutation * rank = aspa_sta_isi_rank(sta);
+  aspa_sta * asta = aspa_sta_aggregate(sta);
+  size_t n_spikes = aspa_sta_n_spikes(sta);
+  bool res = aspa_sta_cache_enable(sta) != 0;
+  // the first pass fills the cache, the second reads it, the third
+  // follows an invalidation
+  for (size_t pass=0; pass<3 && !res; pass++)
+  {
+    if (pass == 2)
+      aspa_sta_set_st_start(sta,0,aspa_sta_get_st_start(sta,0));
+    gsl_vector * c_isi = aspa_sta_isi(sta);
+    gsl_permutation * c_rank = aspa_sta_isi_rank(sta);
+    aspa_sta * c_asta = aspa_sta_aggregate(sta);
+    res |= c_isi == NULL || c_rank == NULL || c_asta == NULL;
+    res |= aspa_sta_n_spikes(sta) != n_spikes || aspa_sta_n_spikes(c_asta) != n_spikes;
+    res |= res || memcmp(c_isi->data,isi->data,isi->size*sizeof(double)) != 0 ||
+      memcmp(c_rank->data,rank->data,rank->size*sizeof(size_t)) != 0 ||
+      sta_sum(c_asta) != sta_sum(asta);
+    if (c_isi != NULL)
+      gsl_vector_free(c_isi);
+    if (c_rank != NULL)
+      gsl_permutation_free(c_rank);
+    if (c_asta != NULL)
+      aspa_sta_free(c_asta);
+  }
+  aspa_sta_cache_disable(sta);
+  gsl_vector_free(isi);
+  gsl_permutation_free(rank);
+  aspa_sta_free(asta);
+  return res;
+}
+
+void one_round(thread_data * data, aspa_fns_workspace * fns_w, aspa_gof_workspace * gof_w)
+{
+  double * value = data->value;
+  gsl_rng * rng = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(rng,20061001);
+  gsl_vector * train = aspa_sim_gamma(rng,4000,15.,2.);
+  gsl_vector * poisson = aspa_sim_poisson(rng,2000,15.);
+  aspa_sta * sta = aspa_sim_sta(train,10.);
+  aspa_sta * sta_b = aspa_sta_from_raw(poisson,10.,2.,4.,10.);
+  value[0] = sta_sum(sta)+sta_sum(sta_b);
+  // text and binary write / read cycles
+  FILE * fp = tmpfile();
+  data->failed |= aspa_sta_fprintf(fp,sta,false) != 0;
+  value[1] = file_size(fp);
+  aspa_sta * copy = aspa_sta_fscanf(fp);
+  fclose(fp);
+  data->failed |= copy == NULL;
+  value[2] = copy != NULL ? sta_sum(copy) : 0.;
+  if (copy != NULL)
+    aspa_sta_free(copy);
+  fp = tmpfile();
+  data->failed |= aspa_sta_fwrite(fp,sta,false) != 0;
+  rewind(fp);
+  copy = aspa_sta_fread(fp);
+  fclose(fp);
+  data->failed |= copy == NULL || sta_sum(copy) != sta_sum(sta);
+  if (copy != NULL)
+    aspa_sta_free(copy);
+  aspa_sta * asta = aspa_sta_aggregate(sta);
+  value[3] = sta_sum(asta);
+  aspa_sta_free(asta);
+  // ISI statistics and tests
+  gsl_vector * isi = aspa_sta_isi(sta);
+  aspa_fns fns = aspa_fns_get(isi);
+  value[4] = fns.mean+fns.median+fns.mad+fns.var;
+  aspa_fns fns_bis = aspa_fns_get_w(isi,fns_w);
+  data->failed |= fns_bis.mad != fns.mad || fns_bis.lowerq != fns.lowerq;
+  value[5] = aspa_lagged_spearman(isi,1);
+  value[6] = aspa_sta_rate(sta);
+  gsl_vector * u = gsl_vector_alloc(isi->size);
+  for (size_t i=0; i<isi->size; i++)
+    gsl_vector_set(u,i,gamma_cdf(gsl_vector_get(isi,i),NULL));
+  value[7] = aspa_Kolmogorov_D(u,false,"D");
+  data->failed |= aspa_Kolmogorov_D_w(u,false,"D",gof_w) != value[7];
+  value[8] = aspa_cdf_K(500,0.05)+aspa_cdf_Kplus(500,0.05);
+  value[9] = aspa_AndersonDarling_W2(u,false);
+  data->failed |= aspa_AndersonDarling_W2_w(u,false,gof_w) != value[9];
+  value[10] = aspa_cdf_AD_P(500,1.);
+  gsl_vector_view head = gsl_vector_subvector(u,0,1000);
+  gsl_vector * durbin = gsl_vector_alloc(1000);
+  data->failed |= aspa_durbin_modification(&head.vector,durbin) != 0;
+  value[11] = sum(durbin);
+  gsl_vector * durbin_bis = gsl_vector_alloc(1000);
+  data->failed |= aspa_durbin_modification_w(&head.vector,durbin_bis,gof_w) != 0 ||
+    sum(durbin_bis) != value[11];
+  gsl_vector_free(durbin_bis);
+  gsl_vector_free(durbin);
+  gsl_vector_free(u);
+  // goodness of fit battery, checked by aspa_gof_test
+  const aspa_sta * units[2] = {sta, sta_b};
+  aspa_gof gof[2];
+  data->failed |= aspa_gof_battery(units,2,gof) != 0;
+  value[27] = gof[0].p_D+gof[0].p_W2+gof[1].p_D_plus+gof[1].durbin_W2;
+  // time rescaling by the PSTH and by a linear intensity, checked by
+  // aspa_rescale_test
+  aspa_intensity * psth = aspa_intensity_psth(sta,0.5);
+  const double knot[3] = {0.,5.,20.}, knot_rate[3] = {10.,40.,5.};
+  aspa_intensity * linear = aspa_intensity_alloc(ASPA_INTENSITY_LINEAR,knot,knot_rate,3);
+  aspa_sta * rescaled = aspa_time_rescale(sta,psth);
+  aspa_sta * rescaled_b = aspa_time_rescale(sta,linear);
+  data->failed |= rescaled == NULL || rescaled_b == NULL;
+  value[28] = sta_sum(rescaled)+sta_sum(rescaled_b);
+  aspa_sta_free(rescaled);
+  aspa_sta_free(rescaled_b);
+  aspa_intensity_free(psth);
+  aspa_intensity_free(linear);
+  // rate curves, checked by aspa_rate_test
+  const double widths[3] = {0.05,0.2,1.};
+  value[29] = 0.;
+  for (int kernel=ASPA_RATE_CAUSAL; kernel<=ASPA_RATE_EXPONENTIAL; kernel++)
+  {
+    gsl_matrix * rate = aspa_sta_rate_curve(sta,widths,3,0.001,kernel);
+    data->failed |= rate == NULL;
+    if (rate != NULL)
+    {
+      value[29] += matrix_sum(rate);
+      gsl_matrix_free(rate);
+    }
+  }
+  // bursts, both methods, checked by aspa_bursts_test
+  value[30] = 0.;
+  for (int method=ASPA_BURST_MAX_INTERVAL; method<=ASPA_BURST_POISSON_SURPRISE; method++)
+  {
+    aspa_burst_params burst_params = aspa_burst_params_default(method);
+    burst_params.max_isi_start = 0.01;
+    burst_params.max_isi_end = 0.02;
+    aspa_bursts * bursts = aspa_bursts_detect(sta,&burst_params);
+    data->failed |= bursts == NULL;
+    for (size_t b=0; bursts != NULL && b<bursts->n_bursts; b++)
+      value[30] += bursts->duration[b]+bursts->last[b];
+    if (bursts != NULL)
+      aspa_bursts_free(bursts);
+  }
+  // distance matrices, checked by aspa_distance_test
+  value[31] = 0.;
+  for (int kind=ASPA_DIST_VICTOR_PURPURA; kind<=ASPA_DIST_SPIKE; kind++)
+  {
+    gsl_matrix * dist = aspa_sta_distance_matrix(sta,kind,kind == ASPA_DIST_VAN_ROSSUM ? 0.02 : 10.);
+    data->failed |= dist == NULL;
+    if (dist != NULL)
+    {
+      value[31] += matrix_sum(dist);
+      gsl_matrix_free(dist);
+    }
+  }
+  const double costs[3] = {0.,10.,100.};
+  gsl_matrix * vp[3];
+  data->failed |= aspa_sta_victor_purpura_matrices(sta,costs,3,vp) != 0;
+  for (size_t k=0; k<3; k++)
+    if (vp[k] != NULL)
+    {
+      value[31] += matrix_sum(vp[k]);
+      gsl_matrix_free(vp[k]);
+    }
+  // renewal fits, checked by aspa_renewal_test
+  aspa_renewal_fit renewal[2];
+  data->failed |= aspa_renewal_fit_units(units,2,renewal) != 0;
+  value[32] = 0.;
+  for (size_t u_idx=0; u_idx<2; u_idx++)
+    for (int m=0; m<ASPA_RENEWAL_N_MODELS; m++)
+      value[32] += renewal[u_idx].fit[m].aic+renewal[u_idx].fit[m].D;
+  // variance-time curves, checked by aspa_vartime_test
+  double vt_windows[] = {0.01,1.,0.6*sta->trial_duration};
+  aspa_variance_time * vt = aspa_sta_variance_time(sta,0.,0.,vt_windows,3);
+  data->failed |= vt == NULL;
+  value[33] = vt != NULL ? vt->fano_within[0]+vt->allan_across[1]+vt->fano_across[2] : 0.;
+  if (vt != NULL)
+    aspa_variance_time_free(vt);
+  gsl_vector_view isi_head = gsl_vector_subvector(isi,0,500);
+  gsl_histogram * hist = aspa_bayesian_blocks(&isi_head.vector,false,0.05);
+  value[12] = hist->n+hist->range[1];
+  gsl_histogram_free(hist);
+  gsl_permutation * rank = aspa_sta_isi_rank(sta);
+  value[13] = rank->data[0]+rank->data[rank->size-1];
+  gsl_permutation_free(rank);
+  // resampling, identical whatever the threads running it
+  aspa_fns_ci ci;
+  data->failed |= aspa_fns_bootstrap(isi,200,0.95,20061001,&ci) != 0 ||
+    fabs(ci.estimate.mean-fns.mean) > 1e-12*fns.mean ||
+    ci.estimate.median != fns.median ||
+    ci.lower.mean > ci.estimate.mean || ci.upper.mean < ci.estimate.mean;
+  value[24] = ci.lower.mean+ci.upper.median+ci.upper.mad;
+  data->failed |= aspa_sta_fns_bootstrap(sta,200,0.9,20061001,&ci) != 0;
+  value[25] = ci.lower.var+ci.upper.lowerq;
+  value[26] = aspa_lagged_spearman_test(&isi_head.vector,1,200,20061001);
+  data->failed |= isnan(value[26]) || value[26] <= 0. || value[26] > 1.;
+  gsl_vector_free(isi);
+  // correlograms
+  aspa_ccg * ccg = aspa_correlogram(sta,sta,0.05,0.001);
+  data->failed |= ccg == NULL;
+  value[14] = ccg != NULL ? sum(ccg->raw)+sum(ccg->shuffled) : 0.;
+  if (ccg != NULL)
+    aspa_ccg_free(ccg);
+  ccg = aspa_autocorrelogram(sta_b,0.05,0.001);
+  value[15] = sum(ccg->raw);
+  aspa_ccg_free(ccg);
+  // bitsets
+  aspa_bitset * bs = aspa_sta_to_bitset(sta,0.001);
+  gsl_matrix * counts = aspa_bitset_window_counts(bs,100);
+  value[16] = gsl_matrix_get(counts,0,0)+aspa_bitset_coincidences(bs,0,bs,1);
+  gsl_matrix_free(counts);
+  fp = tmpfile();
+  data->failed |= aspa_bitset_fwrite(fp,bs) != 0;
+  rewind(fp);
+  aspa_bitset * bs_copy = aspa_bitset_fread(fp);
+  fclose(fp);
+  data->failed |= bs_copy == NULL || aspa_bitset_count(bs_copy,1,0,bs->n_bins) != aspa_bitset_count(bs,1,0,bs->n_bins);
+  if (bs_copy != NULL)
+    aspa_bitset_free(bs_copy);
+  aspa_bitset_free(bs);
+  // decimated plots and images
+  aspa_lod * lod = aspa_lod_cp(sta,true,false,100,0);
+  fp = tmpfile();
+  data->failed |= aspa_lod_fprintf(fp,lod,0.,0.,200) != 0;
+  value[17] = file_size(fp);
+  fclose(fp);
+  fp = tmpfile();
+  data->failed |= aspa_lod_fwrite(fp,lod) != 0;
+  rewind(fp);
+  aspa_lod * lod_copy = aspa_lod_fread(fp);
+  fclose(fp);
+  data->failed |= lod_copy == NULL || lod_copy->n_levels != lod->n_levels;
+  if (lod_copy != NULL)
+    aspa_lod_free(lod_copy);
+  aspa_lod_free(lod);
+  lod = aspa_lod_raster(sta,100,0);
+  value[18] = lod->n_levels;
+  aspa_lod_free(lod);
+  aspa_image * img = aspa_raster_image(sta,400,300);
+  fp = tmpfile();
+  data->failed |= aspa_image_png(fp,img) != 0;
+  value[19] = file_size(fp);
+  fclose(fp);
+  aspa_image_free(img);
+  img = aspa_lagged_rank_image(sta,1,400,300);
+  fp = tmpfile();
+  data->failed |= aspa_image_svg(fp,img) != 0;
+  value[20] = file_size(fp);
+  fclose(fp);
+  aspa_image_free(img);
+  // errors
+  aspa_ctx * ctx = aspa_ctx_current();
+  size_t n_errors = data->n_errors;
+  fp = tmpfile();
+  data->failed |= aspa_sta_fscanf(fp) != NULL || ctx->status != ASPA_EFORMAT;
+  data->failed |= aspa_sta_fread(fp) != NULL;
+  data->failed |= aspa_raw_fscanf(fp,1.) != NULL;
+  fclose(fp);
+  data->failed |= !isnan(aspa_Kolmogorov_D(train,true,"D*")) || ctx->status != ASPA_EINVAL;
+  data->failed |= aspa_image_alloc(10,10,0.,1.,0.,1.) != NULL;
+  data->failed |= aspa_lagged_rank_image(sta,train->size,400,300) != NULL;
+  value[21] = data->n_errors-n_errors;
+  value[22] = fns.n;
+  value[23] = sta->n_trials;
+  data->failed |= cache_differs(sta);
+  aspa_sta_free(sta);
+  aspa_sta_free(sta_b);
+  gsl_vector_free(train);
+  gsl_vector_free(poisson);
+  gsl_rng_free(rng);
+}
+
+/** Returns the number of spikes of a trial */
+double trial_size(const aspa_sta * sta, size_t t_idx, void * params)
+{
+  return sta->st[t_idx]->size;
+}
+
+double max_op(double a, double b)
+{
+  return GSL_MAX(a,b);
+}
+
+/** Returns the number of differences between the parallel loops (on
+    many short trials and in the sorts) and serial computations */
+size_t pool_check(void)
+{
+  gsl_rng * rng = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(rng,20061001);
+  gsl_vector * train = aspa_sim_poisson(rng,500000,15.);
+  aspa_sta * sta = aspa_sim_sta(train,0.2);
+  size_t n_diff = 0, n_spikes = 0, n_max = 0;
+  for (size_t t_idx=0; t_idx<sta->n_trials; t_idx++)
+  {
+    n_spikes += sta->st[t_idx]->size;
+    n_max = GSL_MAX(n_max,sta->st[t_idx]->size);
+  }
+  n_diff += aspa_sta_n_spikes(sta) != n_spikes;
+  n_diff += aspa_sta_parallel_reduce(sta,trial_size,max_op,0.,NULL) != n_max;
+  gsl_vector * isi = aspa_sta_isi(sta);
+  size_t i = 0;
+  for (size_t t_idx=0; t_idx<sta->n_trials; t_idx++)
+  {
+    gsl_vector * st = sta->st[t_idx];
+    for (size_t j=1; j<st->size; j++, i++)
+      n_diff += i >= isi->size ||
+	gsl_vector_get(isi,i) != gsl_vector_get(st,j)-gsl_vector_get(st,j-1);
+  }
+  n_diff += i != isi->size;
+  gsl_vector_free(isi);
+  // sorts large enough to be run in parallel
+  size_t n = ASPA_SORT_PARALLEL_MIN+1000;
+  double * x = malloc(2*n*sizeof(double));
+  size_t * rank = malloc(n*sizeof(size_t));
+  for (size_t j=0; j<n; j++)
+    x[j] = x[n+j] = floor(gsl_rng_uniform(rng)*n/4)-n/8.; // ties and negative values
+  n_diff += aspa_rank(rank,x,n) != 0 || aspa_sort(x+n,n) != 0;
+  for (size_t j=0; j<n; j++)
+    n_diff += x[n+rank[j]] != x[j] || (j > 0 && x[n+j-1] > x[n+j]);
+  free(rank);
+  free(x);
+  aspa_sta_free(sta);
+  gsl_vector_free(train);
+  gsl_rng_free(rng);
+  return n_diff;
+}
+
+void * run(void * arg)
+{
+  thread_data * data = arg;
+  aspa_ctx ctx = {.sink=count_errors, .sink_state=data};
+  aspa_arena * arena = aspa_arena_alloc(0);
+  aspa_fns_workspace * fns_w = aspa_fns_workspace_alloc(0);
+  aspa_gof_workspace * gof_w = aspa_gof_workspace_alloc(0);
+  aspa_ctx_use_arena(&ctx,arena);
+  aspa_ctx_attach(&ctx);
+  for (size_t r=0; r<N_ROUNDS; r++)
+  {
+    size_t n_mallocs = arena->n_mallocs;
+    one_round(data,fns_w,gof_w);
+    aspa_arena_reset(arena);
+    if (r > 0)
+      data->n_mallocs += arena->n_mallocs-n_mallocs;
+  }
+  aspa_ctx_attach(NULL);
+  aspa_gof_workspace_free(gof_w);
+  aspa_fns_workspace_free(fns_w);
+  aspa_arena_free(arena);
+  return NULL;
+}
+
+int main()
+{
+  thread_data data[N_THREADS];
+  pthread_t thread[N_THREADS];
+  memset(data,0,sizeof(data));
+  for (size_t k=0; k<N_THREADS; k++)
+    pthread_create(thread+k,NULL,run,data+k);
+  size_t n_pool_diff = pool_check();
+  for (size_t k=0; k<N_THREADS; k++)
+    pthread_join(thread[k],NULL);
+  size_t n_diff = 0, n_failed = 0, n_mallocs = 0;
+  for (size_t k=0; k<N_THREADS; k++)
+  {
+    n_failed += data[k].failed;
+    n_mallocs += data[k].n_mallocs;
+    for (size_t i=0; i<N_VALUES; i++)
+      n_diff += memcmp(data[k].value+i,data[0].value+i,sizeof(double)) != 0;
+  }
+  printf("%d threads, %d rounds each.\n", N_THREADS, N_ROUNDS);
+  printf("Number of values differing from the ones of the first thread: %d.\n", (int) n_diff);
+  printf("Number of threads with a failed call: %d.\n", (int) n_failed);
+  printf("Errors reported per round and thread: %g (6 expected).\n", data[0].value[21]);
+  printf("Arena blocks allocated after the first round: %d (0 expected).\n", (int) n_mallocs);
+  printf("Parallel loops on %d threads differing from the serial ones: %d (0 expected).\n",
+	 (int) aspa_pool_size(), (int) n_pool_diff);
+  printf("Errors reported to the main thread context: %d (0 expected).\n",
+	 aspa_ctx_current()->status != ASPA_SUCCESS);
+  return n_diff == 0 && n_failed == 0 && n_mallocs == 0 && n_pool_diff == 0 &&
+    data[0].value[21] == 6. ? 0 : 1;
+}
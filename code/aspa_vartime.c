@@ -0,0 +1,283 @@
+/** @file aspa_vartime.c
+ *  @brief Function definitions for the variance-time curves, Fano and
+ *         Allan factors
+ *
+ *  The time range [from,to] of the trials (the whole trial by default)
+ *  is cut into consecutive counting windows of width T,
+ *  [from+kT,from+(k+1)T) for k from 0 to K-1, K = floor((to-from)/T).
+ *  For a homogeneous Poisson process the variance of the counts
+ *  equals their mean whatever T: the Fano factor (variance over mean)
+ *  and the Allan factor (half the mean squared difference of
+ *  successive counts over the mean) are 1. Departures as T grows
+ *  reveal the correlations of the intervals and the slow rate
+ *  fluctuations (Teich et al, 1997, J. Opt. Soc. Am. A 14: 529-546).
+ *  Both factors are computed:
+ *   - within trial, with the counts of the windows of a trial around
+ *     the mean of the trial and the differences of successive windows,
+ *   - across trials, with the counts of the same window in all the
+ *     trials around their mean and the differences between
+ *     successive trials.
+ *
+ *  The count of a window is the difference of two values of the
+ *  counting process of the trial, each one a binary search in the
+ *  sorted spike times: a window width costs O(K log N) per trial
+ *  instead of a pass over the N spikes. The counts are integers, their
+ *  sums and sums of squares are exact. The window widths are processed
+ *  in parallel (see aspa_pool.c).
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+
+#include "aspa.h"
+
+typedef struct
+{
+  const aspa_sta * sta;
+  double from; //!< Start of the first window
+  double duration; //!< Length of the counted range
+  aspa_variance_time * res;
+  int * status; //!< One per window width
+} vt_job;
+
+/** Number of spike times of st smaller than t */
+static size_t count_before(const gsl_vector * st, double t)
+{
+  size_t lo = 0, hi = st->size;
+  while (lo < hi)
+  {
+    size_t mid = lo+(hi-lo)/2;
+    if (gsl_vector_get(st,mid) < t)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void vt_window(size_t w_idx, void * params)
+{
+  vt_job * job = params;
+  const aspa_sta * sta = job->sta;
+  aspa_variance_time * res = job->res;
+  double T = res->window[w_idx];
+  size_t K = (size_t) floor(job->duration/T);
+  size_t R = sta->n_trials;
+  res->mean[w_idx] = res->var_within[w_idx] = res->fano_within[w_idx] =
+    res->allan_within[w_idx] = res->var_across[w_idx] = res->fano_across[w_idx] =
+    res->allan_across[w_idx] = GSL_NAN;
+  job->status[w_idx] = 0;
+  if (K == 0)
+    return;
+  // counts of the trial and of the previous one, sums over the trials
+  double * counts = aspa_ctx_malloc(4*K*sizeof(double));
+  if (counts == NULL)
+  {
+    job->status[w_idx] = ASPA_ENOMEM;
+    return;
+  }
+  double * cur = counts, * prev = counts+K, * sum = counts+2*K, * sum2 = counts+3*K;
+  for (size_t k=0; k<K; k++)
+    sum[k] = sum2[k] = 0.;
+  double total = 0., ss_within = 0., sd_within = 0., sd_across = 0.;
+  for (size_t t_idx=0; t_idx<R; t_idx++)
+  {
+    const gsl_vector * st = sta->st[t_idx];
+    size_t c = count_before(st,job->from);
+    double trial_sum = 0., trial_sum2 = 0.;
+    for (size_t k=0; k<K; k++)
+    {
+      size_t c_next = count_before(st,job->from+(k+1)*T);
+      double n = c_next-c;
+      c = c_next;
+      cur[k] = n;
+      trial_sum += n;
+      trial_sum2 += n*n;
+      sum[k] += n;
+      sum2[k] += n*n;
+      if (k > 0)
+	sd_within += (n-cur[k-1])*(n-cur[k-1]);
+      if (t_idx > 0)
+	sd_across += (n-prev[k])*(n-prev[k]);
+    }
+    total += trial_sum;
+    ss_within += trial_sum2-trial_sum*trial_sum/K;
+    double * swap = prev;
+    prev = cur;
+    cur = swap;
+  }
+  double ss_across = 0.;
+  for (size_t k=0; k<K; k++)
+    ss_across += sum2[k]-sum[k]*sum[k]/R;
+  double mean = total/(R*K);
+  res->mean[w_idx] = mean;
+  if (K > 1)
+  {
+    res->var_within[w_idx] = ss_within/(R*(K-1));
+    res->fano_within[w_idx] = res->var_within[w_idx]/mean;
+    res->allan_within[w_idx] = sd_within/(2.*R*(K-1)*mean);
+  }
+  if (R > 1)
+  {
+    res->var_across[w_idx] = ss_across/(K*(R-1));
+    res->fano_across[w_idx] = res->var_across[w_idx]/mean;
+    res->allan_across[w_idx] = sd_across/(2.*K*(R-1)*mean);
+  }
+  aspa_ctx_free(counts);
+}
+
+/** Allocates an aspa_variance_time for n_windows widths */
+static aspa_variance_time * vt_alloc(size_t n_windows)
+{
+  aspa_variance_time * res = malloc(sizeof(aspa_variance_time));
+  double * buffer = malloc(8*n_windows*sizeof(double));
+  if (res == NULL || buffer == NULL)
+  {
+    free(res);
+    free(buffer);
+    aspa_ctx_error(ASPA_ENOMEM,"Allocation of the variance-time curves failed.");
+    return NULL;
+  }
+  res->n_windows = n_windows;
+  res->window = buffer;
+  res->mean = buffer+n_windows;
+  res->var_within = buffer+2*n_windows;
+  res->fano_within = buffer+3*n_windows;
+  res->allan_within = buffer+4*n_windows;
+  res->var_across = buffer+5*n_windows;
+  res->fano_across = buffer+6*n_windows;
+  res->allan_across = buffer+7*n_windows;
+  return res;
+}
+
+/** @brief Frees an aspa_variance_time
+ *
+ *  @param[in/out] vt a pointer to an allocated aspa_variance_time
+ *  @returns 0 if everything goes fine
+*/
+int aspa_variance_time_free(aspa_variance_time * vt)
+{
+  free(vt->window);
+  free(vt);
+  return 0;
+}
+
+/** @brief Returns the variance-time curves of an aspa_sta
+ *
+ *  See aspa_vartime.c. For each window width, the range [from,to] of
+ *  the trials is cut into floor((to-from)/width) windows starting at
+ *  from; the mean count of a window, the variance, Fano and Allan
+ *  factors within trial and across trials are returned. A quantity
+ *  that needs two windows (or two trials) is NaN when there is only
+ *  one, all of them are NaN for a width larger than the range. If
+ *  `from >= to`, the whole trial, [0,trial_duration], is used. The
+ *  spike times of each trial must be sorted.
+ *
+ *  @param[in] sta a pointer to an aspa_sta structure
+ *  @param[in] from the left end of the counted range
+ *  @param[in] to the right end of the counted range
+ *  @param[in] windows the n_windows window widths (s), > 0
+ *  @param[in] n_windows the number of widths
+ *  @returns a pointer to an allocated aspa_variance_time, NULL if
+ *           something went wrong
+*/
+aspa_variance_time * aspa_sta_variance_time(const aspa_sta * sta, double from, double to,
+					    const double * windows, size_t n_windows)
+{
+  ASPA_PROF_SCOPE();
+  ASPA_PROF_SPIKES(aspa_sta_n_spikes(sta));
+  if (from >= to)
+  {
+    from = 0.;
+    to = sta->trial_duration;
+  }
+  if (sta->n_trials == 0 || n_windows == 0 || !(to-from > 0.))
+  {
+    aspa_ctx_error(ASPA_EINVAL,"The variance-time curves need trials, windows and a"
+		   " time range > 0.");
+    return NULL;
+  }
+  size_t work = 0;
+  for (size_t w_idx=0; w_idx < n_windows; w_idx++)
+  {
+    if (!(windows[w_idx] > 0.))
+    {
+      aspa_ctx_error(ASPA_EINVAL,"The counting windows should be > 0.");
+      return NULL;
+    }
+    work += sta->n_trials*(size_t) floor((to-from)/windows[w_idx]);
+  }
+  aspa_variance_time * res = vt_alloc(n_windows);
+  if (res == NULL)
+    return NULL;
+  int * status = aspa_ctx_malloc(n_windows*sizeof(int));
+  if (status == NULL)
+  {
+    aspa_variance_time_free(res);
+    return NULL;
+  }
+  memcpy(res->window,windows,n_windows*sizeof(double));
+  vt_job job = {.sta=sta, .from=from, .duration=to-from, .res=res, .status=status};
+  aspa_parallel_for(n_windows,work,vt_window,&job);
+  int ret = 0;
+  for (size_t w_idx=0; w_idx < n_windows; w_idx++)
+    if (status[w_idx] != 0)
+      ret = aspa_ctx_error(status[w_idx],"Allocation of the counts failed.");
+  aspa_ctx_free(status);
+  if (ret != 0)
+  {
+    aspa_variance_time_free(res);
+    return NULL;
+  }
+  return res;
+}
+
+/** @brief Plots the Fano factors of variance-time curves
+ *
+ *  The Fano factors within trial and across trials are plotted
+ *  against the window width, on log scales.
+ *  A new window of the gnuplot session pops up.
+ *
+ *  @param[in] vt a pointer to an aspa_variance_time
+ *  @returns 0 if everything goes fine, an error code otherwise
+*/
+int aspa_variance_time_plot_i(const aspa_variance_time * vt)
+{
+  FILE * gp = aspa_gp_window();
+  if (gp == NULL)
+    return ASPA_FAILURE;
+  fprintf(gp,"set logscale xy\n");
+  fprintf(gp,"set key\n");
+  fprintf(gp,"set xlabel 'Window width (s)'\n");
+  fprintf(gp,"set ylabel 'Fano factor'\n");
+  fprintf(gp," plot ");
+  aspa_gp_binary_spec(gp,vt->n_windows);
+  fprintf(gp," u 1:2 with linespoints title 'within trial', ");
+  aspa_gp_binary_spec(gp,vt->n_windows);
+  fprintf(gp," u 1:2 with linespoints title 'across trials', 1 with lines title 'Poisson'\n");
+  aspa_gp_binary_write(gp,vt->window,vt->fano_within,vt->n_windows);
+  aspa_gp_binary_write(gp,vt->window,vt->fano_across,vt->n_windows);
+  return aspa_gp_end(gp);
+}
+
+/** @brief Writes variance-time curves to a file in a gnuplot friendly
+ *         format
+ *
+ *  One row per window width with the columns: width, mean count,
+ *  variance, Fano and Allan factors within trial, variance, Fano and
+ *  Allan factors across trials.
+ *
+ *  @param[in/out] STREAM an open file
+ *  @param[in] vt a pointer to an aspa_variance_time
+ *  @returns 0 if everything goes fine, ASPA_EIO if the writing failed
+*/
+int aspa_variance_time_plot_g(FILE * STREAM, const aspa_variance_time * vt)
+{
+  for (size_t w_idx=0; w_idx < vt->n_windows; w_idx++)
+    fprintf(STREAM,"%g %g %g %g %g %g %g %g\n",vt->window[w_idx],vt->mean[w_idx],
+	    vt->var_within[w_idx],vt->fano_within[w_idx],vt->allan_within[w_idx],
+	    vt->var_across[w_idx],vt->fano_across[w_idx],vt->allan_across[w_idx]);
+  fprintf(STREAM,"\n\n");
+  if (ferror(STREAM))
+    return aspa_ctx_error(ASPA_EIO,"Writing the variance-time curves failed.");
+  return 0;
+}
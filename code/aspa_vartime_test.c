@@ -0,0 +1,97 @@
+/** @file aspa_vartime_test.c
+ *  @brief User program for testing function aspa_sta_variance_time
+ *
+ *  The variance-time curves of a simulated gamma train are computed for
+ *  four windows. The mean and the within trial variance of the 1 s
+ *  windows are compared with the spikes counted one by one; a single
+ *  window per trial gives no within trial variance and a window longer
+ *  than the trials no value at all (NaN). On 200 full trials of 10 s of
+ *  an homogeneous Poisson train the Fano and Allan factors, within and
+ *  across trials, must be within 10% of 1 for windows of 0.1 and 1 s.
+ *
+ *  @author Christophe Pouzat <christophe.pouzat@parisdescartes.fr>
+*/
+#include "aspa_test.h"
+
+/** Returns 200 trials of 10 s of an homogeneous Poisson train of rate
+    20 Hz, the last trial is not cut short */
+aspa_sta * poisson_sta(void)
+{
+  gsl_rng * rng = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(rng,ASPA_TEST_SEED);
+  gsl_vector * train = aspa_sim_poisson(rng,45000,20.);
+  size_t n = 0;
+  while (n < train->size && gsl_vector_get(train,n) < 2000.)
+    n++;
+  gsl_vector_view head = gsl_vector_subvector(train,0,n);
+  aspa_sta * res = aspa_sim_sta(&head.vector,10.);
+  gsl_vector_free(train);
+  gsl_rng_free(rng);
+  return res;
+}
+
+int main()
+{
+  aspa_sta * sta = test_sim_sta(ASPA_TEST_SEED,4000,15.,2.,10.);
+  double windows[4] = {0.01,1.,0.6*sta->trial_duration,2.*sta->trial_duration};
+  aspa_variance_time * vt = aspa_sta_variance_time(sta,0.,0.,windows,4);
+  if (vt == NULL)
+  {
+    fprintf(stderr,"aspa_sta_variance_time failed\n");
+    exit(EXIT_FAILURE);
+  }
+  // the counts of the 1 s windows
+  size_t K = (size_t) floor(sta->trial_duration), R = sta->n_trials;
+  double s = 0., s_within = 0.;
+  for (size_t t_idx=0; t_idx<R; t_idx++)
+  {
+    double t_s = 0., t_s2 = 0.;
+    for (size_t k=0; k<K; k++)
+    {
+      double n = 0.;
+      for (size_t i=0; i<sta->st[t_idx]->size; i++)
+      {
+	double t = gsl_vector_get(sta->st[t_idx],i);
+	n += t >= k && t < k+1.;
+      }
+      t_s += n;
+      t_s2 += n*n;
+    }
+    s += t_s;
+    s_within += t_s2-t_s*t_s/K;
+  }
+  size_t n_failed = 0;
+  test_header("value");
+  n_failed += test_report("1 s windows, mean (relative)",fabs(vt->mean[1]-s/(R*K))/vt->mean[1],1e-12);
+  n_failed += test_report("1 s windows, within variance (relative)",
+			  fabs(vt->var_within[1]-s_within/(R*(K-1)))/vt->var_within[1],1e-9);
+  n_failed += test_report("one window per trial, wrong NaN",
+			  !isnan(vt->fano_within[2])+isnan(vt->fano_across[2]),0.);
+  n_failed += test_report("window above the trials, wrong NaN",
+			  !isnan(vt->mean[3])+!isnan(vt->fano_across[3]),0.);
+  aspa_variance_time_free(vt);
+  aspa_sta_free(sta);
+  // Poisson train, factors of 1
+  sta = poisson_sta();
+  double poisson_windows[2] = {0.1,1.};
+  vt = sta->n_trials == 200 ? aspa_sta_variance_time(sta,0.,0.,poisson_windows,2) : NULL;
+  if (vt == NULL)
+    n_failed++;
+  else
+  {
+    double diff_within = 0., diff_across = 0.;
+    for (size_t w_idx=0; w_idx<2; w_idx++)
+    {
+      diff_within = GSL_MAX(diff_within,GSL_MAX(fabs(vt->fano_within[w_idx]-1.),
+						fabs(vt->allan_within[w_idx]-1.)));
+      diff_across = GSL_MAX(diff_across,GSL_MAX(fabs(vt->fano_across[w_idx]-1.),
+						fabs(vt->allan_across[w_idx]-1.)));
+    }
+    n_failed += test_report("Poisson, Fano and Allan within - 1",diff_within,0.1);
+    n_failed += test_report("Poisson, Fano and Allan across - 1",diff_across,0.1);
+    aspa_variance_time_free(vt);
+  }
+  aspa_sta_free(sta);
+  printf("Checks failed: %d (0 expected).\n",(int) n_failed);
+  return n_failed == 0 ? 0 : 1;
+}